@@ -10,6 +10,8 @@
 #include <algorithm>
 #include <cstring>
 #include <errno.h>
+#include <functional>
+#include <future>
 
 /// Set RG_BUILD_DEBUG to 0 to disable debug features.
 #ifndef RG_BUILD_DEBUG
@@ -358,6 +360,13 @@ const char * formatstr(const char * format, ...);
 /// convert duration in nanoseconds to string
 std::string ns2str(uint64_t ns);
 
+/// Set max number of threads, including the calling thread, that CPU heavy functions like convert() can use.
+/// 0 means using all hardware threads, which is the default. 1 disables multithreading.
+void setMaxWorkerThreads(uint32_t);
+
+/// Returns max number of threads that CPU heavy functions can use. Never returns 0.
+uint32_t getMaxWorkerThreads();
+
 /// call exit function automatically at scope exit
 template<typename PROC>
 class ScopeExit {
@@ -805,6 +814,27 @@ union ColorFormat {
         LAYOUT_DXT3A_AS_1_1_1_1,
         LAYOUT_GRGB,
         LAYOUT_RGBG,
+        LAYOUT_BC6H,
+        LAYOUT_BC7,
+        LAYOUT_ETC2,
+        LAYOUT_ETC2_A1,
+        LAYOUT_ETC2_EAC,
+        LAYOUT_EAC_R11,
+        LAYOUT_EAC_RG11,
+        LAYOUT_ASTC_4x4,
+        LAYOUT_ASTC_5x4,
+        LAYOUT_ASTC_5x5,
+        LAYOUT_ASTC_6x5,
+        LAYOUT_ASTC_6x6,
+        LAYOUT_ASTC_8x5,
+        LAYOUT_ASTC_8x6,
+        LAYOUT_ASTC_8x8,
+        LAYOUT_ASTC_10x5,
+        LAYOUT_ASTC_10x6,
+        LAYOUT_ASTC_10x8,
+        LAYOUT_ASTC_10x10,
+        LAYOUT_ASTC_12x10,
+        LAYOUT_ASTC_12x12,
         NUM_COLOR_LAYOUTS,
     };
     static_assert(NUM_COLOR_LAYOUTS <= 64);
@@ -824,7 +854,7 @@ union ColorFormat {
         uint8_t     blockWidth  : 4;    ///< width of color block
         uint8_t     blockHeight : 4;    ///< heiht of color block
         uint8_t     blockBytes;         ///< bytes of one color block
-        uint8_t     pixelBits;          ///< bits per pixel
+        uint8_t     pixelBits;          ///< bits per pixel, rounded up for ASTC blocks that have fractional bits per pixel
         uint8_t     numChannels;        ///< number of channels
         ChannelDesc channels[4];        ///< channel descriptors
     };
@@ -837,10 +867,10 @@ union ColorFormat {
         { 0 , 0 , 0  , 0   , 0 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_UNKNOWN,
         { 8 , 1 , 1  , 1   , 1 , { { 0 , 1  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_1,
         { 1 , 1 , 1  , 8   , 4 , { { 0 , 2  }, { 2  , 2  }, { 4  , 2  }, { 6  , 2  } } }, //LAYOUT_2_2_2_2,
-        { 1 , 1 , 1  , 8   , 3 , { { 0 , 3  }, { 3  , 3  }, { 8  , 2  }, { 0  , 0  } } }, //LAYOUT_3_3_2,
+        { 1 , 1 , 1  , 8   , 3 , { { 0 , 3  }, { 3  , 3  }, { 6  , 2  }, { 0  , 0  } } }, //LAYOUT_3_3_2,
         { 1 , 1 , 1  , 8   , 2 , { { 0 , 4  }, { 4  , 4  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_4_4,
         { 1 , 1 , 2  , 16  , 4 , { { 0 , 4  }, { 4  , 4  }, { 8  , 4  }, { 12 , 4  } } }, //LAYOUT_4_4_4_4,
-        { 1 , 1 , 2  , 16  , 4 , { { 0 , 5  }, { 10 , 5  }, { 15 , 5  }, { 15 , 1  } } }, //LAYOUT_5_5_5_1,
+        { 1 , 1 , 2  , 16  , 4 , { { 0 , 5  }, { 5  , 5  }, { 10 , 5  }, { 15 , 1  } } }, //LAYOUT_5_5_5_1,
         { 1 , 1 , 2  , 16  , 3 , { { 0 , 5  }, { 5  , 6  }, { 11 , 5  }, { 0  , 0  } } }, //LAYOUT_5_6_5,
         { 1 , 1 , 1  , 8   , 1 , { { 0 , 8  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_8,
         { 1 , 1 , 2  , 16  , 2 , { { 0 , 8  }, { 8  , 8  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_8_8,
@@ -851,7 +881,7 @@ union ColorFormat {
         { 1 , 1 , 4  , 32  , 4 , { { 0 , 10 }, { 10 , 10 }, { 20 , 10 }, { 30 , 2  } } }, //LAYOUT_10_10_10_2,
         { 1 , 1 , 2  , 16  , 1 , { { 0 , 16 }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_16,
         { 1 , 1 , 4  , 32  , 2 , { { 0 , 16 }, { 16 , 16 }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_16_16,
-        { 1 , 1 , 8  , 64  , 4 , { { 0 , 16 }, { 16 , 16 }, { 32 , 16 }, { 48 , 1  } } }, //LAYOUT_16_16_16_16,
+        { 1 , 1 , 8  , 64  , 4 , { { 0 , 16 }, { 16 , 16 }, { 32 , 16 }, { 48 , 16 } } }, //LAYOUT_16_16_16_16,
         { 1 , 1 , 4  , 32  , 1 , { { 0 , 32 }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_32,
         { 1 , 1 , 8  , 64  , 2 , { { 0 , 32 }, { 32 , 32 }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_32_32,
         { 1 , 1 , 12 , 96  , 3 , { { 0 , 32 }, { 32 , 32 }, { 64 , 32 }, { 0  , 0  } } }, //LAYOUT_32_32_32,
@@ -859,7 +889,7 @@ union ColorFormat {
         { 1 , 1 , 3  , 24  , 1 , { { 0 , 24 }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_24,
         { 1 , 1 , 4  , 32  , 2 , { { 0 , 8  }, { 8  , 24 }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_8_24,
         { 1 , 1 , 4  , 32  , 2 , { { 0 , 24 }, { 24 , 8  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_24_8,
-        { 1 , 1 , 4  , 32  , 4 , { { 0 , 4  }, { 4  , 4  }, { 8  , 24 }, { 0  , 0  } } }, //LAYOUT_4_4_24,
+        { 1 , 1 , 4  , 32  , 3 , { { 0 , 4  }, { 4  , 4  }, { 8  , 24 }, { 0  , 0  } } }, //LAYOUT_4_4_24,
         { 1 , 1 , 8  , 64  , 3 , { { 0 , 32 }, { 32 , 8  }, { 40 , 24 }, { 0  , 0  } } }, //LAYOUT_32_8_24,
         { 4 , 4 , 8  , 4   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_DXT1,
         { 4 , 4 , 16 , 8   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_DXT3,
@@ -871,6 +901,27 @@ union ColorFormat {
         { 4 , 4 , 8  , 4   , 4 , { { 0 , 1  }, { 1  , 1  }, { 2  , 1  }, { 3  , 1  } } }, //LAYOUT_DXT3A_AS_1_1_1_1,
         { 2 , 1 , 4  , 16  , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_GRGB,
         { 2 , 1 , 4  , 16  , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_RGBG,
+        { 4 , 4 , 16 , 8   , 3 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_BC6H,
+        { 4 , 4 , 16 , 8   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_BC7,
+        { 4 , 4 , 8  , 4   , 3 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ETC2,
+        { 4 , 4 , 8  , 4   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ETC2_A1,
+        { 4 , 4 , 16 , 8   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ETC2_EAC,
+        { 4 , 4 , 8  , 4   , 1 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_EAC_R11,
+        { 4 , 4 , 16 , 8   , 2 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_EAC_RG11,
+        { 4 , 4 , 16 , 8   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_4x4,
+        { 5 , 4 , 16 , 7   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_5x4,
+        { 5 , 5 , 16 , 6   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_5x5,
+        { 6 , 5 , 16 , 5   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_6x5,
+        { 6 , 6 , 16 , 4   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_6x6,
+        { 8 , 5 , 16 , 4   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_8x5,
+        { 8 , 6 , 16 , 3   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_8x6,
+        { 8 , 8 , 16 , 2   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_8x8,
+        { 10, 5 , 16 , 3   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_10x5,
+        { 10, 6 , 16 , 3   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_10x6,
+        { 10, 8 , 16 , 2   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_10x8,
+        { 10, 10, 16 , 2   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_10x10,
+        { 12, 10, 16 , 2   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_12x10,
+        { 12, 12, 16 , 1   , 4 , { { 0 , 0  }, { 0  , 0  }, { 0  , 0  }, { 0  , 0  } } }, //LAYOUT_ASTC_12x12,
     };
     static_assert(std::size(LAYOUTS) == NUM_COLOR_LAYOUTS);
     static_assert(LAYOUTS[LAYOUT_UNKNOWN].blockWidth == 0);
@@ -879,15 +930,16 @@ union ColorFormat {
     /// color sign
     ///
     enum Sign {
-        SIGN_UNORM, ///< normalized unsigned integer
-        SIGN_SNORM, ///< normalized signed integer
-        SIGN_GNORM, ///< normalized gamma integer
-        SIGN_BNORM, ///< normalized bias integer
-        SIGN_UINT,  ///< unsigned integer
-        SIGN_SINT,  ///< signed integer
-        SIGN_GINT,  ///< gamma integer
-        SIGN_BINT,  ///< bias integer
-        SIGN_FLOAT, ///< float
+        SIGN_UNORM,  ///< normalized unsigned integer
+        SIGN_SNORM,  ///< normalized signed integer
+        SIGN_GNORM,  ///< normalized gamma integer
+        SIGN_BNORM,  ///< normalized bias integer
+        SIGN_UINT,   ///< unsigned integer
+        SIGN_SINT,   ///< signed integer
+        SIGN_GINT,   ///< gamma integer
+        SIGN_BINT,   ///< bias integer
+        SIGN_FLOAT,  ///< float
+        SIGN_UFLOAT, ///< unsigned float. Only used by block compressed formats, like BC6H_UF16.
     };
 
     ///
@@ -973,10 +1025,10 @@ union ColorFormat {
             l,
             si012,
             si3,
-            (Swizzle)(((int)sw0123>>0)&3),
-            (Swizzle)(((int)sw0123>>3)&3),
-            (Swizzle)(((int)sw0123>>6)&3),
-            (Swizzle)(((int)sw0123>>9)&3));
+            (Swizzle)(((int)sw0123>>0)&7),
+            (Swizzle)(((int)sw0123>>3)&7),
+            (Swizzle)(((int)sw0123>>6)&7),
+            (Swizzle)(((int)sw0123>>9)&7));
     }
 
     ///
@@ -997,8 +1049,8 @@ union ColorFormat {
     constexpr bool valid() const {
         return
             0 < layout && layout < NUM_COLOR_LAYOUTS &&
-            sign012  <= SIGN_FLOAT &&
-            sign3    <= SIGN_FLOAT &&
+            sign012  <= SIGN_UFLOAT &&
+            sign3    <= SIGN_UFLOAT &&
             swizzle0 <= SWIZZLE_1 &&
             swizzle1 <= SWIZZLE_1 &&
             swizzle2 <= SWIZZLE_1 &&
@@ -1081,7 +1133,7 @@ union ColorFormat {
 
     // 32 bits
     static constexpr ColorFormat RGBA_8_8_8_8_UNORM()          { return make(LAYOUT_8_8_8_8, SIGN_UNORM, SWIZZLE_RGBA); }
-    static constexpr ColorFormat RGBA_8_8_8_8_UNORM_SRGB()     { return make(LAYOUT_8_8_8_8, SIGN_UNORM, SIGN_GNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat RGBA_8_8_8_8_UNORM_SRGB()     { return make(LAYOUT_8_8_8_8, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
     static constexpr ColorFormat RGBA_8_8_8_8_SNORM()          { return make(LAYOUT_8_8_8_8, SIGN_SNORM, SWIZZLE_RGBA); }
     static constexpr ColorFormat RGBA8()                       { return RGBA_8_8_8_8_UNORM(); }
     static constexpr ColorFormat UBYTE4N()                     { return RGBA_8_8_8_8_UNORM(); }
@@ -1097,6 +1149,8 @@ union ColorFormat {
     static constexpr ColorFormat RGBA_10_10_10_2_UINT()        { return make(LAYOUT_10_10_10_2, SIGN_UINT , SWIZZLE_RGBA); }
     static constexpr ColorFormat RGBA_10_10_10_SNORM_2_UNORM() { return make(LAYOUT_10_10_10_2, SIGN_SNORM, SIGN_UNORM, SWIZZLE_RGBA); }
 
+    static constexpr ColorFormat RGB_11_11_10_FLOAT()          { return make(LAYOUT_11_11_10, SIGN_FLOAT, SWIZZLE_RGB1); }
+
     static constexpr ColorFormat RG_16_16_UNORM()              { return make(LAYOUT_16_16, SIGN_UNORM, SWIZZLE_RG01); }
     static constexpr ColorFormat RG_16_16_SNORM()              { return make(LAYOUT_16_16, SIGN_SNORM, SWIZZLE_RG01); }
     static constexpr ColorFormat RG_16_16_UINT()               { return make(LAYOUT_16_16, SIGN_UINT, SWIZZLE_RG01); }
@@ -1185,10 +1239,40 @@ union ColorFormat {
     static constexpr ColorFormat DXT3_UNORM_SRGB()             { return make(LAYOUT_DXT3, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
     static constexpr ColorFormat DXT5_UNORM()                  { return make(LAYOUT_DXT5, SIGN_UNORM, SWIZZLE_RGBA); }
     static constexpr ColorFormat DXT5_UNORM_SRGB()             { return make(LAYOUT_DXT5, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
-    static constexpr ColorFormat DXT5A_UNORM()                 { return make(LAYOUT_DXT5A, SIGN_UNORM, SWIZZLE_RGBA); }
-    static constexpr ColorFormat DXT5A_SNORM()                 { return make(LAYOUT_DXT5A, SIGN_SNORM, SWIZZLE_RGBA); }
-    static constexpr ColorFormat DXN_UNORM()                   { return make(LAYOUT_DXN, SIGN_UNORM, SWIZZLE_RGBA); }
-    static constexpr ColorFormat DXN_SNORM()                   { return make(LAYOUT_DXN, SIGN_SNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat DXT5A_UNORM()                 { return make(LAYOUT_DXT5A, SIGN_UNORM, SWIZZLE_R001); }
+    static constexpr ColorFormat DXT5A_SNORM()                 { return make(LAYOUT_DXT5A, SIGN_SNORM, SWIZZLE_R001); }
+    static constexpr ColorFormat DXN_UNORM()                   { return make(LAYOUT_DXN, SIGN_UNORM, SWIZZLE_RG01); }
+    static constexpr ColorFormat DXN_SNORM()                   { return make(LAYOUT_DXN, SIGN_SNORM, SWIZZLE_RG01); }
+    static constexpr ColorFormat CTX1_UNORM()                  { return make(LAYOUT_CTX1, SIGN_UNORM, SWIZZLE_RG01); }
+    static constexpr ColorFormat DXT3A_AS_1_1_1_1_UNORM()      { return make(LAYOUT_DXT3A_AS_1_1_1_1, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat BC6H_UF16()                   { return make(LAYOUT_BC6H, SIGN_UFLOAT, SWIZZLE_RGB1); }
+    static constexpr ColorFormat BC6H_SF16()                   { return make(LAYOUT_BC6H, SIGN_FLOAT, SWIZZLE_RGB1); }
+    static constexpr ColorFormat BC7_UNORM()                   { return make(LAYOUT_BC7, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat BC7_UNORM_SRGB()              { return make(LAYOUT_BC7, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat ETC1_UNORM()                  { return ETC2_UNORM(); } // ETC2 is a superset of ETC1.
+    static constexpr ColorFormat ETC2_UNORM()                  { return make(LAYOUT_ETC2, SIGN_UNORM, SWIZZLE_RGB1); }
+    static constexpr ColorFormat ETC2_UNORM_SRGB()             { return make(LAYOUT_ETC2, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGB1); }
+    static constexpr ColorFormat ETC2_A1_UNORM()               { return make(LAYOUT_ETC2_A1, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat ETC2_A1_UNORM_SRGB()          { return make(LAYOUT_ETC2_A1, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat ETC2_EAC_UNORM()              { return make(LAYOUT_ETC2_EAC, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat ETC2_EAC_UNORM_SRGB()         { return make(LAYOUT_ETC2_EAC, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat EAC_R11_UNORM()               { return make(LAYOUT_EAC_R11, SIGN_UNORM, SWIZZLE_R001); }
+    static constexpr ColorFormat EAC_R11_SNORM()               { return make(LAYOUT_EAC_R11, SIGN_SNORM, SWIZZLE_R001); }
+    static constexpr ColorFormat EAC_RG11_UNORM()              { return make(LAYOUT_EAC_RG11, SIGN_UNORM, SWIZZLE_RG01); }
+    static constexpr ColorFormat EAC_RG11_SNORM()              { return make(LAYOUT_EAC_RG11, SIGN_SNORM, SWIZZLE_RG01); }
+
+    /// ASTC formats of all 2D block footprints. Only the LDR profile is decoded. Blocks of HDR endpoint modes are
+    /// decoded to the error color (magenta).
+    static constexpr ColorFormat ASTC_UNORM(Layout l)          { return make(l, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat ASTC_UNORM_SRGB(Layout l)     { return make(l, SIGN_GNORM, SIGN_UNORM, SWIZZLE_RGBA); }
+    static constexpr ColorFormat ASTC_4x4_UNORM()              { return ASTC_UNORM(LAYOUT_ASTC_4x4); }
+    static constexpr ColorFormat ASTC_4x4_UNORM_SRGB()         { return ASTC_UNORM_SRGB(LAYOUT_ASTC_4x4); }
+    static constexpr ColorFormat ASTC_6x6_UNORM()              { return ASTC_UNORM(LAYOUT_ASTC_6x6); }
+    static constexpr ColorFormat ASTC_6x6_UNORM_SRGB()         { return ASTC_UNORM_SRGB(LAYOUT_ASTC_6x6); }
+    static constexpr ColorFormat ASTC_8x8_UNORM()              { return ASTC_UNORM(LAYOUT_ASTC_8x8); }
+    static constexpr ColorFormat ASTC_8x8_UNORM_SRGB()         { return ASTC_UNORM_SRGB(LAYOUT_ASTC_8x8); }
+    static constexpr ColorFormat ASTC_12x12_UNORM()            { return ASTC_UNORM(LAYOUT_ASTC_12x12); }
+    static constexpr ColorFormat ASTC_12x12_UNORM_SRGB()       { return ASTC_UNORM_SRGB(LAYOUT_ASTC_12x12); }
 };
 static_assert(4 == sizeof(ColorFormat));
 static_assert(ColorFormat::UNKNOWN().layoutDesc().blockWidth == 0);
@@ -1242,10 +1326,11 @@ struct ImagePlaneDesc {
     uint32_t step = 0;
 
     /// Bytes from one row to next. Minimal valid value is (width * step) and aligned to pixel boundary.
-    /// For compressed format, this is number of bytes in one scanline.
+    /// For compressed format, this is number of bytes in one row of blocks, since blocks like ASTC 5x5 don't have
+    /// whole number of bytes per scanline.
     uint32_t pitch = 0;
 
-    /// Bytes from one slice to next. Minimal valid value is (pitch * height)
+    /// Bytes from one slice to next. Minimal valid value is (pitch * number of rows)
     uint32_t slice = 0;
 
     /// Bytes of the whole plane. Minimal valid value is (slice * depth)
@@ -1257,10 +1342,14 @@ struct ImagePlaneDesc {
     // /// Memory alignment requirement of the plane. The value must be power of 2.
     // uint32_t alignment = 0;
 
-    /// returns offset of particular pixel within the plane
+    /// returns offset of particular pixel within the plane. For compressed format, it is offset of the block that
+    /// the pixel belongs to.
     size_t pixel(size_t x, size_t y, size_t z = 0) const {
         RG_ASSERT(x < width && y < height && z < depth);
-        size_t r = z * slice + y * pitch + x * step / 8;
+        const auto & ld = format.layoutDesc();
+        size_t       r  = z * slice;
+        r += ld.blockHeight > 1 ? y / ld.blockHeight * pitch : y * pitch;
+        r += ld.blockWidth > 1 ? x / ld.blockWidth * ld.blockBytes : x * step / 8;
         RG_ASSERT(r < size);
         return r + offset;
     }
@@ -1302,23 +1391,24 @@ struct ImagePlaneDesc {
                                size_t width, size_t height = 1, size_t depth = 1,
                                size_t step = 0, size_t pitch = 0, size_t slice = 0);
 
-    /// Save the image plane to PNG file. This method only supports 8-bit and 16-bit image.
+    /// Save the image plane to PNG file. This method only supports 8-bit and 16-bit image. Block compressed planes
+    /// are decoded before saving.
     /// \param filename Target filename
     /// \param pixels   The pixel array. The buffer length should be no less than ImagePlaneDesc::size.
     ///                 Or else, the behavior is undefined.
-    void saveToPNG(const std::string & filename, const void * pixels, uint32_t z = 0);
+    void saveToPNG(const std::string & filename, const void * pixels, uint32_t z = 0) const;
 
     /// Save the image plane to JPG file. This method only supports 8-bit and 16-bit image.
     /// \param filename Target filename
     /// \param pixels   The pixel array The buffer length should be no less than ImagePlaneDesc::size.
     /// \param quality  Compression quality. Valid range is [1, 100];
-    void saveToJPG(const std::string & filename, const void * pixels, uint32_t z = 0, int quality = 80);
+    void saveToJPG(const std::string & filename, const void * pixels, uint32_t z = 0, int quality = 80) const;
 
     /// Save the image to .HDR format. This method will try convert everything to float4
-    void saveToHDR(const std::string & filename, const void * pixels, uint32_t z = 0);
+    void saveToHDR(const std::string & filename, const void * pixels, uint32_t z = 0) const;
 
     /// A general save function. Use extension to determin file format. For JPG, will save as default quality.
-    void save(const std::string & filename, const void * pixels, uint32_t z = 0);
+    void save(const std::string & filename, const void * pixels, uint32_t z = 0) const;
 };
 
 ///
@@ -1542,6 +1632,149 @@ struct ImageProxy {
     }
 };
 
+///
+/// Quality of block compression, used when converting pixels to block compressed formats.
+///
+enum class CompressionQuality {
+    /// Bounding box endpoints. BC6H and BC7 only try the single subset modes. Fast enough to compress textures at
+    /// runtime.
+    FAST,
+
+    /// Cluster fit endpoints. BC6H and BC7 search all modes, and the most promising partitions of multi subset modes.
+    /// Much slower, but with noticeably lower error. Meant for offline builds.
+    HIGH,
+};
+
+///
+/// Convert pixels of one image to another, plane by plane. The two images must have same number of layers and
+/// levels, and each pair of planes must have same dimensions. Pixels are converted directly when there is a dedicated
+/// kernel for the pair of formats. Or else, they are converted to float4 first, then to the destination format. The
+/// two images must not overlap in memory.
+///
+/// Block compressed planes (DXT1 - DXT5, DXT3A, DXT5A, DXN, BC6H, BC7, CTX1 and DXT3A_AS_1_1_1_1) and the packed 4:2:2
+/// layouts (GRGB and RGBG) are supported on both sides. They are decoded and encoded on the fly, block row by block
+/// row. 'quality' is only used when the destination is block compressed. ETC2, EAC and ASTC (LDR) planes are supported
+/// as source only.
+///
+/// \return false if the conversion can't be done. In that case, error is logged and no pixel is written.
+///
+bool convert(const ImageProxy & src, ImageProxy & dst, CompressionQuality quality = CompressionQuality::FAST);
+
+///
+/// Reconstruction filters of image resampling and mipmap generation. Each filter is stretched by the downscale ratio,
+/// so it covers all source pixels that contribute to a destination pixel.
+///
+enum class ImageFilter {
+    BOX,      ///< average of the covered source pixels. Fastest, but blurry and prone to aliasing.
+    TRIANGLE, ///< tent filter with radius of 1 pixel. Smoother than box, at about the same cost.
+    KAISER,   ///< Kaiser windowed sinc with radius of 3 pixels. Sharp, with little ringing.
+    LANCZOS,  ///< Lanczos (3 lobes) windowed sinc. Sharpest, with some ringing around hard edges.
+};
+
+///
+/// Resample pixels of one image to another, plane by plane, with a separable filter: rows are filtered horizontally
+/// first, then vertically, then across slices for volumes. The two images must have same number of layers and levels,
+/// but each pair of planes can have any dimensions and any formats that convert() supports. Volumes are limited to
+/// uncompressed formats. Pixels are filtered as linear float4 values, so sRGB (SIGN_GNORM) channels are decoded to
+/// linear space first. Filter weights are cached per pair of sizes, so resampling many images of same size is cheap to
+/// set up. Planes, slices and row bands are processed in parallel.
+///
+/// \return false if the resampling can't be done. In that case, error is logged and no pixel is written.
+///
+bool resample(const ImageProxy & src, ImageProxy & dst, ImageFilter filter = ImageFilter::LANCZOS,
+              CompressionQuality quality = CompressionQuality::FAST);
+
+///
+/// How mipmap levels are derived from the filtered pixels.
+///
+enum class MipmapMode {
+    /// Store the filtered pixels as they are.
+    COLOR,
+
+    /// The first 3 channels are tangent space normals. Normals are filtered as unit vectors, then renormalized.
+    /// UNORM channels are biased (n * 0.5 + 0.5), others are stored as is. Formats with only 2 channels, like
+    /// DXN_UNORM and RG_8_8_SNORM, store x and y only: z is reconstructed before filtering.
+    NORMAL_MAP,
+
+    /// Alpha is scaled on each level, so that the fraction of pixels that pass the alpha test stays the same as the
+    /// base level. Otherwise, alpha tested geometry like foliage thins out and vanishes at distance.
+    ALPHA_COVERAGE,
+};
+
+///
+/// Options of generateMipmaps().
+///
+struct MipmapOptions {
+    ImageFilter        filter         = ImageFilter::BOX;
+    MipmapMode         mode           = MipmapMode::COLOR;
+    float              alphaReference = 0.5f; ///< alpha test reference of ALPHA_COVERAGE mode. alpha >= ref passes.
+    CompressionQuality quality        = CompressionQuality::FAST; ///< used only when encoding compressed levels.
+};
+
+///
+/// Fill mipmap levels 1 to N of every layer of the image, each level filtered from the previous one. Pixels are
+/// filtered as linear float4 values: sRGB (SIGN_GNORM) channels are decoded to linear space first, and encoded back
+/// afterwards. Layers and row bands of each level are processed in parallel, and so are the per level passes of the
+/// special modes. Plane offsets come from the descriptor, so both MIP_MAJOR and FACE_MAJOR images are supported.
+///
+/// Block compressed planes are decoded and encoded on the fly, like convert().
+///
+/// Volume textures are filtered in all 3 dimensions, slab of slices by slab in parallel. To keep memory usage low,
+/// each level is filtered from the stored pixels of the previous level, instead of float4 pixels. Only uncompressed
+/// formats and COLOR mode are supported for volumes.
+///
+/// \return false if the format can't be converted to/from float4, or the volume texture is not supported. In that
+///         case, error is logged and no pixel is written.
+///
+bool generateMipmaps(ImageProxy & image, const MipmapOptions & options);
+
+///
+/// Fill mipmap levels 1 to N of every layer of the image in COLOR mode.
+///
+inline bool generateMipmaps(ImageProxy & image, ImageFilter filter = ImageFilter::BOX,
+                            CompressionQuality quality = CompressionQuality::FAST) {
+    MipmapOptions options;
+    options.filter  = filter;
+    options.quality = quality;
+    return generateMipmaps(image, options);
+}
+
+///
+/// A range of layers and mipmap levels of an image. Zero counts mean all the rest of layers or levels.
+///
+struct ImageSubset {
+    uint32_t firstLayer = 0; ///< the first layer
+    uint32_t layers     = 0; ///< number of layers
+    uint32_t firstLevel = 0; ///< the first mipmap level
+    uint32_t levels     = 0; ///< number of mipmap levels
+};
+
+///
+/// Options of RawImage::loadMany()
+///
+struct ImageLoadOptions {
+    /// Max number of files that are loaded at the same time, up to getMaxWorkerThreads(). 0 means
+    /// getMaxWorkerThreads().
+    uint32_t maxThreads = 0;
+
+    /// Max bytes of decoded images that are loaded, but not yet handed to the callback. Sizes are probed from the file
+    /// headers. A file that is larger than the budget is still loaded, when it is the only one in flight.
+    size_t maxBytesInFlight = 256 * 1024 * 1024;
+
+    /// Format of the loaded images. UNKNOWN means the format they are stored in. See RawImage::load() for details.
+    ColorFormat format = ColorFormat::UNKNOWN();
+};
+
+///
+/// Timings of loading one image file, in nanoseconds.
+///
+struct ImageLoadTiming {
+    uint64_t wait   = 0; ///< waiting for the bytes-in-flight budget
+    uint64_t read   = 0; ///< opening the file and probing its header
+    uint64_t decode = 0; ///< reading and decoding pixels from the file
+    size_t   bytes  = 0; ///< size of the decoded image, as probed from the header
+};
+
 ///
 /// A basic image class
 ///
@@ -1558,16 +1791,30 @@ public:
     RawImage(RawImage && rhs) {
         _proxy.desc = std::move(rhs._proxy.desc); RG_ASSERT(rhs._proxy.desc.empty());
         _proxy.data = rhs._proxy.data; rhs._proxy.data = nullptr;
-
+        _storage    = std::move(rhs._storage);
+        _mapped     = rhs._mapped; rhs._mapped = false;
     }
     ~RawImage();
     RawImage & operator=(RawImage && rhs) {
         if (this != &rhs) {
+            release();
             _proxy.desc = std::move(rhs._proxy.desc); RG_ASSERT(rhs._proxy.desc.empty());
             _proxy.data = rhs._proxy.data; rhs._proxy.data = nullptr;
+            _storage    = std::move(rhs._storage);
+            _mapped     = rhs._mapped; rhs._mapped = false;
         }
         return *this;
     }
+
+    /// Adopt pixels in memory that is not allocated by the image, without copying them. The image holds a reference
+    /// to 'storage', which keeps the pixels alive, and drops it when the image is released.
+    static RawImage adopt(const ImageDesc & desc, void * pixels, std::shared_ptr<void> storage);
+
+    /// Adopt pixels in memory that is not allocated by the image, without copying them. 'deleter' is called with the
+    /// pixels when the image is released.
+    static RawImage adopt(const ImageDesc & desc, void * pixels, std::function<void(void *)> deleter) {
+        return adopt(desc, pixels, std::shared_ptr<void>(pixels, std::move(deleter)));
+    }
     //@}
 
     /// \name basic property query
@@ -1594,6 +1841,12 @@ public:
     /// check if the image is empty or not.
     bool empty() const { return _proxy.desc.empty(); }
 
+    /// check if pixels are in memory mapped pages of the image file, instead of a buffer owned by the image.
+    bool mapped() const { return _mapped; }
+
+    /// check if pixels are in memory that is not allocated by the image: mapped pages, or adopted memory.
+    bool external() const { return nullptr != _storage; }
+
     //@}
 
     /// \name query properties of the specific plane.
@@ -1608,32 +1861,147 @@ public:
     //@}
 
     /// \name Image loading utilities
+    ///
+    /// Images are loaded in the format they are stored. Files decoded by stb_image (PNG, JPG, HDR, etc.) keep their
+    /// channel count and bit depth: 8-bit files are loaded as L_8, LA_8_8, RGB_8_8_8 or RGBA_8_8_8_8, 16-bit files as
+    /// L_16, LA_16_16 or RGBA_16_16_16_16 (RGB is padded with alpha), and HDR files as RGB_32_32_32_FLOAT. If 'format'
+    /// is not UNKNOWN, the image is converted to it, which fails if there's no conversion between the two formats.
     //@{
     /// Helper method to load from a binary stream.
-    static RawImage load(std::istream &);
+    static RawImage load(std::istream &, ColorFormat format = ColorFormat::UNKNOWN());
 
-    /// Helper method to load from a binary byte arry in memory.
-    static RawImage load(const ConstRange<uint8_t> &);
+    /// Helper method to load from a binary byte array in memory. The bytes are parsed in place, without copying them.
+    static RawImage load(const ConstRange<uint8_t> &, ColorFormat format = ColorFormat::UNKNOWN());
 
     /// Helper method to load from a file.
-    static RawImage load(const std::string & filename) {
+    static RawImage load(const std::string & filename, ColorFormat format = ColorFormat::UNKNOWN()) {
+        std::ifstream f(filename, std::ios::binary);
+        if (!f.good()) {
+            RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+            return {};
+        }
+        return load(f, format);
+    }
+
+    /// Load a subset of layers and mipmap levels from a binary stream. The image contains only the loaded planes, so
+    /// level 0 of the image is level 'firstLevel' of the file. Only DDS and KTX files have more than one plane to choose
+    /// from: only bytes of the subset are read, which requires the stream to be seekable. Other files are loaded as a
+    /// whole, and the subset must include the only plane.
+    static RawImage load(std::istream &, const ImageSubset &);
+
+    /// Load a subset of layers and mipmap levels from a file.
+    static RawImage load(const std::string & filename, const ImageSubset & subset) {
         std::ifstream f(filename, std::ios::binary);
         if (!f.good()) {
             RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
             return {};
         }
-        return load(f);
+        return load(f, subset);
     }
 
+    /// Load from a memory mapped file. DDS images that need no format conversion reference pixels in the mapped pages
+    /// directly, without copying them. The pages are mapped copy-on-write, so the image is still writable, while the
+    /// file stays untouched. Other images are loaded from the mapped pages, same as load(). Useful for large DDS files,
+    /// which would otherwise take twice the memory while loading.
+    static RawImage loadMapped(const std::string & filename);
+
+    /// Load the file on one of the shared worker threads. The file is decoded from a file stream. The returned future
+    /// holds an empty image if the loading fails.
+    static std::future<RawImage> loadAsync(const std::string & filename, ColorFormat format = ColorFormat::UNKNOWN());
+
+    /// Callback of loadMany(): index of the file in the list, the image (empty if the loading fails), and timings.
+    using LoadCallback = std::function<void(size_t index, RawImage && image, const ImageLoadTiming & timing)>;
+
+    /// Load a batch of files on the shared worker threads, including the calling thread, and return after all of them
+    /// are done. Files are started in order, and each thread probes its file, waits for the budget, then decodes it,
+    /// so I/O of some files overlaps with decoding of others. The callback is called on the loading threads, one at a
+    /// time, as soon as each file is done. If the callback throws, files that are not started yet are skipped, and the
+    /// first exception is rethrown to the caller.
+    static void loadMany(const std::vector<std::string> & filenames, const LoadCallback & callback,
+                         const ImageLoadOptions & options = {});
+
+    //@}
+
+    /// \name Image saving utilities
+    //@{
+    /// Save all layers and mipmap levels as KTX2 file. Optionally, each level is supercompressed with zlib. If 'cubemap'
+    /// is true, every 6 layers are faces of one cubemap. Fails if the color format has no Vulkan equivalent.
+    bool saveKTX2(std::ostream &, bool zlib = false, bool cubemap = false) const;
+
+    /// Save all layers and mipmap levels as KTX2 file.
+    bool saveKTX2(const std::string & filename, bool zlib = false, bool cubemap = false) const {
+        std::ofstream f(filename, std::ios::binary);
+        if (!f.good()) {
+            RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+            return false;
+        }
+        return saveKTX2(f, zlib, cubemap);
+    }
+
+    /// Save all layers and mipmap levels as DDS file, as they are, without any conversion. If 'cubemap' is true, every
+    /// 6 layers are faces of one cubemap. Fails if the color format is not supported by DDS.
+    bool saveDDS(std::ostream &, bool cubemap = false) const;
+
+    /// Save all layers and mipmap levels as DDS file. The header and the pixels are written to the file with one
+    /// vectored write, straight from data(), on platforms that support it.
+    bool saveDDS(const std::string & filename, bool cubemap = false) const;
     //@}
 
 private:
 
     ImageProxy _proxy;
 
+    /// Keeps the memory that _proxy.data points to alive, if it is not allocated by the image itself.
+    std::shared_ptr<void> _storage;
+
+    /// True if _storage is a memory mapped image file.
+    bool _mapped = false;
+
 private:
 
     void construct(const void * initialContent, size_t initialContentSizeInbytes);
+    void release();
 };
 
+///
+/// Fill mipmap levels 1 to N of every layer of the image. See generateMipmaps(ImageProxy &, ...) for details.
+///
+inline bool generateMipmaps(RawImage & image, const MipmapOptions & options) {
+    ImageProxy proxy = image.proxy();
+    return generateMipmaps(proxy, options);
+}
+
+///
+/// Fill mipmap levels 1 to N of every layer of the image in COLOR mode.
+///
+inline bool generateMipmaps(RawImage & image, ImageFilter filter = ImageFilter::BOX,
+                            CompressionQuality quality = CompressionQuality::FAST) {
+    ImageProxy proxy = image.proxy();
+    return generateMipmaps(proxy, filter, quality);
+}
+
+/// \name Image probing
+///
+/// Returns descriptor of the image that RawImage::load() would return, by reading only the file header, without
+/// decoding any pixel. Returns an empty descriptor if the image format is not recognized.
+//@{
+ImageDesc probeImage(std::istream &);
+ImageDesc probeImage(const ConstRange<uint8_t> &);
+ImageDesc probeImage(const std::string & filename);
+//@}
+
+///
+/// Descriptor of one image file found by probeImages().
+///
+struct ProbedImage {
+    std::string path; ///< path of the image file
+    ImageDesc   desc; ///< descriptor of the image
+};
+
+///
+/// Probe all image files in the directory in parallel. Files that are not images are skipped, and so are folders that
+/// can't be opened. The result is sorted by path. Returns an empty list if the directory can't be listed.
+///
+std::vector<ProbedImage> probeImages(const std::string & directory, bool recursive = false);
+
 } // namespace rg
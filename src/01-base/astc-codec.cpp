@@ -0,0 +1,623 @@
+#include "pch.h"
+#include "block-codec.h"
+#include <mutex>
+
+using namespace rg;
+
+// *********************************************************************************************************************
+// ASTC (LDR profile) decoder
+// *********************************************************************************************************************
+
+namespace {
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Integer sequence encoding (ISE) ranges, indexed by quantization level. Each range has 2^bits values, times 3 if
+/// it has trits, or times 5 if it has quints.
+struct ISERange {
+    uint16_t levels;
+    uint8_t  trits, quints, bits;
+};
+constexpr ISERange ISE_RANGES[21] = {
+    { 2, 0, 0, 1 },   { 3, 1, 0, 0 },   { 4, 0, 0, 2 },   { 5, 0, 1, 0 },   { 6, 1, 0, 1 },   { 8, 0, 0, 3 },
+    { 10, 0, 1, 1 },  { 12, 1, 0, 2 },  { 16, 0, 0, 4 },  { 20, 0, 1, 2 },  { 24, 1, 0, 3 },  { 32, 0, 0, 5 },
+    { 40, 0, 1, 3 },  { 48, 1, 0, 4 },  { 64, 0, 0, 6 },  { 80, 0, 1, 4 },  { 96, 1, 0, 5 },  { 128, 0, 0, 7 },
+    { 160, 0, 1, 5 }, { 192, 1, 0, 6 }, { 256, 0, 0, 8 },
+};
+
+/// The lowest quantization level that color endpoints can use (6 values).
+constexpr uint32_t MIN_COLOR_RANGE = 4;
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Number of bits of 'count' values in the range.
+uint32_t iseBits(uint32_t range, uint32_t count) {
+    const auto & r = ISE_RANGES[range];
+    return count * r.bits + (r.trits ? (count * 8 + 4) / 5 : 0) + (r.quints ? (count * 7 + 2) / 3 : 0);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The 128 bits of one block, with random access to bit fields.
+struct Bits128 {
+    uint64_t u[2];
+
+    /// Read 'count' (0 to 32) bits, starting from bit 'pos'. Bits beyond the block are zeros.
+    uint32_t read(uint32_t pos, uint32_t count) const {
+        if (0 == count || pos >= 128) return 0;
+        uint64_t v;
+        if (pos >= 64) {
+            v = u[1] >> (pos - 64);
+        } else if (pos + count <= 64 || 0 == pos) {
+            v = u[0] >> pos;
+            if (pos + count > 64) v |= u[1] << (64 - pos);
+        } else {
+            v = (u[0] >> pos) | (u[1] << (64 - pos));
+        }
+        return (uint32_t)(v & ((1ull << count) - 1));
+    }
+
+    /// Returns the block with bit order reversed. Weights are stored from the highest bit down.
+    Bits128 reversed() const {
+        auto rev = [](uint64_t x) {
+            x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+            x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+            x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+            x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+            x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+            return (x >> 32) | (x << 32);
+        };
+        return { { rev(u[1]), rev(u[0]) } };
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Lookup tables of trit and quint blocks: the 5 trits of each 8-bit value, and the 3 quints of each 7-bit value.
+struct ISETables {
+    uint8_t trits[256][5];
+    uint8_t quints[128][3];
+
+    ISETables() {
+        auto bit = [](uint32_t v, uint32_t b) { return (v >> b) & 1; };
+        for (uint32_t t = 0; t < 256; ++t) {
+            uint32_t c, t0, t1, t2, t3, t4;
+            if (7 == ((t >> 2) & 7)) {
+                c  = (t >> 5) << 2 | (t & 3);
+                t4 = t3 = 2;
+            } else {
+                c = t & 0x1F;
+                if (3 == ((t >> 5) & 3)) {
+                    t4 = 2;
+                    t3 = bit(t, 7);
+                } else {
+                    t4 = bit(t, 7);
+                    t3 = (t >> 5) & 3;
+                }
+            }
+            if (3 == (c & 3)) {
+                t2 = 2;
+                t1 = bit(c, 4);
+                t0 = bit(c, 3) << 1 | (bit(c, 2) & ~bit(c, 3) & 1);
+            } else if (3 == ((c >> 2) & 3)) {
+                t2 = t1 = 2;
+                t0 = c & 3;
+            } else {
+                t2 = bit(c, 4);
+                t1 = (c >> 2) & 3;
+                t0 = bit(c, 1) << 1 | (bit(c, 0) & ~bit(c, 1) & 1);
+            }
+            uint32_t values[5] = { t0, t1, t2, t3, t4 };
+            for (int i = 0; i < 5; ++i) trits[t][i] = (uint8_t)values[i];
+        }
+        for (uint32_t q = 0; q < 128; ++q) {
+            uint32_t q0, q1, q2;
+            if (3 == ((q >> 1) & 3) && 0 == ((q >> 5) & 3)) {
+                q2 = bit(q, 0) << 2 | (bit(q, 4) & ~bit(q, 0) & 1) << 1 | (bit(q, 3) & ~bit(q, 0) & 1);
+                q1 = q0 = 4;
+            } else {
+                uint32_t c;
+                if (3 == ((q >> 1) & 3)) {
+                    q2 = 4;
+                    c  = ((q >> 3) & 3) << 3 | (~(q >> 5) & 3) << 1 | bit(q, 0);
+                } else {
+                    q2 = (q >> 5) & 3;
+                    c  = q & 0x1F;
+                }
+                if (5 == (c & 7)) {
+                    q1 = 4;
+                    q0 = (c >> 3) & 3;
+                } else {
+                    q1 = (c >> 3) & 3;
+                    q0 = c & 7;
+                }
+            }
+            quints[q][0] = (uint8_t)q0;
+            quints[q][1] = (uint8_t)q1;
+            quints[q][2] = (uint8_t)q2;
+        }
+    }
+
+    static const ISETables & get() {
+        static const ISETables t;
+        return t;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode 'count' values of the range from the bits, starting at bit 'pos'. Values are returned as (trit or quint, bits)
+/// pairs, packed as (tq << 8 | bits), since unquantization needs them separately.
+void decodeISE(uint16_t * out, const Bits128 & bits, uint32_t pos, uint32_t range, uint32_t count) {
+    const auto & r = ISE_RANGES[range];
+    const auto & t = ISETables::get();
+    if (r.trits) {
+        // 5 values per block: m0 T[1:0] m1 T[3:2] m2 T[4] m3 T[6:5] m4 T[7]
+        static constexpr uint8_t TBITS[5] = { 2, 2, 1, 2, 1 };
+        for (uint32_t i = 0; i < count; i += 5) {
+            uint32_t m[5], tv = 0, shift = 0;
+            for (uint32_t j = 0; j < 5; ++j) {
+                m[j] = bits.read(pos, r.bits);
+                pos += r.bits;
+                tv |= bits.read(pos, TBITS[j]) << shift;
+                pos += TBITS[j];
+                shift += TBITS[j];
+            }
+            for (uint32_t j = 0; j < 5 && i + j < count; ++j) out[i + j] = (uint16_t)(t.trits[tv][j] << 8 | m[j]);
+        }
+    } else if (r.quints) {
+        // 3 values per block: m0 Q[2:0] m1 Q[4:3] m2 Q[6:5]
+        static constexpr uint8_t QBITS[3] = { 3, 2, 2 };
+        for (uint32_t i = 0; i < count; i += 3) {
+            uint32_t m[3], qv = 0, shift = 0;
+            for (uint32_t j = 0; j < 3; ++j) {
+                m[j] = bits.read(pos, r.bits);
+                pos += r.bits;
+                qv |= bits.read(pos, QBITS[j]) << shift;
+                pos += QBITS[j];
+                shift += QBITS[j];
+            }
+            for (uint32_t j = 0; j < 3 && i + j < count; ++j) out[i + j] = (uint16_t)(t.quints[qv][j] << 8 | m[j]);
+        }
+    } else {
+        for (uint32_t i = 0; i < count; ++i, pos += r.bits) out[i] = (uint16_t)bits.read(pos, r.bits);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Unquantize a color endpoint value to [0, 255].
+uint32_t unquantizeColor(uint32_t range, uint16_t value) {
+    const auto & r = ISE_RANGES[range];
+    uint32_t     m = value & 0xFF, d = value >> 8;
+    if (!r.trits && !r.quints) {
+        // bit replication
+        uint32_t v = m << (8 - r.bits);
+        for (uint32_t s = r.bits; s < 8; s += r.bits) v |= v >> s;
+        return v;
+    }
+    uint32_t a = (m & 1) ? 0x1FF : 0, b = 0, c = 0;
+    auto     bit = [&](uint32_t i) { return (m >> i) & 1; };
+    switch (r.trits ? r.bits : r.bits + 8) {
+        case 1: c = 204; break;
+        case 2: b = bit(1) * 0x116; c = 93; break;                                        // b000b0bb0
+        case 3: b = (m >> 1 & 3) * 0x85; c = 44; break;                                  // cb000cbcb
+        case 4: b = (m >> 1 & 7) * 0x41; c = 22; break;                                  // dcb000dcb
+        case 5: b = (m >> 1 & 15) << 5 | (m >> 3 & 3); c = 11; break;                    // edcb000ed
+        case 6: b = (m >> 1 & 31) << 4 | (m >> 5 & 1); c = 5; break;                     // fedcb000f
+        case 9: c = 113; break;
+        case 10: b = bit(1) * 0x10C; c = 54; break;                                      // b0000bb00
+        case 11: b = (m >> 1 & 3) << 7 | (m >> 1 & 3) << 1 | bit(2); c = 26; break;       // cb0000cbc
+        case 12: b = (m >> 1 & 7) << 6 | (m >> 2 & 3); c = 13; break;                    // dcb0000dc
+        case 13: b = (m >> 1 & 15) << 5 | bit(4); c = 6; break;                          // edcb0000e
+        default: RG_ASSERT(false); break;
+    }
+    uint32_t t = (d * c + b) ^ a;
+    return (a & 0x80) | (t >> 2);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Unquantize a weight value to [0, 64].
+uint32_t unquantizeWeight(uint32_t range, uint16_t value) {
+    const auto & r = ISE_RANGES[range];
+    uint32_t     m = value & 0xFF, d = value >> 8, v;
+    if (!r.trits && !r.quints) {
+        v = m << (6 - r.bits);
+        for (uint32_t s = r.bits; s < 6; s += r.bits) v |= v >> s;
+    } else if (0 == r.bits) {
+        v = d * (r.trits ? 32 : 16);
+    } else {
+        uint32_t a = (m & 1) ? 0x7F : 0, b = 0, c = 0;
+        switch (r.trits ? r.bits : r.bits + 8) {
+            case 1: c = 50; break;
+            case 2: b = (m >> 1 & 1) * 0x45; c = 23; break;           // b000b0b
+            case 3: b = (m >> 1 & 3) * 0x21; c = 11; break;           // cb000cb
+            case 9: c = 28; break;
+            case 10: b = (m >> 1 & 1) * 0x42; c = 13; break;          // b0000b0
+            default: RG_ASSERT(false); break;
+        }
+        uint32_t t = (d * c + b) ^ a;
+        v          = (a & 0x20) | (t >> 2);
+    }
+    return v > 32 ? v + 1 : v;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Bilinear infill of one texel from the weight grid: the index of its top left grid point, and weights (in 1/16) of
+/// the 4 grid points around it.
+struct Infill {
+    uint8_t index;
+    uint8_t w[4];
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Properties of one block mode, of one block footprint. They only depend on the lowest 11 bits of the block. So
+/// they are computed once for all of the 2048 block modes.
+struct BlockMode {
+    bool                       valid;
+    bool                       dualPlane;
+    uint8_t                    width, height;  ///< dimensions of the weight grid
+    uint8_t                    range;          ///< quantization level of weights
+    uint8_t                    weightBits;     ///< bits of all weights
+    const std::vector<Infill> * infill = nullptr; ///< infill of each texel, or null if grid is same size as the block.
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Block modes of one block footprint.
+class Footprint {
+public:
+    uint32_t  bw, bh;
+    BlockMode modes[2048];
+
+    Footprint(uint32_t w, uint32_t h): bw(w), bh(h) {
+        for (uint32_t m = 0; m < 2048; ++m) modes[m] = decodeMode(m);
+    }
+
+    static const Footprint & get(ColorFormat format) {
+        static std::mutex                                      mutex;
+        static std::map<uint32_t, std::unique_ptr<Footprint>> registry;
+        std::lock_guard<std::mutex>                            lock(mutex);
+        auto &                                                 f = registry[format.layout];
+        if (!f) f.reset(new Footprint(format.layoutDesc().blockWidth, format.layoutDesc().blockHeight));
+        return *f;
+    }
+
+private:
+    std::map<uint32_t, std::vector<Infill>> _infills; ///< indexed by (width << 8 | height) of the weight grid.
+
+    BlockMode decodeMode(uint32_t m) {
+        BlockMode r = {};
+        auto      bits = [&](uint32_t high, uint32_t low) { return (m >> low) & ((1u << (high - low + 1)) - 1); };
+        uint32_t  a = bits(6, 5), b = bits(8, 7), range, w, h;
+        bool      high = bits(9, 9), dual = bits(10, 10);
+        if (bits(1, 0)) {
+            range = bits(1, 0) << 1 | bits(4, 4);
+            switch (bits(3, 2)) {
+                case 0: w = b + 4, h = a + 2; break;
+                case 1: w = b + 8, h = a + 2; break;
+                case 2: w = a + 2, h = b + 8; break;
+                default:
+                    if (bits(8, 8)) {
+                        w = bits(7, 7) + 2, h = a + 2;
+                    } else {
+                        w = a + 2, h = bits(7, 7) + 6;
+                    }
+                    break;
+            }
+        } else {
+            range = bits(3, 2) << 1 | bits(4, 4);
+            if (0 == bits(3, 0)) return r; // reserved, or void extent
+            switch (b) {
+                case 0: w = 12, h = a + 2; break;
+                case 1: w = a + 2, h = 12; break;
+                case 2:
+                    w = a + 6, h = bits(10, 9) + 6;
+                    high = dual = false;
+                    break;
+                default:
+                    if (0 == a) {
+                        w = 6, h = 10;
+                    } else if (1 == a) {
+                        w = 10, h = 6;
+                    } else {
+                        return r; // reserved
+                    }
+                    break;
+            }
+        }
+        if (range < 2) return r; // reserved
+        range = (range - 2) + (high ? 6 : 0);
+        uint32_t count = w * h * (dual ? 2 : 1);
+        if (w > bw || h > bh || count > 64) return r;
+        uint32_t weightBits = iseBits(range, count);
+        if (weightBits < 24 || weightBits > 96) return r;
+
+        r.valid      = true;
+        r.dualPlane  = dual;
+        r.width      = (uint8_t)w;
+        r.height     = (uint8_t)h;
+        r.range      = (uint8_t)range;
+        r.weightBits = (uint8_t)weightBits;
+        if (w != bw || h != bh) r.infill = &infill(w, h);
+        return r;
+    }
+
+    const std::vector<Infill> & infill(uint32_t w, uint32_t h) {
+        auto & texels = _infills[w << 8 | h];
+        if (!texels.empty()) return texels;
+        uint32_t ds = (1024 + bw / 2) / (bw - 1);
+        uint32_t dt = (1024 + bh / 2) / (bh - 1);
+        for (uint32_t t = 0; t < bh; ++t)
+            for (uint32_t s = 0; s < bw; ++s) {
+                uint32_t gs = (ds * s * (w - 1) + 32) >> 6;
+                uint32_t gt = (dt * t * (h - 1) + 32) >> 6;
+                uint32_t fs = gs & 15, ft = gt & 15;
+                uint32_t w11 = (fs * ft + 8) >> 4;
+                Infill   i;
+                i.index = (uint8_t)((gs >> 4) + (gt >> 4) * w);
+                i.w[0]  = (uint8_t)(16 - fs - ft + w11);
+                i.w[1]  = (uint8_t)(fs - w11);
+                i.w[2]  = (uint8_t)(ft - w11);
+                i.w[3]  = (uint8_t)w11;
+                texels.push_back(i);
+            }
+        return texels;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The partition of the texel, by the hash function of the spec.
+uint32_t selectPartition(uint32_t seed, uint32_t x, uint32_t y, uint32_t partitions, bool smallBlock) {
+    if (smallBlock) {
+        x <<= 1;
+        y <<= 1;
+    }
+    seed += (partitions - 1) * 1024;
+    uint32_t p = seed;
+    p ^= p >> 15;
+    p -= p << 17;
+    p += p << 7;
+    p += p << 4;
+    p ^= p >> 5;
+    p += p << 16;
+    p ^= p >> 7;
+    p ^= p >> 3;
+    p ^= p << 6;
+    p ^= p >> 17;
+    uint32_t rnum = p;
+
+    uint32_t s[8];
+    for (uint32_t i = 0; i < 8; ++i) s[i] = (rnum >> (i * 4)) & 0xF;
+    for (auto & v : s) v *= v;
+    uint32_t sh1, sh2;
+    if (seed & 1) {
+        sh1 = seed & 2 ? 4 : 5;
+        sh2 = 3 == partitions ? 6 : 5;
+    } else {
+        sh1 = 3 == partitions ? 6 : 5;
+        sh2 = seed & 2 ? 4 : 5;
+    }
+    uint32_t a = ((s[0] >> sh1) * x + (s[1] >> sh2) * y + (rnum >> 14)) & 0x3F;
+    uint32_t b = ((s[2] >> sh1) * x + (s[3] >> sh2) * y + (rnum >> 10)) & 0x3F;
+    uint32_t c = ((s[4] >> sh1) * x + (s[5] >> sh2) * y + (rnum >> 6)) & 0x3F;
+    uint32_t d = ((s[6] >> sh1) * x + (s[7] >> sh2) * y + (rnum >> 2)) & 0x3F;
+    if (partitions < 4) d = 0;
+    if (partitions < 3) c = 0;
+    if (a >= b && a >= c && a >= d) return 0;
+    if (b >= c && b >= d) return 1;
+    if (c >= d) return 2;
+    return 3;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode color endpoints of LDR endpoint modes. Returns false for HDR modes, that LDR decoders don't support.
+bool decodeEndpoints(int32_t e0[4], int32_t e1[4], uint32_t cem, const int32_t * v) {
+    auto set = [](int32_t * e, int32_t r, int32_t g, int32_t b, int32_t a) {
+        e[0] = std::clamp(r, 0, 255);
+        e[1] = std::clamp(g, 0, 255);
+        e[2] = std::clamp(b, 0, 255);
+        e[3] = std::clamp(a, 0, 255);
+    };
+    auto blueContract = [&](int32_t * e, int32_t r, int32_t g, int32_t b, int32_t a) {
+        set(e, (r + b) >> 1, (g + b) >> 1, b, a);
+    };
+    // move the top bit of 'a' to 'b', leaving 'a' a 6-bit signed offset.
+    auto bitTransfer = [](int32_t & a, int32_t & b) {
+        b = (b >> 1) | (a & 0x80);
+        a = (a >> 1) & 0x3F;
+        if (a & 0x20) a -= 0x40;
+    };
+    int32_t t[8];
+    switch (cem) {
+        case 0: // luminance, direct
+            set(e0, v[0], v[0], v[0], 255);
+            set(e1, v[1], v[1], v[1], 255);
+            return true;
+        case 1: { // luminance, base + offset
+            int32_t l0 = (v[0] >> 2) | (v[1] & 0xC0);
+            int32_t l1 = std::min(l0 + (v[1] & 0x3F), 255);
+            set(e0, l0, l0, l0, 255);
+            set(e1, l1, l1, l1, 255);
+            return true;
+        }
+        case 4: // luminance + alpha, direct
+            set(e0, v[0], v[0], v[0], v[2]);
+            set(e1, v[1], v[1], v[1], v[3]);
+            return true;
+        case 5: // luminance + alpha, base + offset
+            for (int i = 0; i < 4; ++i) t[i] = v[i];
+            bitTransfer(t[1], t[0]);
+            bitTransfer(t[3], t[2]);
+            set(e0, t[0], t[0], t[0], t[2]);
+            set(e1, t[0] + t[1], t[0] + t[1], t[0] + t[1], t[2] + t[3]);
+            return true;
+        case 6: // RGB, base + scale
+            set(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, 255);
+            set(e1, v[0], v[1], v[2], 255);
+            return true;
+        case 8:   // RGB, direct
+        case 12: { // RGBA, direct
+            int32_t a0 = 12 == cem ? v[6] : 255, a1 = 12 == cem ? v[7] : 255;
+            if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4]) {
+                set(e0, v[0], v[2], v[4], a0);
+                set(e1, v[1], v[3], v[5], a1);
+            } else {
+                blueContract(e0, v[1], v[3], v[5], a1);
+                blueContract(e1, v[0], v[2], v[4], a0);
+            }
+            return true;
+        }
+        case 9:    // RGB, base + offset
+        case 13: { // RGBA, base + offset
+            for (int i = 0; i < 8; ++i) t[i] = i < 6 || 13 == cem ? v[i] : 0;
+            for (int i = 0; i < 8; i += 2) bitTransfer(t[i + 1], t[i]);
+            int32_t a0 = 13 == cem ? t[6] : 255, a1 = 13 == cem ? t[6] + t[7] : 255;
+            if (t[1] + t[3] + t[5] >= 0) {
+                set(e0, t[0], t[2], t[4], a0);
+                set(e1, t[0] + t[1], t[2] + t[3], t[4] + t[5], a1);
+            } else {
+                blueContract(e0, t[0] + t[1], t[2] + t[3], t[4] + t[5], a1);
+                blueContract(e1, t[0], t[2], t[4], a0);
+            }
+            return true;
+        }
+        case 10: // RGB, base + scale, plus 2 alphas
+            set(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, v[4]);
+            set(e1, v[0], v[1], v[2], v[5]);
+            return true;
+        default: // HDR modes
+            return false;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Fill the block with the error color (opaque magenta).
+void errorBlock(uint8_t * dst, size_t pitch, uint32_t bw, uint32_t bh) {
+    for (uint32_t y = 0; y < bh; ++y)
+        for (uint32_t x = 0; x < bw; ++x) memcpy(dst + y * pitch + x * 4, "\xFF\x00\xFF\xFF", 4);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one block to RGBA8 pixels. Rows are 'pitch' bytes apart. For sRGB formats, color endpoints are extended to
+/// 16 bits as (c << 8 | 0x80) before interpolation, instead of (c << 8 | c).
+void decodeASTCBlock(uint8_t * dst, size_t pitch, const uint8_t * block, const Footprint & fp, bool srgb) {
+    Bits128 bits;
+    memcpy(bits.u, block, 16);
+    uint32_t bw = fp.bw, bh = fp.bh;
+
+    // void extent block: one constant color, as 16-bit UNORM values.
+    if (0x1FC == bits.read(0, 9)) {
+        if (bits.read(9, 1)) {
+            errorBlock(dst, pitch, bw, bh); // HDR
+            return;
+        }
+        uint8_t c[4];
+        for (uint32_t i = 0; i < 4; ++i) c[i] = (uint8_t)(bits.read(64 + i * 16, 16) >> 8);
+        for (uint32_t y = 0; y < bh; ++y)
+            for (uint32_t x = 0; x < bw; ++x) memcpy(dst + y * pitch + x * 4, c, 4);
+        return;
+    }
+
+    const BlockMode & mode = fp.modes[bits.read(0, 11)];
+    uint32_t          partitions = bits.read(11, 2) + 1;
+    if (!mode.valid || (4 == partitions && mode.dualPlane)) {
+        errorBlock(dst, pitch, bw, bh);
+        return;
+    }
+
+    // color endpoint modes of each partition
+    uint32_t cems[4];
+    uint32_t colorStart, extraBits = 0, seed = 0;
+    uint32_t belowWeights = 128 - mode.weightBits;
+    if (1 == partitions) {
+        cems[0]    = bits.read(13, 4);
+        colorStart = 17;
+    } else {
+        seed             = bits.read(13, 10);
+        colorStart       = 29;
+        uint32_t cemBits = bits.read(23, 6);
+        if (0 == (cemBits & 3)) {
+            for (uint32_t p = 0; p < partitions; ++p) cems[p] = cemBits >> 2;
+        } else {
+            // more CEM bits are right below the weights.
+            extraBits = partitions * 3 - 4;
+            cemBits |= bits.read(belowWeights - extraBits, extraBits) << 6;
+            uint32_t base = (cemBits & 3) - 1;
+            for (uint32_t p = 0; p < partitions; ++p) {
+                uint32_t c = (cemBits >> (2 + p)) & 1;
+                uint32_t m = (cemBits >> (2 + partitions + p * 2)) & 3;
+                cems[p]    = (base + c) << 2 | m;
+            }
+        }
+    }
+    uint32_t ccsPos = belowWeights - extraBits - 2;
+
+    // color endpoints use the highest precision that fits.
+    uint32_t colorValues = 0;
+    for (uint32_t p = 0; p < partitions; ++p) colorValues += ((cems[p] >> 2) + 1) * 2;
+    int32_t colorBits = (int32_t)belowWeights - (int32_t)extraBits - (mode.dualPlane ? 2 : 0) - (int32_t)colorStart;
+    if (colorValues > 18 || colorBits <= 0) {
+        errorBlock(dst, pitch, bw, bh);
+        return;
+    }
+    uint32_t colorRange = 20;
+    while (colorRange >= MIN_COLOR_RANGE && iseBits(colorRange, colorValues) > (uint32_t)colorBits) --colorRange;
+    if (colorRange < MIN_COLOR_RANGE) {
+        errorBlock(dst, pitch, bw, bh);
+        return;
+    }
+    uint16_t encoded[18];
+    decodeISE(encoded, bits, colorStart, colorRange, colorValues);
+    int32_t endpoints[4][2][4];
+    for (uint32_t p = 0, i = 0; p < partitions; i += ((cems[p] >> 2) + 1) * 2, ++p) {
+        int32_t v[8];
+        for (uint32_t j = 0; j < ((cems[p] >> 2) + 1) * 2; ++j) v[j] = (int32_t)unquantizeColor(colorRange, encoded[i + j]);
+        if (!decodeEndpoints(endpoints[p][0], endpoints[p][1], cems[p], v)) {
+            errorBlock(dst, pitch, bw, bh);
+            return;
+        }
+    }
+
+    // weights of the grid, then infill to weights of each texel.
+    uint32_t planes      = mode.dualPlane ? 2 : 1;
+    uint32_t gridWeights = mode.width * mode.height * planes;
+    uint16_t gridEncoded[64];
+    decodeISE(gridEncoded, bits.reversed(), 0, mode.range, gridWeights);
+    uint8_t grid[2][64 + 16] = {}; // padded, since infill reads one point past the edges with zero weight.
+    for (uint32_t i = 0; i < gridWeights; ++i) {
+        grid[i % planes][i / planes] = (uint8_t)unquantizeWeight(mode.range, gridEncoded[i]);
+    }
+    uint32_t ccs = mode.dualPlane ? bits.read(ccsPos, 2) : 4;
+
+    bool     smallBlock = bw * bh < 31;
+    uint32_t gw         = mode.width;
+    for (uint32_t y = 0; y < bh; ++y) {
+        uint8_t * row = dst + y * pitch;
+        for (uint32_t x = 0; x < bw; ++x) {
+            uint32_t t = y * bw + x;
+            uint32_t w[2];
+            for (uint32_t pl = 0; pl < planes; ++pl) {
+                if (mode.infill) {
+                    const auto &    f = (*mode.infill)[t];
+                    const uint8_t * g = grid[pl] + f.index;
+                    w[pl]             = (g[0] * f.w[0] + g[1] * f.w[1] + g[gw] * f.w[2] + g[gw + 1] * f.w[3] + 8) >> 4;
+                } else {
+                    w[pl] = grid[pl][t];
+                }
+            }
+            uint32_t        p  = 1 == partitions ? 0 : selectPartition(seed, x, y, partitions, smallBlock);
+            const int32_t * e0 = endpoints[p][0];
+            const int32_t * e1 = endpoints[p][1];
+            for (uint32_t c = 0; c < 4; ++c) {
+                int32_t  wc = (int32_t)(c == ccs ? w[1] : w[0]);
+                int32_t  lo = e0[c] << 8 | (srgb && c < 3 ? 0x80 : e0[c]);
+                int32_t  hi = e1[c] << 8 | (srgb && c < 3 ? 0x80 : e1[c]);
+                row[x * 4 + c] = (uint8_t)(((lo * (64 - wc) + hi * wc + 32) >> 6) >> 8);
+            }
+        }
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeASTCRow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    const auto & fp   = Footprint::get(format);
+    bool         srgb = ColorFormat::SIGN_GNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b) decodeASTCBlock(dst + b * fp.bw * 4, pitch, src + b * 16, fp, srgb);
+}
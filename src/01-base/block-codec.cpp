@@ -0,0 +1,867 @@
+#include "pch.h"
+#include "block-codec.h"
+#include <cfloat>
+
+using namespace rg;
+
+// *********************************************************************************************************************
+// BC1 - BC5 (DXT1 - DXT5, DXT5A/ATI1 and DXN/ATI2) decoders
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline uint32_t load32(const uint8_t * p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// load the 48-bit 3-bit indices of BC3 alpha and BC4 blocks.
+static inline uint64_t load48(const uint8_t * p) {
+    uint64_t v = 0;
+    memcpy(&v, p, 6);
+    return v;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeBC1Scalar(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count, size_t stride, bool bc1) {
+    for (size_t b = 0; b < count; ++b, src += stride) {
+        uint32_t palette[4];
+        bc1Palette(palette, src, bc1);
+        uint32_t indices = load32(src + 4);
+        for (size_t y = 0; y < 4; ++y) {
+            uint8_t * row = (uint8_t *)dst + y * pitch + b * 16;
+            for (size_t x = 0; x < 4; ++x, indices >>= 2) memcpy(row + x * 4, &palette[indices & 3], 4);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Compute the 8 values palette of BC3 alpha block, as 8-bit values.
+static inline void bc3AlphaPalette(uint8_t palette[8], const uint8_t * block) {
+    uint32_t a0 = block[0], a1 = block[1];
+    palette[0]  = (uint8_t)a0;
+    palette[1]  = (uint8_t)a1;
+    if (a0 > a1) {
+        for (uint32_t i = 1; i < 7; ++i) palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+    } else {
+        for (uint32_t i = 1; i < 5; ++i) palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Compute the 8 values palette of unsigned BC4 block, as 16-bit UNORM values.
+static inline void bc4PaletteUNorm(uint16_t palette[8], const uint8_t * block) {
+    uint32_t a0 = block[0], a1 = block[1];
+    palette[0]  = (uint16_t)(a0 * 257);
+    palette[1]  = (uint16_t)(a1 * 257);
+    if (a0 > a1) {
+        for (uint32_t i = 1; i < 7; ++i) palette[i + 1] = (uint16_t)((((7 - i) * a0 + i * a1) * 257 + 3) / 7);
+    } else {
+        for (uint32_t i = 1; i < 5; ++i) palette[i + 1] = (uint16_t)((((5 - i) * a0 + i * a1) * 257 + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 65535;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert n / d (in unit of 1/127) to 16-bit SNORM, round half away from zero.
+static inline uint16_t snorm8To16(int32_t n, int32_t d) {
+    n *= 32767;
+    d *= 127;
+    int32_t v = n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d);
+    return (uint16_t)(int16_t)v;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Compute the 8 values palette of signed BC4 block, as 16-bit SNORM values. -128 is treated as -127.
+static inline void bc4PaletteSNorm(uint16_t palette[8], const uint8_t * block) {
+    int32_t a0 = std::max<int32_t>((int8_t)block[0], -127);
+    int32_t a1 = std::max<int32_t>((int8_t)block[1], -127);
+    palette[0] = snorm8To16(a0, 1);
+    palette[1] = snorm8To16(a1, 1);
+    if (a0 > a1) {
+        for (int32_t i = 1; i < 7; ++i) palette[i + 1] = snorm8To16((7 - i) * a0 + i * a1, 7);
+    } else {
+        for (int32_t i = 1; i < 5; ++i) palette[i + 1] = snorm8To16((5 - i) * a0 + i * a1, 5);
+        palette[6] = (uint16_t)(int16_t)-32767;
+        palette[7] = 32767;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one BC4 block to one 16-bit channel of 4x4 pixels. Pixels are 'step' bytes apart, rows are 'pitch' bytes apart.
+static inline void decodeBC4Block(uint8_t * dst, size_t pitch, size_t step, const uint8_t * block, bool snorm) {
+    uint16_t palette[8];
+    if (snorm) {
+        bc4PaletteSNorm(palette, block);
+    } else {
+        bc4PaletteUNorm(palette, block);
+    }
+    uint64_t indices = load48(block + 2);
+    for (size_t y = 0; y < 4; ++y) {
+        for (size_t x = 0; x < 4; ++x, indices >>= 3) memcpy(dst + y * pitch + x * step, &palette[indices & 7], 2);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void decodeDXT1Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    getFastRowKernels().decodeBC1((RGBA8 *)dst, pitch, src, count, 8, true);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// DXT3 (BC2): explicit 4-bit alpha block, followed by color block.
+static void decodeDXT3Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    getFastRowKernels().decodeBC1((RGBA8 *)dst, pitch, src + 8, count, 16, false);
+    for (size_t b = 0; b < count; ++b, src += 16) {
+        uint64_t alpha;
+        memcpy(&alpha, src, 8);
+        for (size_t y = 0; y < 4; ++y) {
+            uint8_t * row = dst + y * pitch + b * 16;
+            for (size_t x = 0; x < 4; ++x, alpha >>= 4) row[x * 4 + 3] = (uint8_t)((alpha & 15) * 17);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// DXT5 (BC3): interpolated alpha block, followed by color block.
+static void decodeDXT5Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    getFastRowKernels().decodeBC1((RGBA8 *)dst, pitch, src + 8, count, 16, false);
+    for (size_t b = 0; b < count; ++b, src += 16) {
+        uint8_t palette[8];
+        bc3AlphaPalette(palette, src);
+        uint64_t indices = load48(src + 2);
+        for (size_t y = 0; y < 4; ++y) {
+            uint8_t * row = dst + y * pitch + b * 16;
+            for (size_t x = 0; x < 4; ++x, indices >>= 3) row[x * 4 + 3] = palette[indices & 7];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// DXT3A: the explicit 4-bit alpha block of DXT3 on its own. Decoded to 8 bits.
+static void decodeDXT3ARow(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    for (size_t b = 0; b < count; ++b, src += 8) {
+        uint64_t alpha;
+        memcpy(&alpha, src, 8);
+        for (size_t y = 0; y < 4; ++y) {
+            uint8_t * row = dst + y * pitch + b * 4;
+            for (size_t x = 0; x < 4; ++x, alpha >>= 4) row[x] = (uint8_t)((alpha & 15) * 17);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// DXT5A (BC4): one interpolated channel. Decoded to 16 bits, since the interpolated values are finer than 8 bits.
+static void decodeDXT5ARow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    bool snorm = ColorFormat::SIGN_SNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b, src += 8) decodeBC4Block(dst + b * 8, pitch, 2, src, snorm);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// DXN (BC5): two BC4 blocks, for red and green channels.
+static void decodeDXNRow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    bool snorm = ColorFormat::SIGN_SNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b, src += 16) {
+        decodeBC4Block(dst + b * 16, pitch, 4, src, snorm);
+        decodeBC4Block(dst + b * 16 + 2, pitch, 4, src + 8, snorm);
+    }
+}
+
+// *********************************************************************************************************************
+// Legacy layouts: CTX1, DXT3A_AS_1_1_1_1, GRGB and RGBG
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::unpack422Scalar(RGBA8 * dst, const uint8_t * src, size_t count, bool rgbg) {
+    // byte offsets of R, G0, B and G1 in the block
+    const size_t r = rgbg ? 0 : 1, g0 = rgbg ? 1 : 0, b = rgbg ? 2 : 3, g1 = rgbg ? 3 : 2;
+    for (size_t i = 0; i < count; ++i, src += 4) {
+        dst[i * 2]     = { src[r], src[g0], src[b], 255 };
+        dst[i * 2 + 1] = { src[r], src[g1], src[b], 255 };
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::pack422Scalar(uint8_t * dst, const RGBA8 * src, size_t count, bool rgbg) {
+    const size_t r = rgbg ? 0 : 1, g0 = rgbg ? 1 : 0, b = rgbg ? 2 : 3, g1 = rgbg ? 3 : 2;
+    for (size_t i = 0; i < count; ++i, dst += 4) {
+        const auto & p0 = src[i * 2];
+        const auto & p1 = src[i * 2 + 1];
+        dst[r]          = (uint8_t)((p0.x + p1.x + 1) >> 1);
+        dst[g0]         = p0.y;
+        dst[b]          = (uint8_t)((p0.z + p1.z + 1) >> 1);
+        dst[g1]         = p1.y;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeCTX1Scalar(uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    for (size_t b = 0; b < count; ++b, src += 8) {
+        uint8_t palette[8];
+        ctx1Palette(palette, src);
+        uint32_t indices = load32(src + 4);
+        for (size_t y = 0; y < 4; ++y) {
+            uint8_t * row = dst + y * pitch + b * 8;
+            for (size_t x = 0; x < 4; ++x, indices >>= 2) memcpy(row + x * 2, &palette[(indices & 3) * 2], 2);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeDXT3AAs1111Scalar(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count) {
+    for (size_t b = 0; b < count; ++b, src += 8) {
+        uint64_t bits;
+        memcpy(&bits, src, 8);
+        for (size_t y = 0; y < 4; ++y) {
+            uint8_t * row = (uint8_t *)dst + y * pitch + b * 16;
+            for (size_t i = 0; i < 16; ++i, bits >>= 1) row[i] = (bits & 1) ? 255 : 0;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// CTX1: 2 channels block of Xbox 360, usually for the XY of normal maps. Decoded to 8 bits.
+static void decodeCTX1Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    getFastRowKernels().decodeCTX1(dst, pitch, src, count);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// DXT3A_AS_1_1_1_1: DXT3A block, where each 4-bit value is four 1-bit channels. Decoded to 8 bits.
+static void decodeDXT3AAs1111Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    getFastRowKernels().decodeDXT3AAs1111((RGBA8 *)dst, pitch, src, count);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// GRGB and RGBG: packed 4:2:2 layouts. Each 2x1 block has its own green values, and shares red and blue.
+static void decode422Row(ColorFormat format, uint8_t * dst, size_t, const uint8_t * src, size_t count) {
+    getFastRowKernels().unpack422((RGBA8 *)dst, src, count, ColorFormat::LAYOUT_RGBG == format.layout);
+}
+
+/// Block decoders of each compressed layout, and the uncompressed layout that they decode to. Decoded pixels keep the
+/// signs of the compressed format, unless 'floating' is true. In that case, they are always float, since BC6H decodes
+/// to half floats regardless of the UF16 and SF16 variants.
+static constexpr struct {
+    ColorFormat::Layout layout;
+    ColorFormat::Layout decoded;
+    bool                floating;
+    void (*decodeRow)(ColorFormat, uint8_t *, size_t, const uint8_t *, size_t);
+} BLOCK_DECODERS[] = {
+    { ColorFormat::LAYOUT_DXT1, ColorFormat::LAYOUT_8_8_8_8, false, &decodeDXT1Row },
+    { ColorFormat::LAYOUT_DXT3, ColorFormat::LAYOUT_8_8_8_8, false, &decodeDXT3Row },
+    { ColorFormat::LAYOUT_DXT3A, ColorFormat::LAYOUT_8, false, &decodeDXT3ARow },
+    { ColorFormat::LAYOUT_DXT5, ColorFormat::LAYOUT_8_8_8_8, false, &decodeDXT5Row },
+    { ColorFormat::LAYOUT_DXT5A, ColorFormat::LAYOUT_16, false, &decodeDXT5ARow },
+    { ColorFormat::LAYOUT_DXN, ColorFormat::LAYOUT_16_16, false, &decodeDXNRow },
+    { ColorFormat::LAYOUT_BC6H, ColorFormat::LAYOUT_16_16_16_16, true, &decodeBC6HRow },
+    { ColorFormat::LAYOUT_BC7, ColorFormat::LAYOUT_8_8_8_8, false, &decodeBC7Row },
+    { ColorFormat::LAYOUT_CTX1, ColorFormat::LAYOUT_8_8, false, &decodeCTX1Row },
+    { ColorFormat::LAYOUT_DXT3A_AS_1_1_1_1, ColorFormat::LAYOUT_8_8_8_8, false, &decodeDXT3AAs1111Row },
+    { ColorFormat::LAYOUT_GRGB, ColorFormat::LAYOUT_8_8_8_8, false, &decode422Row },
+    { ColorFormat::LAYOUT_RGBG, ColorFormat::LAYOUT_8_8_8_8, false, &decode422Row },
+    { ColorFormat::LAYOUT_ETC2, ColorFormat::LAYOUT_8_8_8_8, false, &decodeETC2Row },
+    { ColorFormat::LAYOUT_ETC2_A1, ColorFormat::LAYOUT_8_8_8_8, false, &decodeETC2A1Row },
+    { ColorFormat::LAYOUT_ETC2_EAC, ColorFormat::LAYOUT_8_8_8_8, false, &decodeETC2EACRow },
+    { ColorFormat::LAYOUT_EAC_R11, ColorFormat::LAYOUT_16, false, &decodeEACR11Row },
+    { ColorFormat::LAYOUT_EAC_RG11, ColorFormat::LAYOUT_16_16, false, &decodeEACRG11Row },
+    { ColorFormat::LAYOUT_ASTC_4x4, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_5x4, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_5x5, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_6x5, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_6x6, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_8x5, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_8x6, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_8x8, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_10x5, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_10x6, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_10x8, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_10x10, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_12x10, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+    { ColorFormat::LAYOUT_ASTC_12x12, ColorFormat::LAYOUT_8_8_8_8, false, &decodeASTCRow },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const BlockDecoder * rg::getBlockDecoder(ColorFormat format) {
+    static std::mutex                        mutex;
+    static std::map<uint32_t, BlockDecoder> registry;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        iter = registry.find(format.u32);
+    if (iter != registry.end()) return &iter->second;
+
+    for (const auto & d : BLOCK_DECODERS) {
+        if (d.layout != format.layout) continue;
+        auto sign012 = d.floating ? ColorFormat::SIGN_FLOAT : (ColorFormat::Sign)format.sign012;
+        auto sign3   = d.floating ? ColorFormat::SIGN_FLOAT : (ColorFormat::Sign)format.sign3;
+        auto decoded = ColorFormat::make(d.decoded, sign012, sign3,
+                                         (ColorFormat::Swizzle)format.swizzle0, (ColorFormat::Swizzle)format.swizzle1,
+                                         (ColorFormat::Swizzle)format.swizzle2, (ColorFormat::Swizzle)format.swizzle3);
+        if (!isRowConvertible(decoded)) return nullptr;
+        return &registry.emplace(format.u32, BlockDecoder { format, decoded, d.decodeRow }).first->second;
+    }
+    return nullptr;
+}
+
+// *********************************************************************************************************************
+// BC1 - BC5 encoders
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Copy one 4x4 block of pixels, 'bytes' bytes each, to a tightly packed array.
+static inline void gatherBlock(void * out, const uint8_t * src, size_t pitch, size_t bytes) {
+    for (size_t y = 0; y < 4; ++y) memcpy((uint8_t *)out + y * 4 * bytes, src + y * pitch, 4 * bytes);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Pick the nearest palette color of each pixel, and write the indices to the block. Returns the sum of squared
+/// RGB errors. Transparent pixels of 3 colors BC1 blocks always pick the transparent black.
+static uint32_t bc1FitIndices(uint8_t * block, const RGBA8 pixels[16], bool bc1) {
+    uint32_t palette[4];
+    bc1Palette(palette, block, bc1);
+    uint32_t c0 = load32(block) & 0xFFFF, c1 = load32(block) >> 16;
+    bool     three = bc1 && c0 <= c1;
+    uint32_t indices = 0, error = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        const auto & p = pixels[i];
+        uint32_t     best = 3, bestError = 0;
+        if (!three || p.w >= 128) {
+            bestError = UINT32_MAX;
+            for (uint32_t k = 0; k < (three ? 3u : 4u); ++k) {
+                int32_t  dr = (int32_t)(palette[k] & 0xFF) - p.x;
+                int32_t  dg = (int32_t)((palette[k] >> 8) & 0xFF) - p.y;
+                int32_t  db = (int32_t)((palette[k] >> 16) & 0xFF) - p.z;
+                uint32_t e  = (uint32_t)(dr * dr + dg * dg + db * db);
+                if (e < bestError) {
+                    best      = k;
+                    bestError = e;
+                }
+            }
+        }
+        indices |= best << (i * 2);
+        error += bestError;
+    }
+    memcpy(block + 4, &indices, 4);
+    return error;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::encodeBC1Block(uint8_t * block, const RGBA8 pixels[16], bool bc1) {
+    bool transparent = false;
+    if (bc1) {
+        for (uint32_t i = 0; i < 16; ++i) transparent |= pixels[i].w < 128;
+    }
+
+    // bounding box of the (opaque) pixels
+    uint8_t lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (uint32_t i = 0; i < 16; ++i) {
+        const auto & p = pixels[i];
+        if (transparent && p.w < 128) continue;
+        lo[0] = std::min(lo[0], p.x), hi[0] = std::max(hi[0], p.x);
+        lo[1] = std::min(lo[1], p.y), hi[1] = std::max(hi[1], p.y);
+        lo[2] = std::min(lo[2], p.z), hi[2] = std::max(hi[2], p.z);
+    }
+    if (lo[0] > hi[0]) {
+        // all pixels are transparent.
+        static constexpr uint8_t TRANSPARENT[8] = { 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+        memcpy(block, TRANSPARENT, 8);
+        return;
+    }
+    bc1BoxEndpoints(block, lo, hi, transparent);
+
+    uint32_t palette[4];
+    bc1Palette(palette, block, bc1);
+    uint32_t c0 = load32(block) & 0xFFFF, c1 = load32(block) >> 16;
+    uint32_t colors  = (bc1 && c0 <= c1) ? 3 : 4;
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        const auto & p    = pixels[i];
+        uint32_t     best = 3;
+        if (!transparent || p.w >= 128) {
+            uint32_t bestDistance = UINT32_MAX;
+            for (uint32_t k = 0; k < colors; ++k) {
+                uint32_t d = (uint32_t)(std::abs((int32_t)(palette[k] & 0xFF) - p.x) +
+                                        std::abs((int32_t)((palette[k] >> 8) & 0xFF) - p.y) +
+                                        std::abs((int32_t)((palette[k] >> 16) & 0xFF) - p.z));
+                if (d < bestDistance) {
+                    best         = k;
+                    bestDistance = d;
+                }
+            }
+        }
+        indices |= best << (i * 2);
+    }
+    memcpy(block + 4, &indices, 4);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::encodeBC1Scalar(uint8_t * dst, size_t stride, const RGBA8 * src, size_t pitch, size_t count, bool bc1) {
+    for (size_t b = 0; b < count; ++b, dst += stride) {
+        RGBA8 pixels[16];
+        gatherBlock(pixels, (const uint8_t *)src + b * 16, pitch, 4);
+        encodeBC1Block(dst, pixels, bc1);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Round a color channel to the 565 grid, and expand it back to 8 bits.
+static inline float snapTo565(float v, uint32_t bits) {
+    float    m = (float)((1u << bits) - 1);
+    uint32_t q = (uint32_t)(std::min(std::max(v, 0.0f), 255.0f) * m / 255.0f + 0.5f);
+    return (float)((q << (8 - bits)) | (q >> (2 * bits - 8)));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Pack 8-bit RGB color, that is already on the 565 grid, to 565.
+static inline uint32_t pack565(const float c[3]) {
+    return ((uint32_t)c[0] >> 3 << 11) | ((uint32_t)c[1] >> 2 << 5) | ((uint32_t)c[2] >> 3);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Cluster fit of a 4 colors BC1 block: pixels are sorted along the principal axis of their colors. Then every way of
+/// splitting the sorted list into 4 consecutive clusters is tried, each with least squares endpoints that are snapped
+/// to the 565 grid. The split with the lowest error wins. Returns false if all pixels have the same color.
+static bool bc1ClusterFit(uint8_t * block, const RGBA8 pixels[16]) {
+    float x[16][3], mean[3] = {};
+    for (uint32_t i = 0; i < 16; ++i) {
+        x[i][0] = pixels[i].x, x[i][1] = pixels[i].y, x[i][2] = pixels[i].z;
+        for (int c = 0; c < 3; ++c) mean[c] += x[i][c] / 16.0f;
+    }
+
+    // principal axis, by power iteration on the covariance matrix.
+    float cov[3][3] = {};
+    for (uint32_t i = 0; i < 16; ++i)
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) cov[r][c] += (x[i][r] - mean[r]) * (x[i][c] - mean[c]);
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iter = 0; iter < 8; ++iter) {
+        float v[3], m = 0;
+        for (int r = 0; r < 3; ++r) {
+            v[r] = cov[r][0] * axis[0] + cov[r][1] * axis[1] + cov[r][2] * axis[2];
+            m    = std::max(m, std::abs(v[r]));
+        }
+        if (m < 1e-6f) return false;
+        for (int r = 0; r < 3; ++r) axis[r] = v[r] / m;
+    }
+
+    // sort pixels along the axis, and build prefix sums of the sorted colors.
+    uint32_t order[16];
+    float    dots[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        order[i] = i;
+        dots[i]  = x[i][0] * axis[0] + x[i][1] * axis[1] + x[i][2] * axis[2];
+    }
+    std::sort(order, order + 16, [&](uint32_t a, uint32_t b) { return dots[a] < dots[b]; });
+    float sums[17][3] = {};
+    for (uint32_t i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c) sums[i + 1][c] = sums[i][c] + x[order[i]][c];
+
+    // Clusters [0, i), [i, j), [j, k) and [k, 16) are at 0, 1/3, 2/3 and 1 of the way from endpoint a to endpoint b.
+    static constexpr uint32_t BITS[3] = { 5, 6, 5 };
+    float                     bestError = FLT_MAX, bestA[3] = {}, bestB[3] = {};
+    for (uint32_t i = 0; i <= 16; ++i)
+    for (uint32_t j = i; j <= 16; ++j)
+    for (uint32_t k = j; k <= 16; ++k) {
+        float n1 = (float)(j - i), n2 = (float)(k - j);
+        float aa = (float)i + n1 * (4.0f / 9.0f) + n2 * (1.0f / 9.0f);
+        float bb = (float)(16 - k) + n1 * (1.0f / 9.0f) + n2 * (4.0f / 9.0f);
+        float ab = (n1 + n2) * (2.0f / 9.0f);
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f) continue;
+        // Squared errors below are all minus the constant sum of x^2. The error of the exact least squares endpoints is
+        // the lower bound of the error of the snapped ones. So the split is skipped if it can't beat the best one.
+        float a[3], b[3], ax[3], bx[3], error = 0, rdet = 1.0f / det;
+        for (int c = 0; c < 3; ++c) {
+            float s1 = sums[j][c] - sums[i][c], s2 = sums[k][c] - sums[j][c];
+            ax[c]    = sums[i][c] + s1 * (2.0f / 3.0f) + s2 * (1.0f / 3.0f);
+            bx[c]    = (sums[16][c] - sums[k][c]) + s1 * (1.0f / 3.0f) + s2 * (2.0f / 3.0f);
+            a[c]     = (ax[c] * bb - bx[c] * ab) * rdet;
+            b[c]     = (bx[c] * aa - ax[c] * ab) * rdet;
+            error -= a[c] * ax[c] + b[c] * bx[c];
+        }
+        if (error >= bestError) continue;
+        error = 0;
+        for (int c = 0; c < 3; ++c) {
+            a[c] = snapTo565(a[c], BITS[c]);
+            b[c] = snapTo565(b[c], BITS[c]);
+            error += a[c] * a[c] * aa + b[c] * b[c] * bb + 2.0f * a[c] * b[c] * ab - 2.0f * (a[c] * ax[c] + b[c] * bx[c]);
+        }
+        if (error < bestError) {
+            bestError = error;
+            memcpy(bestA, a, sizeof(a));
+            memcpy(bestB, b, sizeof(b));
+        }
+    }
+    if (FLT_MAX == bestError) return false;
+
+    // larger endpoint goes first, for the 4 colors mode.
+    uint32_t c0 = pack565(bestA), c1 = pack565(bestB);
+    if (c0 < c1) std::swap(c0, c1);
+    block[0] = (uint8_t)c0;
+    block[1] = (uint8_t)(c0 >> 8);
+    block[2] = (uint8_t)c1;
+    block[3] = (uint8_t)(c1 >> 8);
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// High quality BC1 color block: the better one of cluster fit and bounding box. Blocks with transparent pixels are
+/// always encoded with bounding box endpoints.
+static void encodeBC1BlockHQ(uint8_t * block, const RGBA8 pixels[16], bool bc1) {
+    encodeBC1Block(block, pixels, bc1);
+    uint32_t c0 = load32(block) & 0xFFFF, c1 = load32(block) >> 16;
+    if (bc1 && c0 <= c1) return;
+    uint32_t error = bc1FitIndices(block, pixels, bc1);
+    uint8_t  fit[8];
+    if (!bc1ClusterFit(fit, pixels)) return;
+    if (bc1FitIndices(fit, pixels, bc1) < error) memcpy(block, fit, 8);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Codec of blocks with 2 endpoints and 8 interpolated values: BC3 alpha, unsigned BC4 and signed BC4. Values are
+/// compared in the domain of the decoded values: 8-bit for BC3, 16-bit UNORM or SNORM for BC4.
+struct InterpolatedCodec {
+    int32_t minEndpoint, maxEndpoint;
+    int32_t minValue, maxValue;
+    void (*palette)(int32_t palette[8], const uint8_t * block);
+    int32_t (*toEndpoint)(int32_t value); ///< nearest endpoint of a decoded value.
+};
+
+static constexpr InterpolatedCodec BC3_ALPHA = {
+    0, 255, 0, 255,
+    [](int32_t palette[8], const uint8_t * block) {
+        uint8_t p[8];
+        bc3AlphaPalette(p, block);
+        for (int i = 0; i < 8; ++i) palette[i] = p[i];
+    },
+    [](int32_t v) { return v; },
+};
+
+static constexpr InterpolatedCodec BC4_UNORM = {
+    0, 255, 0, 65535,
+    [](int32_t palette[8], const uint8_t * block) {
+        uint16_t p[8];
+        bc4PaletteUNorm(p, block);
+        for (int i = 0; i < 8; ++i) palette[i] = p[i];
+    },
+    [](int32_t v) { return (v + 128) / 257; },
+};
+
+static constexpr InterpolatedCodec BC4_SNORM = {
+    -127, 127, -32767, 32767,
+    [](int32_t palette[8], const uint8_t * block) {
+        uint16_t p[8];
+        bc4PaletteSNorm(p, block);
+        for (int i = 0; i < 8; ++i) palette[i] = (int16_t)p[i];
+    },
+    [](int32_t v) { return v >= 0 ? (v * 127 + 16383) / 32767 : -((-v * 127 + 16383) / 32767); },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode the block with the given endpoints, pick the nearest palette value of each pixel. Returns the sum of
+/// squared errors.
+static uint64_t encodeInterpolated(uint8_t * block, const int32_t values[16], const InterpolatedCodec & codec,
+                                   int32_t e0, int32_t e1) {
+    block[0] = (uint8_t)e0;
+    block[1] = (uint8_t)e1;
+    int32_t palette[8];
+    codec.palette(palette, block);
+    uint64_t indices = 0, error = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        uint64_t bestError = UINT64_MAX;
+        for (uint32_t k = 0; k < 8; ++k) {
+            int64_t  d = (int64_t)values[i] - palette[k];
+            uint64_t e = (uint64_t)(d * d);
+            if (e < bestError) {
+                best      = k;
+                bestError = e;
+            }
+        }
+        indices |= (uint64_t)best << (i * 3);
+        error += bestError;
+    }
+    memcpy(block + 2, &indices, 6);
+    return error;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode one BC3 alpha or BC4 block. The fast tier uses the value range as endpoints. The high quality tier also
+/// searches nearby endpoints, and tries the 6 values mode, which has exact minimum and maximum values for free.
+static void encodeInterpolatedBlock(uint8_t * block, const int32_t values[16], const InterpolatedCodec & codec,
+                                    CompressionQuality quality) {
+    int32_t lo = values[0], hi = values[0];
+    for (uint32_t i = 1; i < 16; ++i) lo = std::min(lo, values[i]), hi = std::max(hi, values[i]);
+    int32_t eLo = codec.toEndpoint(lo), eHi = codec.toEndpoint(hi);
+    // the first endpoint is the larger one, which selects the 8 values mode.
+    uint64_t error = encodeInterpolated(block, values, codec, eHi, eHi > eLo ? eLo : eHi);
+    if (CompressionQuality::FAST == quality || 0 == error) return;
+
+    uint8_t temp[8];
+    auto    tryEndpoints = [&](int32_t e0, int32_t e1) {
+        e0     = std::min(std::max(e0, codec.minEndpoint), codec.maxEndpoint);
+        e1     = std::min(std::max(e1, codec.minEndpoint), codec.maxEndpoint);
+        auto e = encodeInterpolated(temp, values, codec, e0, e1);
+        if (e < error) {
+            error = e;
+            memcpy(block, temp, 8);
+        }
+    };
+    for (int32_t d0 = -2; d0 <= 2; ++d0)
+        for (int32_t d1 = -2; d1 <= 2; ++d1) {
+            if (eHi + d0 > eLo + d1) tryEndpoints(eHi + d0, eLo + d1);
+        }
+
+    // 6 values mode: endpoints only cover values in between the 2 extremes.
+    int32_t lo6 = codec.maxValue, hi6 = codec.minValue;
+    for (uint32_t i = 0; i < 16; ++i) {
+        if (values[i] == codec.minValue || values[i] == codec.maxValue) continue;
+        lo6 = std::min(lo6, values[i]), hi6 = std::max(hi6, values[i]);
+    }
+    if (lo6 > hi6) lo6 = hi6 = codec.minValue;
+    int32_t eLo6 = codec.toEndpoint(lo6), eHi6 = codec.toEndpoint(hi6);
+    for (int32_t d0 = -1; d0 <= 1; ++d0)
+        for (int32_t d1 = -1; d1 <= 1; ++d1) {
+            if (eLo6 + d0 <= eHi6 + d1) tryEndpoints(eLo6 + d0, eHi6 + d1);
+        }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode 4-bit explicit alpha block of BC2, from 16 8-bit values.
+static void encodeExplicitAlpha(uint8_t * block, const uint8_t values[16]) {
+    uint64_t alpha = 0;
+    for (uint32_t i = 0; i < 16; ++i) alpha |= (uint64_t)((values[i] + 8) / 17) << (i * 4);
+    memcpy(block, &alpha, 8);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode a row of BC1 color blocks, that are 'stride' bytes apart.
+static void encodeBC1Row(uint8_t * dst, size_t stride, const uint8_t * src, size_t pitch, size_t count, bool bc1,
+                         CompressionQuality quality) {
+    if (CompressionQuality::FAST == quality) {
+        getFastRowKernels().encodeBC1(dst, stride, (const RGBA8 *)src, pitch, count, bc1);
+        return;
+    }
+    for (size_t b = 0; b < count; ++b, dst += stride) {
+        RGBA8 pixels[16];
+        gatherBlock(pixels, src + b * 16, pitch, 4);
+        encodeBC1BlockHQ(dst, pixels, bc1);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeDXT1Row(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                          CompressionQuality quality) {
+    encodeBC1Row(dst, 8, src, pitch, count, true, quality);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeDXT3Row(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                          CompressionQuality quality) {
+    encodeBC1Row(dst + 8, 16, src, pitch, count, false, quality);
+    for (size_t b = 0; b < count; ++b, dst += 16) {
+        RGBA8 pixels[16];
+        gatherBlock(pixels, src + b * 16, pitch, 4);
+        uint8_t values[16];
+        for (uint32_t i = 0; i < 16; ++i) values[i] = pixels[i].w;
+        encodeExplicitAlpha(dst, values);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeDXT5Row(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                          CompressionQuality quality) {
+    encodeBC1Row(dst + 8, 16, src, pitch, count, false, quality);
+    for (size_t b = 0; b < count; ++b, dst += 16) {
+        RGBA8 pixels[16];
+        gatherBlock(pixels, src + b * 16, pitch, 4);
+        int32_t values[16];
+        for (uint32_t i = 0; i < 16; ++i) values[i] = pixels[i].w;
+        encodeInterpolatedBlock(dst, values, BC3_ALPHA, quality);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeDXT3ARow(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                           CompressionQuality) {
+    for (size_t b = 0; b < count; ++b, dst += 8) {
+        uint8_t values[16];
+        gatherBlock(values, src + b * 4, pitch, 1);
+        encodeExplicitAlpha(dst, values);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode one channel of 4x4 16-bit pixels, that are 'step' bytes apart, to BC4 block.
+static void encodeBC4Block(uint8_t * block, const uint8_t * src, size_t pitch, size_t step, bool snorm,
+                           CompressionQuality quality) {
+    int32_t values[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint16_t v;
+        memcpy(&v, src + i / 4 * pitch + i % 4 * step, 2);
+        values[i] = snorm ? std::max<int32_t>((int16_t)v, -32767) : v;
+    }
+    encodeInterpolatedBlock(block, values, snorm ? BC4_SNORM : BC4_UNORM, quality);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeDXT5ARow(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                           CompressionQuality quality) {
+    bool snorm = ColorFormat::SIGN_SNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b, dst += 8) encodeBC4Block(dst, src + b * 8, pitch, 2, snorm, quality);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeDXNRow(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                         CompressionQuality quality) {
+    bool snorm = ColorFormat::SIGN_SNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b, dst += 16) {
+        encodeBC4Block(dst, src + b * 16, pitch, 4, snorm, quality);
+        encodeBC4Block(dst + 8, src + b * 16 + 2, pitch, 4, snorm, quality);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode the CTX1 block with the given endpoints, pick the nearest palette value of each pixel. Returns the sum of
+/// squared errors.
+static uint32_t encodeCTX1(uint8_t * block, const uint8_t pixels[32], const uint8_t endpoints[4]) {
+    memcpy(block, endpoints, 4);
+    uint8_t palette[8];
+    ctx1Palette(palette, block);
+    uint32_t indices = 0, error = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0, bestError = UINT32_MAX;
+        for (uint32_t k = 0; k < 4; ++k) {
+            int32_t  dx = (int32_t)palette[k * 2] - pixels[i * 2];
+            int32_t  dy = (int32_t)palette[k * 2 + 1] - pixels[i * 2 + 1];
+            uint32_t e  = (uint32_t)(dx * dx + dy * dy);
+            if (e < bestError) {
+                best      = k;
+                bestError = e;
+            }
+        }
+        indices |= best << (i * 2);
+        error += bestError;
+    }
+    memcpy(block + 4, &indices, 4);
+    return error;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode one CTX1 block. The fast tier uses the diagonal of the bounding box that follows the correlation of the 2
+/// channels. The high quality tier then moves each endpoint channel by one step at a time, as long as error drops.
+static void encodeCTX1Block(uint8_t * block, const uint8_t pixels[32], CompressionQuality quality) {
+    int32_t lo[2] = { 255, 255 }, hi[2] = { 0, 0 }, mean[2] = { 0, 0 };
+    for (uint32_t i = 0; i < 16; ++i)
+        for (int c = 0; c < 2; ++c) {
+            lo[c] = std::min<int32_t>(lo[c], pixels[i * 2 + c]);
+            hi[c] = std::max<int32_t>(hi[c], pixels[i * 2 + c]);
+            mean[c] += pixels[i * 2 + c];
+        }
+    int32_t cov = 0;
+    for (uint32_t i = 0; i < 16; ++i) cov += (pixels[i * 2] * 16 - mean[0]) * (pixels[i * 2 + 1] * 16 - mean[1]);
+    uint8_t  e[4]  = { (uint8_t)lo[0], (uint8_t)(cov < 0 ? hi[1] : lo[1]), (uint8_t)hi[0],
+                      (uint8_t)(cov < 0 ? lo[1] : hi[1]) };
+    uint32_t error = encodeCTX1(block, pixels, e);
+    if (CompressionQuality::FAST == quality) return;
+
+    uint8_t temp[8];
+    for (bool improved = error > 0; improved;) {
+        improved = false;
+        for (int i = 0; i < 4; ++i)
+            for (int d : { -1, 1 }) {
+                int32_t v = e[i] + d;
+                if (v < 0 || v > 255) continue;
+                uint8_t t[4] = { e[0], e[1], e[2], e[3] };
+                t[i]         = (uint8_t)v;
+                auto te      = encodeCTX1(temp, pixels, t);
+                if (te < error) {
+                    error = te;
+                    memcpy(e, t, 4);
+                    memcpy(block, temp, 8);
+                    improved = true;
+                }
+            }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encodeCTX1Row(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                          CompressionQuality quality) {
+    for (size_t b = 0; b < count; ++b, dst += 8) {
+        uint8_t pixels[32];
+        gatherBlock(pixels, src + b * 8, pitch, 2);
+        encodeCTX1Block(dst, pixels, quality);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Each channel is one bit, set when the 8-bit value is 128 or more.
+static void encodeDXT3AAs1111Row(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                                 CompressionQuality) {
+    for (size_t b = 0; b < count; ++b, dst += 8) {
+        uint8_t values[64];
+        gatherBlock(values, src + b * 16, pitch, 4);
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < 64; ++i) bits |= (uint64_t)(values[i] >> 7) << i;
+        memcpy(dst, &bits, 8);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void encode422Row(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t, size_t count,
+                         CompressionQuality) {
+    getFastRowKernels().pack422(dst, (const RGBA8 *)src, count, ColorFormat::LAYOUT_RGBG == format.layout);
+}
+
+/// Block encoders of each compressed layout. They read pixels of the format that the block decoder decodes to.
+static constexpr struct {
+    ColorFormat::Layout layout;
+    void (*encodeRow)(ColorFormat, uint8_t *, const uint8_t *, size_t, size_t, CompressionQuality);
+} BLOCK_ENCODERS[] = {
+    { ColorFormat::LAYOUT_DXT1, &encodeDXT1Row },   { ColorFormat::LAYOUT_DXT3, &encodeDXT3Row },
+    { ColorFormat::LAYOUT_DXT3A, &encodeDXT3ARow }, { ColorFormat::LAYOUT_DXT5, &encodeDXT5Row },
+    { ColorFormat::LAYOUT_DXT5A, &encodeDXT5ARow }, { ColorFormat::LAYOUT_DXN, &encodeDXNRow },
+    { ColorFormat::LAYOUT_BC6H, &encodeBC6HRow },   { ColorFormat::LAYOUT_BC7, &encodeBC7Row },
+    { ColorFormat::LAYOUT_CTX1, &encodeCTX1Row },   { ColorFormat::LAYOUT_DXT3A_AS_1_1_1_1, &encodeDXT3AAs1111Row },
+    { ColorFormat::LAYOUT_GRGB, &encode422Row },    { ColorFormat::LAYOUT_RGBG, &encode422Row },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const BlockEncoder * rg::getBlockEncoder(ColorFormat format) {
+    auto decoder = getBlockDecoder(format);
+    if (!decoder) return nullptr;
+
+    static std::mutex                        mutex;
+    static std::map<uint32_t, BlockEncoder> registry;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        iter = registry.find(format.u32);
+    if (iter != registry.end()) return &iter->second;
+
+    for (const auto & e : BLOCK_ENCODERS) {
+        if (e.layout != format.layout) continue;
+        return &registry.emplace(format.u32, BlockEncoder { format, decoder->decoded, e.encodeRow }).first->second;
+    }
+    return nullptr;
+}
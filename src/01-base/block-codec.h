@@ -0,0 +1,188 @@
+#pragma once
+#include "pixel-convert.h"
+
+namespace rg {
+
+///
+/// Decoder of one block compressed color format. Blocks are decoded to pixels of an uncompressed format, which can then
+/// be converted to any other format with getPixelConversion().
+///
+struct BlockDecoder {
+    /// the compressed format
+    ColorFormat format;
+
+    /// The uncompressed format of decoded pixels. It has the same signs and swizzles as the compressed format, except
+    /// that BC6H always decodes to half floats. Decoded channels are wide enough to hold the decoded values without
+    /// losing precision (e.g. BC4 decodes to 16 bits).
+    ColorFormat decoded;
+
+    /// Decode one row of 'count' blocks. Decoded pixels are written to 'dst' as blockHeight rows, 'pitch' bytes apart.
+    /// Each row is (count * blockWidth) tightly packed pixels of the decoded format.
+    void (*decodeRow)(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+};
+
+///
+/// Returns decoder of the compressed format. The result is cached, so it is cheap to call this repeatedly.
+/// Returns null if the format is not compressed, or not supported yet.
+///
+const BlockDecoder * getBlockDecoder(ColorFormat format);
+
+///
+/// Encoder of one block compressed color format. It is the reverse of BlockDecoder: pixels are converted to the
+/// uncompressed 'source' format first, then compressed block row by block row.
+///
+struct BlockEncoder {
+    /// the compressed format
+    ColorFormat format;
+
+    /// The uncompressed format of pixels that the encoder reads. Always same as BlockDecoder::decoded of the format.
+    ColorFormat source;
+
+    /// Encode one row of 'count' blocks to 'dst'. Source pixels are blockHeight rows, 'pitch' bytes apart. Each row
+    /// is (count * blockWidth) tightly packed pixels of the source format.
+    void (*encodeRow)(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                      CompressionQuality quality);
+};
+
+///
+/// Returns encoder of the compressed format. The result is cached, so it is cheap to call this repeatedly.
+/// Returns null if the format is not compressed, or not supported yet.
+///
+const BlockEncoder * getBlockEncoder(ColorFormat format);
+
+///
+/// Compute the 4 color palette of a BC1 color block, as RGBA8 colors packed in uint32_t (red in the lowest byte).
+/// When 'bc1' is true, the block uses BC1 rules: c0 <= c1 selects 3 colors plus transparent black. Otherwise (color
+/// block of BC2 and BC3), the block always has 4 colors.
+///
+inline void bc1Palette(uint32_t palette[4], const uint8_t * block, bool bc1) {
+    uint32_t c0 = (uint32_t)block[0] | ((uint32_t)block[1] << 8);
+    uint32_t c1 = (uint32_t)block[2] | ((uint32_t)block[3] << 8);
+    uint32_t r0 = (c0 >> 11) & 31, g0 = (c0 >> 5) & 63, b0 = c0 & 31;
+    uint32_t r1 = (c1 >> 11) & 31, g1 = (c1 >> 5) & 63, b1 = c1 & 31;
+    uint32_t rgb0[3] = { (r0 << 3) | (r0 >> 2), (g0 << 2) | (g0 >> 4), (b0 << 3) | (b0 >> 2) };
+    uint32_t rgb1[3] = { (r1 << 3) | (r1 >> 2), (g1 << 2) | (g1 >> 4), (b1 << 3) | (b1 >> 2) };
+    uint32_t rgb2[3], rgb3[3];
+    uint32_t a3 = 0xFF;
+    if (c0 > c1 || !bc1) {
+        for (int i = 0; i < 3; ++i) {
+            rgb2[i] = (2 * rgb0[i] + rgb1[i] + 1) / 3;
+            rgb3[i] = (rgb0[i] + 2 * rgb1[i] + 1) / 3;
+        }
+    } else {
+        for (int i = 0; i < 3; ++i) {
+            rgb2[i] = (rgb0[i] + rgb1[i] + 1) / 2;
+            rgb3[i] = 0;
+        }
+        a3 = 0;
+    }
+    palette[0] = rgb0[0] | (rgb0[1] << 8) | (rgb0[2] << 16) | 0xFF000000u;
+    palette[1] = rgb1[0] | (rgb1[1] << 8) | (rgb1[2] << 16) | 0xFF000000u;
+    palette[2] = rgb2[0] | (rgb2[1] << 8) | (rgb2[2] << 16) | 0xFF000000u;
+    palette[3] = rgb3[0] | (rgb3[1] << 8) | (rgb3[2] << 16) | (a3 << 24);
+}
+
+///
+/// Scalar version of FastRowKernels::decodeBC1.
+///
+void decodeBC1Scalar(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count, size_t stride, bool bc1);
+
+///
+/// Write bounding box endpoints of a BC1 color block. The RGB box [lo, hi] is inset by 1/16 of its size on each side,
+/// since the extremes are rarely hit by the interpolated colors, then rounded to 565. The larger endpoint goes first,
+/// which selects the 4 colors mode. Unless 'swap' is true, which selects the 3 colors plus transparent black mode.
+///
+inline void bc1BoxEndpoints(uint8_t * block, const uint8_t lo[3], const uint8_t hi[3], bool swap) {
+    static constexpr uint32_t BITS[3] = { 5, 6, 5 };
+    uint32_t                  c0 = 0, c1 = 0;
+    for (int i = 0; i < 3; ++i) {
+        uint32_t inset = (uint32_t)(hi[i] - lo[i]) >> 4;
+        uint32_t m     = (1u << BITS[i]) - 1;
+        c0             = (c0 << BITS[i]) | (((hi[i] - inset) * m + 127) / 255);
+        c1             = (c1 << BITS[i]) | (((lo[i] + inset) * m + 127) / 255);
+    }
+    if (swap) std::swap(c0, c1);
+    block[0] = (uint8_t)c0;
+    block[1] = (uint8_t)(c0 >> 8);
+    block[2] = (uint8_t)c1;
+    block[3] = (uint8_t)(c1 >> 8);
+}
+
+///
+/// Encode one BC1 color block from 16 RGBA8 pixels in row major order, using bounding box endpoints. Each pixel picks
+/// the palette color with the smallest sum of absolute RGB differences (the lowest index wins a tie). When 'bc1' is
+/// true and there are transparent pixels (alpha < 128), the block is encoded in the 3 colors plus transparent black
+/// mode, with endpoints fitted to the opaque pixels only.
+///
+/// This is the reference of FastRowKernels::encodeBC1. SIMD kernels must produce exactly the same blocks.
+///
+void encodeBC1Block(uint8_t * block, const RGBA8 pixels[16], bool bc1);
+
+///
+/// Scalar version of FastRowKernels::encodeBC1.
+///
+void encodeBC1Scalar(uint8_t * dst, size_t stride, const RGBA8 * src, size_t pitch, size_t count, bool bc1);
+
+///
+/// Scalar version of FastRowKernels::interpolateBC7.
+///
+void interpolateBC7Scalar(uint8_t * dst, const uint8_t * e0, const uint8_t * e1, const uint8_t * weights, size_t count);
+
+///
+/// Scalar version of FastRowKernels::interpolateBC6H.
+///
+void interpolateBC6HScalar(int32_t * dst, const int32_t * e0, const int32_t * e1, const uint8_t * weights,
+                           size_t count);
+
+///
+/// Compute the 4 values palette of a CTX1 block, as 2 channels 8-bit values. The block starts with the two endpoints
+/// (X0, Y0, X1, Y1), followed by 2-bit indices of the 16 pixels in row major order, from the lowest bit. The two
+/// values in between are interpolated at 1/3 and 2/3, rounding down.
+///
+inline void ctx1Palette(uint8_t palette[8], const uint8_t * block) {
+    for (int c = 0; c < 2; ++c) {
+        uint32_t e0 = block[c], e1 = block[2 + c];
+        palette[c]     = (uint8_t)e0;
+        palette[2 + c] = (uint8_t)e1;
+        palette[4 + c] = (uint8_t)((2 * e0 + e1) / 3);
+        palette[6 + c] = (uint8_t)((e0 + 2 * e1) / 3);
+    }
+}
+
+///
+/// Scalar versions of FastRowKernels::unpack422, pack422, decodeCTX1 and decodeDXT3AAs1111.
+///
+void unpack422Scalar(RGBA8 * dst, const uint8_t * src, size_t count, bool rgbg);
+void pack422Scalar(uint8_t * dst, const RGBA8 * src, size_t count, bool rgbg);
+void decodeCTX1Scalar(uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void decodeDXT3AAs1111Scalar(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count);
+
+///
+/// BC6H and BC7 (BPTC) block row decoders and encoders, as used by BlockDecoder and BlockEncoder. BC7 decodes to RGBA8,
+/// and BC6H decodes to RGBA16F with alpha of 1. The encoders search the modes as deep as the quality asks for, and
+/// encode blocks of one row in parallel. See bptc-codec.cpp for details.
+///
+void decodeBC6HRow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void decodeBC7Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void encodeBC6HRow(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                   CompressionQuality quality);
+void encodeBC7Row(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                  CompressionQuality quality);
+
+///
+/// ETC2 and EAC block row decoders, as used by BlockDecoder. ETC2 (including ETC1 blocks) decodes to RGBA8, and EAC
+/// R11/RG11 decode to 16-bit channels. See etc-codec.cpp for details.
+///
+void decodeETC2Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void decodeETC2A1Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void decodeETC2EACRow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void decodeEACR11Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+void decodeEACRG11Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+
+///
+/// ASTC block row decoder of all 2D footprints, as used by BlockDecoder. Blocks decode to RGBA8 following the LDR
+/// profile: HDR blocks decode to the error color (opaque magenta). See astc-codec.cpp for details.
+///
+void decodeASTCRow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+
+} // namespace rg
@@ -0,0 +1,1071 @@
+#include "pch.h"
+#include "block-codec.h"
+#include "thread-pool.h"
+#include <cfloat>
+#include <cmath>
+
+using namespace rg;
+
+// *********************************************************************************************************************
+// BPTC (BC6H and BC7) common
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The 128 bits of one BPTC block. Fields are read and written one after another, from the lowest bit up.
+class BlockBits {
+public:
+    BlockBits() = default;
+
+    explicit BlockBits(const uint8_t * block) { memcpy(_u, block, 16); }
+
+    void store(uint8_t * block) const { memcpy(block, _u, 16); }
+
+    uint32_t position() const { return _pos; }
+
+    /// Read the next 'bits' (0 to 32) bits.
+    uint32_t read(uint32_t bits) {
+        if (0 == bits) return 0;
+        uint64_t v;
+        if (_pos >= 64) {
+            v = _u[1] >> (_pos - 64);
+        } else if (_pos + bits <= 64) {
+            v = _u[0] >> _pos;
+        } else {
+            v = (_u[0] >> _pos) | (_u[1] << (64 - _pos));
+        }
+        _pos += bits;
+        return (uint32_t)(v & ((1ull << bits) - 1));
+    }
+
+    /// Write the lowest 'bits' (0 to 32) bits of the value, to bits that have not been written yet.
+    void write(uint32_t value, uint32_t bits) {
+        if (0 == bits) return;
+        uint64_t v = value & ((1ull << bits) - 1);
+        if (_pos >= 64) {
+            _u[1] |= v << (_pos - 64);
+        } else {
+            _u[0] |= v << _pos;
+            if (_pos + bits > 64) _u[1] |= v >> (64 - _pos);
+        }
+        _pos += bits;
+    }
+
+private:
+    uint64_t _u[2] = {};
+    uint32_t _pos  = 0;
+};
+
+/// Subset of each pixel of 2 subsets partitions. Bit i is the subset of pixel i. BC6H uses the first 32 of them.
+static constexpr uint16_t PARTITIONS2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8,
+    0xFF00, 0xFFF0, 0xF000, 0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110,
+    0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C, 0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696,
+    0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660, 0x0272, 0x04E4, 0x4E40, 0x2720,
+    0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+/// Subset of each pixel of 3 subsets partitions. Bits [2i, 2i+1] are the subset of pixel i.
+static constexpr uint32_t PARTITIONS3[64] = {
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+/// Anchor pixel of the 2nd subset of 2 subsets partitions.
+static constexpr uint8_t ANCHORS2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2,  8,  2,  2,  8,  8,  15, 2, 8,  2,  2,
+    8,  8,  2,  2,  15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,  6,  2,  6,  8,  15, 15, 2, 2,
+    15, 15, 15, 15, 15, 2,  2,  15,
+};
+
+/// Anchor pixel of the 2nd subset of 3 subsets partitions.
+static constexpr uint8_t ANCHORS3A[64] = {
+    3,  3, 15, 15, 8, 3,  15, 15, 8,  8,  6,  6,  6,  5,  3,  3,  3,  3,  8,  15, 3,  3,  6,  10, 5,  8,  8, 6,
+    8,  5, 15, 15, 8, 15, 3,  5,  6,  10, 8,  15, 15, 3,  15, 5,  15, 15, 15, 15, 3,  15, 5,  5,  5,  8,  5, 10,
+    5, 10, 8,  13, 15, 12, 3,  3,
+};
+
+/// Anchor pixel of the 3rd subset of 3 subsets partitions.
+static constexpr uint8_t ANCHORS3B[64] = {
+    15, 8,  8,  3,  15, 15, 3,  8,  15, 15, 15, 15, 15, 15, 15, 8,  15, 8,  15, 3,  15, 8,  15, 8,  3,  15, 6, 10,
+    15, 15, 10, 8,  15, 3,  15, 10, 10, 8,  9,  10, 6,  15, 8,  15, 3,  6,  6,  8,  15, 3,  15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 3,  15, 15, 8,
+};
+
+/// Interpolation weights of 2, 3 and 4 bits indices, indexed by [bits - 2][index].
+static constexpr uint8_t WEIGHTS[3][16] = {
+    { 0, 21, 43, 64 },
+    { 0, 9, 18, 27, 37, 46, 55, 64 },
+    { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Returns subset of the pixel.
+static inline uint32_t subsetOf(uint32_t subsets, uint32_t partition, uint32_t pixel) {
+    if (2 == subsets) return (PARTITIONS2[partition] >> pixel) & 1;
+    if (3 == subsets) return (PARTITIONS3[partition] >> (pixel * 2)) & 3;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Returns anchor pixel of the subset. The index of anchor pixel is stored with one less bit, since its highest bit is
+/// always 0.
+static inline uint32_t anchorOf(uint32_t subsets, uint32_t partition, uint32_t subset) {
+    if (0 == subset) return 0;
+    if (2 == subsets) return ANCHORS2[partition];
+    return 1 == subset ? ANCHORS3A[partition] : ANCHORS3B[partition];
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline bool isAnchor(uint32_t subsets, uint32_t partition, uint32_t pixel) {
+    for (uint32_t s = 0; s < subsets; ++s) {
+        if (anchorOf(subsets, partition, s) == pixel) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::interpolateBC7Scalar(uint8_t * dst, const uint8_t * e0, const uint8_t * e1, const uint8_t * weights,
+                              size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t w = weights[i];
+        dst[i]     = (uint8_t)(((64 - w) * e0[i] + w * e1[i] + 32) >> 6);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::interpolateBC6HScalar(int32_t * dst, const int32_t * e0, const int32_t * e1, const uint8_t * weights,
+                               size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int32_t w = weights[i];
+        dst[i]    = ((64 - w) * e0[i] + w * e1[i] + 32) >> 6;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Fit a line through the points, with least squares. Returns the squared distance of all points to the line. Also
+/// returns the 2 ends of the line segment that covers all points.
+static float fitLine(float lo[4], float hi[4], const float (*points)[4], uint32_t count, uint32_t channels) {
+    float mean[4] = {};
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) mean[c] += points[i][c];
+    }
+    for (uint32_t c = 0; c < channels; ++c) mean[c] /= (float)count;
+
+    float cov[4][4] = {};
+    for (uint32_t i = 0; i < count; ++i) {
+        float d[4];
+        for (uint32_t c = 0; c < channels; ++c) d[c] = points[i][c] - mean[c];
+        for (uint32_t r = 0; r < channels; ++r) {
+            for (uint32_t c = r; c < channels; ++c) cov[r][c] += d[r] * d[c];
+        }
+    }
+    float total = 0;
+    for (uint32_t r = 0; r < channels; ++r) {
+        total += cov[r][r];
+        for (uint32_t c = 0; c < r; ++c) cov[r][c] = cov[c][r];
+    }
+
+    // Power iteration, starting from the row of the largest variance, which is never orthogonal to the principal axis.
+    uint32_t start = 0;
+    for (uint32_t c = 1; c < channels; ++c) {
+        if (cov[c][c] > cov[start][start]) start = c;
+    }
+    float axis[4] = {};
+    for (uint32_t c = 0; c < channels; ++c) axis[c] = cov[start][c];
+    float lambda = 0;
+    for (int iter = 0; iter < 8; ++iter) {
+        float next[4] = {}, len = 0;
+        for (uint32_t r = 0; r < channels; ++r) {
+            for (uint32_t c = 0; c < channels; ++c) next[r] += cov[r][c] * axis[c];
+            len += next[r] * next[r];
+        }
+        if (len < FLT_MIN) break;
+        len    = std::sqrt(len);
+        lambda = len;
+        for (uint32_t c = 0; c < channels; ++c) axis[c] = next[c] / len;
+    }
+    if (lambda <= 0) {
+        // all points are the same.
+        for (uint32_t c = 0; c < channels; ++c) lo[c] = hi[c] = mean[c];
+        return 0;
+    }
+
+    float tmin = FLT_MAX, tmax = -FLT_MAX;
+    for (uint32_t i = 0; i < count; ++i) {
+        float t = 0;
+        for (uint32_t c = 0; c < channels; ++c) t += (points[i][c] - mean[c]) * axis[c];
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+    for (uint32_t c = 0; c < channels; ++c) {
+        lo[c] = mean[c] + axis[c] * tmin;
+        hi[c] = mean[c] + axis[c] * tmax;
+    }
+    return std::max(0.0f, total - lambda);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Rank partitions of 'subsets' subsets by how well each subset fits a line, and return the best 'n' of the first
+/// 'partitions' partitions.
+static uint32_t rankPartitions(uint8_t * best, uint32_t n, const float (*points)[4], uint32_t channels,
+                               uint32_t subsets, uint32_t partitions) {
+    float    errors[64];
+    uint8_t  order[64];
+    for (uint32_t p = 0; p < partitions; ++p) {
+        float    error = 0;
+        for (uint32_t s = 0; s < subsets; ++s) {
+            float    subset[16][4];
+            uint32_t count = 0;
+            for (uint32_t i = 0; i < 16; ++i) {
+                if (subsetOf(subsets, p, i) == s) memcpy(subset[count++], points[i], sizeof(float) * 4);
+            }
+            float lo[4], hi[4];
+            if (count) error += fitLine(lo, hi, subset, count, channels);
+        }
+        errors[p] = error;
+        order[p]  = (uint8_t)p;
+    }
+    n = std::min(n, partitions);
+    std::partial_sort(order, order + n, order + partitions, [&](uint8_t a, uint8_t b) { return errors[a] < errors[b]; });
+    memcpy(best, order, n);
+    return n;
+}
+
+// *********************************************************************************************************************
+// BC7 decoder
+// *********************************************************************************************************************
+
+/// Properties of the 8 BC7 modes.
+static constexpr struct BC7Mode {
+    uint8_t subsets;
+    uint8_t partitionBits;
+    uint8_t rotationBits;
+    uint8_t selectorBits;   ///< index selection bit of mode 4
+    uint8_t colorBits;      ///< bits of each color channel of endpoints, not including the p-bit.
+    uint8_t alphaBits;      ///< bits of the alpha channel of endpoints. 0 means alpha is always 255.
+    uint8_t endpointPBits;  ///< 1 if each endpoint has its own p-bit, which is the shared lowest bit of all channels.
+    uint8_t sharedPBits;    ///< 1 if both endpoints of a subset share one p-bit.
+    uint8_t indexBits;      ///< bits of the primary indices
+    uint8_t index2Bits;     ///< bits of the secondary indices, of modes with separate color and alpha indices.
+} BC7_MODES[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 }, { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 }, { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 }, { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 }, { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 }, { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Expand 5 to 8 bits endpoint channel to 8 bits, by repeating its highest bits.
+static inline uint8_t bc7Expand(uint32_t v, uint32_t bits) { return (uint8_t)((v << (8 - bits)) | (v >> (2 * bits - 8))); }
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one BC7 block to 16 RGBA8 pixels. The bit parsing is scalar. The interpolation, which is the bulk of the
+/// math, is done by the SIMD kernel for all 64 channels at once.
+static void decodeBC7Block(uint8_t * dst, size_t pitch, const uint8_t * block, const FastRowKernels & kernels) {
+    uint32_t mode = 0;
+    while (mode < 8 && 0 == (block[0] & (1u << mode))) ++mode;
+    if (8 == mode) {
+        // reserved mode: transparent black.
+        for (size_t y = 0; y < 4; ++y) memset(dst + y * pitch, 0, 16);
+        return;
+    }
+    const auto & m = BC7_MODES[mode];
+    BlockBits    bits(block);
+    bits.read(mode + 1);
+    uint32_t partition = bits.read(m.partitionBits);
+    uint32_t rotation  = bits.read(m.rotationBits);
+    uint32_t selector  = bits.read(m.selectorBits);
+
+    // endpoints: RGB of all endpoints, then alpha of all endpoints, then the p-bits.
+    uint32_t endpoints = m.subsets * 2u;
+    uint32_t ep[6][4];
+    for (uint32_t c = 0; c < 3; ++c) {
+        for (uint32_t e = 0; e < endpoints; ++e) ep[e][c] = bits.read(m.colorBits);
+    }
+    for (uint32_t e = 0; e < endpoints; ++e) ep[e][3] = bits.read(m.alphaBits);
+    uint32_t cb = m.colorBits, ab = m.alphaBits;
+    if (m.endpointPBits || m.sharedPBits) {
+        uint32_t pbits[6];
+        if (m.endpointPBits) {
+            for (uint32_t e = 0; e < endpoints; ++e) pbits[e] = bits.read(1);
+        } else {
+            for (uint32_t s = 0; s < m.subsets; ++s) pbits[s * 2] = pbits[s * 2 + 1] = bits.read(1);
+        }
+        for (uint32_t e = 0; e < endpoints; ++e) {
+            for (uint32_t c = 0; c < 4; ++c) ep[e][c] = (ep[e][c] << 1) | pbits[e];
+        }
+        ++cb;
+        if (ab) ++ab;
+    }
+    uint8_t expanded[6][4];
+    for (uint32_t e = 0; e < endpoints; ++e) {
+        for (uint32_t c = 0; c < 3; ++c) expanded[e][c] = bc7Expand(ep[e][c], cb);
+        expanded[e][3] = ab ? bc7Expand(ep[e][3], ab) : 0xFF;
+    }
+
+    // indices
+    uint8_t indices[16], indices2[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        indices[i] = (uint8_t)bits.read(m.indexBits - (isAnchor(m.subsets, partition, i) ? 1 : 0));
+    }
+    if (m.index2Bits) {
+        for (uint32_t i = 0; i < 16; ++i) indices2[i] = (uint8_t)bits.read(m.index2Bits - (0 == i ? 1 : 0));
+    }
+    RG_ASSERT(128 == bits.position());
+
+    // Color and alpha share the primary indices, unless the mode has the secondary ones. In that case, the selector
+    // decides which of them is for color.
+    const uint8_t * colorWeights = WEIGHTS[m.indexBits - 2];
+    const uint8_t * alphaWeights = colorWeights;
+    const uint8_t * colorIndices = indices;
+    const uint8_t * alphaIndices = indices;
+    if (m.index2Bits) {
+        alphaWeights = WEIGHTS[m.index2Bits - 2];
+        alphaIndices = indices2;
+        if (selector) {
+            std::swap(colorWeights, alphaWeights);
+            std::swap(colorIndices, alphaIndices);
+        }
+    }
+
+    alignas(16) uint8_t e0[64], e1[64], w[64], out[64];
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t s = subsetOf(m.subsets, partition, i);
+        memcpy(e0 + i * 4, expanded[s * 2], 4);
+        memcpy(e1 + i * 4, expanded[s * 2 + 1], 4);
+        w[i * 4] = w[i * 4 + 1] = w[i * 4 + 2] = colorWeights[colorIndices[i]];
+        w[i * 4 + 3]                           = alphaWeights[alphaIndices[i]];
+    }
+    kernels.interpolateBC7(out, e0, e1, w, 64);
+    if (rotation) {
+        for (uint32_t i = 0; i < 16; ++i) std::swap(out[i * 4 + 3], out[i * 4 + rotation - 1]);
+    }
+    for (size_t y = 0; y < 4; ++y) memcpy(dst + y * pitch, out + y * 16, 16);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeBC7Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    const auto & kernels = getFastRowKernels();
+    for (size_t b = 0; b < count; ++b) decodeBC7Block(dst + b * 16, pitch, src + b * 16, kernels);
+}
+
+// *********************************************************************************************************************
+// BC6H decoder
+// *********************************************************************************************************************
+
+/// Endpoint fields of BC6H blocks. W and X are the endpoints of the 1st subset, Y and Z are of the 2nd subset. D is
+/// the partition.
+enum BC6HField : uint8_t { END, RW, GW, BW, RX, GX, BX, RY, GY, BY, RZ, GZ, BZ, D };
+
+/// A run of bits of one field. Bits are stored from 'first' to 'last'. Most runs go up, but a few are reversed.
+struct BC6HBits {
+    uint8_t field, first, last;
+};
+
+/// Properties and bit layouts of the 14 BC6H modes.
+static constexpr struct BC6HMode {
+    uint8_t  modeBits;     ///< 2 or 5
+    uint8_t  value;        ///< value of the mode bits
+    uint8_t  subsets;
+    bool     transformed;  ///< if true, all endpoints except W are stored as deltas to W.
+    uint8_t  endpointBits; ///< precision of endpoints
+    uint8_t  deltaBits[3]; ///< bits of R, G and B of X, Y and Z.
+    BC6HBits layout[24];
+} BC6H_MODES[14] = {
+    { 2, 0x00, 2, true, 10, { 5, 5, 5 },
+      { { GY, 4, 4 }, { BY, 4, 4 }, { BZ, 4, 4 }, { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 },
+        { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 },
+        { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 } } },
+    { 2, 0x01, 2, true, 7, { 6, 6, 6 },
+      { { GY, 5, 5 }, { GZ, 4, 4 }, { GZ, 5, 5 }, { RW, 0, 6 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 },
+        { GW, 0, 6 }, { BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 6 }, { BZ, 3, 3 }, { BZ, 5, 5 },
+        { BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 },
+        { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 } } },
+    { 5, 0x02, 2, true, 11, { 5, 4, 4 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 }, { RW, 10, 10 }, { GY, 0, 3 }, { GX, 0, 3 },
+        { GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 },
+        { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 } } },
+    { 5, 0x06, 2, true, 11, { 4, 5, 4 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { GZ, 4, 4 }, { GY, 0, 3 },
+        { GX, 0, 4 }, { GW, 10, 10 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 },
+        { RY, 0, 3 }, { BZ, 0, 0 }, { BZ, 2, 2 }, { RZ, 0, 3 }, { GY, 4, 4 }, { BZ, 3, 3 }, { D, 0, 4 } } },
+    { 5, 0x0A, 2, true, 11, { 4, 4, 5 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { BY, 4, 4 }, { GY, 0, 3 },
+        { GX, 0, 3 }, { GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BW, 10, 10 }, { BY, 0, 3 },
+        { RY, 0, 3 }, { BZ, 1, 1 }, { BZ, 2, 2 }, { RZ, 0, 3 }, { BZ, 4, 4 }, { BZ, 3, 3 }, { D, 0, 4 } } },
+    { 5, 0x0E, 2, true, 9, { 5, 5, 5 },
+      { { RW, 0, 8 }, { BY, 4, 4 }, { GW, 0, 8 }, { GY, 4, 4 }, { BW, 0, 8 }, { BZ, 4, 4 }, { RX, 0, 4 },
+        { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 },
+        { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 } } },
+    { 5, 0x12, 2, true, 8, { 6, 5, 5 },
+      { { RW, 0, 7 }, { GZ, 4, 4 }, { BY, 4, 4 }, { GW, 0, 7 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 7 },
+        { BZ, 3, 3 }, { BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 },
+        { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 } } },
+    { 5, 0x16, 2, true, 8, { 5, 6, 5 },
+      { { RW, 0, 7 }, { BZ, 0, 0 }, { BY, 4, 4 }, { GW, 0, 7 }, { GY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 },
+        { GZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 },
+        { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 },
+        { D, 0, 4 } } },
+    { 5, 0x1A, 2, true, 8, { 5, 5, 6 },
+      { { RW, 0, 7 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 7 }, { BY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 },
+        { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 },
+        { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 },
+        { D, 0, 4 } } },
+    { 5, 0x1E, 2, false, 6, { 6, 6, 6 },
+      { { RW, 0, 5 }, { GZ, 4, 4 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 5 }, { GY, 5, 5 },
+        { BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 5 }, { GZ, 5, 5 }, { BZ, 3, 3 }, { BZ, 5, 5 },
+        { BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 },
+        { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 } } },
+    { 5, 0x03, 1, false, 10, { 10, 10, 10 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 9 }, { GX, 0, 9 }, { BX, 0, 9 } } },
+    { 5, 0x07, 1, true, 11, { 9, 9, 9 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 8 }, { RW, 10, 10 }, { GX, 0, 8 }, { GW, 10, 10 },
+        { BX, 0, 8 }, { BW, 10, 10 } } },
+    { 5, 0x0B, 1, true, 12, { 8, 8, 8 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 7 }, { RW, 11, 10 }, { GX, 0, 7 }, { GW, 11, 10 },
+        { BX, 0, 7 }, { BW, 11, 10 } } },
+    { 5, 0x0F, 1, true, 16, { 4, 4, 4 },
+      { { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 15, 10 }, { GX, 0, 3 }, { GW, 15, 10 },
+        { BX, 0, 3 }, { BW, 15, 10 } } },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Returns the mode of the mode bits, or null for reserved modes.
+static const BC6HMode * findBC6HMode(uint32_t value) {
+    for (const auto & m : BC6H_MODES) {
+        if (m.value == (value & ((1u << m.modeBits) - 1))) return &m;
+    }
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline int32_t signExtend(int32_t v, uint32_t bits) {
+    uint32_t shift = 32 - bits;
+    return (int32_t)((uint32_t)v << shift) >> shift;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Unquantize endpoint of 'bits' precision to 16 bits (unsigned) or 15 bits plus sign (signed), before interpolation.
+static inline int32_t bc6hUnquantize(int32_t v, uint32_t bits, bool sf16) {
+    if (!sf16) {
+        if (bits >= 15 || 0 == v) return v;
+        if (v == (1 << bits) - 1) return 0xFFFF;
+        return ((v << 16) + 0x8000) >> bits;
+    }
+    if (bits >= 16) return v;
+    bool    negative = v < 0;
+    int32_t u        = negative ? -v : v;
+    if (0 == u) {
+    } else if (u >= (1 << (bits - 1)) - 1) {
+        u = 0x7FFF;
+    } else {
+        u = ((u << 15) + 0x4000) >> (bits - 1);
+    }
+    return negative ? -u : u;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Scale interpolated value to half float bits.
+static inline uint16_t bc6hFinish(int32_t v, bool sf16) {
+    if (!sf16) return (uint16_t)((v * 31) >> 6);
+    if (v < 0) return (uint16_t)(0x8000 | ((-v * 31) >> 5));
+    return (uint16_t)((v * 31) >> 5);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one BC6H block to 16 RGBA16F pixels. Alpha is always 1.
+static void decodeBC6HBlock(uint8_t * dst, size_t pitch, const uint8_t * block, bool sf16,
+                            const FastRowKernels & kernels) {
+    BlockBits bits(block);
+    uint32_t  value = bits.read(2);
+    if (value > 1) value |= bits.read(3) << 2;
+    const BC6HMode * m = findBC6HMode(value);
+    alignas(16) uint16_t out[64];
+    if (!m) {
+        // reserved mode: black.
+        for (uint32_t i = 0; i < 16; ++i) {
+            out[i * 4] = out[i * 4 + 1] = out[i * 4 + 2] = 0;
+            out[i * 4 + 3]                             = 0x3C00;
+        }
+        for (size_t y = 0; y < 4; ++y) memcpy(dst + y * pitch, out + y * 16, 32);
+        return;
+    }
+
+    int32_t fields[D + 1] = {};
+    for (const auto & r : m->layout) {
+        if (END == r.field) break;
+        int step = r.first <= r.last ? 1 : -1;
+        for (int b = r.first;; b += step) {
+            fields[r.field] |= (int32_t)(bits.read(1) << b);
+            if (b == r.last) break;
+        }
+    }
+    uint32_t partition = (uint32_t)fields[D];
+
+    // endpoints[e][c], in the order of W, X, Y, Z.
+    uint32_t eb        = m->endpointBits;
+    uint32_t endpoints = m->subsets * 2u;
+    int32_t  ep[4][3];
+    for (uint32_t e = 0; e < endpoints; ++e) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            int32_t v = fields[RW + e * 3 + c];
+            if (0 == e) {
+                if (sf16) v = signExtend(v, eb);
+            } else {
+                if (m->transformed || sf16) v = signExtend(v, m->deltaBits[c]);
+                if (m->transformed) {
+                    v = (ep[0][c] + v) & ((1 << eb) - 1);
+                    if (sf16) v = signExtend(v, eb);
+                }
+            }
+            ep[e][c] = v;
+        }
+    }
+    for (uint32_t e = 0; e < endpoints; ++e) {
+        for (uint32_t c = 0; c < 3; ++c) ep[e][c] = bc6hUnquantize(ep[e][c], eb, sf16);
+    }
+
+    uint32_t        indexBits = 2 == m->subsets ? 3 : 4;
+    const uint8_t * weights   = WEIGHTS[indexBits - 2];
+    alignas(16) int32_t e0[48], e1[48], interpolated[48];
+    alignas(16) uint8_t w[48];
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t s     = subsetOf(m->subsets, partition, i);
+        uint32_t index = bits.read(indexBits - (isAnchor(m->subsets, partition, i) ? 1 : 0));
+        for (uint32_t c = 0; c < 3; ++c) {
+            e0[i * 3 + c] = ep[s * 2][c];
+            e1[i * 3 + c] = ep[s * 2 + 1][c];
+            w[i * 3 + c]  = weights[index];
+        }
+    }
+    RG_ASSERT(128 == bits.position());
+    kernels.interpolateBC6H(interpolated, e0, e1, w, 48);
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) out[i * 4 + c] = bc6hFinish(interpolated[i * 3 + c], sf16);
+        out[i * 4 + 3] = 0x3C00;
+    }
+    for (size_t y = 0; y < 4; ++y) memcpy(dst + y * pitch, out + y * 16, 32);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeBC6HRow(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    const auto & kernels = getFastRowKernels();
+    bool         sf16    = ColorFormat::SIGN_FLOAT == format.sign012;
+    for (size_t b = 0; b < count; ++b) decodeBC6HBlock(dst + b * 32, pitch, src + b * 16, sf16, kernels);
+}
+
+// *********************************************************************************************************************
+// BC7 encoder
+// *********************************************************************************************************************
+
+/// Encoding parameters of one BC7 block.
+struct BC7Params {
+    uint32_t mode;
+    uint32_t partition;
+    uint32_t rotation;
+    uint32_t selector;
+};
+
+/// Quantized endpoints of one subset, and the 8-bit values that they expand to.
+struct BC7Endpoints {
+    uint8_t q[2][4];     ///< channels, without the p-bit
+    uint8_t p[2];        ///< p-bit of each endpoint
+    uint8_t value[2][4]; ///< expanded 8 bits channels
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Quantize one 8 bits channel to 'bits' bits plus the given p-bit (-1 means no p-bit). Returns the squared error.
+static float bc7QuantizeChannel(uint8_t & q, uint8_t & value, float v, uint32_t bits, int pbit) {
+    uint32_t total = bits + (pbit >= 0 ? 1 : 0);
+    int32_t  guess = (int32_t)std::lround(v * (float)((1 << total) - 1) / 255.0f) >> (pbit >= 0 ? 1 : 0);
+    float    best  = FLT_MAX;
+    for (int32_t c = guess - 1; c <= guess + 1; ++c) {
+        if (c < 0 || c >= (1 << bits)) continue;
+        uint32_t code = pbit >= 0 ? ((uint32_t)c << 1) | (uint32_t)pbit : (uint32_t)c;
+        uint8_t  x    = bc7Expand(code, total);
+        float    d    = (float)x - v;
+        if (d * d < best) {
+            best  = d * d;
+            q     = (uint8_t)c;
+            value = x;
+        }
+    }
+    return best;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Quantize both endpoints of one subset, and pick the p-bits that fit them best. Channel 3 is quantized only when the
+/// mode has alpha. Or else, it is always 255.
+static void bc7QuantizeEndpoints(BC7Endpoints & out, const float ends[2][4], const BC7Mode & m) {
+    auto quantize = [&](uint32_t e, int pbit) {
+        float error = 0;
+        for (uint32_t c = 0; c < 3; ++c) error += bc7QuantizeChannel(out.q[e][c], out.value[e][c], ends[e][c], m.colorBits, pbit);
+        if (m.alphaBits) {
+            error += bc7QuantizeChannel(out.q[e][3], out.value[e][3], ends[e][3], m.alphaBits, pbit);
+        } else {
+            out.q[e][3] = 0, out.value[e][3] = 0xFF;
+        }
+        out.p[e] = (uint8_t)std::max(pbit, 0);
+        return error;
+    };
+    if (m.endpointPBits) {
+        for (uint32_t e = 0; e < 2; ++e) {
+            float error0 = quantize(e, 0);
+            float error1 = quantize(e, 1);
+            if (error0 < error1) quantize(e, 0); // or else p-bit 1 is better, and is already stored.
+        }
+    } else if (m.sharedPBits) {
+        float error0 = quantize(0, 0);
+        error0 += quantize(1, 0);
+        float error1 = quantize(0, 1);
+        error1 += quantize(1, 1);
+        if (error0 < error1) {
+            quantize(0, 0);
+            quantize(1, 0);
+        }
+    } else {
+        quantize(0, -1);
+        quantize(1, -1);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Pick the best palette entry for each pixel of the subset, over the channels [c0, c1). Returns the squared error.
+static uint32_t bc7FitIndices(uint8_t * indices, const RGBA8 pixels[16], const uint8_t * subsetPixels, uint32_t count,
+                              const BC7Endpoints & ends, uint32_t indexBits, uint32_t c0, uint32_t c1) {
+    const uint8_t * weights = WEIGHTS[indexBits - 2];
+    uint32_t        entries = 1u << indexBits;
+    uint8_t         palette[16][4];
+    for (uint32_t k = 0; k < entries; ++k) {
+        uint32_t w = weights[k];
+        for (uint32_t c = c0; c < c1; ++c) {
+            palette[k][c] = (uint8_t)(((64 - w) * ends.value[0][c] + w * ends.value[1][c] + 32) >> 6);
+        }
+    }
+    uint32_t total = 0;
+    for (uint32_t j = 0; j < count; ++j) {
+        const uint8_t * px   = &pixels[subsetPixels[j]].x;
+        uint32_t        best = UINT32_MAX;
+        for (uint32_t k = 0; k < entries; ++k) {
+            uint32_t error = 0;
+            for (uint32_t c = c0; c < c1; ++c) {
+                int32_t d = (int32_t)palette[k][c] - px[c];
+                error += (uint32_t)(d * d);
+            }
+            if (error < best) {
+                best                    = error;
+                indices[subsetPixels[j]] = (uint8_t)k;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Least squares endpoints of the channels [c0, c1) of one subset, given the indices.
+static bool bc7RefineEndpoints(float ends[2][4], const RGBA8 pixels[16], const uint8_t * subsetPixels, uint32_t count,
+                               const uint8_t * indices, uint32_t indexBits, uint32_t c0, uint32_t c1) {
+    const uint8_t * weights = WEIGHTS[indexBits - 2];
+    float           aa = 0, ab = 0, bb = 0, ax[4] = {}, bx[4] = {};
+    for (uint32_t j = 0; j < count; ++j) {
+        uint32_t i = subsetPixels[j];
+        float    t = weights[indices[i]] / 64.0f, s = 1.0f - t;
+        aa += s * s, ab += s * t, bb += t * t;
+        const uint8_t * px = &pixels[i].x;
+        for (uint32_t c = c0; c < c1; ++c) ax[c] += s * px[c], bx[c] += t * px[c];
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f) return false;
+    for (uint32_t c = c0; c < c1; ++c) {
+        ends[0][c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+        ends[1][c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode the block with the given mode, partition, rotation and index selector. Returns the squared error.
+static uint32_t encodeBC7Params(uint8_t * block, const RGBA8 source[16], const BC7Params & params, bool refine) {
+    const auto & m = BC7_MODES[params.mode];
+
+    // Rotation swaps alpha with one of the color channels, after decoding. So swap them before encoding.
+    RGBA8 pixels[16];
+    memcpy(pixels, source, sizeof(pixels));
+    if (params.rotation) {
+        for (auto & p : pixels) std::swap((&p.x)[3], (&p.x)[params.rotation - 1]);
+    }
+
+    // Modes with separate alpha fit color and alpha independently, with separate indices.
+    bool     separate     = m.index2Bits > 0;
+    uint32_t colorBits    = m.indexBits;
+    uint32_t alphaBits    = m.index2Bits;
+    if (separate && params.selector) std::swap(colorBits, alphaBits);
+    uint32_t colorEnd     = separate || !m.alphaBits ? 3 : 4;
+
+    BC7Endpoints ends[3];
+    uint8_t      colorIndices[16], alphaIndices[16];
+    uint32_t     error = 0;
+    for (uint32_t s = 0; s < m.subsets; ++s) {
+        uint8_t  subsetPixels[16];
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < 16; ++i) {
+            if (subsetOf(m.subsets, params.partition, i) == s) subsetPixels[count++] = (uint8_t)i;
+        }
+        float points[16][4];
+        for (uint32_t j = 0; j < count; ++j) {
+            const uint8_t * px = &pixels[subsetPixels[j]].x;
+            for (uint32_t c = 0; c < 4; ++c) points[j][c] = px[c];
+        }
+
+        float line[2][4] = {};
+        fitLine(line[0], line[1], points, count, colorEnd);
+        if (separate) {
+            line[0][3] = line[1][3] = points[0][3];
+            for (uint32_t j = 1; j < count; ++j) {
+                line[0][3] = std::min(line[0][3], points[j][3]);
+                line[1][3] = std::max(line[1][3], points[j][3]);
+            }
+        }
+
+        // fit indices, then optionally refine endpoints with least squares, and keep the refined ones if better.
+        auto fit = [&](BC7Endpoints & e, uint8_t * ci, uint8_t * ai) {
+            uint32_t err = bc7FitIndices(ci, pixels, subsetPixels, count, e, colorBits, 0, colorEnd);
+            if (separate) err += bc7FitIndices(ai, pixels, subsetPixels, count, e, alphaBits, 3, 4);
+            return err;
+        };
+        bc7QuantizeEndpoints(ends[s], line, m);
+        uint32_t subsetError = fit(ends[s], colorIndices, alphaIndices);
+        for (int iter = 0; refine && iter < 2 && subsetError > 0; ++iter) {
+            float refined[2][4];
+            memcpy(refined, line, sizeof(line));
+            if (!bc7RefineEndpoints(refined, pixels, subsetPixels, count, colorIndices, colorBits, 0, colorEnd)) break;
+            if (separate) bc7RefineEndpoints(refined, pixels, subsetPixels, count, alphaIndices, alphaBits, 3, 4);
+            BC7Endpoints e;
+            uint8_t      ci[16], ai[16];
+            memcpy(ci, colorIndices, 16);
+            memcpy(ai, alphaIndices, 16);
+            bc7QuantizeEndpoints(e, refined, m);
+            uint32_t err = fit(e, ci, ai);
+            if (err >= subsetError) break;
+            subsetError = err;
+            ends[s]     = e;
+            memcpy(line, refined, sizeof(line));
+            memcpy(colorIndices, ci, 16);
+            memcpy(alphaIndices, ai, 16);
+        }
+        error += subsetError;
+
+        // The highest index bit of the anchor pixel must be 0. If not, swap the endpoints and flip the indices.
+        uint32_t anchor = anchorOf(m.subsets, params.partition, s);
+        if (colorIndices[anchor] >> (colorBits - 1)) {
+            auto & e = ends[s];
+            std::swap(e.p[0], e.p[1]);
+            for (uint32_t c = 0; c < colorEnd; ++c) {
+                std::swap(e.q[0][c], e.q[1][c]);
+                std::swap(e.value[0][c], e.value[1][c]);
+            }
+            for (uint32_t j = 0; j < count; ++j) {
+                colorIndices[subsetPixels[j]] = (uint8_t)((1u << colorBits) - 1 - colorIndices[subsetPixels[j]]);
+            }
+        }
+        if (separate && alphaIndices[anchor] >> (alphaBits - 1)) {
+            auto & e = ends[s];
+            std::swap(e.q[0][3], e.q[1][3]);
+            std::swap(e.value[0][3], e.value[1][3]);
+            for (uint32_t j = 0; j < count; ++j) {
+                alphaIndices[subsetPixels[j]] = (uint8_t)((1u << alphaBits) - 1 - alphaIndices[subsetPixels[j]]);
+            }
+        }
+    }
+
+    // pack the block
+    BlockBits bits;
+    bits.write(1u << params.mode, params.mode + 1);
+    bits.write(params.partition, m.partitionBits);
+    bits.write(params.rotation, m.rotationBits);
+    bits.write(params.selector, m.selectorBits);
+    for (uint32_t c = 0; c < 4; ++c) {
+        uint32_t channelBits = c < 3 ? m.colorBits : m.alphaBits;
+        for (uint32_t s = 0; s < m.subsets; ++s) {
+            for (uint32_t e = 0; e < 2; ++e) bits.write(ends[s].q[e][c], channelBits);
+        }
+    }
+    for (uint32_t s = 0; s < m.subsets; ++s) {
+        if (m.endpointPBits) bits.write(ends[s].p[0], 1), bits.write(ends[s].p[1], 1);
+        if (m.sharedPBits) bits.write(ends[s].p[0], 1);
+    }
+    const uint8_t * primary   = separate && params.selector ? alphaIndices : colorIndices;
+    const uint8_t * secondary = separate && params.selector ? colorIndices : alphaIndices;
+    for (uint32_t i = 0; i < 16; ++i) {
+        bits.write(primary[i], m.indexBits - (isAnchor(m.subsets, params.partition, i) ? 1 : 0));
+    }
+    if (separate) {
+        for (uint32_t i = 0; i < 16; ++i) bits.write(secondary[i], m.index2Bits - (0 == i ? 1 : 0));
+    }
+    RG_ASSERT(128 == bits.position());
+    bits.store(block);
+    return error;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode one BC7 block. FAST tries the single subset modes. HIGH also tries all rotations of mode 4 and 5, and the
+/// most promising partitions of multi subset modes. Modes without alpha are skipped when the block is not opaque.
+static void encodeBC7Block(uint8_t * block, const RGBA8 pixels[16], CompressionQuality quality) {
+    bool high   = CompressionQuality::HIGH == quality;
+    bool opaque = true;
+    for (uint32_t i = 0; i < 16; ++i) opaque = opaque && 0xFF == pixels[i].w;
+
+    uint32_t best = UINT32_MAX;
+    auto     tryParams = [&](const BC7Params & params) {
+        if (0 == best) return;
+        uint8_t  candidate[16];
+        uint32_t error = encodeBC7Params(candidate, pixels, params, high);
+        if (error < best) {
+            best = error;
+            memcpy(block, candidate, 16);
+        }
+    };
+
+    tryParams({ 6, 0, 0, 0 });
+    for (uint32_t rotation = 0; rotation < (high ? 4u : 1u); ++rotation) {
+        tryParams({ 5, 0, rotation, 0 });
+        tryParams({ 4, 0, rotation, 0 });
+        if (high) tryParams({ 4, 0, rotation, 1 });
+    }
+    if (!high || 0 == best) return;
+
+    float points[16][4];
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) points[i][c] = (&pixels[i].x)[c];
+    }
+    uint32_t channels = opaque ? 3 : 4;
+    uint8_t  partitions[8];
+    uint32_t n = rankPartitions(partitions, 8, points, channels, 2, 64);
+    for (uint32_t i = 0; i < n; ++i) {
+        tryParams({ 7, partitions[i], 0, 0 });
+        if (opaque) {
+            tryParams({ 1, partitions[i], 0, 0 });
+            tryParams({ 3, partitions[i], 0, 0 });
+        }
+    }
+    if (!opaque) return;
+    n = rankPartitions(partitions, 4, points, channels, 3, 16);
+    for (uint32_t i = 0; i < n; ++i) tryParams({ 0, partitions[i], 0, 0 });
+    n = rankPartitions(partitions, 4, points, channels, 3, 64);
+    for (uint32_t i = 0; i < n; ++i) tryParams({ 2, partitions[i], 0, 0 });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode a row of blocks in parallel. BPTC blocks are slow enough to encode, even in a single block row, that it
+/// pays to spread them across the worker threads.
+template<typename PIXEL, typename PROC>
+static void encodeBlockRow(uint8_t * dst, const uint8_t * src, size_t pitch, size_t count, CompressionQuality quality,
+                           PROC proc) {
+    size_t grain = CompressionQuality::HIGH == quality ? 4 : 64;
+    parallelFor(count, grain, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            PIXEL pixels[16];
+            for (size_t y = 0; y < 4; ++y) memcpy(pixels + y * 4, src + y * pitch + b * 4 * sizeof(PIXEL), 4 * sizeof(PIXEL));
+            proc(dst + b * 16, pixels);
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::encodeBC7Row(ColorFormat, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                      CompressionQuality quality) {
+    encodeBlockRow<RGBA8>(dst, src, pitch, count, quality,
+                          [&](uint8_t * block, const RGBA8 * pixels) { encodeBC7Block(block, pixels, quality); });
+}
+
+// *********************************************************************************************************************
+// BC6H encoder
+// *********************************************************************************************************************
+
+/// One 4x4 block of BC6H source pixels. Half floats are converted to integers that compare like the floats, which is
+/// the domain that BC6H interpolates in.
+struct BC6HSource {
+    int32_t h[16][3];         ///< half float bits, as signed integers. Negative values are clamped to 0 for UF16.
+    float   unquantized[16][4]; ///< the values before bc6hFinish(), that the endpoints are fitted to.
+    bool    sf16;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Quantize unquantized value to 'bits' precision. It is the reverse of bc6hUnquantize().
+static int32_t bc6hQuantize(float u, uint32_t bits, bool sf16) {
+    int32_t maxValue = sf16 ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+    int32_t minValue = sf16 ? -maxValue : 0;
+    int32_t target   = (int32_t)std::lround(u);
+    int32_t guess    = (sf16 ? bits >= 16 : bits >= 15) ? target : (int32_t)std::lround(u * (float)(1 << bits) / 65536.0f);
+    int32_t best = 0, bestError = INT32_MAX;
+    for (int32_t q = guess - 1; q <= guess + 1; ++q) {
+        int32_t c = std::clamp(q, minValue, maxValue);
+        int32_t e = std::abs(bc6hUnquantize(c, bits, sf16) - target);
+        if (e < bestError) bestError = e, best = c;
+    }
+    return best;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode the block with the given mode and partition, using the given unquantized endpoints of each subset. Returns
+/// the squared error, or a negative value if the endpoints can't be stored in the mode.
+static double encodeBC6HMode(uint8_t * block, const BC6HSource & src, const BC6HMode & m, uint32_t partition,
+                             const float ends[2][2][4]) {
+    uint32_t eb        = m.endpointBits;
+    uint32_t indexBits = 2 == m.subsets ? 3 : 4;
+    uint32_t entries   = 1u << indexBits;
+    int32_t  q[4][3];
+    uint8_t  indices[16];
+    double   error = 0;
+    for (uint32_t s = 0; s < m.subsets; ++s) {
+        int32_t unq[2][3];
+        for (uint32_t e = 0; e < 2; ++e) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                q[s * 2 + e][c] = bc6hQuantize(ends[s][e][c], eb, src.sf16);
+                unq[e][c]       = bc6hUnquantize(q[s * 2 + e][c], eb, src.sf16);
+            }
+        }
+        int32_t palette[16][3];
+        for (uint32_t k = 0; k < entries; ++k) {
+            int32_t w = WEIGHTS[indexBits - 2][k];
+            for (uint32_t c = 0; c < 3; ++c) {
+                int32_t  v    = ((64 - w) * unq[0][c] + w * unq[1][c] + 32) >> 6;
+                uint16_t half = bc6hFinish(v, src.sf16);
+                palette[k][c] = (half & 0x8000) ? -(int32_t)(half & 0x7FFF) : (int32_t)half;
+            }
+        }
+        uint32_t anchor = anchorOf(m.subsets, partition, s);
+        bool     flip   = false;
+        for (uint32_t i = 0; i < 16; ++i) {
+            if (subsetOf(m.subsets, partition, i) != s) continue;
+            double best = DBL_MAX;
+            for (uint32_t k = 0; k < entries; ++k) {
+                double d = 0;
+                for (uint32_t c = 0; c < 3; ++c) {
+                    double x = palette[k][c] - src.h[i][c];
+                    d += x * x;
+                }
+                if (d < best) best = d, indices[i] = (uint8_t)k;
+            }
+            error += best;
+            if (i == anchor) flip = 0 != (indices[i] >> (indexBits - 1));
+        }
+        if (flip) {
+            std::swap(q[s * 2], q[s * 2 + 1]);
+            for (uint32_t i = 0; i < 16; ++i) {
+                if (subsetOf(m.subsets, partition, i) == s) indices[i] = (uint8_t)(entries - 1 - indices[i]);
+            }
+        }
+    }
+
+    // Transformed modes store the other endpoints as deltas to W, which must fit in the delta bits.
+    int32_t fields[D + 1] = {};
+    for (uint32_t e = 0; e < m.subsets * 2u; ++e) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            int32_t v = q[e][c];
+            if (e > 0 && m.transformed) {
+                v                 = v - q[0][c];
+                int32_t deltaHalf = 1 << (m.deltaBits[c] - 1);
+                if (v < -deltaHalf || v >= deltaHalf) return -1;
+            }
+            fields[RW + e * 3 + c] = v;
+        }
+    }
+    fields[D] = (int32_t)partition;
+
+    BlockBits bits;
+    bits.write(m.value, m.modeBits);
+    for (const auto & r : m.layout) {
+        if (END == r.field) break;
+        int step = r.first <= r.last ? 1 : -1;
+        for (int b = r.first;; b += step) {
+            bits.write((uint32_t)(fields[r.field] >> b) & 1, 1);
+            if (b == r.last) break;
+        }
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        bits.write(indices[i], indexBits - (isAnchor(m.subsets, partition, i) ? 1 : 0));
+    }
+    RG_ASSERT(128 == bits.position());
+    bits.store(block);
+    return error;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode one BC6H block. FAST tries the single subset modes. HIGH also tries all 2 subsets modes, with the most
+/// promising partitions.
+static void encodeBC6HBlock(uint8_t * block, const uint16_t pixels[64], bool sf16, CompressionQuality quality) {
+    BC6HSource src;
+    src.sf16 = sf16;
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            uint16_t half      = pixels[i * 4 + c];
+            int32_t  magnitude = half & 0x7FFF;
+            bool     negative  = 0 != (half & 0x8000);
+            if (magnitude > 0x7C00) magnitude = 0;      // NaN
+            magnitude = std::min(magnitude, 0x7BFF);  // infinity to max half
+            if (negative && !sf16) magnitude = 0;
+            int32_t h                 = negative ? -magnitude : magnitude;
+            src.h[i][c]               = h;
+            src.unquantized[i][c]     = sf16 ? (float)h * 32.0f / 31.0f : (float)h * 64.0f / 31.0f;
+        }
+        src.unquantized[i][3] = 0;
+    }
+
+    double best = DBL_MAX;
+    auto   tryMode = [&](const BC6HMode & m, uint32_t partition, const float ends[2][2][4]) {
+        if (0 == best) return;
+        uint8_t candidate[16];
+        double  error = encodeBC6HMode(candidate, src, m, partition, ends);
+        if (error >= 0 && error < best) {
+            best = error;
+            memcpy(block, candidate, 16);
+        }
+    };
+
+    float ends[2][2][4];
+    fitLine(ends[0][0], ends[0][1], src.unquantized, 16, 3);
+    for (const auto & m : BC6H_MODES) {
+        if (1 == m.subsets) tryMode(m, 0, ends);
+    }
+    if (CompressionQuality::HIGH != quality) return;
+
+    uint8_t  partitions[8];
+    uint32_t n = rankPartitions(partitions, 8, src.unquantized, 3, 2, 32);
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t s = 0; s < 2; ++s) {
+            float    points[16][4];
+            uint32_t count = 0;
+            for (uint32_t j = 0; j < 16; ++j) {
+                if (subsetOf(2, partitions[i], j) == s) memcpy(points[count++], src.unquantized[j], sizeof(float) * 4);
+            }
+            fitLine(ends[s][0], ends[s][1], points, count, 3);
+        }
+        for (const auto & m : BC6H_MODES) {
+            if (2 == m.subsets) tryMode(m, partitions[i], ends);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::encodeBC6HRow(ColorFormat format, uint8_t * dst, const uint8_t * src, size_t pitch, size_t count,
+                       CompressionQuality quality) {
+    bool sf16 = ColorFormat::SIGN_FLOAT == format.sign012;
+    encodeBlockRow<uint64_t>(dst, src, pitch, count, quality, [&](uint8_t * block, const uint64_t * pixels) {
+        encodeBC6HBlock(block, (const uint16_t *)pixels, sf16, quality);
+    });
+}
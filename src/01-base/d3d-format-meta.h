@@ -13,6 +13,7 @@ D3D_FORMAT( RGBA_8_8_8_8_UNORM_SRGB     , UNKNOWN       , R8G8B8A8_UNORM_SRGB
 D3D_FORMAT( RGBA_8_8_8_8_SNORM          , Q8W8V8U8      , R8G8B8A8_SNORM           )
 D3D_FORMAT( RGBA_10_10_10_2_UNORM       , A2B10G10R10   , R10G10B10A2_UNORM        )
 D3D_FORMAT( RGBA_10_10_10_2_UINT        , UNKNOWN       , R10G10B10A2_UINT         )
+D3D_FORMAT( RGB_11_11_10_FLOAT          , UNKNOWN       , R11G11B10_FLOAT          )
 D3D_FORMAT( RG_16_16_UNORM              , G16R16        , R16G16_UNORM             )
 D3D_FORMAT( RG_16_16_SNORM              , V16U16        , R16G16_SNORM             )
 D3D_FORMAT( RG_16_16_UINT               , UNKNOWN       , R16G16_UINT              )
@@ -53,3 +54,7 @@ D3D_FORMAT( DXT5A_UNORM                 , UNKNOWN       , BC4_UNORM
 D3D_FORMAT( DXT5A_SNORM                 , UNKNOWN       , BC4_SNORM                )
 D3D_FORMAT( DXN_UNORM                   , UNKNOWN       , BC5_UNORM                )
 D3D_FORMAT( DXN_SNORM                   , UNKNOWN       , BC5_SNORM                )
+D3D_FORMAT( BC6H_UF16                   , UNKNOWN       , BC6H_UF16                )
+D3D_FORMAT( BC6H_SF16                   , UNKNOWN       , BC6H_SF16                )
+D3D_FORMAT( BC7_UNORM                   , UNKNOWN       , BC7_UNORM                )
+D3D_FORMAT( BC7_UNORM_SRGB              , UNKNOWN       , BC7_UNORM_SRGB           )
@@ -1,5 +1,11 @@
 #include "pch.h"
 #include "dds.h"
+#include "pixel-convert.h"
+#include "thread-pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 
 #ifndef MAKE_FOURCC
 #define MAKE_FOURCC(ch0, ch1, ch2, ch3)     \
@@ -27,8 +33,10 @@ enum DdsFlag {
     DDS_DDSD_CAPS               = 0x00000001                     ,
     DDS_DDSD_HEIGHT             = 0x00000002                     ,
     DDS_DDSD_WIDTH              = 0x00000004                     ,
+    DDS_DDSD_PITCH              = 0x00000008                     ,
     DDS_DDSD_PIXELFORMAT        = 0x00001000                     ,
     DDS_DDSD_MIPMAPCOUNT        = 0x00020000                     ,
+    DDS_DDSD_LINEARSIZE         = 0x00080000                     ,
     DDS_DDSD_DEPTH              = 0x00800000                     ,
     DDS_CAPS_ALPHA              = 0x00000002                     ,
     DDS_CAPS_COMPLEX            = 0x00000008                     ,
@@ -38,6 +46,9 @@ enum DdsFlag {
     DDS_CAPS2_CUBEMAP           = 0x00000200                     ,
     DDS_CAPS2_CUBEMAP_ALLFACES  = 0x0000fc00                     ,
     DDS_CAPS2_VOLUME            = 0x00200000                     ,
+    DDS_DX10_TEXTURE2D          = 3                              , // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    DDS_DX10_TEXTURE3D          = 4                              , // D3D10_RESOURCE_DIMENSION_TEXTURE3D
+    DDS_DX10_TEXTURECUBE        = 0x00000004                     , // D3D10_RESOURCE_MISC_TEXTURECUBE
     DDS_FOURCC_UYVY             = MAKE_FOURCC('U', 'Y', 'V', 'Y') ,
     DDS_FOURCC_R8G8_B8G8        = MAKE_FOURCC('R', 'G', 'B', 'G') ,
     DDS_FOURCC_YUY2             = MAKE_FOURCC('Y', 'U', 'Y', '2') ,
@@ -95,9 +106,9 @@ static struct DdpfDesc {
   //{ rg::ColorFormat::UVWA_10_10_10_2(),               { DDS_DDPF_SIZE, DDS_DDPF_BUMPDUDV | DDS_DDPF_ALPHAPIXELS,         0, 32, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000 } },
     { rg::ColorFormat::R_16_UNORM(),                    { DDS_DDPF_SIZE, DDS_DDPF_ZBUFFER,                                 0, 16,          0,     0xffff,          0,          0 } },
   //{ rg::ColorFormat::UYVY(),                          { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,                    DDS_FOURCC_UYVY,  0,          0,          0,          0,          0 } },
-  //{ rg::ColorFormat::R8G8_B8G8(),                     { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,               DDS_FOURCC_R8G8_B8G8,  0,          0,          0,          0,          0 } },
+    { rg::ColorFormat::GRGB_UNORM(),                    { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,               DDS_FOURCC_R8G8_B8G8,  0,          0,          0,          0,          0 } },
   //{ rg::ColorFormat::YUY2(),                          { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,                    DDS_FOURCC_YUY2,  0,          0,          0,          0,          0 } },
-  //{ rg::ColorFormat::G8R8_G8B8(),                     { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,               DDS_FOURCC_G8R8_G8B8,  0,          0,          0,          0,          0 } },
+    { rg::ColorFormat::RGBG_UNORM(),                    { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,               DDS_FOURCC_G8R8_G8B8,  0,          0,          0,          0,          0 } },
     { rg::ColorFormat::DXT1_UNORM(),                    { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,                    DDS_FOURCC_DXT1,  0,          0,          0,          0,          0 } },
     { rg::ColorFormat::DXT3_UNORM(),                    { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,                    DDS_FOURCC_DXT2,  0,          0,          0,          0,          0 } },
     { rg::ColorFormat::DXT3_UNORM(),                    { DDS_DDPF_SIZE, DDS_DDPF_FOURCC,                    DDS_FOURCC_DXT3,  0,          0,          0,          0,          0 } },
@@ -366,7 +377,7 @@ static rg::ColorFormat DXGIFormat2ColorFormat(DXGI_FORMAT dxgi) {
 //
 bool DDSReader::checkFormat() {
     uint32_t u32;
-    if (!_file.read((char*)&u32, 4) || 4 != _file.gcount()) return false;
+    if (!read(&u32, 4)) return false;
     return u32 == MAKE_FOURCC('D', 'D', 'S', ' ');
 }
 
@@ -377,7 +388,7 @@ const rg::ImageDesc & DDSReader::readHeader() {
     _imgDesc = {};
 
     // read header
-    if (!_file.read((char*)&_header, sizeof(_header)) || _file.gcount() != sizeof(_header)) {
+    if (!read(&_header, sizeof(_header))) {
         RG_LOGE( "fail to read DDS file header!" );
         return _imgDesc;
     }
@@ -396,36 +407,51 @@ const rg::ImageDesc & DDSReader::readHeader() {
         return _imgDesc;
     }
 
+    // grok image dimension
+    uint32_t faces  = 0;
+    uint32_t width  = _header.width;
+    uint32_t height = _header.height;
+    uint32_t depth  = sGetImageDepth( _header );
+
     // get image format
     if( MAKE_FOURCC('D','X','1','0') == _header.ddpf.fourcc )
     {
         // read DX10 info
         DX10Info dx10;
-        if (!_file.read((char*)&dx10, sizeof(dx10)) || _file.gcount() != sizeof(dx10)) {
+        if (!read(&dx10, sizeof(dx10))) {
             RG_LOGE( "fail to read DX10 info header!" );
             return _imgDesc;
         }
 
         _originalFormat = DXGIFormat2ColorFormat(dx10.format);
         if(rg::ColorFormat::UNKNOWN() == _originalFormat) return _imgDesc;
+
+        // DX10 header describes texture arrays and cubemaps by itself. Each array element has its own 6 faces for
+        // cubemap array. The legacy caps2 flags are not reliable in this case.
+        if (DDS_DX10_TEXTURE3D == dx10.dim) {
+            faces = 1;
+            depth = std::max(1u, _header.depth);
+        } else {
+            faces = std::max(1u, dx10.arraySize);
+            if (DDS_DX10_TEXTURECUBE & dx10.miscFlag) faces *= 6;
+            depth = 1;
+        }
     }
     else
     {
         _originalFormat = getImageFormat( _header.ddpf );
         if( rg::ColorFormat::UNKNOWN() == _originalFormat ) return _imgDesc;
+
+        faces = sGetImageFaceCount( _header );
+        if (0 == faces) return _imgDesc;
     }
 
     // BGR format is not compatible with D3D10/D3D11 hardware. So we need to convert it to RGB format.
     // sUpdateSwizzle() will update format swizzle from BGR to RGB. And we'll do data convertion later
     // in readImage() function.
-    _formatConversion = sCheckFormatConversion(_originalFormat);
-
-    // grok image dimension
-    uint32_t faces  = sGetImageFaceCount( _header );
-    if (0 == faces) return _imgDesc;
-    uint32_t width  = _header.width;
-    uint32_t height = _header.height;
-    uint32_t depth  = sGetImageDepth( _header );
+    // the image is described in the format after conversion, while _originalFormat keeps the one in the file.
+    rg::ColorFormat format = _originalFormat;
+    _formatConversion      = sCheckFormatConversion(format);
 
     // grok miplevel information
     bool hasMipmap = ( DDS_DDSD_MIPMAPCOUNT & _header.flags )
@@ -436,10 +462,13 @@ const rg::ImageDesc & DDSReader::readHeader() {
 
     // Create image descriptor. Here we assume that the offset of each mipmap layer calculated by the image descriptor
     // completely matches the actual data offset in DDS file.
-    _imgDesc = rg::ImageDesc(rg::ImagePlaneDesc::make(_originalFormat, width, height, depth), faces, levels,
+    _imgDesc = rg::ImageDesc(rg::ImagePlaneDesc::make(format, width, height, depth), faces, levels,
                              rg::ImageDesc::FACE_MAJOR);
     RG_ASSERT( _imgDesc.valid() );
 
+    // remember where pixels start, for reading subsets.
+    _pixels = _file ? (std::streamoff)_file->tellg() : (std::streamoff)_offset;
+
     // success
     return _imgDesc;
 }
@@ -456,19 +485,51 @@ bool DDSReader::readPixels(void * o_data, size_t o_size) const {
         return false;
     }
 
-    if (!_file.read((char*)o_data, (int)_imgDesc.size) || _file.gcount() != (int)_imgDesc.size) {
+    // There might be gaps between each mipmap level, or even between each scan line. But we assume that the data in the
+    // gaps are not important and could be converted as well without any side effects. We also assume that each scan
+    // line always starts from pixel size aligned address (4 bytes aligned for 8888 format) regardless of gaps.
+    if (!readConverted((uint8_t*)o_data, _imgDesc.size)) {
         RG_LOGE("failed to read DDS pixels.");
         return false;
     }
 
-    // Do format conversion, if needed.
-    if( FC_NONE != _formatConversion )
-    {
-        // There might be gaps between each mipmap level, or even between each scan line.
-        // But we assume that the data in the gaps are not important and could be converted
-        // as well without any side effects. We also assume that each scan line always starts
-        // from pixel size aligned address (4 bytes aligned for 8888 format) regardless of gaps.
-        sConvertFormat( _formatConversion, o_data, _imgDesc.size );
+    // success
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+rg::ImageDesc DDSReader::subsetDesc(rg::ImageSubset subset) const {
+    if (!resolve(subset)) return {};
+    return rg::ImageDesc(_imgDesc.plane(subset.firstLayer, subset.firstLevel), subset.layers, subset.levels,
+                         rg::ImageDesc::FACE_MAJOR);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool DDSReader::readPixels(void * o_data, size_t o_size, rg::ImageSubset subset) const {
+    if (!resolve(subset)) return false;
+    auto desc = subsetDesc(subset);
+    if (!o_data) {
+        RG_LOGE("null output buffer.");
+        return false;
+    }
+    if (o_size < desc.size) {
+        RG_LOGE("output buffer size is not large enough");
+        return false;
+    }
+
+    // Levels of one layer are packed together in the file, in both the whole image and the subset. So each layer
+    // takes one seek and one read.
+    for (uint32_t i = 0; i < subset.layers; ++i) {
+        const auto & first = _imgDesc.plane(subset.firstLayer + i, subset.firstLevel);
+        const auto & last  = _imgDesc.plane(subset.firstLayer + i, subset.firstLevel + subset.levels - 1);
+        size_t       bytes = last.offset + last.size - first.offset;
+        RG_ASSERT(bytes == desc.plane(i, subset.levels - 1).offset + last.size - desc.plane(i, 0).offset);
+        if (!seek(first.offset) || !readConverted((uint8_t*)o_data + desc.plane(i, 0).offset, bytes)) {
+            RG_LOGE("failed to read DDS pixels.");
+            return false;
+        }
     }
 
     // success
@@ -479,18 +540,131 @@ bool DDSReader::readPixels(void * o_data, size_t o_size) const {
 // DDSReader private functions
 // *********************************************************************************************************************
 
+// ---------------------------------------------------------------------------------------------------------------------
+/// Read bytes from the stream, or copy them from memory.
+bool DDSReader::read(void * buf, size_t size) const {
+    if (_file) return _file->read((char*)buf, (std::streamsize)size) && (size_t)_file->gcount() == size;
+    if (_offset + size > _memory.size()) return false;
+    memcpy(buf, _memory.data() + _offset, size);
+    _offset += size;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Read bytes from the current position, and convert them to the format of the image descriptor on the way.
+///
+/// Files in memory are converted while they are copied to the destination, in one pass. Streams are read straight
+/// into the destination one chunk at a time. While a chunk is converted in place, still hot in cache, the next chunk
+/// is read into the destination on one of the shared worker threads, so the chunk being converted and the one being
+/// read are the two buffers. If no worker picks the read up by the time the conversion is done (for example, when
+/// all workers are busy loading other images), this thread reads the chunk by itself, instead of waiting for them.
+/// When multithreading is disabled by setMaxWorkerThreads(1), or there's only one CPU, chunks are read on this thread.
+bool DDSReader::readConverted(uint8_t * dst, size_t size) const {
+    if (FC_NONE == _formatConversion) return read(dst, size);
+
+    if (!_file) {
+        if (_offset + size > _memory.size()) return false;
+        sConvertFormat(_formatConversion, dst, _memory.data() + _offset, size);
+        _offset += size;
+        return true;
+    }
+
+    /// read of the next chunk, claimed by either the worker or the caller, whoever comes first. The worker might get
+    /// here after the caller has returned. In that case, it sees the read claimed, and never touches the reader.
+    struct Prefetch {
+        std::atomic<bool>       claimed {false};
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    done = false;
+        bool                    ok   = false;
+    };
+
+    bool   overlap = rg::getMaxWorkerThreads() > 1;
+    size_t bytes   = std::min(STREAM_CHUNK_BYTES, size);
+    if (!read(dst, bytes)) return false;
+    for (size_t begin = 0; begin < size;) {
+        // start reading the next chunk.
+        size_t next      = begin + bytes;
+        size_t nextBytes = std::min(STREAM_CHUNK_BYTES, size - next);
+        auto   prefetch  = std::make_shared<Prefetch>();
+        if (nextBytes && overlap) {
+            rg::runAsync([this, prefetch, p = dst + next, nextBytes] {
+                if (prefetch->claimed.exchange(true)) return;
+                bool ok = false;
+                try {
+                    ok = read(p, nextBytes);
+                } catch (...) {
+                }
+                {
+                    std::lock_guard<std::mutex> lock(prefetch->mutex);
+                    prefetch->done = true;
+                    prefetch->ok   = ok;
+                }
+                prefetch->cv.notify_all();
+            });
+        }
+
+        // convert this chunk, then wait for the next one.
+        sConvertFormat(_formatConversion, dst + begin, dst + begin, bytes);
+        if (!nextBytes) break;
+        bool ok;
+        if (!prefetch->claimed.exchange(true)) {
+            ok = read(dst + next, nextBytes);
+        } else {
+            std::unique_lock<std::mutex> lock(prefetch->mutex);
+            prefetch->cv.wait(lock, [&] { return prefetch->done; });
+            ok = prefetch->ok;
+        }
+        if (!ok) return false;
+        begin = next;
+        bytes = nextBytes;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Move the read position to the offset from the first pixel.
+bool DDSReader::seek(size_t offset) const {
+    if (_pixels < 0) {
+        RG_LOGE("DDS reader can't seek: header is not read, or the stream is not seekable.");
+        return false;
+    }
+    if (_file) {
+        _file->clear();
+        return (bool)_file->seekg(_pixels + (std::streamoff)offset, std::ios::beg);
+    }
+    _offset = (size_t)_pixels + offset;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Replace zero counts of the subset with all the rest of layers and levels, and check the range.
+bool DDSReader::resolve(rg::ImageSubset & subset) const {
+    if (subset.firstLayer >= _imgDesc.layers || subset.firstLevel >= _imgDesc.levels) {
+        RG_LOGE("image subset is out of range.");
+        return false;
+    }
+    if (0 == subset.layers) subset.layers = _imgDesc.layers - subset.firstLayer;
+    if (0 == subset.levels) subset.levels = _imgDesc.levels - subset.firstLevel;
+    if (subset.layers > _imgDesc.layers - subset.firstLayer || subset.levels > _imgDesc.levels - subset.firstLevel) {
+        RG_LOGE("image subset is out of range.");
+        return false;
+    }
+    return true;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 //
 DDSReader::FormatConversion
-DDSReader::sCheckFormatConversion(rg::ColorFormat format) {
+DDSReader::sCheckFormatConversion(rg::ColorFormat & format) {
     if (rg::ColorFormat::LAYOUT_8_8_8_8 == format.layout &&
         rg::ColorFormat::SWIZZLE_B == format.swizzle0 &&
         rg::ColorFormat::SWIZZLE_G == format.swizzle1 &&
         rg::ColorFormat::SWIZZLE_R == format.swizzle2) {
+        // alpha (or X) stays where it is.
         format.swizzle0 = rg::ColorFormat::SWIZZLE_R;
         format.swizzle1 = rg::ColorFormat::SWIZZLE_G;
         format.swizzle2 = rg::ColorFormat::SWIZZLE_B;
-        format.swizzle3 = rg::ColorFormat::SWIZZLE_A;
         return FC_BGRA8888_TO_RGBA8888;
     } else {
         return FC_NONE;
@@ -499,17 +673,151 @@ DDSReader::sCheckFormatConversion(rg::ColorFormat format) {
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
-void DDSReader::sConvertFormat(FormatConversion fc, void * data, size_t size ) {
+void DDSReader::sConvertFormat(FormatConversion fc, void * dst, const void * src, size_t size) {
     if (FC_BGRA8888_TO_RGBA8888 == fc) {
-        size_t   numPixels = size / 4;
-        uint32_t * pixels  = (uint32_t*)data;
-        uint32_t * end     = pixels + numPixels;
-        for( ; pixels < end; ++pixels ) {
-            uint32_t a = (*pixels) & 0xFF000000;
-            uint32_t r = (*pixels) & 0xFF0000;
-            uint32_t g = (*pixels) & 0xFF00;
-            uint32_t b = (*pixels) & 0xFF;
-            *pixels = a | (r>>16) | g | (b<<16);
+        // swizzle, in place or not, using the best SIMD kernel of the current CPU.
+        rg::getFastRowKernels().swapRB8888((rg::RGBA8*)dst, (const uint8_t*)src, size / 4);
+    }
+}
+
+// *********************************************************************************************************************
+// DDSWriter
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Legacy pixel format of the color format. Premultiplied DXT2/DXT4 and depth buffer entries are only for reading.
+static const DDPixelFormat * findLegacyFormat(rg::ColorFormat format) {
+    for (const auto & d : s_ddpfDescTable) {
+        if (d.clrfmt != format) continue;
+        if (DDS_FOURCC_DXT2 == d.ddpf.fourcc || DDS_FOURCC_DXT4 == d.ddpf.fourcc) continue;
+        if (DDS_DDPF_ZBUFFER & d.ddpf.flags) continue;
+        return &d.ddpf;
+    }
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static DXGI_FORMAT colorFormat2DXGIFormat(rg::ColorFormat format) {
+    for (const auto & i : dxgiFormats) {
+        if (i.format && i.format == format) return i.dxgi;
+    }
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool DDSWriter::prepare(const rg::ImageProxy & image, bool cubemap) {
+    _header.clear();
+    _chunks.clear();
+    if (image.empty() || !image.data) {
+        RG_LOGE("Can't save empty image.");
+        return false;
+    }
+
+    const auto & base   = image.desc.plane(0, 0);
+    const auto & ld     = base.format.layoutDesc();
+    uint32_t     layers = image.desc.layers;
+    uint32_t     levels = image.desc.levels;
+    bool         volume = base.depth > 1;
+    if (cubemap && (0 != layers % 6 || base.width != base.height || volume)) {
+        RG_LOGE("Can't save image as DDS cubemap: number of layers must be multiple of 6, and faces must be square.");
+        return false;
+    }
+    if (volume && layers > 1) {
+        RG_LOGE("Can't save image as DDS: arrays of volume textures are not supported.");
+        return false;
+    }
+    if (base.step != ld.pixelBits) {
+        RG_LOGE("Can't save image as DDS: pixels must be tightly packed.");
+        return false;
+    }
+
+    // Use the legacy header when it can describe the image. Otherwise, go with the DX10 header.
+    const DDPixelFormat * legacy = (1 == layers || (cubemap && 6 == layers)) ? findLegacyFormat(base.format) : nullptr;
+    DXGI_FORMAT           dxgi   = legacy ? DXGI_FORMAT_UNKNOWN : colorFormat2DXGIFormat(base.format);
+    if (!legacy && DXGI_FORMAT_UNKNOWN == dxgi) {
+        RG_LOGE("Can't save image as DDS: color format 0x%X is not supported.", base.format.u32);
+        return false;
+    }
+
+    bool          compressed = ld.blockWidth > 1 || ld.blockHeight > 1;
+    auto          tight      = rg::ImagePlaneDesc::make(base.format, base.width, base.height, base.depth);
+    DDSFileHeader h          = {};
+    h.size                   = sizeof(h);
+    h.flags                  = DDS_DDSD_CAPS | DDS_DDSD_HEIGHT | DDS_DDSD_WIDTH | DDS_DDSD_PIXELFORMAT;
+    h.flags                 |= compressed ? DDS_DDSD_LINEARSIZE : DDS_DDSD_PITCH;
+    h.flags                 |= levels > 1 ? DDS_DDSD_MIPMAPCOUNT : 0;
+    h.flags                 |= volume ? DDS_DDSD_DEPTH : 0;
+    h.height                 = base.height;
+    h.width                  = base.width;
+    h.pitchOrLinearSize      = compressed ? tight.slice : tight.pitch;
+    h.depth                  = volume ? base.depth : 0;
+    h.mipCount               = levels;
+    h.caps                   = DDS_CAPS_TEXTURE;
+    h.caps                  |= levels > 1 ? DDS_CAPS_MIPMAP | DDS_CAPS_COMPLEX : 0;
+    h.caps                  |= cubemap || volume ? DDS_CAPS_COMPLEX : 0;
+    h.caps2                  = cubemap ? DDS_CAPS2_CUBEMAP | DDS_CAPS2_CUBEMAP_ALLFACES : volume ? DDS_CAPS2_VOLUME : 0;
+    if (legacy) {
+        h.ddpf = *legacy;
+    } else {
+        h.ddpf.size   = sizeof(h.ddpf);
+        h.ddpf.flags  = DDS_DDPF_FOURCC;
+        h.ddpf.fourcc = MAKE_FOURCC('D', 'X', '1', '0');
+    }
+
+    uint32_t magic = MAKE_FOURCC('D', 'D', 'S', ' ');
+    _header.insert(_header.end(), (const uint8_t *)&magic, (const uint8_t *)&magic + sizeof(magic));
+    _header.insert(_header.end(), (const uint8_t *)&h, (const uint8_t *)&h + sizeof(h));
+    if (!legacy) {
+        DX10Info dx10  = {};
+        dx10.format    = dxgi;
+        dx10.dim       = volume ? DDS_DX10_TEXTURE3D : DDS_DX10_TEXTURE2D;
+        dx10.miscFlag  = cubemap ? DDS_DX10_TEXTURECUBE : 0;
+        dx10.arraySize = cubemap ? layers / 6 : layers;
+        _header.insert(_header.end(), (const uint8_t *)&dx10, (const uint8_t *)&dx10 + sizeof(dx10));
+    }
+    _chunks.emplace_back(_header.data(), _header.size());
+
+    // Collect pixels of each plane, in DDS order: all levels of one layer, then the next layer. Planes with padded rows
+    // are written row by row.
+    auto add = [&](const uint8_t * p, size_t size) {
+        auto & last = _chunks.back();
+        if (_chunks.size() > 1 && last.end() == p) {
+            last = rg::ConstRange<uint8_t>(last.data(), last.size() + size);
+        } else {
+            _chunks.emplace_back(p, size);
+        }
+    };
+    for (uint32_t i = 0; i < layers; ++i) {
+        for (uint32_t m = 0; m < levels; ++m) {
+            const auto &    p      = image.desc.plane(i, m);
+            auto            packed = rg::ImagePlaneDesc::make(p.format, p.width, p.height, p.depth);
+            const uint8_t * pixels = image.data + p.offset;
+            if (p.pitch == packed.pitch && p.slice == packed.slice) {
+                add(pixels, packed.size);
+                continue;
+            }
+            uint32_t rows = packed.slice / packed.pitch;
+            for (uint32_t z = 0; z < p.depth; ++z) {
+                for (uint32_t y = 0; y < rows; ++y) add(pixels + (size_t)p.slice * z + (size_t)p.pitch * y, packed.pitch);
+            }
         }
     }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool DDSWriter::write(std::ostream & f) const {
+    if (_chunks.empty()) {
+        RG_LOGE("DDS writer is not prepared.");
+        return false;
+    }
+    for (const auto & c : _chunks) f.write((const char *)c.data(), (std::streamsize)c.size());
+    if (!f.good()) {
+        RG_LOGE("Failed to write DDS file.");
+        return false;
+    }
+    return true;
 }
@@ -43,27 +43,43 @@ static_assert(sizeof(DDSFileHeader) == 124);
 /// dds image reader
 ///
 class DDSReader {
-    std::istream & _file;
-    DDSFileHeader  _header;
-    rg::ImageDesc  _imgDesc;
+    std::istream *          _file = nullptr;
+    rg::ConstRange<uint8_t> _memory;     ///< the DDS file in memory, if there's no stream.
+    mutable size_t          _offset = 0; ///< read position in _memory
+    std::streamoff          _pixels = -1; ///< position of the first pixel, right after the header
+    DDSFileHeader           _header;
+    rg::ImageDesc           _imgDesc;
 
     enum FormatConversion {
         FC_NONE,
         FC_BGRA8888_TO_RGBA8888,
     };
 
-    rg::ColorFormat   _originalFormat;
+    rg::ColorFormat   _originalFormat; ///< format of pixels in the file, before _formatConversion
     FormatConversion  _formatConversion;
 
-    static FormatConversion sCheckFormatConversion(rg::ColorFormat);
-    static void sConvertFormat(FormatConversion fc, void * data, size_t size);
+    /// Pixels of streams that need conversion are read and converted in chunks of this size, which fit in L2 cache.
+    static constexpr size_t STREAM_CHUNK_BYTES = 256 * 1024;
+
+    static FormatConversion sCheckFormatConversion(rg::ColorFormat &);
+    static void sConvertFormat(FormatConversion fc, void * dst, const void * src, size_t size);
+
+    bool read(void * buf, size_t size) const;
+    bool readConverted(uint8_t * dst, size_t size) const;
+    bool seek(size_t offset) const;
+    bool resolve(rg::ImageSubset & subset) const;
 
 public:
 
     ///
-    /// Constructor
+    /// Construct a reader of DDS file stream.
+    ///
+    DDSReader(std::istream & f) : _file(&f), _formatConversion(FC_NONE) {}
+
     ///
-    DDSReader(std::istream & f) : _file(f), _formatConversion(FC_NONE) {}
+    /// Construct a reader of DDS file in memory. The file is parsed in place, without copying it.
+    ///
+    DDSReader(const rg::ConstRange<uint8_t> & memory) : _memory(memory), _formatConversion(FC_NONE) {}
 
     ///
     /// Destructor
@@ -84,4 +100,70 @@ public:
     /// Read DDS image
     ///
     bool readPixels(void * buf, size_t size) const;
+
+    ///
+    /// Returns descriptor of a subset of the image, in FACE_MAJOR order. Returns an empty descriptor if the subset is
+    /// out of range. Call after readHeader().
+    ///
+    rg::ImageDesc subsetDesc(rg::ImageSubset subset) const;
+
+    ///
+    /// Read pixels of a subset of the image, as described by subsetDesc(). Only bytes of the subset are read: the
+    /// reader seeks to the levels of each layer, which are stored together in the file. Subsets can be read in any
+    /// order, any number of times, but the stream must be seekable.
+    ///
+    bool readPixels(void * buf, size_t size, rg::ImageSubset subset) const;
+
+    ///
+    /// Check if pixels are stored in the file as they are described by readHeader(). If true, pixels can be used in
+    /// place, without calling readPixels().
+    ///
+    bool storedAsIs() const { return FC_NONE == _formatConversion; }
+
+    ///
+    /// Returns pixels in the memory of the DDS file, right after the header. Only valid for readers of DDS files in
+    /// memory, after readHeader(). Returns null if pixels are truncated.
+    ///
+    const uint8_t * pixelsInMemory() const {
+        if (!_memory.data() || _offset + _imgDesc.size > _memory.size()) return nullptr;
+        return _memory.data() + _offset;
+    }
+};
+
+///
+/// dds image writer. Pixels are written as they are, without any conversion. Formats of the legacy DirectDraw pixel
+/// format table are written with the legacy header, unless the image is an array. Other formats, and arrays, are
+/// written with the DX10 header.
+///
+class DDSWriter {
+    std::vector<uint8_t>                 _header; ///< "DDS " magic, file header, and the optional DX10 header.
+    std::vector<rg::ConstRange<uint8_t>> _chunks; ///< header, then pixels of the image, in file order.
+
+public:
+
+    RG_NO_COPY(DDSWriter);
+    RG_NO_MOVE(DDSWriter);
+
+    ///
+    /// Constructor
+    ///
+    DDSWriter() = default;
+
+    ///
+    /// Build the header, and collect pixels of the image. If 'cubemap' is true, every 6 layers are faces of one
+    /// cubemap. Returns false if the image can't be saved as DDS.
+    ///
+    bool prepare(const rg::ImageProxy & image, bool cubemap = false);
+
+    ///
+    /// Returns all bytes of the file, after prepare(): the header, followed by pixels of all planes in the order of
+    /// the DDS file, where levels of each layer are stored together. Adjacent planes are merged into one chunk, so
+    /// pixels of a tightly packed FACE_MAJOR image are one chunk that covers the whole image.
+    ///
+    const std::vector<rg::ConstRange<uint8_t>> & chunks() const { return _chunks; }
+
+    ///
+    /// Write the prepared file to the stream.
+    ///
+    bool write(std::ostream & f) const;
 };
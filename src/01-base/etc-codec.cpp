@@ -0,0 +1,247 @@
+#include "pch.h"
+#include "block-codec.h"
+
+using namespace rg;
+
+// *********************************************************************************************************************
+// ETC2 and EAC decoders
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// ETC and EAC blocks are big endian 64-bit integers.
+static inline uint64_t loadBE64(const uint8_t * p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline uint32_t bitsOf(uint64_t v, uint32_t high, uint32_t low) {
+    return (uint32_t)((v >> low) & ((1ull << (high - low + 1)) - 1));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline uint8_t clamp255(int32_t v) { return (uint8_t)std::clamp(v, 0, 255); }
+
+/// Intensity modifiers of ETC1 and ETC2 individual and differential modes, indexed by (table, pixel index).
+static constexpr int32_t ETC_MODIFIERS[8][4] = {
+    { 2, 8, -2, -8 },        { 5, 17, -5, -17 },      { 9, 29, -9, -29 },      { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 },    { 24, 80, -24, -80 },    { 33, 106, -33, -106 },  { 47, 183, -47, -183 },
+};
+
+/// Distances of ETC2 T and H modes.
+static constexpr int32_t ETC_DISTANCES[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+/// Modifiers of EAC blocks, indexed by (table, pixel index).
+static constexpr int32_t EAC_MODIFIERS[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 }, { -3, -6, -8, -12, 2, 5, 7, 11 },  { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },  { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },  { -2, -4, -8, -10, 1, 3, 7, 9 },   { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },  { -1, -2, -3, -10, 0, 1, 2, 9 },   { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one ETC2 RGB block to 4x4 RGBA8 pixels. Rows are 'pitch' bytes apart. When 'punchThrough' is true, the block
+/// is of the RGB8A1 format: bit 33 is the opaque flag instead of the differential flag, and pixel index 2 of non
+/// opaque blocks is transparent black. ETC1 blocks are valid ETC2 blocks, since the T, H and planar modes of ETC2 are
+/// encoded with differential colors that overflow, which ETC1 doesn't allow.
+static void decodeETC2Block(uint8_t * dst, size_t pitch, const uint8_t * block, bool punchThrough) {
+    uint64_t v      = loadBE64(block);
+    bool     diff   = punchThrough || bitsOf(v, 33, 33);
+    bool     opaque = !punchThrough || bitsOf(v, 33, 33);
+
+    // Pixel indices are stored column by column: bit (x * 4 + y) of the low and high halves of the lowest 32 bits.
+    auto index = [&](uint32_t x, uint32_t y) {
+        uint32_t p = x * 4 + y;
+        return (uint32_t)(((v >> (p + 16)) & 1) << 1 | ((v >> p) & 1));
+    };
+    auto store = [&](uint32_t x, uint32_t y, int32_t r, int32_t g, int32_t b, uint8_t a) {
+        uint8_t * p = dst + y * pitch + x * 4;
+        p[0]        = clamp255(r);
+        p[1]        = clamp255(g);
+        p[2]        = clamp255(b);
+        p[3]        = a;
+    };
+    auto expand4 = [](uint32_t c) { return (int32_t)(c << 4 | c); };
+    auto expand5 = [](uint32_t c) { return (int32_t)(c << 3 | c >> 2); };
+
+    int32_t base[2][3];
+    if (diff) {
+        int32_t r = (int32_t)bitsOf(v, 63, 59), dr = ((int32_t)bitsOf(v, 58, 56) << 29) >> 29;
+        int32_t g = (int32_t)bitsOf(v, 55, 51), dg = ((int32_t)bitsOf(v, 50, 48) << 29) >> 29;
+        int32_t b = (int32_t)bitsOf(v, 47, 43), db = ((int32_t)bitsOf(v, 42, 40) << 29) >> 29;
+        if (r + dr < 0 || r + dr > 31) {
+            // T mode: one color, and 3 colors around the other one.
+            int32_t c[2][3] = {
+                { expand4(bitsOf(v, 60, 59) << 2 | bitsOf(v, 57, 56)), expand4(bitsOf(v, 55, 52)), expand4(bitsOf(v, 51, 48)) },
+                { expand4(bitsOf(v, 47, 44)), expand4(bitsOf(v, 43, 40)), expand4(bitsOf(v, 39, 36)) },
+            };
+            int32_t d = ETC_DISTANCES[bitsOf(v, 35, 34) << 1 | bitsOf(v, 32, 32)];
+            for (uint32_t y = 0; y < 4; ++y)
+                for (uint32_t x = 0; x < 4; ++x) {
+                    uint32_t i = index(x, y);
+                    if (!opaque && 2 == i) {
+                        store(x, y, 0, 0, 0, 0);
+                    } else if (0 == i) {
+                        store(x, y, c[0][0], c[0][1], c[0][2], 255);
+                    } else {
+                        int32_t o = 1 == i ? d : 2 == i ? 0 : -d;
+                        store(x, y, c[1][0] + o, c[1][1] + o, c[1][2] + o, 255);
+                    }
+                }
+            return;
+        }
+        if (g + dg < 0 || g + dg > 31) {
+            // H mode: 2 pairs of colors, around 2 base colors.
+            uint32_t c0[3] = { bitsOf(v, 62, 59), bitsOf(v, 58, 56) << 1 | bitsOf(v, 52, 52),
+                               bitsOf(v, 51, 51) << 3 | bitsOf(v, 49, 47) };
+            uint32_t c1[3] = { bitsOf(v, 46, 43), bitsOf(v, 42, 39), bitsOf(v, 38, 35) };
+            uint32_t order = (c0[0] << 8 | c0[1] << 4 | c0[2]) >= (c1[0] << 8 | c1[1] << 4 | c1[2]) ? 1 : 0;
+            int32_t  d     = ETC_DISTANCES[bitsOf(v, 34, 34) << 2 | bitsOf(v, 32, 32) << 1 | order];
+            for (uint32_t y = 0; y < 4; ++y)
+                for (uint32_t x = 0; x < 4; ++x) {
+                    uint32_t i = index(x, y);
+                    if (!opaque && 2 == i) {
+                        store(x, y, 0, 0, 0, 0);
+                        continue;
+                    }
+                    const uint32_t * c = i < 2 ? c0 : c1;
+                    int32_t          o = i & 1 ? -d : d;
+                    store(x, y, expand4(c[0]) + o, expand4(c[1]) + o, expand4(c[2]) + o, 255);
+                }
+            return;
+        }
+        if (b + db < 0 || b + db > 31) {
+            // planar mode: colors are interpolated from the 3 corner colors. Always opaque.
+            auto expand6 = [](uint32_t c) { return (int32_t)(c << 2 | c >> 4); };
+            auto expand7 = [](uint32_t c) { return (int32_t)(c << 1 | c >> 6); };
+            int32_t o[3] = { expand6(bitsOf(v, 62, 57)), expand7(bitsOf(v, 56, 56) << 6 | bitsOf(v, 54, 49)),
+                             expand6(bitsOf(v, 48, 48) << 5 | bitsOf(v, 44, 43) << 3 | bitsOf(v, 41, 39)) };
+            int32_t h[3] = { expand6(bitsOf(v, 38, 34) << 1 | bitsOf(v, 32, 32)), expand7(bitsOf(v, 31, 25)),
+                             expand6(bitsOf(v, 24, 19)) };
+            int32_t w[3] = { expand6(bitsOf(v, 18, 13)), expand7(bitsOf(v, 12, 6)), expand6(bitsOf(v, 5, 0)) };
+            for (int32_t y = 0; y < 4; ++y)
+                for (int32_t x = 0; x < 4; ++x) {
+                    int32_t c[3];
+                    for (int i = 0; i < 3; ++i) c[i] = (x * (h[i] - o[i]) + y * (w[i] - o[i]) + 4 * o[i] + 2) >> 2;
+                    store((uint32_t)x, (uint32_t)y, c[0], c[1], c[2], 255);
+                }
+            return;
+        }
+        base[0][0] = expand5((uint32_t)r);
+        base[0][1] = expand5((uint32_t)g);
+        base[0][2] = expand5((uint32_t)b);
+        base[1][0] = expand5((uint32_t)(r + dr));
+        base[1][1] = expand5((uint32_t)(g + dg));
+        base[1][2] = expand5((uint32_t)(b + db));
+    } else {
+        for (uint32_t c = 0; c < 3; ++c) {
+            base[0][c] = expand4(bitsOf(v, 63 - c * 8, 60 - c * 8));
+            base[1][c] = expand4(bitsOf(v, 59 - c * 8, 56 - c * 8));
+        }
+    }
+
+    // individual and differential modes: 2 sub blocks of 2x4 (side by side) or 4x2 (flipped, top and bottom).
+    bool            flip      = bitsOf(v, 32, 32);
+    const int32_t * tables[2] = { ETC_MODIFIERS[bitsOf(v, 39, 37)], ETC_MODIFIERS[bitsOf(v, 36, 34)] };
+    for (uint32_t y = 0; y < 4; ++y)
+        for (uint32_t x = 0; x < 4; ++x) {
+            uint32_t s = flip ? y / 2 : x / 2;
+            uint32_t i = index(x, y);
+            if (!opaque) {
+                // non opaque blocks of RGB8A1 have no modifier for index 0, and index 2 is transparent.
+                if (2 == i) {
+                    store(x, y, 0, 0, 0, 0);
+                    continue;
+                }
+                if (0 == i) {
+                    store(x, y, base[s][0], base[s][1], base[s][2], 255);
+                    continue;
+                }
+            }
+            int32_t m = tables[s][i];
+            store(x, y, base[s][0] + m, base[s][1] + m, base[s][2] + m, 255);
+        }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one 8-bit EAC alpha block to 4x4 values that are 'step' bytes apart. Rows are 'pitch' bytes apart.
+static void decodeEACAlphaBlock(uint8_t * dst, size_t pitch, size_t step, const uint8_t * block) {
+    uint64_t        v          = loadBE64(block);
+    int32_t         base       = (int32_t)bitsOf(v, 63, 56);
+    int32_t         multiplier = (int32_t)bitsOf(v, 55, 52);
+    const int32_t * modifiers  = EAC_MODIFIERS[bitsOf(v, 51, 48)];
+    for (uint32_t x = 0; x < 4; ++x)
+        for (uint32_t y = 0; y < 4; ++y) {
+            uint32_t p                   = x * 4 + y;
+            dst[y * pitch + x * step] = clamp255(base + modifiers[bitsOf(v, 47 - p * 3, 45 - p * 3)] * multiplier);
+        }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode one 11-bit EAC block (R11 or one channel of RG11) to 4x4 16-bit values that are 'step' bytes apart. Values
+/// are extended from 11 bits to 16 bits by bit replication, like the GPUs do.
+static void decodeEAC11Block(uint8_t * dst, size_t pitch, size_t step, const uint8_t * block, bool snorm) {
+    uint64_t        v          = loadBE64(block);
+    int32_t         multiplier = (int32_t)bitsOf(v, 55, 52);
+    const int32_t * modifiers  = EAC_MODIFIERS[bitsOf(v, 51, 48)];
+    for (uint32_t x = 0; x < 4; ++x)
+        for (uint32_t y = 0; y < 4; ++y) {
+            uint32_t p = x * 4 + y;
+            int32_t  m = modifiers[bitsOf(v, 47 - p * 3, 45 - p * 3)];
+            m          = multiplier ? m * multiplier * 8 : m;
+            uint16_t value;
+            if (snorm) {
+                int32_t s = std::clamp(std::max<int32_t>((int8_t)bitsOf(v, 63, 56), -127) * 8 + m, -1023, 1023);
+                int32_t a = std::abs(s);
+                a         = a << 5 | a >> 5;
+                value     = (uint16_t)(int16_t)(s < 0 ? -a : a);
+            } else {
+                int32_t u = std::clamp((int32_t)bitsOf(v, 63, 56) * 8 + 4 + m, 0, 2047);
+                value     = (uint16_t)(u << 5 | u >> 6);
+            }
+            memcpy(dst + y * pitch + x * step, &value, 2);
+        }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeETC2Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    for (size_t b = 0; b < count; ++b) decodeETC2Block(dst + b * 16, pitch, src + b * 8, false);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeETC2A1Row(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    for (size_t b = 0; b < count; ++b) decodeETC2Block(dst + b * 16, pitch, src + b * 8, true);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// ETC2 RGBA8: EAC alpha block, followed by ETC2 color block.
+void rg::decodeETC2EACRow(ColorFormat, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    for (size_t b = 0; b < count; ++b) {
+        decodeETC2Block(dst + b * 16, pitch, src + b * 16 + 8, false);
+        decodeEACAlphaBlock(dst + b * 16 + 3, pitch, 4, src + b * 16);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::decodeEACR11Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    bool snorm = ColorFormat::SIGN_SNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b) decodeEAC11Block(dst + b * 8, pitch, 2, src + b * 8, snorm);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// EAC RG11: two R11 blocks, for red and green channels.
+void rg::decodeEACRG11Row(ColorFormat format, uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    bool snorm = ColorFormat::SIGN_SNORM == format.sign012;
+    for (size_t b = 0; b < count; ++b) {
+        decodeEAC11Block(dst + b * 16, pitch, 4, src + b * 16, snorm);
+        decodeEAC11Block(dst + b * 16 + 2, pitch, 4, src + b * 16 + 8, snorm);
+    }
+}
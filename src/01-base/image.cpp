@@ -1,5 +1,9 @@
 #include "pch.h"
+#include "block-codec.h"
 #include "dds.h"
+#include "ktx.h"
+#include "pixel-convert.h"
+#include "thread-pool.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STBI_ASSERT RG_ASSERT
@@ -10,8 +14,22 @@
 #include "stb_image.h"
 #include "stb_image_write.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <numeric>
 #include <filesystem>
+#if RG_MSWIN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+#endif
 
 using namespace rg;
 
@@ -36,17 +54,18 @@ bool rg::ImagePlaneDesc::valid() const {
 
     // check pitches
     auto & cld = format.layoutDesc();
-    auto w = nextMultiple<uint32_t>( width, cld.blockWidth );
-    auto h = nextMultiple<uint32_t>( height, cld.blockHeight );
+    // Block size might not be power of 2 (ASTC), so can't use nextMultiple here.
+    auto w = (width + cld.blockWidth - 1) / cld.blockWidth * cld.blockWidth;
+    auto h = (height + cld.blockHeight - 1) / cld.blockHeight * cld.blockHeight;
     if (step < cld.pixelBits) {
         RG_LOGE("step is too small!");
         return false;
     }
-    if (pitch < w * cld.pixelBits / 8) {
+    if (pitch < (cld.blockWidth > 1 ? w / cld.blockWidth * cld.blockBytes : w * cld.pixelBits / 8)) {
         RG_LOGE("pitch is too small!");
         return false;
     }
-    if (slice < pitch * h) {
+    if (slice < pitch * (h / cld.blockHeight)) {
         RG_LOGE("slice is too small!");
         return false;
     }
@@ -56,7 +75,7 @@ bool rg::ImagePlaneDesc::valid() const {
     }
 
     // check alignment
-    if ((pitch * cld.blockHeight) % cld.blockBytes) {
+    if (pitch % cld.blockBytes) {
         RG_LOGE("Pitch is not aligned to pixel boundary.");
         return false;
     }
@@ -89,8 +108,6 @@ rg::ImagePlaneDesc rg::ImagePlaneDesc::make(ColorFormat format, size_t width, si
     //     RG_LOGE("image alignment (%d) must be 0 or power of 2.", alignment);
     //     return {};
     // }
-    RG_ASSERT(0 == (fd.blockBytes % fd.blockHeight));
-    uint32_t rowAlignment = fd.blockBytes / fd.blockHeight;
     // alignment = ceilPowerOf2(std::max((uint32_t)alignment, (uint32_t)fd.blockBytes));
 
     ImagePlaneDesc p;
@@ -101,17 +118,17 @@ rg::ImagePlaneDesc rg::ImagePlaneDesc::make(ColorFormat format, size_t width, si
     p.step      = std::max((uint32_t)step, (uint32_t)fd.pixelBits);
     // p.alignment = (uint32_t)alignment;
 
-    // align image size to pixel block size
-    auto aw  = nextMultiple<uint32_t>(p.width, fd.blockWidth);
-    auto ah  = nextMultiple<uint32_t>(p.height, fd.blockHeight);
+    // align image size to pixel block size. Note that we can't just use nextMultiple here, since block size might not
+    // be power of 2.
+    auto aw  = (p.width + fd.blockWidth - 1) / fd.blockWidth * fd.blockWidth;
+    auto ah  = (p.height + fd.blockHeight - 1) / fd.blockHeight * fd.blockHeight;
 
-    // calculate row pitch, aligned to rowAlignment.
-    // Note that we can't just use nextMultiple here, since rowAlignment might not be power of 2.
-    p.pitch = std::max(aw * p.step / 8u, (uint32_t)pitch);
-    p.pitch = (p.pitch + rowAlignment - 1) / rowAlignment * rowAlignment;
+    // calculate row pitch, aligned to block size. Rows of compressed formats are rows of blocks.
+    p.pitch = std::max(fd.blockWidth > 1 ? aw / fd.blockWidth * fd.blockBytes : aw * p.step / 8u, (uint32_t)pitch);
+    p.pitch = (p.pitch + fd.blockBytes - 1) / fd.blockBytes * fd.blockBytes;
 
     // calculate slice and plane size of the image.
-    p.slice  = std::max(p.pitch * ah, (uint32_t)slice);
+    p.slice  = std::max(p.pitch * (ah / fd.blockHeight), (uint32_t)slice);
     p.size   = p.slice * p.depth;
 
     // done
@@ -120,141 +137,197 @@ rg::ImagePlaneDesc rg::ImagePlaneDesc::make(ColorFormat format, size_t width, si
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
-
-struct RGBA8 {
-    uint8_t x, y, z, w;
+/// Consecutive rows of one image plane, that are converted together as one work item.
+struct RowBand {
+    const PixelConversion * conv;
+    const BlockDecoder *    decoder; ///< decoder of compressed source plane. Null if the source is not compressed.
+    const BlockEncoder *    encoder; ///< encoder of compressed destination plane. Null if it is not compressed.
+    CompressionQuality      quality; ///< compression quality of the encoder.
+    const ImagePlaneDesc *  src;
+    const ImagePlaneDesc *  dst;
+    uint32_t                first; ///< index of the first row (block row, if compressed), counting rows of all slices.
+    uint32_t                count; ///< number of rows (block rows, if compressed).
 };
 
-struct float4 {
-    float x, y, z, w;
-};
+/// Max bytes of source and destination pixels in one row band. Bands are small enough to stay in L2 cache, but large
+/// enough to amortize the cost of scheduling.
+static constexpr size_t ROW_BAND_BYTES = 256 * 1024;
 
-struct uint128_t {
-    uint64_t lo;
-    uint64_t hi;
-    uint32_t segment(uint32_t offset, uint32_t count) const {
-        if (offset + count <= 64) {
-            uint64_t mask = (((uint64_t)1) << count) - 1;
-            return (uint32_t)((lo >> offset) & mask);
-        } else if (offset >= 64) {
-            uint64_t mask = (((uint64_t)1) << count) - 1;
-            return (uint32_t)(hi >> (offset - 64) & mask);
-        } else {
-            // This means the segment is crossing the low and hi
-            RG_THROW("unsupported yet.");
-        }
+// ---------------------------------------------------------------------------------------------------------------------
+/// Returns true if the format is block compressed.
+static bool isBlockCompressed(ColorFormat format) {
+    return format.layoutDesc().blockWidth > 1 || format.layoutDesc().blockHeight > 1;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Find the way to convert pixels of the source plane to the target format. Compressed sources are decoded first, then
+/// converted from the decoded format. Compressed targets are encoded from the encoder's source format. Returns false
+/// if the conversion is not supported.
+static bool getRowConversion(const PixelConversion *& conv, const BlockDecoder *& decoder,
+                             const BlockEncoder *& encoder, ColorFormat src, ColorFormat target) {
+    decoder = nullptr;
+    encoder = nullptr;
+    if (isBlockCompressed(src)) {
+        decoder = getBlockDecoder(src);
+        if (!decoder) return false;
+        src = decoder->decoded;
     }
-};
+    if (isBlockCompressed(target)) {
+        encoder = getBlockEncoder(target);
+        if (!encoder) return false;
+        target = encoder->source;
+    }
+    conv = getPixelConversion(src, target);
+    return nullptr != conv;
+}
 
 // ---------------------------------------------------------------------------------------------------------------------
-/// Convert one color channel to float, based on the channel format/sign
-/// \param value The channel value
-/// \param width The number of valid bits in that value
-/// \param sign  The channel's data format
-static inline float tofloat(uint32_t value, uint32_t width, ColorFormat::Sign sign) {
-    auto castToFloat = [](uint32_t u32) {
-        union { ;
-            float f;
-            uint32_t u;
-        };
-        u = u32;
-        return f;
-    };
-    uint32_t mask = (1u << width) - 1;
-    value &= mask;
-    switch(sign) {
-        case ColorFormat::SIGN_UNORM:
-            return (float)value / (float)mask;
-
-        case ColorFormat::SIGN_FLOAT:
-            // 10 bits    =>                         EE EEEFFFFF
-            // 11 bits    =>                        EEE EEFFFFFF
-            // 16 bits    =>                   SEEEEEFF FFFFFFFF
-            // Float bits => SEEEEEEE EFFFFFFF FFFFFFFF FFFFFFFF
-            // 0x0000001F => 00000000 00000000 00000000 00011111
-            // 0x0000003F => 00000000 00000000 00000000 00111111
-            // 0x000003E0 => 00000000 00000000 00000011 11100000
-            // 0x000007C0 => 00000000 00000000 00000111 11000000
-            // 0x00007C00 => 00000000 00000000 01111100 00000000
-            // 0x000003FF => 00000000 00000000 00000011 11111111
-            // 0x38000000 => 00111000 00000000 00000000 00000000
-            // 0x7f800000 => 01111111 10000000 00000000 00000000
-            // 0x00008000 => 00000000 00000000 10000000 00000000
-            if (width == 32) {
-                return castToFloat(value);
-            } else if (width == 16) {
-                uint32_t u32 = ((value & 0x8000) << 16) | ((( value & 0x7c00) + 0x1C000) << 13) | // exponential
-                               ((value & 0x03FF) << 13); // mantissa
-                return castToFloat(u32);
-            } else if (width == 11) {
-                uint32_t u32 = ((((value & 0x07c0) << 17) + 0x38000000) & 0x7f800000) | // exponential
-                               ((value & 0x003f) << 17); // Mantissa
-                return castToFloat(u32);
-            } else if (width == 10) {
-                uint32_t u32 = ((((value & 0x03E0) << 18) + 0x38000000) & 0x7f800000) | // exponential
-                               ((value & 0x001f) << 18); // Mantissa
-                return castToFloat(u32);
-            } else {
-                RG_THROW("unsupported yet.");
-            }
+/// Bytes per pixel of the format that pixels are converted from (if 'decoder' is not null), or to (if 'encoder' is
+/// not null). Or else, the step of the plane.
+static uint32_t convertedPixelBits(const BlockDecoder * decoder, const BlockEncoder * encoder, const ImagePlaneDesc & p) {
+    if (decoder) return decoder->decoded.layoutDesc().pixelBits;
+    if (encoder) return encoder->source.layoutDesc().pixelBits;
+    return p.step;
+}
 
-        case ColorFormat::SIGN_UINT:
-            return (float)value;
+// ---------------------------------------------------------------------------------------------------------------------
+/// Number of scanlines that are converted together, when either side is compressed. It covers whole blocks of both
+/// sides, which matters when transcoding between formats of different block heights, like ASTC 6x6 to BC7.
+static uint32_t blockRowHeight(ColorFormat src, ColorFormat dst) {
+    return std::lcm<uint32_t>(src.layoutDesc().blockHeight, dst.layoutDesc().blockHeight);
+}
 
-        case ColorFormat::SIGN_SNORM:
-        case ColorFormat::SIGN_GNORM:
-        case ColorFormat::SIGN_BNORM:
-        case ColorFormat::SIGN_SINT:
-        case ColorFormat::SIGN_GINT:
-        case ColorFormat::SIGN_BINT:
-        default:
-            // not supported yet.
-            RG_THROW("unsupported yet.");
+// ---------------------------------------------------------------------------------------------------------------------
+/// Split all rows of the plane into bands, and append them to the list. When either side is compressed, rows are
+/// split by block rows, since a block row is the smallest unit that can be decoded or encoded.
+static void appendRowBands(std::vector<RowBand> & bands, const PixelConversion & conv, const BlockDecoder * decoder,
+                           const BlockEncoder * encoder, CompressionQuality quality, const ImagePlaneDesc & src,
+                           const ImagePlaneDesc & dst) {
+    uint32_t rowHeight = blockRowHeight(src.format, dst.format);
+    uint32_t srcBits   = convertedPixelBits(decoder, nullptr, src);
+    uint32_t dstBits   = convertedPixelBits(nullptr, encoder, dst);
+    size_t   rowBytes  = (size_t)src.width * (srcBits + dstBits) / 8 * rowHeight;
+    uint32_t perBand   = (uint32_t)std::max<size_t>(1, ROW_BAND_BYTES / std::max<size_t>(1, rowBytes));
+    uint32_t rows      = (src.height + rowHeight - 1) / rowHeight * src.depth;
+    for (uint32_t r = 0; r < rows; r += perBand) {
+        bands.push_back({ &conv, decoder, encoder, quality, &src, &dst, r, std::min(perBand, rows - r) });
     }
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
-/// Convert pixel of arbitrary format to float4. Do not support compressed format.
-static inline float4 convertToFloat4(const ColorFormat::LayoutDesc & ld, const ColorFormat & format,
-                                     const void * pixel) {
-    RG_ASSERT(1 == ld.blockWidth && 1 == ld.blockHeight); // do not support compressed format.
-
-    const uint128_t * src = (const uint128_t*)pixel;
-
-    // labmda to convert one channel
-    auto convertChannel = [&](uint32_t swizzle) {
-        if (ColorFormat::SWIZZLE_0 == swizzle) return 0.f;
-        if (ColorFormat::SWIZZLE_1 == swizzle) return 1.f;
-        const auto & ch = ld.channels[swizzle];
-        auto sign = (ColorFormat::Sign)((swizzle < 3) ? format.sign012 : format.sign3);
-        return tofloat(src->segment(ch.shift, ch.bits), ch.bits, sign);
-    };
+/// Convert block rows of one band, when either side is compressed. Compressed source block rows are decoded to a
+/// small temporary buffer, that is then converted while it is still hot in cache. Likewise, pixels are converted to
+/// another temporary buffer before being encoded to the compressed destination. Partial blocks at the right and
+/// bottom edges are padded by repeating the edge pixels, so the padding doesn't add any error to the encoded block.
+static void convertBlockRowBand(const RowBand & b, uint8_t * dst, const uint8_t * src) {
+    const auto & sp        = *b.src;
+    const auto & dp        = *b.dst;
+    const auto & sl        = sp.format.layoutDesc();
+    const auto & dl        = dp.format.layoutDesc();
+    uint32_t     rowHeight = blockRowHeight(sp.format, dp.format);
+    uint32_t     blockRows = (sp.height + rowHeight - 1) / rowHeight;
+
+    // temporary buffer of decoded source pixels
+    thread_local std::vector<uint8_t> decoded;
+    uint32_t srcBlocks = (sp.width + sl.blockWidth - 1) / sl.blockWidth;
+    size_t   srcStep   = convertedPixelBits(b.decoder, nullptr, sp) / 8;
+    size_t   srcPitch  = b.decoder ? (size_t)srcBlocks * sl.blockWidth * srcStep : sp.pitch;
+    if (b.decoder) decoded.resize(srcPitch * rowHeight);
+
+    // temporary buffer of pixels to encode
+    thread_local std::vector<uint8_t> encoding;
+    uint32_t dstBlocks = (dp.width + dl.blockWidth - 1) / dl.blockWidth;
+    size_t   dstStep   = convertedPixelBits(nullptr, b.encoder, dp) / 8;
+    size_t   dstPitch  = b.encoder ? (size_t)dstBlocks * dl.blockWidth * dstStep : dp.pitch;
+    if (b.encoder) encoding.resize(dstPitch * rowHeight);
+
+    for (uint32_t r = b.first; r < b.first + b.count; ++r) {
+        uint32_t z    = r / blockRows;
+        uint32_t y    = r % blockRows * rowHeight;
+        uint32_t rows = std::min(rowHeight, sp.height - y);
+
+        const uint8_t * s = src + sp.pixel(0, y, z);
+        uint8_t *       d = dst + dp.pixel(0, y, z);
+        if (b.decoder) {
+            // decode all source block rows that have pixels in this row.
+            for (uint32_t i = 0; i < rows; i += sl.blockHeight) {
+                b.decoder->decodeRow(sp.format, decoded.data() + i * srcPitch, srcPitch, s + i / sl.blockHeight * sp.pitch,
+                                     srcBlocks);
+            }
+            s = decoded.data();
+        }
+        uint8_t * c = b.encoder ? encoding.data() : d;
+        for (uint32_t i = 0; i < rows; ++i) (*b.conv)(c + i * dstPitch, dstStep, s + i * srcPitch, srcStep, sp.width);
+        if (!b.encoder) continue;
+
+        // pad partial blocks, then encode block rows that have pixels in this row.
+        for (uint32_t i = 0; i < rowHeight; ++i) {
+            uint8_t * row = c + i * dstPitch;
+            if (i >= rows) memcpy(row, c + (rows - 1) * dstPitch, dstPitch);
+            for (size_t x = dp.width; x < dstBlocks * dl.blockWidth; ++x) {
+                memcpy(row + x * dstStep, row + (dp.width - 1) * dstStep, dstStep);
+            }
+        }
+        for (uint32_t i = 0; i < rows; i += dl.blockHeight) {
+            b.encoder->encodeRow(dp.format, d + i / dl.blockHeight * dp.pitch, c + i * dstPitch, dstPitch, dstBlocks,
+                                 b.quality);
+        }
+    }
+}
 
-    return {
-        convertChannel(format.swizzle0),
-        convertChannel(format.swizzle1),
-        convertChannel(format.swizzle2),
-        convertChannel(format.swizzle3),
-    };
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert rows of all bands in parallel. Within a band, row pointers are stepped incrementally.
+static void convertRowBands(const std::vector<RowBand> & bands, uint8_t * dst, const uint8_t * src) {
+    parallelFor(bands.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto & b = bands[i];
+            if (b.decoder || b.encoder) {
+                convertBlockRowBand(b, dst, src);
+                continue;
+            }
+            const auto &    sp = *b.src;
+            const auto &    dp = *b.dst;
+            uint32_t        y  = b.first % sp.height;
+            const uint8_t * s  = src + sp.pixel(0, y, b.first / sp.height);
+            uint8_t *       d  = dst + dp.pixel(0, y, b.first / sp.height);
+            for (uint32_t r = 0; r < b.count; ++r) {
+                (*b.conv)(d, dp.step / 8, s, sp.step / 8, sp.width);
+                if (++y < sp.height) {
+                    s += sp.pitch;
+                    d += dp.pitch;
+                } else {
+                    // move to the first row of the next slice.
+                    y = 0;
+                    s += sp.slice - (size_t)(sp.height - 1) * sp.pitch;
+                    d += dp.slice - (size_t)(dp.height - 1) * dp.pitch;
+                }
+            }
+        }
+    });
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
-//
-static RGBA8 convertToRGBA8(const ColorFormat::LayoutDesc & ld, const ColorFormat & format,
-                            const void * src) {
-    if (ColorFormat::RGBA8() == format) {
-        // shortcut for RGBA8 format.
-        return *(const RGBA8*)src;
-    } else {
-        // this is the general case that could in theory handle any format.
-        auto f4 = convertToFloat4(ld, format, src);
-        RGBA8 result;
-        result.x = (uint8_t)std::clamp<uint32_t>((uint32_t)(f4.x * 255.0f), 0, 255);
-        result.y = (uint8_t)std::clamp<uint32_t>((uint32_t)(f4.y * 255.0f), 0, 255);
-        result.z = (uint8_t)std::clamp<uint32_t>((uint32_t)(f4.z * 255.0f), 0, 255);
-        result.w = (uint8_t)std::clamp<uint32_t>((uint32_t)(f4.w * 255.0f), 0, 255);
-        return result;
+/// Convert one slice of the plane to tightly packed pixels of the target format.
+template<typename T>
+static std::vector<T> convertSlice(const ImagePlaneDesc & plane, const void * pixels, uint32_t z, ColorFormat target) {
+    const PixelConversion * conv;
+    const BlockDecoder *    decoder;
+    const BlockEncoder *    encoder;
+    if (!getRowConversion(conv, decoder, encoder, plane.format, target)) {
+        RG_LOGE("Can't convert color format 0x%X to 0x%X.", plane.format.u32, target.u32);
+        return {};
     }
+    ImagePlaneDesc src = plane;
+    src.offset += z * plane.slice;
+    src.depth = 1;
+    src.size  = plane.slice;
+    auto dst  = ImagePlaneDesc::make(target, plane.width, plane.height);
+    RG_ASSERT(dst.pitch == plane.width * sizeof(T));
+    std::vector<T> colors(plane.width * plane.height);
+    std::vector<RowBand> bands;
+    appendRowBands(bands, *conv, decoder, encoder, CompressionQuality::FAST, src, dst);
+    convertRowBands(bands, (uint8_t *)colors.data(), (const uint8_t *)pixels);
+    return colors;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -264,16 +337,11 @@ static std::vector<RGBA8> convertToRGBA8(const ImagePlaneDesc & plane, const voi
         RG_LOGE("Can't save empty image plane.");
         return {};
     }
-    const uint8_t * p = (const uint8_t *)pixels;
-    auto ld = plane.format.layoutDesc();
-    std::vector<RGBA8> colors;
-    colors.reserve(plane.width * plane.height);
-    for(uint32_t y = 0; y < plane.height; ++y) {
-        for(uint32_t x = 0; x < plane.width; ++x) {
-            colors.push_back(convertToRGBA8(ld, plane.format, p + plane.pixel(x, y, z)));
-        }
-    }
-    return colors;
+    // 8-bit image files store sRGB encoded colors. So sRGB pixels are kept as they are, instead of being decoded to
+    // linear space.
+    auto target = ColorFormat::SIGN_GNORM == plane.format.sign012 ? ColorFormat::RGBA_8_8_8_8_UNORM_SRGB()
+                                                                   : ColorFormat::RGBA8();
+    return convertSlice<RGBA8>(plane, pixels, z, target);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -283,29 +351,20 @@ static std::vector<float4> convertToFloat4(const ImagePlaneDesc & plane, const v
         RG_LOGE("Can't save empty image plane.");
         return {};
     }
-    const uint8_t * p = (const uint8_t *)pixels;
-    auto ld = plane.format.layoutDesc();
-    std::vector<float4> colors;
-    colors.reserve(plane.width * plane.height);
-    for(uint32_t y = 0; y < plane.height; ++y) {
-        for(uint32_t x = 0; x < plane.width; ++x) {
-            colors.push_back(convertToFloat4(ld, plane.format, p + plane.pixel(x, y, z)));
-        }
-    }
-    return colors;
+    return convertSlice<float4>(plane, pixels, z, ColorFormat::RGBA_32_32_32_32_FLOAT());
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
-void rg::ImagePlaneDesc::saveToPNG(const std::string & filename, const void * pixels, uint32_t z) {
+void rg::ImagePlaneDesc::saveToPNG(const std::string & filename, const void * pixels, uint32_t z) const {
     auto colors = convertToRGBA8(*this, pixels, z);
     if (colors.empty()) return;
-    stbi_write_png(filename.c_str(), (int)width, (int)height, 4, colors.data(), 4);
+    stbi_write_png(filename.c_str(), (int)width, (int)height, 4, colors.data(), (int)width * 4);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
-void rg::ImagePlaneDesc::saveToJPG(const std::string & filename, const void * pixels, uint32_t z, int quality) {
+void rg::ImagePlaneDesc::saveToJPG(const std::string & filename, const void * pixels, uint32_t z, int quality) const {
     auto colors = convertToRGBA8(*this, pixels, z);
     if (colors.empty()) return;
     stbi_write_jpg(filename.c_str(), (int)width, (int)height, 4, colors.data(), quality);
@@ -313,7 +372,7 @@ void rg::ImagePlaneDesc::saveToJPG(const std::string & filename, const void * pi
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
-void rg::ImagePlaneDesc::saveToHDR(const std::string & filename, const void * pixels, uint32_t z) {
+void rg::ImagePlaneDesc::saveToHDR(const std::string & filename, const void * pixels, uint32_t z) const {
     auto colors = convertToFloat4(*this, pixels, z);
     if (colors.empty()) return;
     stbi_write_hdr(filename.c_str(), (int)width, (int)height, 4, (const float*)colors.data());
@@ -321,7 +380,7 @@ void rg::ImagePlaneDesc::saveToHDR(const std::string & filename, const void * pi
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
-void rg::ImagePlaneDesc::save(const std::string & filename, const void * pixels, uint32_t z) {
+void rg::ImagePlaneDesc::save(const std::string & filename, const void * pixels, uint32_t z) const {
     auto ext = std::filesystem::path(filename).extension().string();
     std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
     if (".jpg" == ext || ".jpeg" == ext) {
@@ -451,6 +510,50 @@ void rg::ImageDesc::reset(const ImagePlaneDesc & basemap, uint32_t layers_, uint
     RG_ASSERT(valid());
 }
 
+// *********************************************************************************************************************
+// ImageProxy
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::convert(const ImageProxy & src, ImageProxy & dst, CompressionQuality quality) {
+    if (src.empty() || !src.data || dst.empty() || !dst.data) {
+        RG_LOGE("Can't convert empty image.");
+        return false;
+    }
+    if (src.desc.layers != dst.desc.layers || src.desc.levels != dst.desc.levels) {
+        RG_LOGE("Source and destination images must have same number of layers and levels.");
+        return false;
+    }
+
+    // validate all planes before touching any pixel.
+    std::vector<const PixelConversion *> conversions(src.desc.planes.size());
+    std::vector<const BlockDecoder *>    decoders(src.desc.planes.size());
+    std::vector<const BlockEncoder *>    encoders(src.desc.planes.size());
+    for (size_t i = 0; i < src.desc.planes.size(); ++i) {
+        const auto & sp = src.desc.planes[i];
+        const auto & dp = dst.desc.planes[i];
+        if (sp.width != dp.width || sp.height != dp.height || sp.depth != dp.depth) {
+            RG_LOGE("image plane [%zu] has different dimensions in source and destination images.", i);
+            return false;
+        }
+        if (!getRowConversion(conversions[i], decoders[i], encoders[i], sp.format, dp.format)) {
+            RG_LOGE("image plane [%zu]: unsupported conversion from format 0x%X to 0x%X.", i, sp.format.u32, dp.format.u32);
+            return false;
+        }
+    }
+
+    // Split rows of all planes into bands, so small mipmap levels are converted in parallel with the large ones.
+    std::vector<RowBand> bands;
+    for (size_t i = 0; i < src.desc.planes.size(); ++i) {
+        appendRowBands(bands, *conversions[i], decoders[i], encoders[i], quality, src.desc.planes[i],
+                       dst.desc.planes[i]);
+    }
+    convertRowBands(bands, dst.data, src.data);
+
+    return true;
+}
+
 // *********************************************************************************************************************
 // RawImage
 // *********************************************************************************************************************
@@ -472,16 +575,38 @@ rg::RawImage::RawImage(const ImageDesc & desc, const void * initialContent, size
 // ---------------------------------------------------------------------------------------------------------------------
 //
 rg::RawImage::~RawImage() {
-    afree(_proxy.data);
+    release();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::RawImage::release() {
+    // Pixels that are not allocated by the image are released along with the storage.
+    if (!_storage) afree(_proxy.data);
     _proxy.data = nullptr;
+    _storage.reset();
+    _mapped = false;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+rg::RawImage rg::RawImage::adopt(const ImageDesc & desc, void * pixels, std::shared_ptr<void> storage) {
+    if (!desc.valid() || !pixels || !storage) {
+        RG_LOGE("Can't adopt pixels: invalid descriptor, or null pixels or storage.");
+        return {};
+    }
+    RawImage image;
+    image._proxy.desc = desc;
+    image._proxy.data = (uint8_t *)pixels;
+    image._storage    = std::move(storage);
+    return image;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
 void rg::RawImage::construct(const void * initialContent, size_t initialContentSizeInbytes) {
     // clear old image data.
-    afree(_proxy.data);
-    _proxy.data = nullptr;
+    release();
 
     // deal with empty image
     if (_proxy.desc.empty()) {
@@ -509,12 +634,79 @@ void rg::RawImage::construct(const void * initialContent, size_t initialContentS
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
-//
-rg::RawImage rg::RawImage::load(std::istream & fp) {
-    // store current stream position
-    auto begin = fp.tellg();
+/// A whole file mapped into memory. Pages are mapped copy-on-write: they can be modified, without touching the file.
+struct MappedFile {
+    uint8_t * data = nullptr;
+    size_t    size = 0;
+
+    RG_NO_COPY(MappedFile);
+    RG_NO_MOVE(MappedFile);
+    MappedFile() = default;
+
+    ~MappedFile() {
+        if (!data) return;
+#if RG_MSWIN
+        UnmapViewOfFile(data);
+#else
+        munmap(data, size);
+#endif
+    }
+};
 
-    // setup stbi io callback
+// ---------------------------------------------------------------------------------------------------------------------
+/// Map the file into memory, with hints that it is going to be read sequentially and soon.
+static std::shared_ptr<MappedFile> mapFile(const std::string & filename) {
+    auto file = std::make_shared<MappedFile>();
+#if RG_MSWIN
+    HANDLE h = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == h) {
+        RG_LOGE("Failed to open image file %s : error code %u", filename.c_str(), (uint32_t)GetLastError());
+        return {};
+    }
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(h, &size);
+    file->size     = (size_t)size.QuadPart;
+    HANDLE mapping = file->size ? CreateFileMappingA(h, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+    if (mapping) {
+        file->data = (uint8_t *)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(h);
+    if (!file->data) {
+        RG_LOGE("Failed to map image file %s : error code %u", filename.c_str(), (uint32_t)GetLastError());
+        return {};
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+        return {};
+    }
+    struct stat st = {};
+    if (0 == fstat(fd, &st) && st.st_size > 0) {
+        void * p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED != p) {
+            file->data = (uint8_t *)p;
+            file->size = (size_t)st.st_size;
+        }
+    }
+    int err = errno;
+    ::close(fd);
+    if (!file->data) {
+        RG_LOGE("Failed to map image file %s : %s", filename.c_str(), errno2str(err));
+        return {};
+    }
+    // The two hints are not exclusive: sequential allows aggressive read-ahead, and willneed starts it right away.
+    madvise(file->data, file->size, MADV_SEQUENTIAL);
+    madvise(file->data, file->size, MADV_WILLNEED);
+#endif
+    return file;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// stb_image IO callbacks that read from std::istream.
+static stbi_io_callbacks streamCallbacks() {
     stbi_io_callbacks io = {};
     io.read = [](void* user, char* data, int size) -> int {
         auto fp = (std::istream *)user;
@@ -529,6 +721,120 @@ rg::RawImage rg::RawImage::load(std::istream & fp) {
         auto fp = (std::istream*)user;
         return fp->eof();
     };
+    return io;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Color formats of pixels decoded by stb_image: 8 and 16 bits integers, and 32 bits floats for HDR files.
+static const struct StbFormat {
+    int         bits;
+    int         channels;
+    ColorFormat format;
+} s_stbFormats[] = {
+    { 8,  1, ColorFormat::L_8_UNORM()              },
+    { 8,  2, ColorFormat::LA_8_8_UNORM()           },
+    { 8,  3, ColorFormat::RGB_8_8_8_UNORM()        },
+    { 8,  4, ColorFormat::RGBA_8_8_8_8_UNORM()     },
+    { 16, 1, ColorFormat::L_16_UNORM()             },
+    { 16, 2, ColorFormat::LA_16_16_UNORM()         },
+    { 16, 4, ColorFormat::RGBA_16_16_16_16_UNORM() },
+    { 32, 3, ColorFormat::RGB_32_32_32_FLOAT()     },
+    { 32, 4, ColorFormat::RGBA_32_32_32_32_FLOAT() },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The format to decode the file of 'bits' per channel and 'n' channels to. It is 'requested' if stb_image can decode
+/// to it directly. Otherwise, it is the smallest format that holds all channels of the file.
+static const StbFormat & stbFormat(int bits, int n, ColorFormat requested = ColorFormat::UNKNOWN()) {
+    for (const auto & f : s_stbFormats) {
+        if (f.bits == bits && f.format == requested) return f;
+    }
+    for (const auto & f : s_stbFormats) {
+        if (f.bits == bits && f.channels >= n) return f;
+    }
+    return s_stbFormats[3];
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static ImageDesc stbImageDesc(const StbFormat & f, int x, int y) {
+    return ImageDesc(ImagePlaneDesc::make(f.format, (uint32_t)x, (uint32_t)y));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// stb_image functions on an image file in memory.
+struct StbMemory {
+    const stbi_uc * data;
+    int             size;
+
+    bool info(int * x, int * y, int * n) const { return stbi_info_from_memory(data, size, x, y, n); }
+    int  bits() const { return stbi_is_hdr_from_memory(data, size) ? 32 : stbi_is_16_bit_from_memory(data, size) ? 16 : 8; }
+    void * load(int bits, int * x, int * y, int * n, int channels) const {
+        if (32 == bits) return stbi_loadf_from_memory(data, size, x, y, n, channels);
+        if (16 == bits) return stbi_load_16_from_memory(data, size, x, y, n, channels);
+        return stbi_load_from_memory(data, size, x, y, n, channels);
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// stb_image functions on an image file stream. Each call starts from the beginning of the file.
+struct StbStream {
+    std::istream &    fp;
+    std::streampos    begin;
+    stbi_io_callbacks io = streamCallbacks();
+
+    void rewind() const {
+        fp.clear();
+        fp.seekg(begin, std::ios::beg);
+    }
+    bool info(int * x, int * y, int * n) const {
+        rewind();
+        return stbi_info_from_callbacks(&io, &fp, x, y, n);
+    }
+    int bits() const {
+        rewind();
+        if (stbi_is_hdr_from_callbacks(&io, &fp)) return 32;
+        rewind();
+        return stbi_is_16_bit_from_callbacks(&io, &fp) ? 16 : 8;
+    }
+    void * load(int bits, int * x, int * y, int * n, int channels) const {
+        rewind();
+        if (32 == bits) return stbi_loadf_from_callbacks(&io, &fp, x, y, n, channels);
+        if (16 == bits) return stbi_load_16_from_callbacks(&io, &fp, x, y, n, channels);
+        return stbi_load_from_callbacks(&io, &fp, x, y, n, channels);
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode the file with stb_image at its own bit depth. Returns empty image if the file is not recognized. The image
+/// takes over the buffer of stb_image, instead of copying pixels out of it.
+template<typename SOURCE>
+static RawImage stbLoad(const SOURCE & source, ColorFormat requested) {
+    int x, y, n;
+    if (!source.info(&x, &y, &n)) return {};
+    const auto & f      = stbFormat(source.bits(), n, requested);
+    void *       pixels = source.load(f.bits, &x, &y, &n, f.channels);
+    if (!pixels) return {};
+    return RawImage::adopt(stbImageDesc(f, x, y), pixels, stbi_image_free);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert the loaded image to the requested format. UNKNOWN format means the image is good as it is.
+static RawImage convertTo(RawImage image, ColorFormat format) {
+    if (image.empty() || ColorFormat::UNKNOWN() == format || format == image.format()) return image;
+    const auto & base      = image.desc(0, 0);
+    auto         converted = RawImage(ImageDesc(ImagePlaneDesc::make(format, base.width, base.height, base.depth),
+                                             image.desc().layers, image.desc().levels));
+    ImageProxy   dst       = converted.proxy();
+    if (!convert(image.proxy(), dst)) return {};
+    return converted;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+rg::RawImage rg::RawImage::load(std::istream & fp, ColorFormat format) {
+    // store current stream position
+    auto begin = fp.tellg();
 
     // try read as DDS first
     DDSReader dds(fp);
@@ -536,31 +842,393 @@ rg::RawImage rg::RawImage::load(std::istream & fp) {
         auto image = RawImage(dds.readHeader());
         if (image.empty()) return {};
         if (!dds.readPixels(image.data(), image.size())) return {};
-        return image;
+        return convertTo(std::move(image), format);
+    }
+
+    // then KTX2 and KTX
+    fp.clear();
+    fp.seekg(begin, std::ios::beg);
+    KTXReader ktx(fp);
+    if (ktx.checkFormat()) {
+        auto image = RawImage(ktx.readHeader());
+        if (image.empty()) return {};
+        if (!ktx.readPixels(image.data(), image.size())) return {};
+        return convertTo(std::move(image), format);
     }
 
     // Load from common image file via stb_image library
-    // TODO: hdr/grayscale support
-    int x,y,n;
+    auto image = stbLoad(StbStream {fp, begin}, format);
+    if (!image.empty()) return convertTo(std::move(image), format);
+
+    RG_LOGE("Failed to load image from stream: unrecognized image format.");
+    return {};
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+rg::RawImage rg::RawImage::load(std::istream & fp, const ImageSubset & subset) {
+    auto begin = fp.tellg();
+
+    DDSReader dds(fp);
+    if (dds.checkFormat()) {
+        if (dds.readHeader().empty()) return {};
+        auto image = RawImage(dds.subsetDesc(subset));
+        if (image.empty()) return {};
+        if (!dds.readPixels(image.data(), image.size(), subset)) return {};
+        return image;
+    }
+
+    fp.clear();
     fp.seekg(begin, std::ios::beg);
-    auto data = stbi_load_from_callbacks(&io, &fp, &x, &y, &n, 4);
-    if (data) {
-        auto image = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_8_8_8_8_UNORM(), (uint32_t)x, (uint32_t)y)), data);
-        RG_ASSERT(image.desc().valid());
-        stbi_image_free(data);
+    KTXReader ktx(fp);
+    if (ktx.checkFormat()) {
+        if (ktx.readHeader().empty()) return {};
+        auto image = RawImage(ktx.subsetDesc(subset));
+        if (image.empty()) return {};
+        if (!ktx.readPixels(image.data(), image.size(), subset)) return {};
         return image;
     }
 
-    // TODO: KTX, DDS support
+    // other formats have only one plane.
+    if (subset.firstLayer > 0 || subset.layers > 1 || subset.firstLevel > 0 || subset.levels > 1) {
+        RG_LOGE("Failed to load image from stream: image subset is out of range.");
+        return {};
+    }
+    fp.clear();
+    fp.seekg(begin, std::ios::beg);
+    return load(fp);
+}
 
-    RG_LOGE("Failed to load image from stream: unrecognized image format.");
+// ---------------------------------------------------------------------------------------------------------------------
+//
+rg::RawImage rg::RawImage::load(const ConstRange<uint8_t> & data, ColorFormat format) {
+    // try read as DDS first
+    DDSReader dds(data);
+    if (dds.checkFormat()) {
+        auto image = RawImage(dds.readHeader());
+        if (image.empty()) return {};
+        if (!dds.readPixels(image.data(), image.size())) return {};
+        return convertTo(std::move(image), format);
+    }
+
+    // then KTX2 and KTX
+    KTXReader ktx(data);
+    if (ktx.checkFormat()) {
+        auto image = RawImage(ktx.readHeader());
+        if (image.empty()) return {};
+        if (!ktx.readPixels(image.data(), image.size())) return {};
+        return convertTo(std::move(image), format);
+    }
+
+    // Load from common image file via stb_image library
+    if (data.size() > (size_t)std::numeric_limits<int>::max()) {
+        RG_LOGE("Failed to load image from memory: the image is too large.");
+        return {};
+    }
+    auto image = stbLoad(StbMemory {data.data(), (int)data.size()}, format);
+    if (!image.empty()) return convertTo(std::move(image), format);
+
+    RG_LOGE("Failed to load image from memory: unrecognized image format.");
     return {};
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 //
-rg::RawImage rg::RawImage::load(const ConstRange<uint8_t> & data) {
-    auto str = std::string((const char*)data.data(), data.size());
-    auto iss = std::istringstream(str);
-    return load(iss);
+rg::RawImage rg::RawImage::loadMapped(const std::string & filename) {
+    auto file = mapFile(filename);
+    if (!file) return {};
+
+    // DDS pixels that need no conversion are used in place.
+    auto      memory = ConstRange<uint8_t>(file->data, file->size);
+    DDSReader dds(memory);
+    if (dds.checkFormat()) {
+        const auto & desc = dds.readHeader();
+        if (desc.empty()) return {};
+        auto pixels = dds.pixelsInMemory();
+        if (dds.storedAsIs() && pixels) {
+            auto image    = adopt(desc, const_cast<uint8_t *>(pixels), std::move(file)); // the pages are copy-on-write.
+            image._mapped = !image.empty();
+            return image;
+        }
+    }
+
+    // Otherwise, copy (and convert) pixels from the mapped pages.
+    return load(memory);
+}
+
+// *********************************************************************************************************************
+// Asynchronous loading
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Open the file and probe its header. Returns bytes of the decoded image, including the converted copy when it is
+/// loaded in another format, or 0 if the file can't be opened or recognized.
+static size_t probeTimed(std::ifstream & f, const std::string & filename, ColorFormat format, ImageLoadTiming & timing) {
+    auto start = std::chrono::steady_clock::now();
+    f.open(filename, std::ios::binary);
+    if (!f.good()) {
+        RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+        return 0;
+    }
+    auto   desc  = probeImage(f);
+    size_t bytes = desc.size;
+    if (bytes && ColorFormat::UNKNOWN() != format && format != desc.planes[0].format) {
+        const auto & base = desc.planes[0];
+        bytes += ImageDesc(ImagePlaneDesc::make(format, base.width, base.height, base.depth), desc.layers, desc.levels).size;
+    }
+    timing.bytes = bytes;
+    timing.read  = nanosecondsSince(start);
+    return bytes;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode the image from the file opened by probeTimed(). Pixels are streamed from the file, without reading the
+/// whole file into memory first.
+static RawImage decodeTimed(std::ifstream & f, ColorFormat format, ImageLoadTiming & timing) {
+    if (!f.is_open()) return {};
+    auto start = std::chrono::steady_clock::now();
+    f.clear();
+    f.seekg(0, std::ios::beg);
+    auto image    = RawImage::load(f, format);
+    timing.decode = nanosecondsSince(start);
+    return image;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+std::future<RawImage> rg::RawImage::loadAsync(const std::string & filename, ColorFormat format) {
+    auto promise = std::make_shared<std::promise<RawImage>>();
+    auto future  = promise->get_future();
+    runAsync([promise, filename, format] {
+        try {
+            ImageLoadTiming timing;
+            std::ifstream   f;
+            probeTimed(f, filename, format, timing);
+            promise->set_value(decodeTimed(f, format, timing));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::RawImage::loadMany(const std::vector<std::string> & filenames, const LoadCallback & callback,
+                            const ImageLoadOptions & options) {
+    if (filenames.empty()) return;
+    uint32_t threads = options.maxThreads ? options.maxThreads : getMaxWorkerThreads();
+    threads          = (uint32_t)std::min<size_t>(threads, filenames.size());
+
+    std::atomic<size_t>     next {0};
+    std::mutex              budgetMutex, callbackMutex;
+    std::condition_variable budgetCV;
+    size_t                  inFlight = 0, filesInFlight = 0;
+    bool                    failed   = false;
+    std::exception_ptr      error;
+
+    auto run = [&] {
+        for (size_t i = next++; i < filenames.size(); i = next++) {
+            // reserve budget for the decoded image. Files that can't be probed are loaded as if they were empty.
+            ImageLoadTiming timing;
+            std::ifstream   f;
+            size_t          bytes = probeTimed(f, filenames[i], options.format, timing);
+            auto            start = std::chrono::steady_clock::now();
+            {
+                std::unique_lock<std::mutex> lock(budgetMutex);
+                budgetCV.wait(lock, [&] {
+                    return failed || 0 == filesInFlight || inFlight + bytes <= options.maxBytesInFlight;
+                });
+                if (failed) return;
+                inFlight += bytes;
+                ++filesInFlight;
+            }
+            timing.wait = nanosecondsSince(start);
+
+            bool threw = false;
+            try {
+                auto                        image = decodeTimed(f, options.format, timing);
+                std::lock_guard<std::mutex> lock(callbackMutex);
+                if (!error) callback(i, std::move(image), timing);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(callbackMutex);
+                if (!error) error = std::current_exception();
+                threw = true;
+            }
+
+            // release the budget.
+            {
+                std::lock_guard<std::mutex> lock(budgetMutex);
+                inFlight -= bytes;
+                --filesInFlight;
+                failed = failed || threw;
+            }
+            budgetCV.notify_all();
+        }
+    };
+
+    // Each job of the shared worker pool keeps taking files until there's none left. The calling thread runs one of
+    // the jobs.
+    parallelFor(threads, 1, [&](size_t, size_t) { run(); });
+    if (error) std::rethrow_exception(error);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::RawImage::saveKTX2(std::ostream & fp, bool zlib, bool cubemap) const {
+    return KTXWriter(fp).write(_proxy, zlib, cubemap);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::RawImage::saveDDS(std::ostream & fp, bool cubemap) const {
+    DDSWriter dds;
+    return dds.prepare(_proxy, cubemap) && dds.write(fp);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::RawImage::saveDDS(const std::string & filename, bool cubemap) const {
+    DDSWriter dds;
+    if (!dds.prepare(_proxy, cubemap)) return false;
+#if RG_MSWIN
+    std::ofstream f(filename, std::ios::binary);
+    if (!f.good()) {
+        RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+        return false;
+    }
+    return dds.write(f);
+#else
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+        return false;
+    }
+
+    // All chunks go to the kernel with one writev() call, unless there are more than IOV_MAX of them, or the write is
+    // partial. Then the rest are written with more calls.
+    std::vector<iovec> iov;
+    for (const auto & c : dds.chunks()) iov.push_back({const_cast<uint8_t *>(c.data()), c.size()});
+    size_t first = 0;
+    while (first < iov.size()) {
+        auto n = ::writev(fd, iov.data() + first, (int)std::min<size_t>(iov.size() - first, IOV_MAX));
+        if (n < 0) {
+            if (EINTR == errno) continue;
+            int err = errno;
+            ::close(fd);
+            RG_LOGE("Failed to write image file %s : %s", filename.c_str(), errno2str(err));
+            return false;
+        }
+        // skip the chunks that are done, and trim the partially written one.
+        for (auto done = (size_t)n; done > 0;) {
+            auto & v = iov[first];
+            if (done < v.iov_len) {
+                v.iov_base = (uint8_t *)v.iov_base + done;
+                v.iov_len -= done;
+                break;
+            }
+            done -= v.iov_len;
+            ++first;
+        }
+    }
+    if (0 != ::close(fd)) {
+        RG_LOGE("Failed to write image file %s : %s", filename.c_str(), errno2str(errno));
+        return false;
+    }
+    return true;
+#endif
+}
+
+// *********************************************************************************************************************
+// Image probing
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Descriptor of the image that stbLoad() would return.
+template<typename SOURCE>
+static ImageDesc stbProbe(const SOURCE & source) {
+    int x, y, n;
+    if (!source.info(&x, &y, &n)) return {};
+    return stbImageDesc(stbFormat(source.bits(), n), x, y);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+ImageDesc rg::probeImage(std::istream & fp) {
+    auto begin = fp.tellg();
+
+    DDSReader dds(fp);
+    if (dds.checkFormat()) return dds.readHeader();
+
+    fp.clear();
+    fp.seekg(begin, std::ios::beg);
+    KTXReader ktx(fp);
+    if (ktx.checkFormat()) return ktx.readHeader();
+
+    return stbProbe(StbStream {fp, begin});
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+ImageDesc rg::probeImage(const ConstRange<uint8_t> & data) {
+    DDSReader dds(data);
+    if (dds.checkFormat()) return dds.readHeader();
+
+    KTXReader ktx(data);
+    if (ktx.checkFormat()) return ktx.readHeader();
+
+    if (data.size() > (size_t)std::numeric_limits<int>::max()) return {};
+    return stbProbe(StbMemory {data.data(), (int)data.size()});
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+ImageDesc rg::probeImage(const std::string & filename) {
+    std::ifstream f(filename, std::ios::binary);
+    if (!f.good()) {
+        RG_LOGE("Failed to open image file %s : %s", filename.c_str(), errno2str(errno));
+        return {};
+    }
+    return probeImage(f);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+std::vector<ProbedImage> rg::probeImages(const std::string & directory, bool recursive) {
+    // collect files first, then probe them in parallel.
+    std::vector<ProbedImage> files;
+    std::error_code          ec;
+    // iterate with increment(ec), since operator++ throws on errors in the middle of the walk.
+    auto walk = [&](auto it) {
+        for (decltype(it) end; !ec && it != end; it.increment(ec)) {
+            std::error_code fileError; // entries that can't be stat'ed are skipped.
+            if (it->is_regular_file(fileError)) files.push_back({it->path().string(), {}});
+        }
+    };
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    if (recursive) {
+        walk(std::filesystem::recursive_directory_iterator(directory, options, ec));
+    } else {
+        walk(std::filesystem::directory_iterator(directory, options, ec));
+    }
+    if (ec) {
+        RG_LOGE("Failed to list directory %s : %s", directory.c_str(), ec.message().c_str());
+        return {};
+    }
+
+    parallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) files[i].desc = probeImage(files[i].path);
+    });
+
+    files.erase(std::remove_if(files.begin(), files.end(), [](const ProbedImage & f) { return f.desc.empty(); }),
+                files.end());
+    std::sort(files.begin(), files.end(), [](const ProbedImage & a, const ProbedImage & b) { return a.path < b.path; });
+    return files;
 }
@@ -0,0 +1,680 @@
+#include "pch.h"
+#include "ktx.h"
+#include <numeric>
+
+// zlib codec of stb_image and stb_image_write. Both are implemented in image.cpp.
+extern "C" unsigned char * stbi_zlib_compress(unsigned char * data, int data_len, int * out_len, int quality);
+extern "C" int stbi_zlib_decode_buffer(char * obuffer, int olen, const char * ibuffer, int ilen);
+
+using namespace rg;
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint8_t KTX1_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+/// KTX2 supercompression schemes
+enum KTX2Supercompression {
+    KTX2_SUPERCOMPRESSION_NONE = 0,
+    KTX2_SUPERCOMPRESSION_ZLIB = 3,
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Color formats of KTX files: Vulkan format of KTX2, and sized OpenGL internal format of KTX1. When more than one
+/// entry has the same color format, the first one is used for writing.
+struct KTXFormat {
+    ColorFormat format;
+    uint32_t    vkFormat;
+    uint32_t    glInternalFormat;
+};
+
+static const KTXFormat s_ktxFormats[] = {
+    //  rg color format                                                       VkFormat    GL internal format
+    { ColorFormat::R_8_UNORM(),                                               9,          0x8229 }, // R8
+    { ColorFormat::R_8_SNORM(),                                               10,         0x8F94 }, // R8_SNORM
+    { ColorFormat::make(ColorFormat::LAYOUT_8, ColorFormat::SIGN_UINT, ColorFormat::SWIZZLE_R001), 13, 0x8232 }, // R8UI
+    { ColorFormat::make(ColorFormat::LAYOUT_8, ColorFormat::SIGN_SINT, ColorFormat::SWIZZLE_R001), 14, 0x8231 }, // R8I
+    { ColorFormat::RG_8_8_UNORM(),                                            16,         0x822B }, // RG8
+    { ColorFormat::RG_8_8_SNORM(),                                            17,         0x8F95 }, // RG8_SNORM
+    { ColorFormat::RGB_8_8_8_UNORM(),                                         23,         0x8051 }, // RGB8
+    { ColorFormat::RGB_8_8_8_SNORM(),                                         24,         0x8F96 }, // RGB8_SNORM
+    { ColorFormat::BGR_8_8_8_UNORM(),                                         30,         0      },
+    { ColorFormat::RGBA_8_8_8_8_UNORM(),                                      37,         0x8058 }, // RGBA8
+    { ColorFormat::RGBA_8_8_8_8_SNORM(),                                      38,         0x8F97 }, // RGBA8_SNORM
+    { ColorFormat::RGBA_8_8_8_8_UNORM_SRGB(),                                 43,         0x8C43 }, // SRGB8_ALPHA8
+    { ColorFormat::BGRA_8_8_8_8_UNORM(),                                      44,         0      },
+    { ColorFormat::BGR_5_6_5_UNORM(),                                         4,          0x8D62 }, // RGB565
+    { ColorFormat::BGRA_5_5_5_1_UNORM(),                                      8,          0      },
+    { ColorFormat::RGBA_10_10_10_2_UNORM(),                                   64,         0x8059 }, // RGB10_A2
+    { ColorFormat::RGBA_10_10_10_2_UINT(),                                    68,         0x906F }, // RGB10_A2UI
+    { ColorFormat::RGB_11_11_10_FLOAT(),                                      122,        0x8C3A }, // R11F_G11F_B10F
+    { ColorFormat::R_16_UNORM(),                                              70,         0x822A }, // R16
+    { ColorFormat::R_16_SNORM(),                                              71,         0x8F98 }, // R16_SNORM
+    { ColorFormat::R_16_UINT(),                                               74,         0x8234 }, // R16UI
+    { ColorFormat::R_16_SINT(),                                               75,         0x8233 }, // R16I
+    { ColorFormat::R_16_FLOAT(),                                              76,         0x822D }, // R16F
+    { ColorFormat::RG_16_16_UNORM(),                                          77,         0x822C }, // RG16
+    { ColorFormat::RG_16_16_SNORM(),                                          78,         0x8F99 }, // RG16_SNORM
+    { ColorFormat::RG_16_16_UINT(),                                           81,         0x823A }, // RG16UI
+    { ColorFormat::RG_16_16_SINT(),                                           82,         0x8239 }, // RG16I
+    { ColorFormat::RG_16_16_FLOAT(),                                          83,         0x822F }, // RG16F
+    { ColorFormat::RGBA_16_16_16_16_UNORM(),                                  91,         0x805B }, // RGBA16
+    { ColorFormat::RGBA_16_16_16_16_SNORM(),                                  92,         0x8F9B }, // RGBA16_SNORM
+    { ColorFormat::RGBA_16_16_16_16_UINT(),                                   95,         0x8D76 }, // RGBA16UI
+    { ColorFormat::RGBA_16_16_16_16_SINT(),                                   96,         0x8D88 }, // RGBA16I
+    { ColorFormat::RGBA_16_16_16_16_FLOAT(),                                  97,         0x881A }, // RGBA16F
+    { ColorFormat::R_32_UINT(),                                               98,         0x8236 }, // R32UI
+    { ColorFormat::R_32_SINT(),                                               99,         0x8235 }, // R32I
+    { ColorFormat::R_32_FLOAT(),                                              100,        0x822E }, // R32F
+    { ColorFormat::RG_32_32_UINT(),                                           101,        0x823C }, // RG32UI
+    { ColorFormat::RG_32_32_SINT(),                                           102,        0x823B }, // RG32I
+    { ColorFormat::RG_32_32_FLOAT(),                                          103,        0x8230 }, // RG32F
+    { ColorFormat::RGB_32_32_32_UINT(),                                       104,        0x8D71 }, // RGB32UI
+    { ColorFormat::RGB_32_32_32_SINT(),                                       105,        0x8D83 }, // RGB32I
+    { ColorFormat::RGB_32_32_32_FLOAT(),                                      106,        0x8815 }, // RGB32F
+    { ColorFormat::RGBA_32_32_32_32_UINT(),                                   107,        0x8D70 }, // RGBA32UI
+    { ColorFormat::RGBA_32_32_32_32_SINT(),                                   108,        0x8D82 }, // RGBA32I
+    { ColorFormat::RGBA_32_32_32_32_FLOAT(),                                  109,        0x8814 }, // RGBA32F
+    { ColorFormat::DXT1_UNORM(),                                              133,        0x83F1 }, // BC1_RGBA
+    { ColorFormat::DXT1_UNORM(),                                              131,        0x83F0 }, // BC1_RGB
+    { ColorFormat::DXT1_UNORM_SRGB(),                                         134,        0x8C4D }, // BC1_RGBA sRGB
+    { ColorFormat::DXT1_UNORM_SRGB(),                                         132,        0x8C4C }, // BC1_RGB sRGB
+    { ColorFormat::DXT3_UNORM(),                                              135,        0x83F2 }, // BC2
+    { ColorFormat::DXT3_UNORM_SRGB(),                                         136,        0x8C4E }, // BC2 sRGB
+    { ColorFormat::DXT5_UNORM(),                                              137,        0x83F3 }, // BC3
+    { ColorFormat::DXT5_UNORM_SRGB(),                                         138,        0x8C4F }, // BC3 sRGB
+    { ColorFormat::DXT5A_UNORM(),                                             139,        0x8DBB }, // BC4
+    { ColorFormat::DXT5A_SNORM(),                                             140,        0x8DBC }, // BC4 signed
+    { ColorFormat::DXN_UNORM(),                                               141,        0x8DBD }, // BC5
+    { ColorFormat::DXN_SNORM(),                                               142,        0x8DBE }, // BC5 signed
+    { ColorFormat::BC6H_UF16(),                                               143,        0x8E8F }, // BC6H unsigned
+    { ColorFormat::BC6H_SF16(),                                               144,        0x8E8E }, // BC6H signed
+    { ColorFormat::BC7_UNORM(),                                               145,        0x8E8C }, // BC7
+    { ColorFormat::BC7_UNORM_SRGB(),                                          146,        0x8E8D }, // BC7 sRGB
+    { ColorFormat::ETC2_UNORM(),                                              147,        0x9274 }, // ETC2 RGB8
+    { ColorFormat::ETC1_UNORM(),                                              0,          0x8D64 }, // ETC1 RGB8
+    { ColorFormat::ETC2_UNORM_SRGB(),                                         148,        0x9275 }, // ETC2 sRGB8
+    { ColorFormat::ETC2_A1_UNORM(),                                           149,        0x9276 }, // ETC2 RGB8 A1
+    { ColorFormat::ETC2_A1_UNORM_SRGB(),                                      150,        0x9277 }, // ETC2 sRGB8 A1
+    { ColorFormat::ETC2_EAC_UNORM(),                                          151,        0x9278 }, // ETC2 RGBA8
+    { ColorFormat::ETC2_EAC_UNORM_SRGB(),                                     152,        0x9279 }, // ETC2 sRGB8 A8
+    { ColorFormat::EAC_R11_UNORM(),                                           153,        0x9270 }, // EAC R11
+    { ColorFormat::EAC_R11_SNORM(),                                           154,        0x9271 }, // EAC R11 signed
+    { ColorFormat::EAC_RG11_UNORM(),                                          155,        0x9272 }, // EAC RG11
+    { ColorFormat::EAC_RG11_SNORM(),                                          156,        0x9273 }, // EAC RG11 signed
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_4x4),                  157,        0x93B0 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_4x4),             158,        0x93D0 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_5x4),                  159,        0x93B1 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_5x4),             160,        0x93D1 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_5x5),                  161,        0x93B2 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_5x5),             162,        0x93D2 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_6x5),                  163,        0x93B3 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_6x5),             164,        0x93D3 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_6x6),                  165,        0x93B4 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_6x6),             166,        0x93D4 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_8x5),                  167,        0x93B5 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_8x5),             168,        0x93D5 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_8x6),                  169,        0x93B6 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_8x6),             170,        0x93D6 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_8x8),                  171,        0x93B7 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_8x8),             172,        0x93D7 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_10x5),                 173,        0x93B8 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_10x5),            174,        0x93D8 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_10x6),                 175,        0x93B9 },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_10x6),            176,        0x93D9 },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_10x8),                 177,        0x93BA },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_10x8),            178,        0x93DA },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_10x10),                179,        0x93BB },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_10x10),           180,        0x93DB },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_12x10),                181,        0x93BC },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_12x10),           182,        0x93DC },
+    { ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_12x12),                183,        0x93BD },
+    { ColorFormat::ASTC_UNORM_SRGB(ColorFormat::LAYOUT_ASTC_12x12),           184,        0x93DD },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static ColorFormat vkFormat2ColorFormat(uint32_t vkFormat) {
+    for (const auto & f : s_ktxFormats) {
+        if (f.vkFormat && f.vkFormat == vkFormat) return f.format;
+    }
+    if (0 == vkFormat) {
+        RG_LOGE("KTX2 files of VK_FORMAT_UNDEFINED (e.g. Basis Universal) are not supported.");
+    } else {
+        RG_LOGE("unsupported KTX2 format: VkFormat %u", vkFormat);
+    }
+    return ColorFormat::UNKNOWN();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static uint32_t colorFormat2VkFormat(ColorFormat format) {
+    for (const auto & f : s_ktxFormats) {
+        if (f.vkFormat && f.format == format) return f.vkFormat;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Format of KTX1 files. Besides the sized internal formats, 8-bit pixels of unsized internal formats are supported.
+static ColorFormat glFormat2ColorFormat(const KTX1FileHeader & h) {
+    for (const auto & f : s_ktxFormats) {
+        if (f.glInternalFormat && f.glInternalFormat == h.glInternalFormat) return f.format;
+    }
+    if (0x1401 == h.glType) { // GL_UNSIGNED_BYTE
+        switch (h.glInternalFormat) {
+        case 0x1903: return ColorFormat::R_8_UNORM();          // GL_RED
+        case 0x8227: return ColorFormat::RG_8_8_UNORM();       // GL_RG
+        case 0x1907: return ColorFormat::RGB_8_8_8_UNORM();    // GL_RGB
+        case 0x1908: return ColorFormat::RGBA_8_8_8_8_UNORM(); // GL_RGBA
+        case 0x1906: return ColorFormat::A_8_UNORM();          // GL_ALPHA
+        case 0x1909: return ColorFormat::L_8_UNORM();          // GL_LUMINANCE
+        case 0x190A: return ColorFormat::LA_8_8_UNORM();       // GL_LUMINANCE_ALPHA
+        default: break;
+        }
+    }
+    RG_LOGE("unsupported KTX format: glInternalFormat 0x%X, glFormat 0x%X, glType 0x%X", h.glInternalFormat,
+            h.glFormat, h.glType);
+    return ColorFormat::UNKNOWN();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static uint64_t alignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+// *********************************************************************************************************************
+// KTXReader public functions
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool KTXReader::checkFormat() {
+    _begin = _file ? (std::streamoff)_file->tellg() : (std::streamoff)_offset;
+    uint8_t id[12];
+    if (!read(id, sizeof(id))) return false;
+    if (0 == memcmp(id, KTX2_IDENTIFIER, sizeof(id))) {
+        _version = 2;
+    } else if (0 == memcmp(id, KTX1_IDENTIFIER, sizeof(id))) {
+        _version = 1;
+    } else {
+        _version = 0;
+    }
+    return _version > 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const rg::ImageDesc & KTXReader::readHeader() {
+    _imgDesc = {};
+    _levels.clear();
+    bool ok = 2 == _version ? readHeader2() : 1 == _version ? readHeader1() : false;
+    if (!ok) _imgDesc = {};
+    return _imgDesc;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool KTXReader::readPixels(void * buf, size_t size) const { return readPixels(buf, size, {}); }
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+rg::ImageDesc KTXReader::subsetDesc(rg::ImageSubset subset) const {
+    if (!resolve(subset)) return {};
+    return rg::ImageDesc(_imgDesc.plane(subset.firstLayer, subset.firstLevel), subset.layers, subset.levels,
+                         rg::ImageDesc::MIP_MAJOR);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool KTXReader::readPixels(void * o_data, size_t o_size, rg::ImageSubset subset) const {
+    if (!resolve(subset)) return false;
+    auto desc = subsetDesc(subset);
+    if (!o_data) {
+        RG_LOGE("null output buffer.");
+        return false;
+    }
+    if (o_size < desc.size) {
+        RG_LOGE("output buffer size is not large enough");
+        return false;
+    }
+    for (uint32_t m = 0; m < subset.levels; ++m) {
+        if (!readLevel((uint8_t *)o_data, desc, m, subset.firstLevel + m, subset.firstLayer, subset.layers)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// *********************************************************************************************************************
+// KTXReader private functions
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Read bytes from the stream, or copy them from memory.
+bool KTXReader::read(void * buf, size_t size) const {
+    if (_file) return _file->read((char *)buf, (std::streamsize)size) && (size_t)_file->gcount() == size;
+    if (_offset + size > _memory.size()) return false;
+    memcpy(buf, _memory.data() + _offset, size);
+    _offset += size;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Move the read position to the offset from the beginning of the file.
+bool KTXReader::seek(uint64_t offset) const {
+    if (_file) {
+        _file->clear();
+        return (bool)_file->seekg(_begin + (std::streamoff)offset, std::ios::beg);
+    }
+    _offset = (size_t)_begin + (size_t)offset;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Replace zero counts of the subset with all the rest of layers and levels, and check the range.
+bool KTXReader::resolve(rg::ImageSubset & subset) const {
+    if (subset.firstLayer >= _imgDesc.layers || subset.firstLevel >= _imgDesc.levels) {
+        RG_LOGE("image subset is out of range.");
+        return false;
+    }
+    if (0 == subset.layers) subset.layers = _imgDesc.layers - subset.firstLayer;
+    if (0 == subset.levels) subset.levels = _imgDesc.levels - subset.firstLevel;
+    if (subset.layers > _imgDesc.layers - subset.firstLayer || subset.levels > _imgDesc.levels - subset.firstLevel) {
+        RG_LOGE("image subset is out of range.");
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool KTXReader::readHeader2() {
+    KTX2FileHeader h;
+    if (!read(&h, sizeof(h))) {
+        RG_LOGE("fail to read KTX2 file header!");
+        return false;
+    }
+
+    auto format = vkFormat2ColorFormat(h.vkFormat);
+    if (ColorFormat::UNKNOWN() == format) return false;
+
+    if (KTX2_SUPERCOMPRESSION_NONE != h.supercompressionScheme &&
+        KTX2_SUPERCOMPRESSION_ZLIB != h.supercompressionScheme) {
+        RG_LOGE("unsupported KTX2 supercompression scheme: %u", h.supercompressionScheme);
+        return false;
+    }
+    _zlib = KTX2_SUPERCOMPRESSION_ZLIB == h.supercompressionScheme;
+
+    // Cubemap faces of each array layer are stored together, same as the order of our layers.
+    uint32_t layers = std::max(1u, h.layerCount) * std::max(1u, h.faceCount);
+    uint32_t levels = std::max(1u, h.levelCount);
+    _imgDesc = ImageDesc(ImagePlaneDesc::make(format, h.pixelWidth, h.pixelHeight, h.pixelDepth), layers, levels,
+                         ImageDesc::MIP_MAJOR);
+    if (_imgDesc.empty() || _imgDesc.levels != levels) {
+        RG_LOGE("invalid KTX2 image dimension.");
+        return false;
+    }
+
+    // Level index. Level 0 comes first in the index, while it is the last one in the file.
+    _levels.resize(levels);
+    if (!read(_levels.data(), sizeof(Level) * levels)) {
+        RG_LOGE("fail to read KTX2 level index!");
+        return false;
+    }
+    for (uint32_t m = 0; m < levels; ++m) {
+        const auto & p    = _imgDesc.plane(0, m);
+        uint64_t     size = (uint64_t)p.size * layers;
+        const auto & l    = _levels[m];
+        if ((_zlib ? l.uncompressed : l.length) != size) {
+            RG_LOGE("KTX2 level %u has %llu bytes, while %llu bytes are expected.", m,
+                    (unsigned long long)(_zlib ? l.uncompressed : l.length), (unsigned long long)size);
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool KTXReader::readHeader1() {
+    KTX1FileHeader h;
+    if (!read(&h, sizeof(h))) {
+        RG_LOGE("fail to read KTX file header!");
+        return false;
+    }
+    if (0x04030201 != h.endianness) {
+        RG_LOGE("big endian KTX files are not supported.");
+        return false;
+    }
+
+    auto format = glFormat2ColorFormat(h);
+    if (ColorFormat::UNKNOWN() == format) return false;
+
+    uint32_t layers = std::max(1u, h.numberOfArrayElements) * std::max(1u, h.numberOfFaces);
+    uint32_t levels = std::max(1u, h.numberOfMipmapLevels);
+    _imgDesc = ImageDesc(ImagePlaneDesc::make(format, h.pixelWidth, h.pixelHeight, h.pixelDepth), layers, levels,
+                         ImageDesc::MIP_MAJOR);
+    if (_imgDesc.empty() || _imgDesc.levels != levels) {
+        RG_LOGE("invalid KTX image dimension.");
+        return false;
+    }
+
+    // KTX1 has no level index. Each level starts with its size, and rows are 4 bytes aligned. Since rows are aligned,
+    // the cube and mip paddings are always zero.
+    _zlib         = false;
+    _rowAlignment = 4;
+    uint64_t offset = sizeof(KTX1_IDENTIFIER) + sizeof(h) + h.bytesOfKeyValueData;
+    _levels.resize(levels);
+    for (uint32_t m = 0; m < levels; ++m) {
+        const auto & p    = _imgDesc.plane(0, m);
+        uint64_t     rows = (uint64_t)(p.slice / p.pitch) * p.depth;
+        offset += 4; // imageSize
+        _levels[m].offset       = offset;
+        _levels[m].length       = alignUp(p.pitch, _rowAlignment) * rows * layers;
+        _levels[m].uncompressed = _levels[m].length;
+        offset += _levels[m].length;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Read 'layers' layers of one level, starting from 'firstLayer', to level 'dstLevel' of the destination image.
+bool KTXReader::readLevel(uint8_t * dst, const rg::ImageDesc & dstDesc, uint32_t dstLevel, uint32_t level,
+                          uint32_t firstLayer, uint32_t layers) const {
+    const auto & p         = _imgDesc.plane(0, level);
+    const auto & l         = _levels[level];
+    uint64_t     rows      = (uint64_t)(p.slice / p.pitch) * p.depth;
+    uint64_t     fileRow   = alignUp(p.pitch, _rowAlignment);
+    uint64_t     filePlane = fileRow * rows;
+    uint64_t     bytes     = filePlane * layers;
+    uint8_t *    out       = dst + dstDesc.plane(0, dstLevel).offset; // layers of one level are packed together.
+
+    std::vector<uint8_t> temp;
+    const uint8_t *      src = nullptr;
+    if (_zlib) {
+        // supercompressed levels are inflated as a whole.
+        std::vector<uint8_t> compressed((size_t)l.length);
+        if (l.length > INT32_MAX || l.uncompressed > INT32_MAX) {
+            RG_LOGE("KTX2 level %u is too large.", level);
+            return false;
+        }
+        temp.resize((size_t)l.uncompressed);
+        if (!seek(l.offset) || !read(compressed.data(), compressed.size())) {
+            RG_LOGE("failed to read KTX2 pixels.");
+            return false;
+        }
+        int n = stbi_zlib_decode_buffer((char *)temp.data(), (int)temp.size(), (const char *)compressed.data(),
+                                        (int)compressed.size());
+        if (n != (int)temp.size()) {
+            RG_LOGE("failed to inflate KTX2 level %u.", level);
+            return false;
+        }
+        src = temp.data() + filePlane * firstLayer;
+    } else if (fileRow == p.pitch) {
+        // read straight to the destination.
+        if (!seek(l.offset + filePlane * firstLayer) || !read(out, (size_t)bytes)) {
+            RG_LOGE("failed to read KTX pixels.");
+            return false;
+        }
+        return true;
+    } else {
+        temp.resize((size_t)bytes);
+        if (!seek(l.offset + filePlane * firstLayer) || !read(temp.data(), temp.size())) {
+            RG_LOGE("failed to read KTX pixels.");
+            return false;
+        }
+        src = temp.data();
+    }
+
+    // copy rows, dropping the row paddings.
+    for (uint64_t i = 0; i < rows * layers; ++i) memcpy(out + i * p.pitch, src + i * fileRow, p.pitch);
+    return true;
+}
+
+// *********************************************************************************************************************
+// KTXWriter
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Data format descriptor (DFD) of the color format: one basic descriptor block, as defined by the Khronos Data Format
+/// Specification. Uncompressed formats have one sample per channel, and compressed formats have one sample per 64 bits
+/// of the block.
+static std::vector<uint32_t> buildDFD(ColorFormat format) {
+    enum {
+        MODEL_RGBSDA = 1,
+        MODEL_BC1A   = 128,
+        MODEL_BC2    = 129,
+        MODEL_BC3    = 130,
+        MODEL_BC4    = 131,
+        MODEL_BC5    = 132,
+        MODEL_BC6H   = 133,
+        MODEL_BC7    = 134,
+        MODEL_ETC2   = 161,
+        MODEL_ASTC   = 162,
+        CHANNEL_RED   = 0,
+        CHANNEL_GREEN = 1,
+        CHANNEL_BLUE  = 2,
+        CHANNEL_ALPHA = 15,
+        // channel ids of compressed models. Each model has its own set.
+        CHANNEL_BC1A_COLOR        = 0,
+        CHANNEL_BC1A_ALPHAPRESENT = 1,
+        CHANNEL_BC_COLOR          = 0, ///< color of BC2, BC3, BC6H and BC7, data of BC4
+        CHANNEL_BC_ALPHA          = 15,
+        CHANNEL_ETC2_RED          = 0,
+        CHANNEL_ETC2_GREEN        = 1,
+        CHANNEL_ETC2_COLOR        = 2,
+        CHANNEL_ETC2_ALPHA        = 15,
+        CHANNEL_ASTC_DATA         = 0,
+        QUALIFIER_LINEAR   = 0x10,
+        QUALIFIER_SIGNED   = 0x40,
+        QUALIFIER_FLOAT    = 0x80,
+    };
+
+    struct Sample {
+        uint32_t offset, bits, channel, lower, upper;
+    };
+
+    const auto &        ld   = format.layoutDesc();
+    bool                srgb = ColorFormat::SIGN_GNORM == format.sign012;
+    uint32_t            model = MODEL_RGBSDA;
+    std::vector<Sample> samples;
+
+    auto qualifiers = [](uint32_t sign) -> uint32_t {
+        switch (sign) {
+        case ColorFormat::SIGN_SNORM:
+        case ColorFormat::SIGN_SINT: return QUALIFIER_SIGNED;
+        case ColorFormat::SIGN_FLOAT: return QUALIFIER_SIGNED | QUALIFIER_FLOAT;
+        case ColorFormat::SIGN_UFLOAT: return QUALIFIER_FLOAT;
+        default: return 0;
+        }
+    };
+
+    if (ld.blockWidth > 1 || ld.blockHeight > 1) {
+        // Compressed formats have one sample for each 64-bit half of the block, or one for the whole block.
+        struct CompressedModel {
+            uint32_t layout, model, samples, channels[2];
+        };
+        static const CompressedModel s_models[] = {
+            {ColorFormat::LAYOUT_DXT1, MODEL_BC1A, 1, {CHANNEL_BC1A_ALPHAPRESENT}},
+            {ColorFormat::LAYOUT_DXT3, MODEL_BC2, 2, {CHANNEL_BC_ALPHA, CHANNEL_BC_COLOR}},
+            {ColorFormat::LAYOUT_DXT5, MODEL_BC3, 2, {CHANNEL_BC_ALPHA, CHANNEL_BC_COLOR}},
+            {ColorFormat::LAYOUT_DXT5A, MODEL_BC4, 1, {CHANNEL_BC_COLOR}},
+            {ColorFormat::LAYOUT_DXN, MODEL_BC5, 2, {CHANNEL_RED, CHANNEL_GREEN}},
+            {ColorFormat::LAYOUT_BC6H, MODEL_BC6H, 1, {CHANNEL_BC_COLOR}},
+            {ColorFormat::LAYOUT_BC7, MODEL_BC7, 1, {CHANNEL_BC_COLOR}},
+            {ColorFormat::LAYOUT_ETC2, MODEL_ETC2, 1, {CHANNEL_ETC2_COLOR}},
+            {ColorFormat::LAYOUT_ETC2_A1, MODEL_ETC2, 1, {CHANNEL_ETC2_COLOR}},
+            {ColorFormat::LAYOUT_ETC2_EAC, MODEL_ETC2, 2, {CHANNEL_ETC2_ALPHA, CHANNEL_ETC2_COLOR}},
+            {ColorFormat::LAYOUT_EAC_R11, MODEL_ETC2, 1, {CHANNEL_ETC2_RED}},
+            {ColorFormat::LAYOUT_EAC_RG11, MODEL_ETC2, 2, {CHANNEL_ETC2_RED, CHANNEL_ETC2_GREEN}},
+        };
+        CompressedModel m = {format.layout, MODEL_ASTC, 1, {CHANNEL_ASTC_DATA}};
+        for (const auto & i : s_models) {
+            if (i.layout == format.layout) m = i;
+        }
+        // BC1 without alpha has only the color channel.
+        if (ColorFormat::LAYOUT_DXT1 == format.layout && ColorFormat::SWIZZLE_1 == format.swizzle3) {
+            m.channels[0] = CHANNEL_BC1A_COLOR;
+        }
+        model          = m.model;
+        uint32_t q     = qualifiers(format.sign012);
+        uint32_t upper = q & QUALIFIER_FLOAT ? 0x3F800000u : 0xFFFFFFFFu; // 1.0f for float
+        uint32_t bits  = ld.blockBytes * 8u / m.samples;
+        for (uint32_t i = 0; i < m.samples; ++i) samples.push_back({i * bits, bits, m.channels[i] | q, 0, upper});
+    } else {
+        // one sample for each channel that is referenced by the swizzles.
+        const uint32_t swizzles[] = {format.swizzle0, format.swizzle1, format.swizzle2, format.swizzle3};
+        for (uint32_t c = 0; c < ld.numChannels; ++c) {
+            uint32_t component = 4;
+            for (uint32_t i = 0; i < 4 && 4 == component; ++i) {
+                if (swizzles[i] == c) component = i;
+            }
+            if (4 == component) continue;
+            const auto & ch    = ld.channels[c];
+            uint32_t     sign  = 3 == component ? format.sign3 : format.sign012;
+            uint32_t     q     = qualifiers(sign);
+            uint32_t     id    = 3 == component ? (uint32_t)CHANNEL_ALPHA : component;
+            uint32_t     max   = ch.bits >= 32 ? 0xFFFFFFFFu : (1u << ch.bits) - 1;
+            uint32_t     lower = 0, upper = max;
+            if (q & QUALIFIER_FLOAT) {
+                lower = q & QUALIFIER_SIGNED ? 0xBF800000u : 0; // -1.0f
+                upper = 0x3F800000u;                            // 1.0f
+            } else if (ColorFormat::SIGN_SNORM == sign) {
+                upper = max >> 1;
+                lower = (uint32_t)-(int32_t)upper;
+            } else if (ColorFormat::SIGN_UINT == sign || ColorFormat::SIGN_SINT == sign) {
+                upper = 1;
+            }
+            if (srgb && 3 == component) q |= QUALIFIER_LINEAR;
+            samples.push_back({ch.shift, ch.bits, id | q, lower, upper});
+        }
+    }
+
+    uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+    std::vector<uint32_t> dfd;
+    dfd.push_back(4 + blockSize);                       // total size
+    dfd.push_back(0);                                   // vendor id (Khronos), descriptor type (basic)
+    dfd.push_back(2 | (blockSize << 16));               // version, block size
+    dfd.push_back(model | (1u << 8) | ((srgb ? 2u : 1u) << 16)); // model, primaries (BT709), transfer, flags
+    dfd.push_back((uint32_t)(ld.blockWidth - 1) | ((uint32_t)(ld.blockHeight - 1) << 8)); // block dimensions
+    dfd.push_back(ld.blockBytes);                       // bytes of plane 0
+    dfd.push_back(0);                                   // bytes of plane 4-7
+    for (const auto & s : samples) {
+        dfd.push_back(s.offset | ((s.bits - 1) << 16) | (s.channel << 24));
+        dfd.push_back(0); // sample position
+        dfd.push_back(s.lower);
+        dfd.push_back(s.upper);
+    }
+    return dfd;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// KTX2 type size: size of the data type of the format, used for endianness conversion.
+static uint32_t typeSize(ColorFormat format) {
+    const auto & ld = format.layoutDesc();
+    if (ld.blockWidth > 1 || ld.blockHeight > 1) return 1;
+    for (uint32_t c = 1; c < ld.numChannels; ++c) {
+        if (ld.channels[c].bits != ld.channels[0].bits) return ld.blockBytes; // packed format
+    }
+    return ld.channels[0].bits / 8u;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool KTXWriter::write(const rg::ImageProxy & image, bool zlib, bool cubemap) {
+    if (image.empty() || !image.data) {
+        RG_LOGE("Can't save empty image.");
+        return false;
+    }
+    const auto & base     = image.desc.plane(0, 0);
+    uint32_t     vkFormat = colorFormat2VkFormat(base.format);
+    if (!vkFormat) {
+        RG_LOGE("Can't save image as KTX2: color format 0x%X has no Vulkan equivalent.", base.format.u32);
+        return false;
+    }
+    if (base.step != base.format.layoutDesc().pixelBits) {
+        RG_LOGE("Can't save image as KTX2: pixels must be tightly packed.");
+        return false;
+    }
+    if (cubemap && (0 != image.desc.layers % 6 || base.width != base.height || base.depth > 1)) {
+        RG_LOGE("Can't save image as KTX2 cubemap: number of layers must be multiple of 6, and faces must be square.");
+        return false;
+    }
+
+    // Gather pixels of each level: all layers, with tightly packed rows. Then supercompress it, if asked to.
+    const uint32_t                    layers = image.desc.layers;
+    const uint32_t                    levels = image.desc.levels;
+    std::vector<std::vector<uint8_t>> data(levels);
+    std::vector<uint64_t>             uncompressed(levels);
+    for (uint32_t m = 0; m < levels; ++m) {
+        const auto & p     = image.desc.plane(0, m);
+        auto         tight = ImagePlaneDesc::make(p.format, p.width, p.height, p.depth);
+        uint32_t     rows  = tight.slice / tight.pitch;
+        auto &       d     = data[m];
+        d.resize((size_t)tight.size * layers);
+        for (uint32_t i = 0; i < layers; ++i) {
+            const auto & src = image.desc.plane(i, m);
+            for (uint32_t z = 0; z < p.depth; ++z) {
+                for (uint32_t y = 0; y < rows; ++y) {
+                    memcpy(d.data() + (size_t)tight.size * i + tight.slice * z + tight.pitch * y,
+                           image.data + src.offset + (size_t)src.slice * z + (size_t)src.pitch * y, tight.pitch);
+                }
+            }
+        }
+        uncompressed[m] = d.size();
+        if (zlib) {
+            if (d.size() > INT32_MAX) {
+                RG_LOGE("Can't save image as KTX2: level %u is too large to supercompress.", m);
+                return false;
+            }
+            int    n = 0;
+            auto * c = stbi_zlib_compress(d.data(), (int)d.size(), &n, 8);
+            if (!c) {
+                RG_LOGE("Can't save image as KTX2: failed to deflate level %u.", m);
+                return false;
+            }
+            d.assign(c, c + n);
+            free(c);
+        }
+    }
+
+    // layout of the file: header, level index, DFD, then levels from the smallest to the largest.
+    auto                  dfd = buildDFD(base.format);
+    KTX2FileHeader        h   = {};
+    std::vector<uint64_t> index(levels * 3);
+    h.vkFormat               = vkFormat;
+    h.typeSize               = typeSize(base.format);
+    h.pixelWidth             = base.width;
+    h.pixelHeight            = base.height;
+    h.pixelDepth             = base.depth > 1 ? base.depth : 0;
+    h.faceCount              = cubemap ? 6 : 1;
+    h.layerCount             = layers > h.faceCount ? layers / h.faceCount : 0;
+    h.levelCount             = levels;
+    h.supercompressionScheme = zlib ? KTX2_SUPERCOMPRESSION_ZLIB : KTX2_SUPERCOMPRESSION_NONE;
+    h.dfdByteOffset          = (uint32_t)(sizeof(KTX2_IDENTIFIER) + sizeof(h) + index.size() * sizeof(uint64_t));
+    h.dfdByteLength          = (uint32_t)(dfd.size() * sizeof(uint32_t));
+    uint64_t alignment       = zlib ? 1 : std::lcm<uint64_t>(base.format.layoutDesc().blockBytes, 4);
+    uint64_t offset          = h.dfdByteOffset + h.dfdByteLength;
+    for (uint32_t m = levels; m-- > 0;) {
+        offset               = alignUp(offset, alignment);
+        index[m * 3 + 0]     = offset;
+        index[m * 3 + 1]     = data[m].size();
+        index[m * 3 + 2]     = uncompressed[m];
+        offset              += data[m].size();
+    }
+
+    _file.write((const char *)KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    _file.write((const char *)&h, sizeof(h));
+    _file.write((const char *)index.data(), (std::streamsize)(index.size() * sizeof(uint64_t)));
+    _file.write((const char *)dfd.data(), (std::streamsize)h.dfdByteLength);
+    offset = h.dfdByteOffset + h.dfdByteLength;
+    for (uint32_t m = levels; m-- > 0;) {
+        static const char zeros[16] = {};
+        _file.write(zeros, (std::streamsize)(index[m * 3] - offset));
+        _file.write((const char *)data[m].data(), (std::streamsize)data[m].size());
+        offset = index[m * 3] + data[m].size();
+    }
+    if (!_file.good()) {
+        RG_LOGE("Failed to write KTX2 file.");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <rg/base.h>
+#include <iostream>
+
+///
+/// KTX2 file header, right after the 12 bytes identifier. The 64-bit fields are only 4 bytes aligned in the file.
+///
+#pragma pack(push, 4)
+struct KTX2FileHeader {
+    /// \cond NEVER
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+    /// \endcond
+};
+#pragma pack(pop)
+static_assert(sizeof(KTX2FileHeader) == 68);
+
+///
+/// KTX (version 1) file header, right after the 12 bytes identifier.
+///
+struct KTX1FileHeader {
+    /// \cond NEVER
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+    /// \endcond
+};
+static_assert(sizeof(KTX1FileHeader) == 52);
+
+///
+/// KTX2 and KTX (version 1) image reader. Images are described in MIP_MAJOR order, since both versions store all
+/// layers and faces of one level together. Cubemap faces are layers, as in DDS.
+///
+class KTXReader {
+    /// location of one level in the file
+    struct Level {
+        uint64_t offset;       ///< offset from the beginning of the file
+        uint64_t length;       ///< bytes of the level in the file
+        uint64_t uncompressed; ///< bytes of the level after zlib decompression
+    };
+
+    std::istream *          _file = nullptr;
+    rg::ConstRange<uint8_t> _memory;      ///< the KTX file in memory, if there's no stream.
+    mutable size_t          _offset = 0;  ///< read position in _memory
+    std::streamoff          _begin  = 0;  ///< position of the beginning of the file in the stream
+    uint32_t                _version = 0; ///< 1 or 2, set by checkFormat()
+    bool                    _zlib    = false;
+    uint32_t                _rowAlignment = 1; ///< KTX1 pads rows of uncompressed formats to 4 bytes
+    std::vector<Level>      _levels;
+    rg::ImageDesc           _imgDesc;
+
+    bool read(void * buf, size_t size) const;
+    bool seek(uint64_t offset) const;
+    bool resolve(rg::ImageSubset & subset) const;
+    bool readHeader2();
+    bool readHeader1();
+    bool readLevel(uint8_t * dst, const rg::ImageDesc & dstDesc, uint32_t dstLevel, uint32_t level,
+                   uint32_t firstLayer, uint32_t layers) const;
+
+public:
+
+    ///
+    /// Construct a reader of KTX file stream.
+    ///
+    KTXReader(std::istream & f) : _file(&f) {}
+
+    ///
+    /// Construct a reader of KTX file in memory.
+    ///
+    KTXReader(const rg::ConstRange<uint8_t> & memory) : _memory(memory) {}
+
+    ///
+    /// Check file format. Return true if the file is KTX2 or KTX file.
+    ///
+    bool checkFormat();
+
+    ///
+    /// Read KTX header and the level index.
+    ///
+    const rg::ImageDesc & readHeader();
+
+    ///
+    /// Read KTX image.
+    ///
+    bool readPixels(void * buf, size_t size) const;
+
+    ///
+    /// Returns descriptor of a subset of the image, in MIP_MAJOR order. Returns an empty descriptor if the subset is
+    /// out of range. Call after readHeader().
+    ///
+    rg::ImageDesc subsetDesc(rg::ImageSubset subset) const;
+
+    ///
+    /// Read pixels of a subset of the image, as described by subsetDesc(). Levels are located with the level index,
+    /// so only the levels of the subset are read. Zlib supercompressed levels are read and inflated as a whole.
+    ///
+    bool readPixels(void * buf, size_t size, rg::ImageSubset subset) const;
+};
+
+///
+/// KTX2 image writer
+///
+class KTXWriter {
+    std::ostream & _file;
+
+public:
+
+    ///
+    /// Constructor
+    ///
+    KTXWriter(std::ostream & f) : _file(f) {}
+
+    ///
+    /// Write the image as KTX2 file. Optionally, each level is supercompressed with zlib. If 'cubemap' is true, every
+    /// 6 layers are faces of one cubemap. Returns false if the color format has no Vulkan equivalent.
+    ///
+    bool write(const rg::ImageProxy & image, bool zlib = false, bool cubemap = false);
+};
@@ -0,0 +1,254 @@
+#include "pch.h"
+#include "resample.h"
+#include "thread-pool.h"
+#include <cmath>
+
+using namespace rg;
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// View of one mipmap level of all layers, as an image of 1 level. Plane offsets are kept, so the view shares pixels
+/// with the image.
+static ImageProxy levelView(const ImageProxy & image, uint32_t level) {
+    ImageProxy view;
+    view.desc.layers = image.desc.layers;
+    view.desc.levels = 1;
+    view.desc.size   = image.desc.size;
+    for (uint32_t i = 0; i < image.desc.layers; ++i) view.desc.planes.push_back(image.desc.plane(i, level));
+    view.data = image.data;
+    return view;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Float4 image of one level of all layers, backed by 'pixels'. Layers are tightly packed one after another.
+static ImageProxy float4Image(std::vector<float4> & pixels, uint32_t layers, uint32_t width, uint32_t height) {
+    ImageProxy image;
+    image.desc = ImageDesc(ImagePlaneDesc::make(ColorFormat::FLOAT4(), width, height), layers, 1);
+    pixels.resize(image.desc.size / sizeof(float4));
+    image.data = (uint8_t *)pixels.data();
+    return image;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Run proc(pixel) on all pixels in parallel.
+template<typename PROC>
+static void forEachPixel(float4 * pixels, size_t count, PROC proc) {
+    parallelFor(count, 64 * 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) proc(pixels[i]);
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// How normals are stored in channels of a color format.
+struct NormalEncoding {
+    bool biased; ///< UNORM channels store n * 0.5 + 0.5
+    bool hasZ;   ///< false if only x and y are stored
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static NormalEncoding getNormalEncoding(ColorFormat format) {
+    return {ColorFormat::SIGN_UNORM == format.sign012, format.swizzle2 <= ColorFormat::SWIZZLE_W};
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert stored normals to unit vectors in xyz. Alpha is untouched.
+static void decodeNormals(float4 * pixels, size_t count, NormalEncoding e) {
+    forEachPixel(pixels, count, [e](float4 & p) {
+        if (e.biased) {
+            p.x = p.x * 2.0f - 1.0f;
+            p.y = p.y * 2.0f - 1.0f;
+            p.z = e.hasZ ? p.z * 2.0f - 1.0f : p.z;
+        }
+        if (!e.hasZ) p.z = std::sqrt(std::max(0.0f, 1.0f - p.x * p.x - p.y * p.y));
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Normalize xyz of the filtered normals. Normals that cancel each other out become (0, 0, 1).
+static void renormalize(float4 * pixels, size_t count) {
+    forEachPixel(pixels, count, [](float4 & p) {
+        float len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        if (len > 1e-6f) {
+            p.x /= len;
+            p.y /= len;
+            p.z /= len;
+        } else {
+            p.x = p.y = 0.0f;
+            p.z       = 1.0f;
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The reverse of decodeNormals().
+static void encodeNormals(float4 * pixels, size_t count, NormalEncoding e) {
+    forEachPixel(pixels, count, [e](float4 & p) {
+        if (!e.biased) return;
+        p.x = p.x * 0.5f + 0.5f;
+        p.y = p.y * 0.5f + 0.5f;
+        p.z = p.z * 0.5f + 0.5f;
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Fraction of pixels that pass the alpha test, after alpha is scaled.
+static float alphaCoverage(const float4 * pixels, size_t count, float reference, float scale) {
+    size_t passed = 0;
+    for (size_t i = 0; i < count; ++i) passed += pixels[i].w * scale >= reference;
+    return (float)passed / (float)count;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Binary search the alpha scale that gives the expected coverage. Coverage only grows with the scale, so the search
+/// first doubles the upper bound until it reaches the coverage, then narrows down the range.
+static float searchAlphaScale(const float4 * pixels, size_t count, float reference, float coverage) {
+    float lo = 0.0f, hi = 1.0f;
+    while (alphaCoverage(pixels, count, reference, hi) < coverage && hi < 1024.0f) hi *= 2.0f;
+    for (int i = 0; i < 16; ++i) {
+        float mid = (lo + hi) * 0.5f;
+        if (alphaCoverage(pixels, count, reference, mid) < coverage) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    // pick the closer one of the two bounds.
+    float clo = alphaCoverage(pixels, count, reference, lo);
+    float chi = alphaCoverage(pixels, count, reference, hi);
+    return std::abs(clo - coverage) < std::abs(chi - coverage) ? lo : hi;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Mipmaps of volume textures. Each level is filtered in all 3 dimensions from the stored pixels of the previous level,
+/// which are converted to/from float4 row by row. A float4 copy of a large volume wouldn't fit in memory.
+static bool generateVolumeMipmaps(ImageProxy & image, const MipmapOptions & options) {
+    const auto & base = image.desc.plane(0, 0);
+    if (MipmapMode::COLOR != options.mode) {
+        RG_LOGE("Only COLOR mode is supported by mipmap generation of volume textures.");
+        return false;
+    }
+    const PixelConversion * toFloat4   = getPixelConversion(base.format, ColorFormat::FLOAT4());
+    const PixelConversion * fromFloat4 = getPixelConversion(ColorFormat::FLOAT4(), base.format);
+    if (!toFloat4 || !fromFloat4) {
+        RG_LOGE("Mipmap generation of compressed volume textures is not supported.");
+        return false;
+    }
+
+    for (uint32_t m = 1; m < image.desc.levels; ++m) {
+        const auto &            sp = image.desc.plane(0, m - 1);
+        const auto &            dp = image.desc.plane(0, m);
+        auto                    wx = getFilterWeights(sp.width, dp.width, options.filter);
+        auto                    wy = getFilterWeights(sp.height, dp.height, options.filter);
+        auto                    wz = getFilterWeights(sp.depth, dp.depth, options.filter);
+        std::vector<Resampling> jobs(image.desc.layers);
+        for (uint32_t i = 0; i < image.desc.layers; ++i) {
+            auto & r   = jobs[i];
+            r.x        = wx.get();
+            r.y        = wy.get();
+            r.z        = wz.get();
+            r.src      = image.pixel(i, m - 1);
+            r.srcSlice = sp.slice;
+            r.srcPitch = sp.pitch;
+            r.srcStep  = sp.step / 8;
+            r.srcConv  = toFloat4;
+            r.dst      = image.pixel(i, m);
+            r.dstSlice = dp.slice;
+            r.dstPitch = dp.pitch;
+            r.dstStep  = dp.step / 8;
+            r.dstConv  = fromFloat4;
+        }
+        resampleRows(jobs);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::generateMipmaps(ImageProxy & image, const MipmapOptions & options) {
+    if (image.empty() || !image.data) {
+        RG_LOGE("Can't generate mipmaps of empty image.");
+        return false;
+    }
+    if (image.desc.levels < 2) return true;
+    const auto & base = image.desc.plane(0, 0);
+    if (base.depth > 1) return generateVolumeMipmaps(image, options);
+
+    // Each level is filtered from the float4 (linear) pixels of the previous level, instead of the stored pixels, so
+    // the error of the storage format doesn't accumulate down the chain. In COLOR mode, uncompressed base levels are
+    // read in place, and converted to float4 row by row. Otherwise, the base level is converted to a float4 image
+    // first, which is also where the special modes prepare their pixels.
+    const uint32_t          layers     = image.desc.layers;
+    const size_t            basePixels = (size_t)base.width * base.height;
+    const NormalEncoding    encoding   = getNormalEncoding(base.format);
+    const PixelConversion * toFloat4   = nullptr;
+    if (MipmapMode::COLOR == options.mode) toFloat4 = getPixelConversion(base.format, ColorFormat::FLOAT4());
+    std::vector<float4>     prev, next, output;
+    std::vector<float>      coverage(layers);
+    ImageProxy              src;
+    if (!toFloat4) {
+        src = float4Image(prev, layers, base.width, base.height);
+        if (!convert(levelView(image, 0), src)) return false;
+        if (MipmapMode::NORMAL_MAP == options.mode) decodeNormals(prev.data(), prev.size(), encoding);
+        if (MipmapMode::ALPHA_COVERAGE == options.mode) {
+            parallelFor(layers, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    coverage[i] = alphaCoverage(prev.data() + i * basePixels, basePixels, options.alphaReference, 1.0f);
+                }
+            });
+        }
+    }
+
+    for (uint32_t m = 1; m < image.desc.levels; ++m) {
+        const auto & sp  = image.desc.plane(0, m - 1);
+        const auto & dp  = image.desc.plane(0, m);
+        auto         wx  = getFilterWeights(sp.width, dp.width, options.filter);
+        auto         wy  = getFilterWeights(sp.height, dp.height, options.filter);
+        ImageProxy   dst = float4Image(next, layers, dp.width, dp.height);
+
+        std::vector<Resampling> jobs(layers);
+        const bool              inPlace = 1 == m && toFloat4;
+        for (uint32_t i = 0; i < layers; ++i) {
+            auto & r   = jobs[i];
+            r.x        = wx.get();
+            r.y        = wy.get();
+            r.src      = inPlace ? image.pixel(i, 0) : src.pixel(i, 0);
+            r.srcPitch = inPlace ? sp.pitch : sp.width * sizeof(float4);
+            r.srcStep  = inPlace ? sp.step / 8 : sizeof(float4);
+            r.srcConv  = inPlace ? toFloat4 : nullptr;
+            r.dst      = dst.pixel(i, 0);
+            r.dstPitch = dp.width * sizeof(float4);
+            r.dstStep  = sizeof(float4);
+            r.dstConv  = nullptr;
+        }
+        resampleRows(jobs);
+
+        // Special modes adjust a copy of the level for output, so the next level is still filtered from the pure
+        // filtered pixels. Except that normals are renormalized in place: the next level filters unit vectors.
+        ImageProxy out = dst;
+        if (MipmapMode::NORMAL_MAP == options.mode) {
+            renormalize(next.data(), next.size());
+            output = next;
+            encodeNormals(output.data(), output.size(), encoding);
+            out.data = (uint8_t *)output.data();
+        } else if (MipmapMode::ALPHA_COVERAGE == options.mode) {
+            output            = next;
+            out.data          = (uint8_t *)output.data();
+            const size_t size = (size_t)dp.width * dp.height;
+            parallelFor(layers, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    float4 * p     = output.data() + i * size;
+                    float    scale = searchAlphaScale(p, size, options.alphaReference, coverage[i]);
+                    for (size_t j = 0; j < size; ++j) p[j].w = std::min(1.0f, p[j].w * scale);
+                }
+            });
+        }
+
+        ImageProxy level = levelView(image, m);
+        if (!convert(out, level, options.quality)) return false;
+
+        // the new level is the source of the next one.
+        std::swap(prev, next);
+        src = std::move(dst);
+    }
+    return true;
+}
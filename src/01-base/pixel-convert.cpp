@@ -0,0 +1,1189 @@
+#include "pch.h"
+#include "pixel-convert.h"
+#include "block-codec.h"
+#include <array>
+#include <cmath>
+
+using namespace rg;
+
+// *********************************************************************************************************************
+// Channel helpers
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// reinterpret bits of 32-bit unsigned integer as float
+static inline float castToFloat(uint32_t u32) {
+    float f;
+    memcpy(&f, &u32, sizeof(f));
+    return f;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// reinterpret bits of float as 32-bit unsigned integer
+static inline uint32_t castToUInt(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Zero, denormals, infinity and NaN are all preserved. Signaling NaN is converted to quiet NaN, as hardware does.
+float rg::halfToFloat(uint16_t h) {
+    uint32_t sign = ((uint32_t)h & 0x8000u) << 16;
+    uint32_t u    = ((uint32_t)h & 0x7fffu) << 13; // exponent and mantissa
+    uint32_t exp  = u & 0x0f800000u;               // exponent only
+    u += (127u - 15u) << 23;                       // adjust exponent bias
+    if (0x0f800000u == exp) {
+        u += (128u - 16u) << 23;                   // Inf/NaN
+        if (u & 0x007fffffu) u |= 0x00400000u;     // quiet the NaN
+    } else if (0 == exp) {
+        u += 1u << 23;                             // zero and denormal, renormalize it.
+        u = castToUInt(castToFloat(u) - castToFloat(113u << 23));
+    }
+    return castToFloat(u | sign);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// This is based on float_to_half_fast3_rtne() from https://gist.github.com/rygorous/2156668, with NaN handling
+// changed to match F16C and NEON: keep the upper bits of the payload and set the quiet bit.
+uint16_t rg::floatToHalf(float value) {
+    const uint32_t f32infty     = 255u << 23;
+    const uint32_t f16max       = (127u + 16u) << 23;
+    const uint32_t denormMagic  = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+    uint32_t f    = castToUInt(value);
+    uint32_t sign = f & 0x80000000u;
+    uint32_t o;
+    f ^= sign;
+    if (f >= f16max) {
+        // result is Inf or NaN
+        o = (f > f32infty) ? (0x7e00u | ((f >> 13) & 0x3ffu)) : 0x7c00u;
+    } else if (f < (113u << 23)) {
+        // result is denormal or zero. Use a magic value to align the 10 mantissa bits at the bottom of the float.
+        // As long as float addition is round-to-nearest-even, this just works.
+        o = castToUInt(castToFloat(f) + castToFloat(denormMagic)) - denormMagic;
+    } else {
+        uint32_t mantOdd = (f >> 13) & 1u;
+        f += ((uint32_t)(15 - 127) << 23) + 0xfffu; // update exponent, rounding bias part 1
+        f += mantOdd;                               // rounding bias part 2
+        o = f >> 13;
+    }
+    return (uint16_t)(o | (sign >> 16));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert unsigned small float (5 bits exponent, no sign bit) to 32-bit float.
+/// \param mantissa Number of mantissa bits. 6 for 11-bit float, 5 for 10-bit float.
+static inline float smallFloatToFloat(uint32_t value, uint32_t mantissa) {
+    // Small float has the same exponent layout as half float. So just shift the mantissa into half float position.
+    return halfToFloat((uint16_t)((value << (10 - mantissa)) & 0x7fffu));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert normalized float to 8-bit unsigned integer. NaN is converted to 0.
+static inline uint8_t floatToUNorm8(float f) {
+    f = f > 0.f ? (f < 1.f ? f : 1.f) : 0.f;
+    return (uint8_t)(f * 255.0f + 0.5f);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert normalized float to unsigned integer of arbitrary width. NaN is converted to 0. Channels wider than 16 bits
+/// are computed in double, since float can't represent the scaled value precisely.
+static inline uint32_t floatToUNorm(float f, uint32_t mask) {
+    f = f > 0.f ? (f < 1.f ? f : 1.f) : 0.f;
+    if (mask <= 0xFFFF) return (uint32_t)(f * (float)mask + 0.5f);
+    return (uint32_t)((double)f * (double)mask + 0.5);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert float to unsigned integer, round to nearest and clamp to [0, mask]. NaN is converted to 0.
+static inline uint32_t floatToUInt(float f, uint32_t mask) {
+    double d = f > 0.f ? (double)f + 0.5 : 0.0;
+    return d < (double)mask ? (uint32_t)d : mask;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert float to unsigned small float (5 bits exponent, no sign bit), round to nearest even. Negative values are
+/// clamped to 0.
+/// \param mantissa Number of mantissa bits. 6 for 11-bit float, 5 for 10-bit float.
+static inline uint32_t floatToSmallFloat(float value, uint32_t mantissa) {
+    uint32_t f     = castToUInt(value);
+    uint32_t shift = 23 - mantissa;
+    if ((f & 0x7fffffffu) > 0x7f800000u) {
+        // NaN: keep the upper bits of the payload and set the quiet bit.
+        return (0x1fu << mantissa) | (1u << (mantissa - 1)) | ((f >> shift) & ((1u << mantissa) - 1));
+    }
+    if (f & 0x80000000u) return 0;                           // negative, including -Inf.
+    if (f >= ((127u + 16u) << 23)) return 0x1fu << mantissa; // too large, convert to Inf.
+    if (f < (113u << 23)) {
+        // denormal or zero. Same magic as floatToHalf().
+        uint32_t magic = ((127u - 15u) + shift + 1u) << 23;
+        return castToUInt(castToFloat(f) + castToFloat(magic)) - magic;
+    }
+    uint32_t mantOdd = (f >> shift) & 1u;
+    f += ((uint32_t)(15 - 127) << 23) + (1u << (shift - 1)) - 1u + mantOdd;
+    return f >> shift;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Store value of one channel to the pixel bits. The channel may cross the 64-bit boundary.
+static inline void storeBits(uint64_t bits[2], uint32_t shift, uint32_t width, uint32_t value) {
+    if (shift >= 64) {
+        bits[1] |= (uint64_t)value << (shift - 64);
+    } else {
+        bits[0] |= (uint64_t)value << shift;
+        if (shift + width > 64) bits[1] |= (uint64_t)value >> (64 - shift);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// returns mask of the lowest 'width' bits.
+static inline uint32_t widthMask(uint32_t width) {
+    return width < 32 ? ((1u << width) - 1) : 0xFFFFFFFFu;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Sign extend a two's complement integer of 'width' bits.
+static inline int32_t signExtend(uint32_t value, uint32_t width) {
+    uint32_t shift = 32 - width;
+    return (int32_t)(value << shift) >> shift;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// sRGB curve, with both input and output in [0, 1].
+static inline double srgbToLinear(double s) {
+    return s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// inverse sRGB curve, with both input and output in [0, 1].
+static inline double linearToSRGB(double l) {
+    return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Lookup tables of sRGB conversion.
+///
+/// Encoding to 8-bit is piecewise: floats in [2^-16, 1) are split into 2048 buckets by their top exponent and mantissa
+/// bits (128 buckets per octave). Each bucket stores the sRGB code of its lower bound. The buckets are small enough
+/// that at most one code boundary falls into any of them, so one compare against the boundary table finishes the job.
+struct SRGBTables {
+    static constexpr uint32_t ENCODE_MIN_BITS = (127u - 16u) << 23; ///< bits of 2^-16, the lowest bucket.
+    static constexpr uint32_t ENCODE_BUCKETS  = 16 * 128;
+
+    float   decode8[256];                 ///< 8-bit sRGB -> linear float
+    uint8_t decode8To8[256];              ///< 8-bit sRGB -> 8-bit linear unorm
+    float   decode16[65536];              ///< 16-bit sRGB -> linear float
+    uint8_t encodeStart[ENCODE_BUCKETS];  ///< sRGB code at the lower bound of each bucket
+    float   encodeBoundary[256];          ///< linear value where code k + 1 starts. The last one is never reached.
+
+    SRGBTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            decode8[i]    = (float)srgbToLinear(i / 255.0);
+            decode8To8[i] = (uint8_t)(decode8[i] * 255.0f + 0.5f);
+        }
+        for (uint32_t i = 0; i < 65536; ++i) decode16[i] = (float)srgbToLinear(i / 65535.0);
+        for (uint32_t i = 0; i < 255; ++i) encodeBoundary[i] = (float)srgbToLinear((i + 0.5) / 255.0);
+        encodeBoundary[255] = 2.0f;
+        uint32_t code = 0;
+        for (uint32_t i = 0; i < ENCODE_BUCKETS; ++i) {
+            float lower = castToFloat(ENCODE_MIN_BITS + (i << 16));
+            while (lower >= encodeBoundary[code]) ++code;
+            encodeStart[i] = (uint8_t)code;
+            RG_ASSERT(castToFloat(ENCODE_MIN_BITS + ((i + 1) << 16)) <= encodeBoundary[std::min(code + 1, 255u)]);
+        }
+    }
+
+    static const SRGBTables & get() {
+        static const SRGBTables t;
+        return t;
+    }
+
+    /// linear float -> 8-bit sRGB. NaN is converted to 0.
+    uint8_t encode8(float f) const {
+        if (!(f >= castToFloat(ENCODE_MIN_BITS))) return 0;
+        if (f >= 1.0f) return 255;
+        uint32_t code = encodeStart[(castToUInt(f) - ENCODE_MIN_BITS) >> 16];
+        return (uint8_t)(code + (f >= encodeBoundary[code] ? 1 : 0));
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode signed normalized integer. Both the minimal and the minimal + 1 value map to -1.
+static inline float snormToFloat(uint32_t value, uint32_t width) {
+    float f = (float)signExtend(value, width) * (1.0f / (float)((1u << (width - 1)) - 1));
+    return f < -1.0f ? -1.0f : f;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode biased normalized integer: [0, mask] maps to [-1, 1].
+static inline float bnormToFloat(uint32_t value, uint32_t width) {
+    return (float)value * (2.0f / (float)widthMask(width)) - 1.0f;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode gamma (sRGB) normalized integer to linear float.
+static inline float gnormToFloat(uint32_t value, uint32_t width) {
+    if (8 == width) return SRGBTables::get().decode8[value];
+    if (16 == width) return SRGBTables::get().decode16[value];
+    return (float)srgbToLinear((double)value / (double)widthMask(width));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Decode biased integer: [0, mask] maps to [-2^(width-1), 2^(width-1) - 1].
+static inline float bintToFloat(uint32_t value, uint32_t width) {
+    return (float)((int64_t)value - ((int64_t)1 << (width - 1)));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode float to signed normalized integer, round to nearest. NaN is converted to 0.
+static inline uint32_t floatToSNorm(float f, uint32_t width) {
+    if (std::isnan(f)) return 0;
+    f        = f > -1.f ? (f < 1.f ? f : 1.f) : -1.f;
+    double d = (double)f * (double)((1u << (width - 1)) - 1);
+    return (uint32_t)(int32_t)(d < 0 ? d - 0.5 : d + 0.5) & widthMask(width);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode float to signed integer, round to nearest and clamp to the range of the integer. NaN is converted to 0.
+static inline uint32_t floatToSInt(float f, uint32_t width) {
+    if (std::isnan(f)) return 0;
+    double lo = -(double)(1ull << (width - 1));
+    double hi = (double)((1ull << (width - 1)) - 1);
+    double d  = f < 0 ? (double)f - 0.5 : (double)f + 0.5;
+    d         = d < lo ? lo : (d > hi ? hi : d);
+    return (uint32_t)(int32_t)d & widthMask(width);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline uint32_t floatToBInt(float f, uint32_t width) {
+    return (floatToSInt(f, width) + (1u << (width - 1))) & widthMask(width);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static inline uint32_t floatToBNorm(float f, uint32_t width) {
+    return floatToUNorm((f + 1.0f) * 0.5f, widthMask(width));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Encode linear float to gamma (sRGB) normalized integer. NaN is converted to 0.
+static inline uint32_t floatToGNorm(float f, uint32_t width) {
+    if (8 == width) return SRGBTables::get().encode8(f);
+    f = f > 0.f ? (f < 1.f ? f : 1.f) : 0.f;
+    return floatToUNorm((float)linearToSRGB(f), widthMask(width));
+}
+
+// *********************************************************************************************************************
+// Channel extraction
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Extract channel bits of pixels. Each pixel is read with one fixed sized load of BYTES bytes starting from 'src'.
+template<uint32_t BYTES>
+static void extractChannelBytes(uint32_t * dst, const uint8_t * src, size_t count, size_t step, uint32_t shift,
+                                uint32_t mask) {
+    for (size_t i = 0; i < count; ++i, src += step) {
+        uint64_t v = 0;
+        memcpy(&v, src, BYTES);
+        dst[i] = (uint32_t)(v >> shift) & mask;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarExtractChannel(uint32_t * dst, const uint8_t * src, size_t count, size_t step, uint32_t pixelBytes,
+                                 uint32_t shift, uint32_t bits) {
+    // A channel of up to 32 bits spans no more than 5 bytes, wherever it is in the pixel. Round that up to power of 2,
+    // which is a single machine load, as long as the pixel is large enough. The load window is moved backward when it
+    // would go past the end of the pixel.
+    uint32_t first = shift / 8;
+    uint32_t bytes = (shift % 8 + bits + 7) / 8;
+    uint32_t load  = bytes <= 2 ? bytes : (bytes <= 4 ? 4 : 8);
+    shift %= 8;
+    if (load <= pixelBytes) {
+        if (first + load > pixelBytes) {
+            shift += (first + load - pixelBytes) * 8;
+            first = pixelBytes - load;
+        }
+        bytes = load;
+    }
+    const uint32_t mask = widthMask(bits);
+    src += first;
+    switch (bytes) {
+        case 1: extractChannelBytes<1>(dst, src, count, step, shift, mask); break;
+        case 2: extractChannelBytes<2>(dst, src, count, step, shift, mask); break;
+        case 3: extractChannelBytes<3>(dst, src, count, step, shift, mask); break;
+        case 4: extractChannelBytes<4>(dst, src, count, step, shift, mask); break;
+        case 5: extractChannelBytes<5>(dst, src, count, step, shift, mask); break;
+        default: extractChannelBytes<8>(dst, src, count, step, shift, mask); break;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarKernelExtractChannel(uint32_t * dst, const uint8_t * src, size_t count, uint32_t pixelBytes,
+                                       uint32_t shift, uint32_t bits) {
+    scalarExtractChannel(dst, src, count, pixelBytes, pixelBytes, shift, bits);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::extractChannel(uint32_t * dst, const uint8_t * src, size_t count, size_t step, uint32_t pixelBytes,
+                        uint32_t shift, uint32_t bits) {
+    RG_ASSERT(0 < bits && bits <= 32 && pixelBytes <= 16 && shift + bits <= pixelBytes * 8);
+    if (step == pixelBytes) {
+        getFastRowKernels().extractChannel(dst, src, count, pixelBytes, shift, bits);
+    } else {
+        scalarExtractChannel(dst, src, count, step, pixelBytes, shift, bits);
+    }
+}
+
+// *********************************************************************************************************************
+// Generic pixel conversion. This handles all non-compressed formats, at the cost of a lot of runtime branches per pixel.
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert one color channel to float, based on the channel format/sign
+/// \param value The channel value
+/// \param width The number of valid bits in that value
+/// \param sign  The channel's data format
+static inline float tofloat(uint32_t value, uint32_t width, ColorFormat::Sign sign) {
+    uint32_t mask = width < 32 ? ((1u << width) - 1) : 0xFFFFFFFFu;
+    value &= mask;
+    switch(sign) {
+        case ColorFormat::SIGN_UNORM:
+            return (float)value * (1.0f / (float)mask);
+
+        case ColorFormat::SIGN_FLOAT:
+            if (width == 32) {
+                return castToFloat(value);
+            } else if (width == 16) {
+                return halfToFloat((uint16_t)value);
+            } else if (width == 11) {
+                return smallFloatToFloat(value, 6);
+            } else if (width == 10) {
+                return smallFloatToFloat(value, 5);
+            } else {
+                RG_THROW("unsupported yet.");
+            }
+
+        case ColorFormat::SIGN_UINT:
+        case ColorFormat::SIGN_GINT: // gamma has no meaning w/o normalization.
+            return (float)value;
+
+        case ColorFormat::SIGN_SNORM:
+            return snormToFloat(value, width);
+
+        case ColorFormat::SIGN_GNORM:
+            return gnormToFloat(value, width);
+
+        case ColorFormat::SIGN_BNORM:
+            return bnormToFloat(value, width);
+
+        case ColorFormat::SIGN_SINT:
+            return (float)signExtend(value, width);
+
+        case ColorFormat::SIGN_BINT:
+            return bintToFloat(value, width);
+
+        default:
+            RG_THROW("invalid sign: %d", sign);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert one color channel to 8-bit unsigned normalized integer.
+static inline uint8_t tounorm8(uint32_t value, uint32_t width, ColorFormat::Sign sign) {
+    if (ColorFormat::SIGN_UNORM == sign) {
+        // Use integer math to avoid rounding error of float.
+        uint64_t mask = (((uint64_t)1) << width) - 1;
+        return (uint8_t)(((value & mask) * 255 + mask / 2) / mask);
+    } else if (ColorFormat::SIGN_GNORM == sign && 8 == width) {
+        return SRGBTables::get().decode8To8[value & 0xFF];
+    } else {
+        return floatToUNorm8(tofloat(value, width, sign));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert float to one color channel. This is the reverse of tofloat().
+static inline uint32_t fromfloat(float value, uint32_t width, ColorFormat::Sign sign) {
+    uint32_t mask = width < 32 ? ((1u << width) - 1) : 0xFFFFFFFFu;
+    switch(sign) {
+        case ColorFormat::SIGN_UNORM:
+            return floatToUNorm(value, mask);
+
+        case ColorFormat::SIGN_FLOAT:
+            if (width == 32) {
+                return castToUInt(value);
+            } else if (width == 16) {
+                return floatToHalf(value);
+            } else if (width == 11) {
+                return floatToSmallFloat(value, 6);
+            } else if (width == 10) {
+                return floatToSmallFloat(value, 5);
+            } else {
+                RG_THROW("unsupported yet.");
+            }
+
+        case ColorFormat::SIGN_UINT:
+        case ColorFormat::SIGN_GINT:
+            return floatToUInt(value, mask);
+
+        case ColorFormat::SIGN_SNORM:
+            return floatToSNorm(value, width);
+
+        case ColorFormat::SIGN_GNORM:
+            return floatToGNorm(value, width);
+
+        case ColorFormat::SIGN_BNORM:
+            return floatToBNorm(value, width);
+
+        case ColorFormat::SIGN_SINT:
+            return floatToSInt(value, width);
+
+        case ColorFormat::SIGN_BINT:
+            return floatToBInt(value, width);
+
+        default:
+            RG_THROW("invalid sign: %d", sign);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert float4 to pixel of arbitrary format. Channels that are not referenced by the swizzles are set to zero.
+/// Do not support compressed format.
+static inline void convertFromFloat4(const ColorFormat::LayoutDesc & ld, const ColorFormat & format, void * pixel,
+                                     const float4 & color) {
+    RG_ASSERT(1 == ld.blockWidth && 1 == ld.blockHeight); // do not support compressed format.
+    const float    components[] = { color.x, color.y, color.z, color.w };
+    const uint32_t swizzles[]   = { format.swizzle0, format.swizzle1, format.swizzle2, format.swizzle3 };
+    uint64_t       bits[2]      = {};
+    for (uint32_t c = 0; c < ld.numChannels; ++c) {
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (swizzles[i] != c) continue;
+            const auto & ch   = ld.channels[c];
+            auto         sign = (ColorFormat::Sign)((c < 3) ? format.sign012 : format.sign3);
+            storeBits(bits, ch.shift, ch.bits, fromfloat(components[i], ch.bits, sign));
+            break;
+        }
+    }
+    memcpy(pixel, bits, ld.blockBytes);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Number of pixels that the generic converters process at a time. Channels are extracted and converted one batch at a
+/// time, so that the per channel setup and branches are paid once per batch, instead of once per pixel.
+static constexpr size_t GENERIC_BATCH = 64;
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void genericRowToFloat4(ColorFormat format, float4 * dst, const uint8_t * src, size_t count, size_t step) {
+    const auto &   ld          = format.layoutDesc();
+    const uint32_t swizzles[4] = { format.swizzle0, format.swizzle1, format.swizzle2, format.swizzle3 };
+    uint32_t       values[GENERIC_BATCH];
+    for (size_t begin = 0; begin < count; begin += GENERIC_BATCH) {
+        size_t n = std::min(count - begin, GENERIC_BATCH);
+        float4 * d = dst + begin;
+        for (uint32_t i = 0; i < 4; ++i) {
+            uint32_t s = swizzles[i];
+            if (s >= ld.numChannels || 0 == ld.channels[s].bits) {
+                float constant = ColorFormat::SWIZZLE_1 == s ? 1.f : 0.f;
+                for (size_t k = 0; k < n; ++k) (&d[k].x)[i] = constant;
+                continue;
+            }
+            const auto & ch   = ld.channels[s];
+            auto         sign = (ColorFormat::Sign)((s < 3) ? format.sign012 : format.sign3);
+            extractChannel(values, src + begin * step, n, step, ld.blockBytes, ch.shift, ch.bits);
+            for (size_t k = 0; k < n; ++k) (&d[k].x)[i] = tofloat(values[k], ch.bits, sign);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void genericRowToRGBA8(ColorFormat format, RGBA8 * dst, const uint8_t * src, size_t count, size_t step) {
+    const auto &   ld          = format.layoutDesc();
+    const uint32_t swizzles[4] = { format.swizzle0, format.swizzle1, format.swizzle2, format.swizzle3 };
+    uint32_t       values[GENERIC_BATCH];
+    for (size_t begin = 0; begin < count; begin += GENERIC_BATCH) {
+        size_t n = std::min(count - begin, GENERIC_BATCH);
+        RGBA8 * d = dst + begin;
+        for (uint32_t i = 0; i < 4; ++i) {
+            uint32_t s = swizzles[i];
+            if (s >= ld.numChannels || 0 == ld.channels[s].bits) {
+                uint8_t constant = ColorFormat::SWIZZLE_1 == s ? 255 : 0;
+                for (size_t k = 0; k < n; ++k) (&d[k].x)[i] = constant;
+                continue;
+            }
+            const auto & ch   = ld.channels[s];
+            auto         sign = (ColorFormat::Sign)((s < 3) ? format.sign012 : format.sign3);
+            extractChannel(values, src + begin * step, n, step, ld.blockBytes, ch.shift, ch.bits);
+            for (size_t k = 0; k < n; ++k) (&d[k].x)[i] = tounorm8(values[k], ch.bits, sign);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void genericRowFromFloat4(ColorFormat format, uint8_t * dst, const float4 * src, size_t count, size_t step) {
+    const auto & ld = format.layoutDesc();
+    for (size_t i = 0; i < count; ++i, dst += step) {
+        convertFromFloat4(ld, format, dst, src[i]);
+    }
+}
+
+// *********************************************************************************************************************
+// Compile-time specialized pixel conversion.
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Conversion of one color channel, with bit width and sign known at compile time.
+template<uint32_t BITS, uint32_t SIGN>
+struct ChannelConverter {
+    static constexpr uint32_t MASK = (uint32_t)((((uint64_t)1) << BITS) - 1);
+
+    static inline float toFloat(uint32_t value) {
+        if constexpr (ColorFormat::SIGN_UNORM == SIGN) {
+            return (float)value * (1.0f / (float)MASK);
+        } else if constexpr (ColorFormat::SIGN_UINT == SIGN || ColorFormat::SIGN_GINT == SIGN) {
+            return (float)value;
+        } else if constexpr (ColorFormat::SIGN_SNORM == SIGN) {
+            return snormToFloat(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_GNORM == SIGN) {
+            return gnormToFloat(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_BNORM == SIGN) {
+            return bnormToFloat(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_SINT == SIGN) {
+            return (float)signExtend(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_BINT == SIGN) {
+            return bintToFloat(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 32 == BITS) {
+            return castToFloat(value);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 16 == BITS) {
+            return halfToFloat((uint16_t)value);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 11 == BITS) {
+            return smallFloatToFloat(value, 6);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 10 == BITS) {
+            return smallFloatToFloat(value, 5);
+        } else {
+            static_assert(AlwaysFalse<std::integral_constant<uint32_t, BITS>, std::integral_constant<uint32_t, SIGN>>);
+        }
+    }
+
+    static inline uint8_t toUNorm8(uint32_t value) {
+        if constexpr (ColorFormat::SIGN_UNORM == SIGN && 8 == BITS) {
+            return (uint8_t)value;
+        } else if constexpr (ColorFormat::SIGN_UNORM == SIGN) {
+            return (uint8_t)(((uint64_t)value * 255 + MASK / 2) / MASK);
+        } else if constexpr (ColorFormat::SIGN_GNORM == SIGN && 8 == BITS) {
+            return SRGBTables::get().decode8To8[value];
+        } else {
+            return floatToUNorm8(toFloat(value));
+        }
+    }
+
+    static inline uint32_t fromFloat(float value) {
+        if constexpr (ColorFormat::SIGN_UNORM == SIGN) {
+            return floatToUNorm(value, MASK);
+        } else if constexpr (ColorFormat::SIGN_UINT == SIGN || ColorFormat::SIGN_GINT == SIGN) {
+            return floatToUInt(value, MASK);
+        } else if constexpr (ColorFormat::SIGN_SNORM == SIGN) {
+            return floatToSNorm(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_GNORM == SIGN) {
+            return floatToGNorm(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_BNORM == SIGN) {
+            return floatToBNorm(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_SINT == SIGN) {
+            return floatToSInt(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_BINT == SIGN) {
+            return floatToBInt(value, BITS);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 32 == BITS) {
+            return castToUInt(value);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 16 == BITS) {
+            return floatToHalf(value);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 11 == BITS) {
+            return floatToSmallFloat(value, 6);
+        } else if constexpr (ColorFormat::SIGN_FLOAT == SIGN && 10 == BITS) {
+            return floatToSmallFloat(value, 5);
+        } else {
+            static_assert(AlwaysFalse<std::integral_constant<uint32_t, BITS>, std::integral_constant<uint32_t, SIGN>>);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Row converters specialized for one color format. Template arguments are the layout, signs and swizzles of the
+/// format. The swizzles are packed in the same way as ColorFormat::Swizzle4.
+template<uint32_t LAYOUT, uint32_t SIGN012, uint32_t SIGN3, uint32_t SWIZZLE>
+struct SpecializedRowConverters {
+    static constexpr const ColorFormat::LayoutDesc & LD = ColorFormat::LAYOUTS[LAYOUT];
+    static_assert(1 == LD.blockWidth && 1 == LD.blockHeight, "compressed format is not supported.");
+
+    /// returns source channel index of the destination channel.
+    static constexpr uint32_t swizzle(uint32_t dstChannel) { return (SWIZZLE >> (dstChannel * 3)) & 7; }
+
+    /// returns sign of the source channel.
+    static constexpr uint32_t sign(uint32_t srcChannel) { return srcChannel < 3 ? SIGN012 : SIGN3; }
+
+    /// returns the format of this specialization
+    static constexpr ColorFormat format() {
+        return ColorFormat::make((ColorFormat::Layout)LAYOUT, (ColorFormat::Sign)SIGN012, (ColorFormat::Sign)SIGN3,
+            (ColorFormat::Swizzle)swizzle(0), (ColorFormat::Swizzle)swizzle(1),
+            (ColorFormat::Swizzle)swizzle(2), (ColorFormat::Swizzle)swizzle(3));
+    }
+
+    /// Load one source channel from the pixel. Only touches bytes that the channel occupies.
+    template<uint32_t CH>
+    static inline uint32_t load(const uint8_t * pixel) {
+        constexpr auto     shift = LD.channels[CH].shift;
+        constexpr auto     bits  = LD.channels[CH].bits;
+        constexpr uint32_t first = shift / 8;
+        constexpr uint32_t bytes = (shift % 8 + bits + 7) / 8;
+        static_assert(0 < bits && bits <= 32 && bytes <= 8 && first + bytes <= LD.blockBytes);
+        uint64_t v = 0;
+        memcpy(&v, pixel + first, bytes);
+        return (uint32_t)((v >> (shift % 8)) & ChannelConverter<bits, sign(CH)>::MASK);
+    }
+
+    template<uint32_t DST>
+    static inline float channelToFloat(const uint8_t * pixel) {
+        constexpr uint32_t s = swizzle(DST);
+        if constexpr (ColorFormat::SWIZZLE_0 == s) {
+            return 0.f;
+        } else if constexpr (ColorFormat::SWIZZLE_1 == s) {
+            return 1.f;
+        } else {
+            return ChannelConverter<LD.channels[s].bits, sign(s)>::toFloat(load<s>(pixel));
+        }
+    }
+
+    template<uint32_t DST>
+    static inline uint8_t channelToUNorm8(const uint8_t * pixel) {
+        constexpr uint32_t s = swizzle(DST);
+        if constexpr (ColorFormat::SWIZZLE_0 == s) {
+            return 0;
+        } else if constexpr (ColorFormat::SWIZZLE_1 == s) {
+            return 255;
+        } else {
+            return ChannelConverter<LD.channels[s].bits, sign(s)>::toUNorm8(load<s>(pixel));
+        }
+    }
+
+    /// returns the destination channel that is stored in the source channel, or 4 if there's none.
+    static constexpr uint32_t component(uint32_t srcChannel) {
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (swizzle(i) == srcChannel) return i;
+        }
+        return 4;
+    }
+
+    /// Encode one channel and store it to the pixel bits.
+    template<uint32_t CH>
+    static inline void storeChannel(uint64_t bits[2], const float4 & color) {
+        if constexpr (CH < LD.numChannels && component(CH) < 4) {
+            constexpr auto shift = LD.channels[CH].shift;
+            constexpr auto width = LD.channels[CH].bits;
+            const float    value = (&color.x)[component(CH)];
+            storeBits(bits, shift, width, ChannelConverter<width, sign(CH)>::fromFloat(value));
+        }
+    }
+
+    static void scalarToFloat4(float4 * dst, const uint8_t * src, size_t count, size_t step) {
+        for (size_t i = 0; i < count; ++i, src += step) {
+            dst[i] = { channelToFloat<0>(src), channelToFloat<1>(src), channelToFloat<2>(src), channelToFloat<3>(src) };
+        }
+    }
+
+    static void scalarToRGBA8(RGBA8 * dst, const uint8_t * src, size_t count, size_t step) {
+        if constexpr (ColorFormat::LAYOUT_8_8_8_8 == LAYOUT && ColorFormat::SIGN_UNORM == SIGN012 &&
+                      ColorFormat::SIGN_UNORM == SIGN3 && ColorFormat::SWIZZLE_RGBA == SWIZZLE) {
+            if (sizeof(RGBA8) == step) {
+                memcpy(dst, src, count * sizeof(RGBA8));
+                return;
+            }
+        }
+        for (size_t i = 0; i < count; ++i, src += step) {
+            dst[i] = { channelToUNorm8<0>(src), channelToUNorm8<1>(src), channelToUNorm8<2>(src), channelToUNorm8<3>(src) };
+        }
+    }
+
+    static void scalarFromFloat4(uint8_t * dst, const float4 * src, size_t count, size_t step) {
+        for (size_t i = 0; i < count; ++i, dst += step) {
+            uint64_t bits[2] = {};
+            storeChannel<0>(bits, src[i]);
+            storeChannel<1>(bits, src[i]);
+            storeChannel<2>(bits, src[i]);
+            storeChannel<3>(bits, src[i]);
+            memcpy(dst, bits, LD.blockBytes);
+        }
+    }
+
+    static void toFloat4(ColorFormat, float4 * dst, const uint8_t * src, size_t count, size_t step) {
+        scalarToFloat4(dst, src, count, step);
+    }
+
+    static void toRGBA8(ColorFormat, RGBA8 * dst, const uint8_t * src, size_t count, size_t step) {
+        scalarToRGBA8(dst, src, count, step);
+    }
+
+    static void fromFloat4(ColorFormat, uint8_t * dst, const float4 * src, size_t count, size_t step) {
+        scalarFromFloat4(dst, src, count, step);
+    }
+
+    static constexpr PixelRowConverters make() {
+        return { format(), true, &toFloat4, &toRGBA8, &fromFloat4 };
+    }
+
+    /// Make converters that go through the fast row kernel whenever pixels are tightly packed. Set the kernel
+    /// to nullptr to always use the scalar path in that direction.
+    template<auto TO_FLOAT4, auto TO_RGBA8, auto FROM_FLOAT4>
+    static constexpr PixelRowConverters makeFast() {
+        return { format(), true, &fastToFloat4<TO_FLOAT4>, &fastToRGBA8<TO_RGBA8>, &fastFromFloat4<FROM_FLOAT4> };
+    }
+
+private:
+
+    template<auto KERNEL>
+    static void fastToFloat4(ColorFormat, float4 * dst, const uint8_t * src, size_t count, size_t step) {
+        if constexpr (!std::is_same_v<decltype(KERNEL), std::nullptr_t>) {
+            if (LD.blockBytes == step) {
+                if constexpr (std::is_member_pointer_v<decltype(KERNEL)>) {
+                    (getFastRowKernels().*KERNEL)(dst, src, count);
+                } else {
+                    KERNEL(dst, src, count);
+                }
+                return;
+            }
+        }
+        scalarToFloat4(dst, src, count, step);
+    }
+
+    template<auto KERNEL>
+    static void fastToRGBA8(ColorFormat, RGBA8 * dst, const uint8_t * src, size_t count, size_t step) {
+        if constexpr (!std::is_same_v<decltype(KERNEL), std::nullptr_t>) {
+            if (LD.blockBytes == step) {
+                if constexpr (std::is_member_pointer_v<decltype(KERNEL)>) {
+                    (getFastRowKernels().*KERNEL)(dst, src, count);
+                } else {
+                    KERNEL(dst, src, count);
+                }
+                return;
+            }
+        }
+        scalarToRGBA8(dst, src, count, step);
+    }
+
+    template<auto KERNEL>
+    static void fastFromFloat4(ColorFormat, uint8_t * dst, const float4 * src, size_t count, size_t step) {
+        if constexpr (!std::is_same_v<decltype(KERNEL), std::nullptr_t>) {
+            if (LD.blockBytes == step) {
+                KERNEL(dst, src, count);
+                return;
+            }
+        }
+        scalarFromFloat4(dst, src, count, step);
+    }
+};
+
+/// Type of specialized row converters of the color format.
+#define RG_SPECIALIZED_TYPE(name)                                             \
+    SpecializedRowConverters<                                                 \
+        ColorFormat::name().layout,                                           \
+        ColorFormat::name().sign012,                                          \
+        ColorFormat::name().sign3,                                            \
+        (ColorFormat::name().swizzle0 << 0) | (ColorFormat::name().swizzle1 << 3) | \
+        (ColorFormat::name().swizzle2 << 6) | (ColorFormat::name().swizzle3 << 9)>
+
+/// Fast kernel of RGBA_16_16_16_16_FLOAT -> float4, which is just half -> float conversion of the whole row.
+static void halfToFloat4(float4 * dst, const uint8_t * src, size_t count) {
+    getFastRowKernels().halfToFloat((float *)dst, (const uint16_t *)src, count * 4);
+}
+
+/// Fast kernel of RGBA_32_32_32_32_FLOAT -> RGBA8
+static void float4ToRGBA8(RGBA8 * dst, const uint8_t * src, size_t count) {
+    getFastRowKernels().float4ToRGBA8(dst, (const float4 *)src, count);
+}
+
+/// Fast kernel of float4 -> RGBA_8_8_8_8_UNORM
+static void rgba8FromFloat4(uint8_t * dst, const float4 * src, size_t count) {
+    getFastRowKernels().float4ToRGBA8((RGBA8 *)dst, src, count);
+}
+
+/// Fast kernel of float4 -> RGBA_16_16_16_16_FLOAT
+static void halfFromFloat4(uint8_t * dst, const float4 * src, size_t count) {
+    getFastRowKernels().floatToHalf((uint16_t *)dst, (const float *)src, count * 4);
+}
+
+/// Instantiate specialized row converters from name of the color format.
+#define RG_SPECIALIZED_ROW_CONVERTERS(name) RG_SPECIALIZED_TYPE(name)::make()
+
+/// Instantiate specialized row converters that use fast row kernels for tightly packed pixels.
+#define RG_FAST_ROW_CONVERTERS(name, toFloat4, toRGBA8, fromFloat4) \
+    RG_SPECIALIZED_TYPE(name)::makeFast<toFloat4, toRGBA8, fromFloat4>()
+
+/// All color formats that have specialized row converters. Formats that are not in this list go through the
+/// generic path.
+static constexpr PixelRowConverters SPECIALIZED_CONVERTERS[] = {
+    RG_SPECIALIZED_ROW_CONVERTERS(R_8_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_8_SNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(L_8_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(A_8_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGB_3_3_2_UNORM),
+    RG_FAST_ROW_CONVERTERS(BGRA_4_4_4_4_UNORM, nullptr, &FastRowKernels::bgra4444ToRGBA8, nullptr),
+    RG_SPECIALIZED_ROW_CONVERTERS(BGRX_4_4_4_4_UNORM),
+    RG_FAST_ROW_CONVERTERS(BGR_5_6_5_UNORM, nullptr, &FastRowKernels::bgr565ToRGBA8, nullptr),
+    RG_FAST_ROW_CONVERTERS(BGRA_5_5_5_1_UNORM, nullptr, &FastRowKernels::bgra5551ToRGBA8, nullptr),
+    RG_SPECIALIZED_ROW_CONVERTERS(BGRX_5_5_5_1_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_8_8_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_8_8_SNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(LA_8_8_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_16_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_16_SNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_16_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_16_SINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_16_FLOAT),
+    RG_SPECIALIZED_ROW_CONVERTERS(L_16_UNORM),
+    RG_FAST_ROW_CONVERTERS(RGB_8_8_8_UNORM, nullptr, &FastRowKernels::rgb8ToRGBA8, nullptr),
+    RG_SPECIALIZED_ROW_CONVERTERS(BGR_8_8_8_UNORM),
+    RG_FAST_ROW_CONVERTERS(RGBA_8_8_8_8_UNORM, &FastRowKernels::rgba8ToFloat4, nullptr, &rgba8FromFloat4),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_8_8_8_8_UNORM_SRGB),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_8_8_8_8_SNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBX_8_8_8_8_UNORM),
+    RG_FAST_ROW_CONVERTERS(BGRA_8_8_8_8_UNORM, nullptr, &FastRowKernels::swapRB8888, nullptr),
+    RG_SPECIALIZED_ROW_CONVERTERS(BGRX_8_8_8_8_UNORM),
+    RG_FAST_ROW_CONVERTERS(RGBA_10_10_10_2_UNORM, &FastRowKernels::rgb10a2ToFloat4, &FastRowKernels::rgb10a2ToRGBA8, nullptr),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_10_10_10_2_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_10_10_10_SNORM_2_UNORM),
+    RG_FAST_ROW_CONVERTERS(RGB_11_11_10_FLOAT, &FastRowKernels::rg11b10fToFloat4, nullptr, nullptr),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_16_16_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_16_16_SNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_16_16_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_16_16_FLOAT),
+    RG_SPECIALIZED_ROW_CONVERTERS(LA_16_16_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_32_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_32_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_32_SINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(R_32_FLOAT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_24_UNORM_8_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(XG_24_8_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_16_16_16_16_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_16_16_16_16_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_16_16_16_16_SNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_16_16_16_16_SINT),
+    RG_FAST_ROW_CONVERTERS(RGBA_16_16_16_16_FLOAT, &halfToFloat4, nullptr, &halfFromFloat4),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBX_16_16_16_16_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_32_32_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_32_32_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RG_32_32_FLOAT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RXX_32_8_24_FLOAT),
+    RG_SPECIALIZED_ROW_CONVERTERS(XGX_32_8_24_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGB_32_32_32_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGB_32_32_32_UINT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGB_32_32_32_FLOAT),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_32_32_32_32_UNORM),
+    RG_SPECIALIZED_ROW_CONVERTERS(RGBA_32_32_32_32_UINT),
+    RG_FAST_ROW_CONVERTERS(RGBA_32_32_32_32_FLOAT, nullptr, &float4ToRGBA8, nullptr),
+};
+
+#undef RG_FAST_ROW_CONVERTERS
+#undef RG_SPECIALIZED_ROW_CONVERTERS
+
+static constexpr PixelRowConverters GENERIC_CONVERTERS = {
+    ColorFormat::UNKNOWN(), false, &genericRowToFloat4, &genericRowToRGBA8, &genericRowFromFloat4
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const PixelRowConverters & rg::getPixelRowConverters(ColorFormat format) {
+    // sort the specialized converters by format, to allow binary search.
+    static const std::vector<const PixelRowConverters *> sorted = []{
+        std::vector<const PixelRowConverters *> v;
+        for (const auto & c : SPECIALIZED_CONVERTERS) v.push_back(&c);
+        std::sort(v.begin(), v.end(), [](auto a, auto b) { return a->format < b->format; });
+        return v;
+    }();
+    auto iter = std::lower_bound(sorted.begin(), sorted.end(), format, [](auto a, auto b) { return a->format < b; });
+    if (iter != sorted.end() && (*iter)->format == format) return **iter;
+    return GENERIC_CONVERTERS;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const PixelRowConverters & rg::getGenericPixelRowConverters() {
+    return GENERIC_CONVERTERS;
+}
+
+// *********************************************************************************************************************
+// Format to format conversion
+// *********************************************************************************************************************
+
+/// number of pixels converted in one batch, when going through float4.
+static constexpr size_t CONVERSION_BATCH = 256;
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The 2-hop route: source -> float4 -> destination. This works for any pair of row convertible formats.
+static void convertRowThroughFloat4(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src,
+                                    size_t srcStep, size_t count) {
+    float4 temp[CONVERSION_BATCH];
+    while (count > 0) {
+        size_t n = std::min(count, CONVERSION_BATCH);
+        c.srcRow->toFloat4(c.src, temp, src, n, srcStep);
+        c.dstRow->fromFloat4(c.dst, dst, temp, n, dstStep);
+        src += n * srcStep;
+        dst += n * dstStep;
+        count -= n;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void copyRow(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src, size_t srcStep,
+                    size_t count) {
+    size_t bytes = c.src.bytesPerBlock();
+    if (bytes == srcStep && bytes == dstStep) {
+        memcpy(dst, src, count * bytes);
+    } else {
+        for (size_t i = 0; i < count; ++i, dst += dstStep, src += srcStep) memcpy(dst, src, bytes);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void convertRowToRGBA8(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src,
+                              size_t srcStep, size_t count) {
+    if (sizeof(RGBA8) == dstStep) {
+        c.srcRow->toRGBA8(c.src, (RGBA8 *)dst, src, count, srcStep);
+    } else {
+        convertRowThroughFloat4(c, dst, dstStep, src, srcStep, count);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void convertRowToFloat4(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src,
+                               size_t srcStep, size_t count) {
+    if (sizeof(float4) == dstStep) {
+        c.srcRow->toFloat4(c.src, (float4 *)dst, src, count, srcStep);
+    } else {
+        convertRowThroughFloat4(c, dst, dstStep, src, srcStep, count);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void convertRowFromFloat4(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src,
+                                 size_t srcStep, size_t count) {
+    if (sizeof(float4) == srcStep) {
+        c.dstRow->fromFloat4(c.dst, dst, (const float4 *)src, count, dstStep);
+    } else {
+        convertRowThroughFloat4(c, dst, dstStep, src, srcStep, count);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void swapRB8888Row(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src,
+                          size_t srcStep, size_t count) {
+    if (4 == srcStep && 4 == dstStep) {
+        getFastRowKernels().swapRB8888((RGBA8 *)dst, src, count);
+    } else {
+        convertRowThroughFloat4(c, dst, dstStep, src, srcStep, count);
+    }
+}
+
+/// Direct conversions between specific pair of formats. Conversions from/to RGBA8 and float4 are always direct,
+/// thus not listed here.
+static constexpr struct {
+    ColorFormat src;
+    ColorFormat dst;
+    void (*convertRow)(const PixelConversion &, uint8_t *, size_t, const uint8_t *, size_t, size_t);
+} DIRECT_CONVERSIONS[] = {
+    { ColorFormat::RGBA_8_8_8_8_UNORM(), ColorFormat::BGRA_8_8_8_8_UNORM(), &swapRB8888Row },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::isRowConvertible(ColorFormat format) {
+    const auto & ld = format.layoutDesc();
+    if (1 != ld.blockWidth || 1 != ld.blockHeight) return false;
+    const uint32_t swizzles[] = { format.swizzle0, format.swizzle1, format.swizzle2, format.swizzle3 };
+    for (auto s : swizzles) {
+        if (s >= ld.numChannels) continue; // constant 0/1, or channel that doesn't exist.
+        auto bits = ld.channels[s].bits;
+        auto sign = (ColorFormat::Sign)((s < 3) ? format.sign012 : format.sign3);
+        if (0 == bits || bits > 32) return false;
+        if (ColorFormat::SIGN_FLOAT == sign && 32 != bits && 16 != bits && 11 != bits && 10 != bits) return false;
+        if (sign > ColorFormat::SIGN_FLOAT) return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const PixelConversion * rg::getPixelConversion(ColorFormat src, ColorFormat dst) {
+    static std::mutex                        mutex;
+    static std::map<uint64_t, PixelConversion> registry;
+
+    uint64_t                    key = ((uint64_t)src.u32 << 32) | dst.u32;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        iter = registry.find(key);
+    if (iter != registry.end()) return &iter->second;
+
+    if (!isRowConvertible(src) || !isRowConvertible(dst)) return nullptr;
+
+    PixelConversion c = { src, dst, true, &getPixelRowConverters(src), &getPixelRowConverters(dst), nullptr };
+    if (src == dst) {
+        c.convertRow = &copyRow;
+    } else if (ColorFormat::RGBA_8_8_8_8_UNORM() == dst) {
+        c.convertRow = &convertRowToRGBA8;
+    } else if (ColorFormat::RGBA_32_32_32_32_FLOAT() == dst) {
+        c.convertRow = &convertRowToFloat4;
+    } else if (ColorFormat::RGBA_32_32_32_32_FLOAT() == src) {
+        c.convertRow = &convertRowFromFloat4;
+    } else {
+        for (const auto & d : DIRECT_CONVERSIONS) {
+            if (d.src == src && d.dst == dst) c.convertRow = d.convertRow;
+        }
+        if (!c.convertRow) {
+            c.direct     = false;
+            c.convertRow = &convertRowThroughFloat4;
+        }
+    }
+    return &registry.emplace(key, c).first->second;
+}
+
+// *********************************************************************************************************************
+// Fast row kernels
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Scalar fast kernel built on top of the specialized row converter of the format.
+template<typename CONVERTERS>
+static void scalarKernelToFloat4(float4 * dst, const uint8_t * src, size_t count) {
+    CONVERTERS::scalarToFloat4(dst, src, count, CONVERTERS::LD.blockBytes);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Scalar fast kernel built on top of the specialized row converter of the format.
+template<typename CONVERTERS>
+static void scalarKernelToRGBA8(RGBA8 * dst, const uint8_t * src, size_t count) {
+    CONVERTERS::scalarToRGBA8(dst, src, count, CONVERTERS::LD.blockBytes);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarFloat4ToRGBA8(RGBA8 * dst, const float4 * src, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const float4 c = src[i];
+        dst[i] = { floatToUNorm8(c.x), floatToUNorm8(c.y), floatToUNorm8(c.z), floatToUNorm8(c.w) };
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarHalfToFloat(float * dst, const uint16_t * src, size_t count) {
+    for (size_t i = 0; i < count; ++i) dst[i] = halfToFloat(src[i]);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarFloatToHalf(uint16_t * dst, const float * src, size_t count) {
+    for (size_t i = 0; i < count; ++i) dst[i] = floatToHalf(src[i]);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarFilterFloat4H(float4 * dst, const float4 * src, const uint32_t * first, const float * weights,
+                                size_t taps, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const float4 * s = src + first[i];
+        const float *  w = weights + i * taps;
+        float4         c = {0, 0, 0, 0};
+        for (size_t k = 0; k < taps; ++k) {
+            c.x += w[k] * s[k].x;
+            c.y += w[k] * s[k].y;
+            c.z += w[k] * s[k].z;
+            c.w += w[k] * s[k].w;
+        }
+        dst[i] = c;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void scalarFilterFloat4V(float4 * dst, const float4 * const * rows, const float * weights, size_t taps,
+                                size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        float4 c = {0, 0, 0, 0};
+        for (size_t k = 0; k < taps; ++k) {
+            const float4 & s = rows[k][i];
+            c.x += weights[k] * s.x;
+            c.y += weights[k] * s.y;
+            c.z += weights[k] * s.z;
+            c.w += weights[k] * s.w;
+        }
+        dst[i] = c;
+    }
+}
+
+static constexpr FastRowKernels SCALAR_KERNELS = {
+    &scalarKernelToFloat4<RG_SPECIALIZED_TYPE(RGBA_8_8_8_8_UNORM)>,
+    &scalarFloat4ToRGBA8,
+    &scalarKernelToRGBA8<RG_SPECIALIZED_TYPE(BGRA_8_8_8_8_UNORM)>,
+    &scalarKernelToRGBA8<RG_SPECIALIZED_TYPE(RGB_8_8_8_UNORM)>,
+    &scalarKernelToRGBA8<RG_SPECIALIZED_TYPE(BGR_5_6_5_UNORM)>,
+    &scalarKernelToRGBA8<RG_SPECIALIZED_TYPE(BGRA_5_5_5_1_UNORM)>,
+    &scalarKernelToRGBA8<RG_SPECIALIZED_TYPE(BGRA_4_4_4_4_UNORM)>,
+    &scalarKernelToFloat4<RG_SPECIALIZED_TYPE(RGBA_10_10_10_2_UNORM)>,
+    &scalarKernelToRGBA8<RG_SPECIALIZED_TYPE(RGBA_10_10_10_2_UNORM)>,
+    &scalarKernelToFloat4<RG_SPECIALIZED_TYPE(RGB_11_11_10_FLOAT)>,
+    &scalarHalfToFloat,
+    &scalarFloatToHalf,
+    &scalarKernelExtractChannel,
+    &decodeBC1Scalar,
+    &encodeBC1Scalar,
+    &interpolateBC7Scalar,
+    &interpolateBC6HScalar,
+    &unpack422Scalar,
+    &pack422Scalar,
+    &decodeCTX1Scalar,
+    &decodeDXT3AAs1111Scalar,
+    &scalarFilterFloat4H,
+    &scalarFilterFloat4V,
+};
+
+#undef RG_SPECIALIZED_TYPE
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const FastRowKernels * rg::getFastRowKernels(SimdLevel level) {
+    static const auto kernels = [] {
+        std::array<FastRowKernels, 4> k;
+        k[(size_t)SimdLevel::SCALAR] = SCALAR_KERNELS;
+        k[(size_t)SimdLevel::SSE41]  = SCALAR_KERNELS;
+        setupSSE41RowKernels(k[(size_t)SimdLevel::SSE41]);
+        k[(size_t)SimdLevel::AVX2] = k[(size_t)SimdLevel::SSE41];
+        setupAVX2RowKernels(k[(size_t)SimdLevel::AVX2]);
+        k[(size_t)SimdLevel::NEON] = SCALAR_KERNELS;
+        setupNEONRowKernels(k[(size_t)SimdLevel::NEON]);
+        return k;
+    }();
+    auto best      = detectSimdLevel();
+    bool supported = false;
+    switch (level) {
+    case SimdLevel::SCALAR: supported = true; break;
+    case SimdLevel::SSE41: supported = SimdLevel::SSE41 == best || SimdLevel::AVX2 == best; break;
+    case SimdLevel::AVX2: supported = SimdLevel::AVX2 == best; break;
+    case SimdLevel::NEON: supported = SimdLevel::NEON == best; break;
+    }
+    return supported ? &kernels[(size_t)level] : nullptr;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const FastRowKernels & rg::getFastRowKernels() {
+    static const FastRowKernels * best = getFastRowKernels(detectSimdLevel());
+    return *best;
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include <rg/base.h>
+
+namespace rg {
+
+///
+/// 8-bit RGBA color. This is the intermediate pixel format for 8-bit image saving and processing.
+///
+struct RGBA8 {
+    uint8_t x, y, z, w;
+};
+
+///
+/// 32-bit floating point RGBA color. This is the intermediate pixel format for HDR image saving and processing.
+///
+struct float4 {
+    float x, y, z, w;
+};
+
+///
+/// Row converters of one non-compressed color format. The "to" converters read 'count' pixels from 'src', where pixels
+/// are 'step' bytes apart, and write them tightly packed to 'dst'. The "from" converters do the reverse.
+///
+struct PixelRowConverters {
+    /// the source color format
+    ColorFormat format;
+
+    /// true if the converters are compile-time specialized for the format; false if this is the generic fallback.
+    bool specialized;
+
+    /// convert one row of pixels to float4
+    void (*toFloat4)(ColorFormat format, float4 * dst, const uint8_t * src, size_t count, size_t step);
+
+    /// convert one row of pixels to RGBA8
+    void (*toRGBA8)(ColorFormat format, RGBA8 * dst, const uint8_t * src, size_t count, size_t step);
+
+    /// convert one row of float4 pixels to this format. Channels not referenced by the format's swizzles are zeroed.
+    void (*fromFloat4)(ColorFormat format, uint8_t * dst, const float4 * src, size_t count, size_t step);
+};
+
+///
+/// Returns row converters of the color format. Specialized converters are returned whenever there is one for the
+/// format. Otherwise, the generic (slow) converters are returned.
+///
+const PixelRowConverters & getPixelRowConverters(ColorFormat format);
+
+///
+/// Returns the generic row converters that works for any non-compressed color format. This is mainly for testing.
+///
+const PixelRowConverters & getGenericPixelRowConverters();
+
+///
+/// Check if pixels of the format can be converted by the row converters: the format must be non-compressed, and float
+/// channels referenced by the swizzles must be 10, 11, 16 or 32 bits.
+///
+bool isRowConvertible(ColorFormat format);
+
+///
+/// Conversion of pixels from one color format to another.
+///
+struct PixelConversion {
+    ColorFormat src; ///< source format
+    ColorFormat dst; ///< destination format
+
+    /// true if pixels are converted directly. False if pixels go through float4 (2 hops).
+    bool direct;
+
+    const PixelRowConverters * srcRow; ///< row converters of the source format
+    const PixelRowConverters * dstRow; ///< row converters of the destination format
+
+    /// convert one row of pixels. Pixels are 'srcStep' and 'dstStep' bytes apart in source and destination.
+    void (*convertRow)(const PixelConversion & c, uint8_t * dst, size_t dstStep, const uint8_t * src, size_t srcStep,
+                       size_t count);
+
+    void operator()(uint8_t * dst, size_t dstStep, const uint8_t * src, size_t srcStep, size_t count) const {
+        convertRow(*this, dst, dstStep, src, srcStep, count);
+    }
+};
+
+///
+/// Returns conversion from one color format to another. The result is cached, so it is cheap to call this repeatedly.
+/// Returns null if either format is not row convertible.
+///
+const PixelConversion * getPixelConversion(ColorFormat src, ColorFormat dst);
+
+///
+/// SIMD instruction sets used by the pixel conversion kernels.
+///
+enum class SimdLevel {
+    SCALAR, ///< plain C++ code, no SIMD instructions.
+    SSE41,  ///< SSE4.1 (includes SSSE3)
+    AVX2,   ///< AVX2 and F16C
+    NEON,   ///< ARM NEON
+};
+
+///
+/// Returns the best SIMD level supported by the current CPU. The result is detected once and then cached.
+///
+SimdLevel detectSimdLevel();
+
+///
+/// Returns name of the SIMD level.
+///
+const char * simdLevelName(SimdLevel);
+
+///
+/// Row kernels of the most commonly used pixel conversions. Unlike PixelRowConverters, pixels of both source
+/// and destination are always tightly packed. Kernels of same-sized conversions support in-place conversion
+/// (dst == src).
+///
+struct FastRowKernels {
+    /// RGBA_8_8_8_8_UNORM -> float4
+    void (*rgba8ToFloat4)(float4 * dst, const uint8_t * src, size_t count);
+
+    /// float4 -> RGBA_8_8_8_8_UNORM. Values are clamped to [0, 1]. NaN is converted to 0.
+    void (*float4ToRGBA8)(RGBA8 * dst, const float4 * src, size_t count);
+
+    /// BGRA_8_8_8_8_UNORM <-> RGBA_8_8_8_8_UNORM. Swaps the 1st and the 3rd bytes of each pixel.
+    void (*swapRB8888)(RGBA8 * dst, const uint8_t * src, size_t count);
+
+    /// RGB_8_8_8_UNORM -> RGBA_8_8_8_8_UNORM
+    void (*rgb8ToRGBA8)(RGBA8 * dst, const uint8_t * src, size_t count);
+
+    /// BGR_5_6_5_UNORM -> RGBA_8_8_8_8_UNORM
+    void (*bgr565ToRGBA8)(RGBA8 * dst, const uint8_t * src, size_t count);
+
+    /// BGRA_5_5_5_1_UNORM -> RGBA_8_8_8_8_UNORM
+    void (*bgra5551ToRGBA8)(RGBA8 * dst, const uint8_t * src, size_t count);
+
+    /// BGRA_4_4_4_4_UNORM -> RGBA_8_8_8_8_UNORM
+    void (*bgra4444ToRGBA8)(RGBA8 * dst, const uint8_t * src, size_t count);
+
+    /// RGBA_10_10_10_2_UNORM -> float4
+    void (*rgb10a2ToFloat4)(float4 * dst, const uint8_t * src, size_t count);
+
+    /// RGBA_10_10_10_2_UNORM -> RGBA_8_8_8_8_UNORM
+    void (*rgb10a2ToRGBA8)(RGBA8 * dst, const uint8_t * src, size_t count);
+
+    /// RGB_11_11_10_FLOAT -> float4
+    void (*rg11b10fToFloat4)(float4 * dst, const uint8_t * src, size_t count);
+
+    /// half float -> float. 'count' is number of floats, not pixels.
+    void (*halfToFloat)(float * dst, const uint16_t * src, size_t count);
+
+    /// float -> half float, round to nearest even. 'count' is number of floats, not pixels.
+    void (*floatToHalf)(uint16_t * dst, const float * src, size_t count);
+
+    /// Extract one channel of 'pixelBytes' sized pixels, as described by extractChannel().
+    void (*extractChannel)(uint32_t * dst, const uint8_t * src, size_t count, uint32_t pixelBytes, uint32_t shift,
+                           uint32_t bits);
+
+    /// Decode a row of 'count' BC1 color blocks, which are 'stride' bytes apart, to RGBA8. Decoded pixels are written
+    /// as 4 rows, 'pitch' bytes apart. 'bc1' selects BC1 rules, or the always 4 colors rule of BC2/BC3 color blocks.
+    /// See bc1Palette() for details.
+    void (*decodeBC1)(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count, size_t stride, bool bc1);
+
+    /// Encode 4 rows of RGBA8 pixels, 'pitch' bytes apart, to a row of 'count' BC1 color blocks, 'stride' bytes apart,
+    /// using bounding box endpoints. When 'bc1' is true, blocks with transparent pixels (alpha < 128) are encoded in
+    /// the 3 colors plus transparent black mode. Otherwise, alpha is ignored. See encodeBC1Block() for details.
+    void (*encodeBC1)(uint8_t * dst, size_t stride, const RGBA8 * src, size_t pitch, size_t count, bool bc1);
+
+    /// BC7 endpoint interpolation of 'count' 8-bit channels: dst = ((64 - w) * e0 + w * e1 + 32) >> 6, where the
+    /// weights are in [0, 64].
+    void (*interpolateBC7)(uint8_t * dst, const uint8_t * e0, const uint8_t * e1, const uint8_t * weights,
+                           size_t count);
+
+    /// Same as interpolateBC7, but on BC6H unquantized endpoints, which are 17 bits signed integers.
+    void (*interpolateBC6H)(int32_t * dst, const int32_t * e0, const int32_t * e1, const uint8_t * weights,
+                            size_t count);
+
+    /// GRGB (G8R8_G8B8) or RGBG (R8G8_B8G8) -> RGBA_8_8_8_8_UNORM. 'count' is number of 2x1 blocks, 4 bytes each. The
+    /// two pixels of one block share red and blue. 'rgbg' selects the byte order of RGBG.
+    void (*unpack422)(RGBA8 * dst, const uint8_t * src, size_t count, bool rgbg);
+
+    /// RGBA_8_8_8_8_UNORM -> GRGB or RGBG, the reverse of unpack422. Red and blue of each pair of pixels are averaged,
+    /// rounding up. Alpha is ignored.
+    void (*pack422)(uint8_t * dst, const RGBA8 * src, size_t count, bool rgbg);
+
+    /// Decode a row of 'count' CTX1 blocks to 2 channels 8-bit pixels. Decoded pixels are written as 4 rows, 'pitch'
+    /// bytes apart. See ctx1Palette() for details.
+    void (*decodeCTX1)(uint8_t * dst, size_t pitch, const uint8_t * src, size_t count);
+
+    /// Decode a row of 'count' DXT3A_AS_1_1_1_1 blocks to RGBA8. Decoded pixels are written as 4 rows, 'pitch' bytes
+    /// apart. Each 4-bit value of the explicit alpha block holds four 1-bit channels, red in the lowest bit.
+    void (*decodeDXT3AAs1111)(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count);
+
+    /// Horizontal pass of separable filtering: dst[i] = sum of weights[i * taps + k] * src[first[i] + k], for k in
+    /// [0, taps). Products are added up in order of k, so all SIMD levels produce identical results.
+    void (*filterFloat4H)(float4 * dst, const float4 * src, const uint32_t * first, const float * weights, size_t taps,
+                          size_t count);
+
+    /// Vertical pass of separable filtering: dst[i] = sum of weights[k] * rows[k][i], for k in [0, taps). Products
+    /// are added up in order of k, like filterFloat4H.
+    void (*filterFloat4V)(float4 * dst, const float4 * const * rows, const float * weights, size_t taps, size_t count);
+};
+
+///
+/// Extract one channel from 'count' pixels that are 'step' bytes apart, and store the raw channel bits to 'dst'.
+/// The channel occupies 'bits' (1 to 32) bits starting at bit 'shift' of the 'pixelBytes' (up to 16) bytes pixel.
+/// It can be anywhere in the pixel, including crossing the 64-bit boundary. Only the bytes that the channel occupies
+/// are read, so it is safe to use on the last pixel of an image.
+///
+void extractChannel(uint32_t * dst, const uint8_t * src, size_t count, size_t step, uint32_t pixelBytes,
+                    uint32_t shift, uint32_t bits);
+
+///
+/// Returns fast row kernels of specific SIMD level. Kernels not implemented for that level fall back to lower
+/// levels. Returns null if the level is not supported by the current CPU.
+///
+const FastRowKernels * getFastRowKernels(SimdLevel level);
+
+///
+/// Returns fast row kernels of the best SIMD level of the current CPU.
+///
+const FastRowKernels & getFastRowKernels();
+
+/// \name Per instruction set kernel setup, implemented in pixel-simd.cpp. Each function overrides kernels
+/// that it implements, leaving the others untouched.
+//@{
+void setupSSE41RowKernels(FastRowKernels &);
+void setupAVX2RowKernels(FastRowKernels &);
+void setupNEONRowKernels(FastRowKernels &);
+//@}
+
+///
+/// Scalar float -> half conversion, bit-exact to the hardware conversion (F16C and NEON): round to nearest even,
+/// overflow to infinity, and NaN to quiet NaN with truncated payload.
+///
+uint16_t floatToHalf(float);
+
+///
+/// Scalar half -> float conversion, bit-exact to the hardware conversion.
+///
+float halfToFloat(uint16_t);
+
+} // namespace rg
@@ -0,0 +1,1167 @@
+#include "pch.h"
+#include "block-codec.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RG_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define RG_SIMD_X86 0
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Kernels of each instruction set are compiled with their own target attribute, so the rest of the library does
+// not require those instruction sets. MSVC allows intrinsics of any instruction set without special flags.
+#ifdef _MSC_VER
+#define RG_TARGET_SSE41
+#define RG_TARGET_AVX2
+#else
+#define RG_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define RG_TARGET_AVX2  __attribute__((target("avx2,f16c")))
+#endif
+
+using namespace rg;
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Scalar kernels, used to convert the remaining pixels that don't fill a whole SIMD register.
+static const FastRowKernels & scalar() {
+    return *getFastRowKernels(SimdLevel::SCALAR);
+}
+
+#if RG_SIMD_X86 || defined(__aarch64__)
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Byte shuffle masks of BC1 decoding. Each mask expands one byte of BC1 indices, which are 4 2-bit palette indices of
+/// one row of the block, to the 4 RGBA8 pixels of the row. The palette is 4 RGBA8 colors in one 128-bit register.
+struct BC1ShuffleTable {
+    alignas(16) uint8_t masks[256][16];
+
+    BC1ShuffleTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (uint32_t p = 0; p < 4; ++p) {
+                uint32_t k = (i >> (p * 2)) & 3;
+                for (uint32_t c = 0; c < 4; ++c) masks[i][p * 4 + c] = (uint8_t)(k * 4 + c);
+            }
+        }
+    }
+
+    static const BC1ShuffleTable & get() {
+        static const BC1ShuffleTable t;
+        return t;
+    }
+};
+
+#endif
+
+// *********************************************************************************************************************
+// CPU detection
+// *********************************************************************************************************************
+
+#if RG_SIMD_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; ++i) regs[i] = (uint32_t)r[i];
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// returns true if the OS saves and restores YMM registers.
+static bool osSupportsYMM() {
+#ifdef _MSC_VER
+    return 6 == (_xgetbv(0) & 6);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return 6 == (eax & 6);
+#endif
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+SimdLevel rg::detectSimdLevel() {
+    static const SimdLevel level = [] {
+#if RG_SIMD_X86
+        uint32_t regs[4];
+        cpuid(1, 0, regs);
+        bool ssse3   = 0 != (regs[2] & (1u << 9));
+        bool sse41   = 0 != (regs[2] & (1u << 19));
+        bool osxsave = 0 != (regs[2] & (1u << 27));
+        bool avx     = 0 != (regs[2] & (1u << 28));
+        bool f16c    = 0 != (regs[2] & (1u << 29));
+        if (!ssse3 || !sse41) return SimdLevel::SCALAR;
+        if (!osxsave || !avx || !f16c || !osSupportsYMM()) return SimdLevel::SSE41;
+        cpuid(7, 0, regs);
+        bool avx2 = 0 != (regs[1] & (1u << 5));
+        return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE41;
+#elif defined(__ARM_NEON)
+        return SimdLevel::NEON;
+#else
+        return SimdLevel::SCALAR;
+#endif
+    }();
+    return level;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+const char * rg::simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SCALAR: return "scalar";
+    case SimdLevel::SSE41: return "SSE4.1";
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::NEON: return "NEON";
+    default: return "unknown";
+    }
+}
+
+// *********************************************************************************************************************
+// SSE4.1
+// *********************************************************************************************************************
+
+#if RG_SIMD_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert 4 half floats in the lower 16 bits of each 32-bit lane to floats. Vectorized version of the scalar
+/// rg::halfToFloat(). Denormals are renormalized with a subtraction of normal floats, since multiplying denormal
+/// operands is very slow on most x86 CPUs.
+RG_TARGET_SSE41 static inline __m128 halfToFloatSSE41(__m128i h) {
+    const __m128i maskNoSign = _mm_set1_epi32(0x7fff);
+    const __m128i expMask    = _mm_set1_epi32(0x0f800000);
+    const __m128i expAdjust  = _mm_set1_epi32((127 - 15) << 23);
+    const __m128i infNanAdj  = _mm_set1_epi32((128 - 16) << 23);
+    const __m128i oneExp     = _mm_set1_epi32(1 << 23);
+    const __m128  denormBias = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+    const __m128i wasInf     = _mm_set1_epi32(0x7c00);
+    const __m128i quietBit   = _mm_set1_epi32(0x00400000);
+
+    __m128i expmant  = _mm_and_si128(maskNoSign, h);
+    __m128i shifted  = _mm_slli_epi32(expmant, 13);
+    __m128i exp      = _mm_and_si128(shifted, expMask);
+    __m128i u        = _mm_add_epi32(shifted, expAdjust);
+    __m128i isInfNan = _mm_cmpeq_epi32(exp, expMask);
+    __m128i isDenorm = _mm_cmpeq_epi32(exp, _mm_setzero_si128());
+    u                = _mm_add_epi32(u, _mm_and_si128(isInfNan, infNanAdj));
+    __m128i denorm   = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(u, oneExp)), denormBias));
+    u                = _mm_blendv_epi8(u, denorm, isDenorm);
+    __m128i quiet    = _mm_and_si128(_mm_cmpgt_epi32(expmant, wasInf), quietBit);
+    __m128i sign     = _mm_slli_epi32(_mm_xor_si128(h, expmant), 16);
+    return _mm_castsi128_ps(_mm_or_si128(_mm_or_si128(u, quiet), sign));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Convert 4 floats to half floats, stored in the lower 16 bits of each 32-bit lane. Vectorized version of the
+/// scalar rg::floatToHalf().
+RG_TARGET_SSE41 static inline __m128i floatToHalfSSE41(__m128 f) {
+    const __m128i maskSign     = _mm_set1_epi32((int)0x80000000u);
+    const __m128i f32infty     = _mm_set1_epi32(255 << 23);
+    const __m128i f16max       = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i minNormal    = _mm_set1_epi32(113 << 23);
+    const __m128i denormMagic  = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalBias   = _mm_set1_epi32((int)(((uint32_t)(15 - 127) << 23) + 0xfffu));
+    const __m128i infinity     = _mm_set1_epi32(0x7c00);
+    const __m128i quietNan     = _mm_set1_epi32(0x7e00);
+    const __m128i payloadMask  = _mm_set1_epi32(0x3ff);
+
+    __m128i u        = _mm_castps_si128(f);
+    __m128i justsign = _mm_and_si128(u, maskSign);
+    __m128i absf     = _mm_xor_si128(u, justsign);
+
+    // Inf or NaN
+    __m128i isNan   = _mm_cmpgt_epi32(absf, f32infty);
+    __m128i nan     = _mm_or_si128(quietNan, _mm_and_si128(_mm_srli_epi32(absf, 13), payloadMask));
+    __m128i infNan  = _mm_blendv_epi8(infinity, nan, isNan);
+
+    // denormal or zero
+    __m128i subnorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(absf), _mm_castsi128_ps(denormMagic))), denormMagic);
+
+    // normal, round to nearest even
+    __m128i mantOdd = _mm_and_si128(_mm_srli_epi32(absf, 13), _mm_set1_epi32(1));
+    __m128i normal  = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(absf, normalBias), mantOdd), 13);
+
+    __m128i isSub     = _mm_cmpgt_epi32(minNormal, absf);
+    __m128i isRegular = _mm_cmpgt_epi32(f16max, absf);
+    __m128i finite    = _mm_blendv_epi8(normal, subnorm, isSub);
+    __m128i joined    = _mm_blendv_epi8(infNan, finite, isRegular);
+    return _mm_or_si128(joined, _mm_srli_epi32(justsign, 16));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Clamp 4 floats to [0, 1] and convert to 8-bit unorm, in 32-bit lanes. NaN is converted to 0.
+RG_TARGET_SSE41 static inline __m128i floatToUNorm8SSE41(__m128 f) {
+    // note that _mm_max_ps() returns the 2nd operand when the 1st one is NaN.
+    f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void rgba8ToFloat4SSE41(float4 * dst, const uint8_t * src, size_t count) {
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    size_t       i     = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_ps(&dst[i + 0].x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), scale));
+        _mm_storeu_ps(&dst[i + 1].x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))), scale));
+        _mm_storeu_ps(&dst[i + 2].x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))), scale));
+        _mm_storeu_ps(&dst[i + 3].x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))), scale));
+    }
+    if (i < count) scalar().rgba8ToFloat4(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void float4ToRGBA8SSE41(RGBA8 * dst, const float4 * src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i c0 = floatToUNorm8SSE41(_mm_loadu_ps(&src[i + 0].x));
+        __m128i c1 = floatToUNorm8SSE41(_mm_loadu_ps(&src[i + 1].x));
+        __m128i c2 = floatToUNorm8SSE41(_mm_loadu_ps(&src[i + 2].x));
+        __m128i c3 = floatToUNorm8SSE41(_mm_loadu_ps(&src[i + 3].x));
+        __m128i v  = _mm_packus_epi16(_mm_packus_epi32(c0, c1), _mm_packus_epi32(c2, c3));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    if (i < count) scalar().float4ToRGBA8(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void swapRB8888SSE41(RGBA8 * dst, const uint8_t * src, size_t count) {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t        i       = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, shuffle));
+    }
+    if (i < count) scalar().swapRB8888(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void rgb8ToRGBA8SSE41(RGBA8 * dst, const uint8_t * src, size_t count) {
+    // 16 pixels (48 bytes) per iteration. The last 4 pixels are loaded from byte 32, not 36, to avoid reading past
+    // the end of the 48 bytes.
+    const __m128i shuffle0 = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i shuffle3 = _mm_setr_epi8(4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15, -1);
+    const __m128i alpha    = _mm_set1_epi32((int)0xff000000u);
+    size_t        i        = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8_t * s  = src + i * 3;
+        __m128i         v0 = _mm_loadu_si128((const __m128i *)(s + 0));
+        __m128i         v1 = _mm_loadu_si128((const __m128i *)(s + 12));
+        __m128i         v2 = _mm_loadu_si128((const __m128i *)(s + 24));
+        __m128i         v3 = _mm_loadu_si128((const __m128i *)(s + 32));
+        _mm_storeu_si128((__m128i *)(dst + i + 0), _mm_or_si128(_mm_shuffle_epi8(v0, shuffle0), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_or_si128(_mm_shuffle_epi8(v1, shuffle0), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_or_si128(_mm_shuffle_epi8(v2, shuffle0), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_or_si128(_mm_shuffle_epi8(v3, shuffle3), alpha));
+    }
+    if (i < count) scalar().rgb8ToRGBA8(dst + i, src + i * 3, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Interleave 8-bit channels stored in 16-bit lanes into 8 RGBA8 pixels. 'rg' holds R in low byte and G in high byte;
+/// 'ba' holds B in low byte and A in high byte.
+RG_TARGET_SSE41 static inline void storeRGBA8x8SSE41(RGBA8 * dst, __m128i rg, __m128i ba) {
+    _mm_storeu_si128((__m128i *)(dst + 0), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(rg, ba));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Expand 5-bit unorm to 8-bit unorm in 16-bit lanes: (v * 255 + 15) / 31, with the division done by multiplication.
+RG_TARGET_SSE41 static inline __m128i unorm5To8SSE41(__m128i v) {
+    v = _mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(255)), _mm_set1_epi16(15));
+    return _mm_srli_epi16(_mm_mulhi_epu16(v, _mm_set1_epi16((short)33826)), 4);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Expand 6-bit unorm to 8-bit unorm in 16-bit lanes: (v * 255 + 31) / 63, with the division done by multiplication.
+RG_TARGET_SSE41 static inline __m128i unorm6To8SSE41(__m128i v) {
+    v = _mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(255)), _mm_set1_epi16(31));
+    return _mm_srli_epi16(_mm_mulhi_epu16(v, _mm_set1_epi16((short)33289)), 5);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void bgr565ToRGBA8SSE41(RGBA8 * dst, const uint8_t * src, size_t count) {
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    const __m128i alpha = _mm_set1_epi16((short)0xff00);
+    size_t        i     = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+        __m128i r = unorm5To8SSE41(_mm_srli_epi16(v, 11));
+        __m128i g = unorm6To8SSE41(_mm_and_si128(_mm_srli_epi16(v, 5), mask6));
+        __m128i b = unorm5To8SSE41(_mm_and_si128(v, mask5));
+        storeRGBA8x8SSE41(dst + i, _mm_or_si128(r, _mm_slli_epi16(g, 8)), _mm_or_si128(b, alpha));
+    }
+    if (i < count) scalar().bgr565ToRGBA8(dst + i, src + i * 2, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void bgra5551ToRGBA8SSE41(RGBA8 * dst, const uint8_t * src, size_t count) {
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i maskA = _mm_set1_epi16((short)0xff00);
+    size_t        i     = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+        __m128i r = unorm5To8SSE41(_mm_and_si128(_mm_srli_epi16(v, 10), mask5));
+        __m128i g = unorm5To8SSE41(_mm_and_si128(_mm_srli_epi16(v, 5), mask5));
+        __m128i b = unorm5To8SSE41(_mm_and_si128(v, mask5));
+        __m128i a = _mm_and_si128(_mm_srai_epi16(v, 15), maskA);
+        storeRGBA8x8SSE41(dst + i, _mm_or_si128(r, _mm_slli_epi16(g, 8)), _mm_or_si128(b, a));
+    }
+    if (i < count) scalar().bgra5551ToRGBA8(dst + i, src + i * 2, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void bgra4444ToRGBA8SSE41(RGBA8 * dst, const uint8_t * src, size_t count) {
+    const __m128i mask4 = _mm_set1_epi16(0xf);
+    const __m128i x17   = _mm_set1_epi16(17);
+    size_t        i     = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+        __m128i r = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 8), mask4), x17);
+        __m128i g = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 4), mask4), x17);
+        __m128i b = _mm_mullo_epi16(_mm_and_si128(v, mask4), x17);
+        __m128i a = _mm_mullo_epi16(_mm_srli_epi16(v, 12), x17);
+        storeRGBA8x8SSE41(dst + i, _mm_or_si128(r, _mm_slli_epi16(g, 8)), _mm_or_si128(b, _mm_slli_epi16(a, 8)));
+    }
+    if (i < count) scalar().bgra4444ToRGBA8(dst + i, src + i * 2, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void rgb10a2ToFloat4SSE41(float4 * dst, const uint8_t * src, size_t count) {
+    const __m128i mask10  = _mm_set1_epi32(0x3ff);
+    const __m128  scale10 = _mm_set1_ps(1.0f / 1023.0f);
+    const __m128  scale2  = _mm_set1_ps(1.0f / 3.0f);
+    size_t        i       = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        __m128  r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask10)), scale10);
+        __m128  g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 10), mask10)), scale10);
+        __m128  b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 20), mask10)), scale10);
+        __m128  a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 30)), scale2);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        _mm_storeu_ps(&dst[i + 0].x, r);
+        _mm_storeu_ps(&dst[i + 1].x, g);
+        _mm_storeu_ps(&dst[i + 2].x, b);
+        _mm_storeu_ps(&dst[i + 3].x, a);
+    }
+    if (i < count) scalar().rgb10a2ToFloat4(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void rgb10a2ToRGBA8SSE41(RGBA8 * dst, const uint8_t * src, size_t count) {
+    // (v * 255 + 511) / 1023 == (v * 1021 + 2048) >> 12 for all 10-bit v.
+    const __m128i mask10 = _mm_set1_epi32(0x3ff);
+    const __m128i mul    = _mm_set1_epi32(1021);
+    const __m128i bias   = _mm_set1_epi32(2048);
+    size_t        i      = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        __m128i r = _mm_and_si128(v, mask10);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 10), mask10);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 20), mask10);
+        __m128i a = _mm_mullo_epi32(_mm_srli_epi32(v, 30), _mm_set1_epi32(85));
+        r         = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(r, mul), bias), 12);
+        g         = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(g, mul), bias), 12);
+        b         = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(b, mul), bias), 12);
+        __m128i c = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+        _mm_storeu_si128((__m128i *)(dst + i), c);
+    }
+    if (i < count) scalar().rgb10a2ToRGBA8(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void rg11b10fToFloat4SSE41(float4 * dst, const uint8_t * src, size_t count) {
+    // 11 and 10 bits floats have the same exponent as half float. Shift them into half float positions.
+    const __m128i mask11 = _mm_set1_epi32(0x7ff);
+    size_t        i      = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        __m128  r = halfToFloatSSE41(_mm_slli_epi32(_mm_and_si128(v, mask11), 4));
+        __m128  g = halfToFloatSSE41(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(v, 11), mask11), 4));
+        __m128  b = halfToFloatSSE41(_mm_slli_epi32(_mm_srli_epi32(v, 22), 5));
+        __m128  a = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        _mm_storeu_ps(&dst[i + 0].x, r);
+        _mm_storeu_ps(&dst[i + 1].x, g);
+        _mm_storeu_ps(&dst[i + 2].x, b);
+        _mm_storeu_ps(&dst[i + 3].x, a);
+    }
+    if (i < count) scalar().rg11b10fToFloat4(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void halfToFloatSSE41(float * dst, const uint16_t * src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128  a = halfToFloatSSE41(_mm_cvtepu16_epi32(h));
+        __m128  b = halfToFloatSSE41(_mm_cvtepu16_epi32(_mm_srli_si128(h, 8)));
+        _mm_storeu_ps(dst + i, a);
+        _mm_storeu_ps(dst + i + 4, b);
+    }
+    if (i < count) scalar().halfToFloat(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void floatToHalfSSE41(uint16_t * dst, const float * src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = floatToHalfSSE41(_mm_loadu_ps(src + i));
+        __m128i b = floatToHalfSSE41(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi32(a, b));
+    }
+    if (i < count) scalar().floatToHalf(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void decodeBC1SSE41(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count, size_t stride,
+                                           bool bc1) {
+    const auto & table = BC1ShuffleTable::get();
+    for (size_t b = 0; b < count; ++b, src += stride) {
+        alignas(16) uint32_t palette[4];
+        bc1Palette(palette, src, bc1);
+        __m128i   p   = _mm_load_si128((const __m128i *)palette);
+        uint8_t * out = (uint8_t *)dst + b * 16;
+        for (size_t y = 0; y < 4; ++y) {
+            __m128i mask = _mm_load_si128((const __m128i *)table.masks[src[4 + y]]);
+            _mm_storeu_si128((__m128i *)(out + y * pitch), _mm_shuffle_epi8(p, mask));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Sum of absolute RGB differences between 4 pixels and one color, as 32-bit lanes.
+RG_TARGET_SSE41 static inline __m128i rgbDistanceSSE41(__m128i pixels, __m128i color) {
+    __m128i d = _mm_or_si128(_mm_subs_epu8(pixels, color), _mm_subs_epu8(color, pixels));
+    d         = _mm_maddubs_epi16(d, _mm_set1_epi32(0x00010101));
+    return _mm_madd_epi16(d, _mm_set1_epi16(1));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Bounding box BC1 encoder. Same as encodeBC1Block(), except that opaque blocks are done with SIMD: 4 pixels a time
+/// for the bounding box, and for the distances to the 4 palette colors.
+RG_TARGET_SSE41 static void encodeBC1SSE41(uint8_t * dst, size_t stride, const RGBA8 * src, size_t pitch, size_t count,
+                                           bool bc1) {
+    const __m128i shifts = _mm_setr_epi32(1, 4, 16, 64);
+    for (size_t b = 0; b < count; ++b, dst += stride) {
+        const uint8_t * s = (const uint8_t *)src + b * 16;
+        __m128i         rows[4];
+        int             opaque = 0x8888; // sign bits of alpha bytes
+        for (size_t y = 0; y < 4; ++y) {
+            rows[y] = _mm_loadu_si128((const __m128i *)(s + y * pitch));
+            opaque &= _mm_movemask_epi8(rows[y]);
+        }
+        if (bc1 && 0x8888 != opaque) {
+            RGBA8 pixels[16];
+            for (size_t y = 0; y < 4; ++y) _mm_storeu_si128((__m128i *)(pixels + y * 4), rows[y]);
+            encodeBC1Block(dst, pixels, bc1);
+            continue;
+        }
+
+        __m128i lo = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+        __m128i hi = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+        lo         = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, 0x4E));
+        lo         = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, 0xB1));
+        hi         = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, 0x4E));
+        hi         = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, 0xB1));
+        uint32_t l = (uint32_t)_mm_cvtsi128_si32(lo), h = (uint32_t)_mm_cvtsi128_si32(hi);
+        uint8_t  lo3[3] = { (uint8_t)l, (uint8_t)(l >> 8), (uint8_t)(l >> 16) };
+        uint8_t  hi3[3] = { (uint8_t)h, (uint8_t)(h >> 8), (uint8_t)(h >> 16) };
+        bc1BoxEndpoints(dst, lo3, hi3, false);
+        if (dst[0] == dst[2] && dst[1] == dst[3]) {
+            // single color block: every pixel picks the first color.
+            memset(dst + 4, 0, 4);
+            continue;
+        }
+
+        alignas(16) uint32_t palette[4];
+        bc1Palette(palette, dst, bc1);
+        __m128i colors[4];
+        for (size_t k = 0; k < 4; ++k) colors[k] = _mm_set1_epi32((int)palette[k]);
+        for (size_t y = 0; y < 4; ++y) {
+            __m128i best  = rgbDistanceSSE41(rows[y], colors[0]);
+            __m128i index = _mm_setzero_si128();
+            for (int k = 1; k < 4; ++k) {
+                __m128i d = rgbDistanceSSE41(rows[y], colors[k]);
+                index     = _mm_blendv_epi8(index, _mm_set1_epi32(k), _mm_cmplt_epi32(d, best));
+                best      = _mm_min_epi32(best, d);
+            }
+            // pack the 4 2-bit indices to one byte.
+            index  = _mm_mullo_epi32(index, shifts);
+            index  = _mm_add_epi32(index, _mm_shuffle_epi32(index, 0x4E));
+            index  = _mm_add_epi32(index, _mm_shuffle_epi32(index, 0xB1));
+            dst[4 + y] = (uint8_t)_mm_cvtsi128_si32(index);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// 16 channels a time. Endpoints and weights are interleaved, so one maddubs does both products of 8 channels.
+RG_TARGET_SSE41 static void interpolateBC7SSE41(uint8_t * dst, const uint8_t * e0, const uint8_t * e1,
+                                                const uint8_t * weights, size_t count) {
+    const __m128i w64   = _mm_set1_epi8(64);
+    const __m128i round = _mm_set1_epi16(32);
+    size_t        i     = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a  = _mm_loadu_si128((const __m128i *)(e0 + i));
+        __m128i b  = _mm_loadu_si128((const __m128i *)(e1 + i));
+        __m128i w  = _mm_loadu_si128((const __m128i *)(weights + i));
+        __m128i iw = _mm_sub_epi8(w64, w);
+        __m128i lo = _mm_maddubs_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(iw, w));
+        __m128i hi = _mm_maddubs_epi16(_mm_unpackhi_epi8(a, b), _mm_unpackhi_epi8(iw, w));
+        lo         = _mm_srli_epi16(_mm_add_epi16(lo, round), 6);
+        hi         = _mm_srli_epi16(_mm_add_epi16(hi, round), 6);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    if (i < count) scalar().interpolateBC7(dst + i, e0 + i, e1 + i, weights + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void interpolateBC6HSSE41(int32_t * dst, const int32_t * e0, const int32_t * e1,
+                                                 const uint8_t * weights, size_t count) {
+    const __m128i w64   = _mm_set1_epi32(64);
+    const __m128i round = _mm_set1_epi32(32);
+    size_t        i     = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32_t w4;
+        memcpy(&w4, weights + i, 4);
+        __m128i w = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(w4));
+        __m128i a = _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(e0 + i)), _mm_sub_epi32(w64, w));
+        __m128i b = _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(e1 + i)), w);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(a, b), round), 6));
+    }
+    if (i < count) scalar().interpolateBC6H(dst + i, e0 + i, e1 + i, weights + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Shift 32-bit lanes right, then mask them.
+RG_TARGET_SSE41 static inline __m128i extractBitsSSE41(__m128i v, __m128i shift, __m128i mask) {
+    return _mm_and_si128(_mm_srl_epi32(v, shift), mask);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Extract channel of 1, 2, 4 and 8 bytes pixels. Other pixel sizes go to the scalar kernel.
+RG_TARGET_SSE41 static void extractChannelSSE41(uint32_t * dst, const uint8_t * src, size_t count,
+                                                uint32_t pixelBytes, uint32_t shift, uint32_t bits) {
+    const uint32_t m      = bits < 32 ? (1u << bits) - 1 : 0xFFFFFFFFu;
+    const __m128i  mask32 = _mm_set1_epi32((int)m);
+    const __m128i  mask64 = _mm_set1_epi64x((long long)m);
+    const __m128i  s      = _mm_cvtsi32_si128((int)shift);
+    size_t         i      = 0;
+    switch (pixelBytes) {
+        case 1:
+            for (; i + 16 <= count; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+                for (size_t j = 0; j < 16; j += 4, v = _mm_srli_si128(v, 4)) {
+                    _mm_storeu_si128((__m128i *)(dst + i + j), extractBitsSSE41(_mm_cvtepu8_epi32(v), s, mask32));
+                }
+            }
+            break;
+        case 2:
+            for (; i + 8 <= count; i += 8) {
+                __m128i v  = _mm_loadu_si128((const __m128i *)(src + i * 2));
+                __m128i lo = extractBitsSSE41(_mm_cvtepu16_epi32(v), s, mask32);
+                __m128i hi = extractBitsSSE41(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)), s, mask32);
+                _mm_storeu_si128((__m128i *)(dst + i), lo);
+                _mm_storeu_si128((__m128i *)(dst + i + 4), hi);
+            }
+            break;
+        case 4:
+            for (; i + 4 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+                _mm_storeu_si128((__m128i *)(dst + i), extractBitsSSE41(v, s, mask32));
+            }
+            break;
+        case 8:
+            // Shift the 64-bit pixels, so channels crossing the 32-bit boundary work too. Then gather the low 32 bits.
+            for (; i + 4 <= count; i += 4) {
+                __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 8));
+                __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 8 + 16));
+                a         = _mm_and_si128(_mm_srl_epi64(a, s), mask64);
+                b         = _mm_and_si128(_mm_srl_epi64(b, s), mask64);
+                __m128 v  = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_castps_si128(v));
+            }
+            break;
+        default:
+            break;
+    }
+    if (i < count) scalar().extractChannel(dst + i, src + i * pixelBytes, count - i, pixelBytes, shift, bits);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void unpack422SSE41(RGBA8 * dst, const uint8_t * src, size_t count, bool rgbg) {
+    // R, G0, B of the 1st pixel and R, G1, B of the 2nd pixel, of 2 blocks. Alpha bytes are zeroed, then set to 255.
+    const __m128i lo    = rgbg ? _mm_setr_epi8(0, 1, 2, -1, 0, 3, 2, -1, 4, 5, 6, -1, 4, 7, 6, -1)
+                               : _mm_setr_epi8(1, 0, 3, -1, 1, 2, 3, -1, 5, 4, 7, -1, 5, 6, 7, -1);
+    const __m128i hi    = rgbg ? _mm_setr_epi8(8, 9, 10, -1, 8, 11, 10, -1, 12, 13, 14, -1, 12, 15, 14, -1)
+                               : _mm_setr_epi8(9, 8, 11, -1, 9, 10, 11, -1, 13, 12, 15, -1, 13, 14, 15, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    size_t        i     = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i * 2), _mm_or_si128(_mm_shuffle_epi8(v, lo), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i * 2 + 4), _mm_or_si128(_mm_shuffle_epi8(v, hi), alpha));
+    }
+    if (i < count) scalar().unpack422(dst + i * 2, src + i * 4, count - i, rgbg);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Pack 4 pixels to 2 blocks in the lower 8 bytes: average each pixel with the other pixel of its pair, then pick
+/// green from the pixels, red and blue from the averages.
+RG_TARGET_SSE41 static inline __m128i pack422x4SSE41(__m128i v, __m128i swap, __m128i g, __m128i rb) {
+    __m128i avg = _mm_avg_epu8(v, _mm_shuffle_epi8(v, swap));
+    return _mm_or_si128(_mm_shuffle_epi8(v, g), _mm_shuffle_epi8(avg, rb));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void pack422SSE41(uint8_t * dst, const RGBA8 * src, size_t count, bool rgbg) {
+    const __m128i swap = _mm_setr_epi8(4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9, 10, 11);
+    const __m128i g    = rgbg ? _mm_setr_epi8(-1, 1, -1, 5, -1, 9, -1, 13, -1, -1, -1, -1, -1, -1, -1, -1)
+                              : _mm_setr_epi8(1, -1, 5, -1, 9, -1, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i rb   = rgbg ? _mm_setr_epi8(0, -1, 2, -1, 8, -1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1)
+                              : _mm_setr_epi8(-1, 0, -1, 2, -1, 8, -1, 10, -1, -1, -1, -1, -1, -1, -1, -1);
+    size_t        i    = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = pack422x4SSE41(_mm_loadu_si128((const __m128i *)(src + i * 2)), swap, g, rb);
+        __m128i b = pack422x4SSE41(_mm_loadu_si128((const __m128i *)(src + i * 2 + 4)), swap, g, rb);
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_unpacklo_epi64(a, b));
+    }
+    if (i < count) scalar().pack422(dst + i * 4, src + i * 2, count - i, rgbg);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Shuffle masks that expand one row of CTX1 indices (8 bits, 4 pixels) to 4 pixels of 2 bytes.
+struct CTX1ShuffleTable {
+    alignas(16) uint8_t masks[256][8];
+
+    CTX1ShuffleTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (uint32_t p = 0; p < 4; ++p) {
+                uint32_t k = (i >> (p * 2)) & 3;
+                for (uint32_t c = 0; c < 2; ++c) masks[i][p * 2 + c] = (uint8_t)(k * 2 + c);
+            }
+        }
+    }
+
+    static const CTX1ShuffleTable & get() {
+        static const CTX1ShuffleTable t;
+        return t;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void decodeCTX1SSE41(uint8_t * dst, size_t pitch, const uint8_t * src, size_t count) {
+    const auto & table = CTX1ShuffleTable::get();
+    for (size_t b = 0; b < count; ++b, src += 8) {
+        uint8_t palette[8];
+        ctx1Palette(palette, src);
+        __m128i   p   = _mm_loadl_epi64((const __m128i *)palette);
+        uint8_t * out = dst + b * 8;
+        for (size_t y = 0; y < 4; y += 2) {
+            // 2 rows at a time: the lower 8 bytes are the 1st row, the upper 8 bytes are the 2nd row.
+            __m128i mask = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)table.masks[src[4 + y]]),
+                                              _mm_loadl_epi64((const __m128i *)table.masks[src[5 + y]]));
+            __m128i v    = _mm_shuffle_epi8(p, mask);
+            _mm_storel_epi64((__m128i *)(out + y * pitch), v);
+            _mm_storel_epi64((__m128i *)(out + (y + 1) * pitch), _mm_srli_si128(v, 8));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void decodeDXT3AAs1111SSE41(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count) {
+    // Each row is 16 bits, one per channel. Spread the low byte to the first 8 bytes and the high byte to the last 8
+    // bytes, then test one bit per byte.
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i bits   = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    for (size_t b = 0; b < count; ++b, src += 8) {
+        uint8_t * out = (uint8_t *)dst + b * 16;
+        for (size_t y = 0; y < 4; ++y) {
+            uint16_t row;
+            memcpy(&row, src + y * 2, 2);
+            __m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(row), spread);
+            _mm_storeu_si128((__m128i *)(out + y * pitch), _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// One float4 pixel per register. Multiply and add are separate instructions, to match the scalar kernel bit by bit.
+RG_TARGET_SSE41 static void filterFloat4HSSE41(float4 * dst, const float4 * src, const uint32_t * first,
+                                               const float * weights, size_t taps, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const float * s = (const float *)(src + first[i]);
+        const float * w = weights + i * taps;
+        __m128        c = _mm_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4)));
+        _mm_storeu_ps((float *)(dst + i), c);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_SSE41 static void filterFloat4VSSE41(float4 * dst, const float4 * const * rows, const float * weights,
+                                               size_t taps, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            const float * s = (const float *)(rows[k] + i);
+            __m128        w = _mm_set1_ps(weights[k]);
+            c0              = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(s)));
+            c1              = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(s + 4)));
+        }
+        _mm_storeu_ps((float *)(dst + i), c0);
+        _mm_storeu_ps((float *)(dst + i + 1), c1);
+    }
+    if (i < count) {
+        __m128 c = _mm_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps((const float *)(rows[k] + i))));
+        }
+        _mm_storeu_ps((float *)(dst + i), c);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::setupSSE41RowKernels(FastRowKernels & k) {
+    k.rgba8ToFloat4     = &rgba8ToFloat4SSE41;
+    k.float4ToRGBA8     = &float4ToRGBA8SSE41;
+    k.swapRB8888        = &swapRB8888SSE41;
+    k.rgb8ToRGBA8       = &rgb8ToRGBA8SSE41;
+    k.bgr565ToRGBA8     = &bgr565ToRGBA8SSE41;
+    k.bgra5551ToRGBA8   = &bgra5551ToRGBA8SSE41;
+    k.bgra4444ToRGBA8   = &bgra4444ToRGBA8SSE41;
+    k.rgb10a2ToFloat4   = &rgb10a2ToFloat4SSE41;
+    k.rgb10a2ToRGBA8    = &rgb10a2ToRGBA8SSE41;
+    k.rg11b10fToFloat4  = &rg11b10fToFloat4SSE41;
+    k.halfToFloat       = &halfToFloatSSE41;
+    k.floatToHalf       = &floatToHalfSSE41;
+    k.extractChannel    = &extractChannelSSE41;
+    k.decodeBC1         = &decodeBC1SSE41;
+    k.encodeBC1         = &encodeBC1SSE41;
+    k.interpolateBC7    = &interpolateBC7SSE41;
+    k.interpolateBC6H   = &interpolateBC6HSSE41;
+    k.unpack422         = &unpack422SSE41;
+    k.pack422           = &pack422SSE41;
+    k.decodeCTX1        = &decodeCTX1SSE41;
+    k.decodeDXT3AAs1111 = &decodeDXT3AAs1111SSE41;
+    k.filterFloat4H     = &filterFloat4HSSE41;
+    k.filterFloat4V     = &filterFloat4VSSE41;
+}
+
+// *********************************************************************************************************************
+// AVX2 + F16C. Kernels that don't gain from wider registers are inherited from SSE4.1.
+// *********************************************************************************************************************
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static void rgba8ToFloat4AVX2(float4 * dst, const uint8_t * src, size_t count) {
+    const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+    size_t       i     = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (size_t j = 0; j < 8; j += 2) {
+            __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + (i + j) * 4)));
+            _mm256_storeu_ps(&dst[i + j].x, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        }
+    }
+    if (i < count) scalar().rgba8ToFloat4(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static inline __m256i floatToUNorm8AVX2(__m256 f) {
+    f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static void float4ToRGBA8AVX2(RGBA8 * dst, const float4 * src, size_t count) {
+    // Packing works within 128-bit lanes, which leaves pixels in order of 0 2 4 6 1 3 5 7. The final permutation
+    // restores the order.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t        i     = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i c0 = floatToUNorm8AVX2(_mm256_loadu_ps(&src[i + 0].x));
+        __m256i c1 = floatToUNorm8AVX2(_mm256_loadu_ps(&src[i + 2].x));
+        __m256i c2 = floatToUNorm8AVX2(_mm256_loadu_ps(&src[i + 4].x));
+        __m256i c3 = floatToUNorm8AVX2(_mm256_loadu_ps(&src[i + 6].x));
+        __m256i v  = _mm256_packus_epi16(_mm256_packus_epi32(c0, c1), _mm256_packus_epi32(c2, c3));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(v, order));
+    }
+    if (i < count) scalar().float4ToRGBA8(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static void swapRB8888AVX2(RGBA8 * dst, const uint8_t * src, size_t count) {
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t        i       = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(v, shuffle));
+    }
+    if (i < count) scalar().swapRB8888(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static void halfToFloatAVX2(float * dst, const uint16_t * src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+    }
+    if (i < count) scalar().halfToFloat(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static void floatToHalfAVX2(uint16_t * dst, const float * src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+    if (i < count) scalar().floatToHalf(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Shift 32-bit lanes right, then mask them.
+RG_TARGET_AVX2 static inline __m256i extractBitsAVX2(__m256i v, __m128i shift, __m256i mask) {
+    return _mm256_and_si256(_mm256_srl_epi32(v, shift), mask);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Extract channel of 1, 2, 4 and 8 bytes pixels. Other pixel sizes go to the SSE4.1 kernel.
+RG_TARGET_AVX2 static void extractChannelAVX2(uint32_t * dst, const uint8_t * src, size_t count, uint32_t pixelBytes,
+                                              uint32_t shift, uint32_t bits) {
+    const uint32_t m      = bits < 32 ? (1u << bits) - 1 : 0xFFFFFFFFu;
+    const __m256i  mask32 = _mm256_set1_epi32((int)m);
+    const __m256i  mask64 = _mm256_set1_epi64x((long long)m);
+    const __m128i  s      = _mm_cvtsi32_si128((int)shift);
+    // Gathering the low 32 bits works within 128-bit lanes, which leaves pixels in order of 0 1 4 5 2 3 6 7. The
+    // permutation restores the order.
+    const __m256i  order  = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    size_t         i      = 0;
+    switch (pixelBytes) {
+        case 1:
+            for (; i + 16 <= count; i += 16) {
+                __m128i v  = _mm_loadu_si128((const __m128i *)(src + i));
+                __m256i lo = extractBitsAVX2(_mm256_cvtepu8_epi32(v), s, mask32);
+                __m256i hi = extractBitsAVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), s, mask32);
+                _mm256_storeu_si256((__m256i *)(dst + i), lo);
+                _mm256_storeu_si256((__m256i *)(dst + i + 8), hi);
+            }
+            break;
+        case 2:
+            for (; i + 8 <= count; i += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+                _mm256_storeu_si256((__m256i *)(dst + i), extractBitsAVX2(_mm256_cvtepu16_epi32(v), s, mask32));
+            }
+            break;
+        case 4:
+            for (; i + 8 <= count; i += 8) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+                _mm256_storeu_si256((__m256i *)(dst + i), extractBitsAVX2(v, s, mask32));
+            }
+            break;
+        case 8:
+            for (; i + 8 <= count; i += 8) {
+                __m256i a = _mm256_loadu_si256((const __m256i *)(src + i * 8));
+                __m256i b = _mm256_loadu_si256((const __m256i *)(src + i * 8 + 32));
+                a         = _mm256_and_si256(_mm256_srl_epi64(a, s), mask64);
+                b         = _mm256_and_si256(_mm256_srl_epi64(b, s), mask64);
+                __m256 v  = _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+                _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(_mm256_castps_si256(v), order));
+            }
+            break;
+        default:
+            break;
+    }
+    if (i < count) extractChannelSSE41(dst + i, src + i * pixelBytes, count - i, pixelBytes, shift, bits);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Two destination pixels per register, each with its own source pixels and weights.
+RG_TARGET_AVX2 static void filterFloat4HAVX2(float4 * dst, const float4 * src, const uint32_t * first,
+                                             const float * weights, size_t taps, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const float * s0 = (const float *)(src + first[i]);
+        const float * s1 = (const float *)(src + first[i + 1]);
+        const float * w0 = weights + i * taps;
+        const float * w1 = w0 + taps;
+        __m256        c  = _mm256_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            __m256 w = _mm256_set_m128(_mm_set1_ps(w1[k]), _mm_set1_ps(w0[k]));
+            __m256 p = _mm256_set_m128(_mm_loadu_ps(s1 + k * 4), _mm_loadu_ps(s0 + k * 4));
+            c        = _mm256_add_ps(c, _mm256_mul_ps(w, p));
+        }
+        _mm256_storeu_ps((float *)(dst + i), c);
+    }
+    if (i < count) filterFloat4HSSE41(dst + i, src, first + i, weights + i * taps, taps, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+RG_TARGET_AVX2 static void filterFloat4VAVX2(float4 * dst, const float4 * const * rows, const float * weights,
+                                             size_t taps, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256 c0 = _mm256_setzero_ps(), c1 = _mm256_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            const float * s = (const float *)(rows[k] + i);
+            __m256        w = _mm256_set1_ps(weights[k]);
+            c0              = _mm256_add_ps(c0, _mm256_mul_ps(w, _mm256_loadu_ps(s)));
+            c1              = _mm256_add_ps(c1, _mm256_mul_ps(w, _mm256_loadu_ps(s + 8)));
+        }
+        _mm256_storeu_ps((float *)(dst + i), c0);
+        _mm256_storeu_ps((float *)(dst + i + 2), c1);
+    }
+    for (; i < count; ++i) {
+        __m128 c = _mm_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps((const float *)(rows[k] + i))));
+        }
+        _mm_storeu_ps((float *)(dst + i), c);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::setupAVX2RowKernels(FastRowKernels & k) {
+    k.rgba8ToFloat4  = &rgba8ToFloat4AVX2;
+    k.float4ToRGBA8  = &float4ToRGBA8AVX2;
+    k.swapRB8888     = &swapRB8888AVX2;
+    k.halfToFloat    = &halfToFloatAVX2;
+    k.floatToHalf    = &floatToHalfAVX2;
+    k.extractChannel = &extractChannelAVX2;
+    k.filterFloat4H  = &filterFloat4HAVX2;
+    k.filterFloat4V  = &filterFloat4VAVX2;
+}
+
+#else // RG_SIMD_X86
+
+void rg::setupSSE41RowKernels(FastRowKernels &) {}
+void rg::setupAVX2RowKernels(FastRowKernels &) {}
+
+#endif // RG_SIMD_X86
+
+// *********************************************************************************************************************
+// NEON
+// *********************************************************************************************************************
+
+#if defined(__ARM_NEON)
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void rgba8ToFloat4NEON(float4 * dst, const uint8_t * src, size_t count) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / 255.0f);
+    size_t            i     = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t v  = vld1q_u8(src + i * 4);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+        vst1q_f32(&dst[i + 0].x, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale));
+        vst1q_f32(&dst[i + 1].x, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+        vst1q_f32(&dst[i + 2].x, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale));
+        vst1q_f32(&dst[i + 3].x, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+    }
+    if (i < count) scalar().rgba8ToFloat4(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void swapRB8888NEON(RGBA8 * dst, const uint8_t * src, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        uint8x16_t   t = v.val[0];
+        v.val[0]       = v.val[2];
+        v.val[2]       = t;
+        vst4q_u8((uint8_t *)(dst + i), v);
+    }
+    if (i < count) scalar().swapRB8888(dst + i, src + i * 4, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void rgb8ToRGBA8NEON(RGBA8 * dst, const uint8_t * src, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t v = vld3q_u8(src + i * 3);
+        uint8x16x4_t o;
+        o.val[0] = v.val[0];
+        o.val[1] = v.val[1];
+        o.val[2] = v.val[2];
+        o.val[3] = vdupq_n_u8(255);
+        vst4q_u8((uint8_t *)(dst + i), o);
+    }
+    if (i < count) scalar().rgb8ToRGBA8(dst + i, src + i * 3, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Extract channel of 4 bytes pixels. Other pixel sizes go to the scalar kernel.
+static void extractChannelNEON(uint32_t * dst, const uint8_t * src, size_t count, uint32_t pixelBytes, uint32_t shift,
+                               uint32_t bits) {
+    size_t i = 0;
+    if (4 == pixelBytes) {
+        const uint32x4_t mask  = vdupq_n_u32(bits < 32 ? (1u << bits) - 1 : 0xFFFFFFFFu);
+        const int32x4_t  right = vdupq_n_s32(-(int32_t)shift); // shift left by negative amount is shift right.
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t v = vld1q_u32((const uint32_t *)(src + i * 4));
+            vst1q_u32(dst + i, vandq_u32(vshlq_u32(v, right), mask));
+        }
+    }
+    if (i < count) scalar().extractChannel(dst + i, src + i * pixelBytes, count - i, pixelBytes, shift, bits);
+}
+
+#if defined(__aarch64__)
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Clamp 4 floats to [0, 1] and convert to 8-bit unorm. vmaxnmq_f32() returns the number when the other operand is
+/// NaN, which converts NaN to 0. Multiply and add are kept separate to match the scalar rounding.
+static inline uint16x4_t floatToUNorm8NEON(float32x4_t f) {
+    f = vminq_f32(vmaxnmq_f32(f, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    f = vaddq_f32(vmulq_f32(f, vdupq_n_f32(255.0f)), vdupq_n_f32(0.5f));
+    return vmovn_u32(vcvtq_u32_f32(f));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void float4ToRGBA8NEON(RGBA8 * dst, const float4 * src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint16x8_t c01 = vcombine_u16(floatToUNorm8NEON(vld1q_f32(&src[i + 0].x)), floatToUNorm8NEON(vld1q_f32(&src[i + 1].x)));
+        uint16x8_t c23 = vcombine_u16(floatToUNorm8NEON(vld1q_f32(&src[i + 2].x)), floatToUNorm8NEON(vld1q_f32(&src[i + 3].x)));
+        vst1q_u8((uint8_t *)(dst + i), vcombine_u8(vmovn_u16(c01), vmovn_u16(c23)));
+    }
+    if (i < count) scalar().float4ToRGBA8(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void halfToFloatNEON(float * dst, const uint16_t * src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+    }
+    if (i < count) scalar().halfToFloat(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void floatToHalfNEON(uint16_t * dst, const float * src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+    }
+    if (i < count) scalar().floatToHalf(dst + i, src + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void interpolateBC7NEON(uint8_t * dst, const uint8_t * e0, const uint8_t * e1, const uint8_t * weights,
+                               size_t count) {
+    const uint8x16_t w64 = vdupq_n_u8(64);
+    size_t           i   = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t a  = vld1q_u8(e0 + i);
+        uint8x16_t b  = vld1q_u8(e1 + i);
+        uint8x16_t w  = vld1q_u8(weights + i);
+        uint8x16_t iw = vsubq_u8(w64, w);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), vget_low_u8(iw)), vget_low_u8(b), vget_low_u8(w));
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), vget_high_u8(iw)), vget_high_u8(b), vget_high_u8(w));
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 6), vrshrn_n_u16(hi, 6)));
+    }
+    if (i < count) scalar().interpolateBC7(dst + i, e0 + i, e1 + i, weights + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void interpolateBC6HNEON(int32_t * dst, const int32_t * e0, const int32_t * e1, const uint8_t * weights,
+                                size_t count) {
+    const int32x4_t w64 = vdupq_n_s32(64);
+    size_t          i   = 0;
+    for (; i + 4 <= count; i += 4) {
+        const int32_t ws[4] = { weights[i], weights[i + 1], weights[i + 2], weights[i + 3] };
+        int32x4_t     w     = vld1q_s32(ws);
+        int32x4_t     v     = vmulq_s32(vld1q_s32(e0 + i), vsubq_s32(w64, w));
+        v                   = vmlaq_s32(v, vld1q_s32(e1 + i), w);
+        vst1q_s32(dst + i, vrshrq_n_s32(v, 6));
+    }
+    if (i < count) scalar().interpolateBC6H(dst + i, e0 + i, e1 + i, weights + i, count - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static void decodeBC1NEON(RGBA8 * dst, size_t pitch, const uint8_t * src, size_t count, size_t stride, bool bc1) {
+    const auto & table = BC1ShuffleTable::get();
+    for (size_t b = 0; b < count; ++b, src += stride) {
+        uint32_t palette[4];
+        bc1Palette(palette, src, bc1);
+        uint8x16_t p   = vreinterpretq_u8_u32(vld1q_u32(palette));
+        uint8_t *  out = (uint8_t *)dst + b * 16;
+        for (size_t y = 0; y < 4; ++y) vst1q_u8(out + y * pitch, vqtbl1q_u8(p, vld1q_u8(table.masks[src[4 + y]])));
+    }
+}
+
+#endif // __aarch64__
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::setupNEONRowKernels(FastRowKernels & k) {
+    k.rgba8ToFloat4  = &rgba8ToFloat4NEON;
+    k.swapRB8888     = &swapRB8888NEON;
+    k.rgb8ToRGBA8    = &rgb8ToRGBA8NEON;
+    k.extractChannel = &extractChannelNEON;
+#if defined(__aarch64__)
+    k.float4ToRGBA8   = &float4ToRGBA8NEON;
+    k.halfToFloat     = &halfToFloatNEON;
+    k.floatToHalf     = &floatToHalfNEON;
+    k.decodeBC1       = &decodeBC1NEON;
+    k.interpolateBC7  = &interpolateBC7NEON;
+    k.interpolateBC6H = &interpolateBC6HNEON;
+#endif
+}
+
+#else // __ARM_NEON
+
+void rg::setupNEONRowKernels(FastRowKernels &) {}
+
+#endif // __ARM_NEON
@@ -0,0 +1,319 @@
+#include "pch.h"
+#include "resample.h"
+#include "thread-pool.h"
+#include <cmath>
+
+using namespace rg;
+
+/// Shape parameter of the Kaiser window. Larger values trade sharpness for less ringing.
+static constexpr double KAISER_ALPHA = 4.0;
+
+/// Max number of weight tables kept by getFilterWeights().
+static constexpr size_t MAX_CACHED_WEIGHTS = 256;
+
+/// Number of destination pixels of one band of resampleFloat4(). Source rows of a band are filtered into a temporary
+/// buffer, so the band should be small enough to stay in cache, but large enough to amortize the rows shared with the
+/// neighbor bands.
+static constexpr size_t BAND_PIXELS = 32 * 1024;
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Radius of the filter, in unscaled pixels.
+static double filterRadius(ImageFilter filter) {
+    switch (filter) {
+    case ImageFilter::BOX: return 0.5;
+    case ImageFilter::TRIANGLE: return 1.0;
+    case ImageFilter::KAISER:
+    case ImageFilter::LANCZOS: return 3.0;
+    }
+    return 0.5;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+static double sinc(double x) {
+    if (std::abs(x) < 1e-9) return 1.0;
+    x *= 3.14159265358979323846;
+    return std::sin(x) / x;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Modified Bessel function of the first kind, order 0, as used by the Kaiser window.
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0, q = x * x / 4.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; ++k) {
+        term *= q / ((double)k * (double)k);
+        sum += term;
+    }
+    return sum;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Value of the unscaled filter at distance x from its center.
+static double filterValue(ImageFilter filter, double x) {
+    switch (filter) {
+    case ImageFilter::BOX: return (-0.5 <= x && x < 0.5) ? 1.0 : 0.0;
+    case ImageFilter::TRIANGLE: return std::max(0.0, 1.0 - std::abs(x));
+    case ImageFilter::KAISER: {
+        if (std::abs(x) >= 3.0) return 0.0;
+        double t = x / 3.0;
+        return sinc(x) * besselI0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / besselI0(KAISER_ALPHA);
+    }
+    case ImageFilter::LANCZOS: return std::abs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+FilterWeights rg::computeFilterWeights(uint32_t srcSize, uint32_t dstSize, ImageFilter filter) {
+    FilterWeights w;
+    w.srcSize = srcSize;
+    w.dstSize = dstSize;
+    if (0 == srcSize || 0 == dstSize) return w;
+
+    const double  scale   = (double)srcSize / (double)dstSize;
+    const double  stretch = std::max(scale, 1.0);
+    const double  support = filterRadius(filter) * stretch;
+    const int64_t last    = (int64_t)srcSize - 1;
+
+    // Weights of each destination pixel, with zero weights at both ends trimmed.
+    std::vector<uint32_t>            first(dstSize);
+    std::vector<std::vector<double>> values(dstSize);
+    for (uint32_t i = 0; i < dstSize; ++i) {
+        const double  center = (i + 0.5) * scale;
+        const int64_t j0     = (int64_t)std::floor(center - support);
+        const int64_t j1     = (int64_t)std::ceil(center + support);
+        const int64_t lo     = std::clamp<int64_t>(j0, 0, last);
+        auto &        v      = values[i];
+        v.assign((size_t)(std::clamp<int64_t>(j1, 0, last) - lo + 1), 0.0);
+        double sum = 0.0;
+        for (int64_t j = j0; j <= j1; ++j) {
+            double f = filterValue(filter, ((double)j + 0.5 - center) / stretch);
+            v[(size_t)(std::clamp<int64_t>(j, 0, last) - lo)] += f;
+            sum += f;
+        }
+        if (std::abs(sum) < 1e-9) {
+            // the filter misses all pixel centers. Fall back to the nearest pixel.
+            std::fill(v.begin(), v.end(), 0.0);
+            v[(size_t)(std::clamp<int64_t>((int64_t)center, 0, last) - lo)] = 1.0;
+            sum                                                            = 1.0;
+        }
+        for (auto & x : v) x /= sum;
+        size_t b = 0, e = v.size();
+        while (b + 1 < e && 0.0 == v[b]) ++b;
+        while (e - 1 > b && 0.0 == v[e - 1]) --e;
+        v        = std::vector<double>(v.begin() + (ptrdiff_t)b, v.begin() + (ptrdiff_t)e);
+        first[i] = (uint32_t)lo + (uint32_t)b;
+        w.taps   = std::max(w.taps, (uint32_t)v.size());
+    }
+
+    // Pad all destination pixels to the same number of taps. Pixels near the right edge are shifted left, so that the
+    // taps never go past the end of the source.
+    w.first.resize(dstSize);
+    w.weights.assign((size_t)dstSize * w.taps, 0.0f);
+    for (uint32_t i = 0; i < dstSize; ++i) {
+        uint32_t f  = std::min(first[i], srcSize - w.taps);
+        w.first[i]  = f;
+        float * dst = &w.weights[(size_t)i * w.taps + (first[i] - f)];
+        for (size_t k = 0; k < values[i].size(); ++k) dst[k] = (float)values[i][k];
+    }
+    return w;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+std::shared_ptr<const FilterWeights> rg::getFilterWeights(uint32_t srcSize, uint32_t dstSize, ImageFilter filter) {
+    using Key = std::tuple<uint32_t, uint32_t, ImageFilter>;
+    static std::mutex                                          mutex;
+    static std::map<Key, std::shared_ptr<const FilterWeights>> registry;
+
+    Key key = {srcSize, dstSize, filter};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto                        iter = registry.find(key);
+        if (iter != registry.end()) return iter->second;
+    }
+
+    // Compute outside of the lock. If another thread computes the same weights meanwhile, the first one wins.
+    auto weights = std::make_shared<const FilterWeights>(computeFilterWeights(srcSize, dstSize, filter));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (registry.size() >= MAX_CACHED_WEIGHTS) registry.clear();
+    return registry.emplace(key, weights).first->second;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::resampleRows(const std::vector<Resampling> & jobs) {
+    struct Band {
+        const Resampling * job;
+        uint32_t           z;      // destination slice
+        uint32_t           y0, y1; // range of destination rows
+    };
+    std::vector<Band> bands;
+    for (const auto & j : jobs) {
+        uint32_t rows  = (uint32_t)std::max<size_t>(1, BAND_PIXELS / std::max(1u, j.x->dstSize));
+        uint32_t depth = j.z ? j.z->dstSize : 1;
+        for (uint32_t z = 0; z < depth; ++z) {
+            for (uint32_t y = 0; y < j.y->dstSize; y += rows) {
+                bands.push_back({&j, z, y, std::min(y + rows, j.y->dstSize)});
+            }
+        }
+    }
+
+    const auto & k = getFastRowKernels();
+    parallelFor(bands.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<float4>         temp, line, slices;
+        std::vector<const float4 *> rows;
+        for (size_t i = begin; i < end; ++i) {
+            const auto & b     = bands[i];
+            const auto & j     = *b.job;
+            const auto & wx    = *j.x;
+            const auto & wy    = *j.y;
+            const size_t dstW  = wx.dstSize;
+            const size_t srcW  = wx.srcSize;
+            const size_t taps  = wy.taps;
+            const size_t zTaps = j.z ? j.z->taps : 1;
+            const size_t bandH = b.y1 - b.y0;
+            uint32_t     r0    = wy.first[b.y0];
+            uint32_t     r1    = r0;
+            for (uint32_t y = b.y0; y < b.y1; ++y) {
+                r0 = std::min(r0, wy.first[y]);
+                r1 = std::max(r1, wy.first[y] + wy.taps);
+            }
+            line.resize(std::max(srcW, dstW));
+            temp.resize((r1 - r0) * dstW);
+            rows.resize(std::max(taps, zTaps));
+            if (zTaps > 1) slices.resize(zTaps * bandH * dstW);
+
+            // Destination rows are written in place, or through the line buffer when they need conversion.
+            uint8_t * dstSlice = j.dst + b.z * j.dstSlice;
+            auto      target   = [&](uint32_t y) {
+                return j.dstConv ? line.data() : (float4 *)(dstSlice + y * j.dstPitch);
+            };
+            auto store = [&](uint32_t y) {
+                if (!j.dstConv) return;
+                (*j.dstConv)(dstSlice + y * j.dstPitch, j.dstStep, (const uint8_t *)line.data(), sizeof(float4), dstW);
+            };
+
+            for (size_t t = 0; t < zTaps; ++t) {
+                const uint8_t * srcSlice = j.src + (j.z ? j.z->first[b.z] + t : 0) * j.srcSlice;
+
+                // horizontal pass of all source rows used by the band.
+                for (uint32_t r = r0; r < r1; ++r) {
+                    const uint8_t * s = srcSlice + r * j.srcPitch;
+                    if (j.srcConv) {
+                        (*j.srcConv)((uint8_t *)line.data(), sizeof(float4), s, j.srcStep, srcW);
+                        s = (const uint8_t *)line.data();
+                    }
+                    k.filterFloat4H(temp.data() + (r - r0) * dstW, (const float4 *)s, wx.first.data(),
+                                    wx.weights.data(), wx.taps, dstW);
+                }
+
+                // vertical pass. Results go to the destination directly, unless there are multiple source slices to
+                // blend.
+                for (uint32_t y = b.y0; y < b.y1; ++y) {
+                    for (size_t n = 0; n < taps; ++n) rows[n] = temp.data() + (wy.first[y] + n - r0) * dstW;
+                    float4 * d = zTaps > 1 ? slices.data() + (t * bandH + y - b.y0) * dstW : target(y);
+                    k.filterFloat4V(d, rows.data(), wy.weights.data() + y * taps, taps, dstW);
+                    if (1 == zTaps) store(y);
+                }
+            }
+
+            // blend across source slices.
+            if (zTaps > 1) {
+                for (uint32_t y = b.y0; y < b.y1; ++y) {
+                    for (size_t t = 0; t < zTaps; ++t) rows[t] = slices.data() + (t * bandH + y - b.y0) * dstW;
+                    k.filterFloat4V(target(y), rows.data(), j.z->weights.data() + b.z * zTaps, zTaps, dstW);
+                    store(y);
+                }
+            }
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Float4 image with the same layers, levels and plane dimensions as 'like', backed by 'pixels'. Planes are tightly
+/// packed one after another.
+static ImageProxy float4Image(std::vector<float4> & pixels, const ImageDesc & like) {
+    ImageProxy image;
+    image.desc.layers = like.layers;
+    image.desc.levels = like.levels;
+    for (const auto & p : like.planes) {
+        image.desc.planes.push_back(ImagePlaneDesc::make(ColorFormat::FLOAT4(), p.width, p.height));
+        image.desc.planes.back().offset = image.desc.size;
+        image.desc.size += image.desc.planes.back().size;
+    }
+    pixels.resize(image.desc.size / sizeof(float4));
+    image.data = (uint8_t *)pixels.data();
+    return image;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Check if pixels of all planes can be converted to/from float4 row by row, without going through a temporary image.
+static bool allPlanesRowConvertible(const ImageDesc & desc) {
+    for (const auto & p : desc.planes) {
+        if (!isRowConvertible(p.format)) return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+bool rg::resample(const ImageProxy & src, ImageProxy & dst, ImageFilter filter, CompressionQuality quality) {
+    if (src.empty() || !src.data || dst.empty() || !dst.data) {
+        RG_LOGE("Can't resample empty image.");
+        return false;
+    }
+    if (src.desc.layers != dst.desc.layers || src.desc.levels != dst.desc.levels) {
+        RG_LOGE("Source and destination images must have same number of layers and levels.");
+        return false;
+    }
+
+    // Uncompressed pixels are converted to/from float4 row by row, as the bands read and write them. Other formats
+    // (block compressed and 4:2:2) go through a temporary float4 image, with convert().
+    std::vector<float4> srcPixels, dstPixels;
+    ImageProxy          srcFloat, dstFloat;
+    const bool          srcDirect = allPlanesRowConvertible(src.desc);
+    const bool          dstDirect = allPlanesRowConvertible(dst.desc);
+    for (size_t i = 0; i < src.desc.planes.size(); ++i) {
+        bool volume = src.desc.planes[i].depth > 1 || dst.desc.planes[i].depth > 1;
+        if (volume && !(srcDirect && dstDirect)) {
+            RG_LOGE("image plane [%zu]: resampling of compressed volume textures is not supported.", i);
+            return false;
+        }
+    }
+    if (!srcDirect) {
+        srcFloat = float4Image(srcPixels, src.desc);
+        if (!convert(src, srcFloat)) return false;
+    }
+    if (!dstDirect) dstFloat = float4Image(dstPixels, dst.desc);
+
+    std::vector<std::shared_ptr<const FilterWeights>> weights;
+    std::vector<Resampling>                           jobs;
+    for (size_t i = 0; i < src.desc.planes.size(); ++i) {
+        const auto & sp = srcDirect ? src.desc.planes[i] : srcFloat.desc.planes[i];
+        const auto & dp = dstDirect ? dst.desc.planes[i] : dstFloat.desc.planes[i];
+        weights.push_back(getFilterWeights(sp.width, dp.width, filter));
+        weights.push_back(getFilterWeights(sp.height, dp.height, filter));
+        weights.push_back(getFilterWeights(sp.depth, dp.depth, filter));
+        Resampling r;
+        r.x        = weights[i * 3].get();
+        r.y        = weights[i * 3 + 1].get();
+        r.z        = sp.depth > 1 || dp.depth > 1 ? weights[i * 3 + 2].get() : nullptr;
+        r.src      = (srcDirect ? src.data : srcFloat.data) + sp.offset;
+        r.srcSlice = sp.slice;
+        r.srcPitch = sp.pitch;
+        r.srcStep  = sp.step / 8;
+        r.srcConv  = srcDirect ? getPixelConversion(sp.format, ColorFormat::FLOAT4()) : nullptr;
+        r.dst      = (dstDirect ? dst.data : dstFloat.data) + dp.offset;
+        r.dstSlice = dp.slice;
+        r.dstPitch = dp.pitch;
+        r.dstStep  = dp.step / 8;
+        r.dstConv  = dstDirect ? getPixelConversion(ColorFormat::FLOAT4(), dp.format) : nullptr;
+        jobs.push_back(r);
+    }
+    resampleRows(jobs);
+
+    return dstDirect || convert(dstFloat, dst, quality);
+}
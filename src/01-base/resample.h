@@ -0,0 +1,63 @@
+#pragma once
+#include "pixel-convert.h"
+
+namespace rg {
+
+///
+/// Polyphase weights of resampling one dimension from 'srcSize' to 'dstSize' pixels. Destination pixel i is the sum of
+/// weights[i * taps + k] * source[first[i] + k], for k in [0, taps). Taps that fall outside of the source are folded
+/// into the edge pixels (clamp to edge), and the weights of each destination pixel add up to 1. Destination pixels
+/// that need fewer taps are padded with zero weights, so all of them have the same number of taps.
+///
+struct FilterWeights {
+    uint32_t              srcSize = 0;
+    uint32_t              dstSize = 0;
+    uint32_t              taps    = 0;
+    std::vector<uint32_t> first;   ///< index of the first source pixel of each destination pixel
+    std::vector<float>    weights; ///< 'taps' weights of each destination pixel
+};
+
+///
+/// Compute polyphase weights of the filter. Pixel centers are aligned, so destination pixel i is centered at source
+/// coordinate (i + 0.5) * srcSize / dstSize. When downscaling, the filter is stretched by the scale ratio.
+///
+FilterWeights computeFilterWeights(uint32_t srcSize, uint32_t dstSize, ImageFilter filter);
+
+///
+/// Returns polyphase weights of the filter from a cache, computing them on first use. Weights are shared by all
+/// threads. The cache is bounded: it is cleared when it gets full, while weights that are in use stay alive.
+///
+std::shared_ptr<const FilterWeights> getFilterWeights(uint32_t srcSize, uint32_t dstSize, ImageFilter filter);
+
+///
+/// One resampling, from (x.srcSize, y.srcSize, z.srcSize) to (x.dstSize, y.dstSize, z.dstSize) pixels. Slices are
+/// 'slice' bytes apart, rows are 'pitch' bytes apart, and pixels are 'step' bytes apart. Source pixels are converted to
+/// float4 by 'srcConv' as they are read, and destination pixels are converted from float4 by 'dstConv' as they are
+/// written. A null conversion means the pixels are float4 already, and are accessed in place. A null 'z' means the
+/// resampling is 2D, and only the first slice is touched.
+///
+struct Resampling {
+    const FilterWeights *   x;
+    const FilterWeights *   y;
+    const FilterWeights *   z = nullptr;
+    const uint8_t *         src;
+    size_t                  srcSlice = 0;
+    size_t                  srcPitch;
+    size_t                  srcStep;
+    const PixelConversion * srcConv;
+    uint8_t *               dst;
+    size_t                  dstSlice = 0;
+    size_t                  dstPitch;
+    size_t                  dstStep;
+    const PixelConversion * dstConv;
+};
+
+///
+/// Run all resamplings in parallel. Each one is split into bands of destination rows of each destination slice, so
+/// volumes are processed in parallel across slices. A band filters the source rows it needs horizontally first, then
+/// blends them vertically, with FastRowKernels::filterFloat4H and filterFloat4V. For volumes, that is done on each
+/// source slice the band needs, and the results are blended across slices with filterFloat4V again.
+///
+void resampleRows(const std::vector<Resampling> & jobs);
+
+} // namespace rg
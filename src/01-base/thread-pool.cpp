@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "thread-pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+using namespace rg;
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The max number of threads (including the calling thread) requested by user. 0 means all hardware threads.
+static std::atomic<uint32_t> sMaxWorkerThreads {0};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// The shared worker threads. Threads are created on demand, the first time they are needed.
+class WorkerPool {
+public:
+    static WorkerPool & get() {
+        static WorkerPool p;
+        return p;
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _cv.notify_all();
+        for (auto & t : _threads) t.join();
+    }
+
+    /// Post tasks to the pool. Make sure there are at least 'threads' worker threads to run them.
+    void post(size_t tasks, size_t threads, const std::function<void()> & task) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (_threads.size() < threads) _threads.emplace_back([this] { run(); });
+            for (size_t i = 0; i < tasks; ++i) _tasks.push_back(task);
+        }
+        if (1 == tasks) {
+            _cv.notify_one();
+        } else {
+            _cv.notify_all();
+        }
+    }
+
+private:
+    std::mutex                        _mutex;
+    std::condition_variable           _cv;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread>          _threads;
+    bool                              _quit = false;
+
+    void run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this] { return _quit || !_tasks.empty(); });
+                if (_tasks.empty()) return; // quit
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Chunks of one parallelFor() call. Chunks are claimed one by one by the calling thread and the workers, so faster
+/// threads end up doing more chunks.
+struct ParallelJob {
+    const std::function<void(size_t, size_t)> * proc;
+    size_t                                      count;
+    size_t                                      grain;
+    size_t                                      chunks;
+    std::atomic<size_t>                         next {0};
+    std::atomic<size_t>                         done {0};
+    std::mutex                                  mutex;
+    std::condition_variable                     cv;
+    std::exception_ptr                          error;
+
+    /// Run chunks until there's none left. A worker might get here after the whole job is done and the caller
+    /// has returned. In that case, it sees no chunk left and never touches 'proc'.
+    void run() {
+        for (size_t c = next++; c < chunks; c = next++) {
+            try {
+                size_t begin = c * grain;
+                (*proc)(begin, std::min(begin + grain, count));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+            if (chunks == ++done) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::setMaxWorkerThreads(uint32_t n) { sMaxWorkerThreads = n; }
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+uint32_t rg::getMaxWorkerThreads() {
+    uint32_t n = sMaxWorkerThreads;
+    if (n) return n;
+    n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> & proc) {
+    if (0 == count) return;
+    if (0 == grain) grain = 1;
+    size_t chunks  = (count + grain - 1) / grain;
+    size_t threads = std::min<size_t>(getMaxWorkerThreads(), chunks);
+    if (threads <= 1) {
+        proc(0, count);
+        return;
+    }
+
+    auto job    = std::make_shared<ParallelJob>();
+    job->proc   = &proc;
+    job->count  = count;
+    job->grain  = grain;
+    job->chunks = chunks;
+
+    // the calling thread counts as one of the threads.
+    WorkerPool::get().post(threads - 1, threads - 1, [job] { job->run(); });
+    job->run();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&] { return job->chunks == job->done; });
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+void rg::runAsync(std::function<void()> task) {
+    uint32_t threads = std::max(getMaxWorkerThreads(), 2u) - 1;
+    WorkerPool::get().post(1, threads, task);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <rg/base.h>
+#include <functional>
+
+namespace rg {
+
+///
+/// Split [0, count) into chunks of 'grain' items, and call proc(begin, end) on each chunk in parallel, using the shared
+/// worker threads and the calling thread. Returns after all chunks are done. When there's only one chunk, or
+/// multithreading is disabled by setMaxWorkerThreads(1), everything runs on the calling thread.
+///
+/// It is safe to call this function recursively from within 'proc': the calling thread always works on its own job,
+/// so it never waits for workers that are busy with something else. If 'proc' throws, the first exception is
+/// rethrown to the caller after all other chunks are done.
+///
+void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> & proc);
+
+///
+/// Run the task on one of the shared worker threads, and return right away. Tasks are queued when all workers are
+/// busy, so there are never more than getMaxWorkerThreads() - 1 workers (and at least one). The task must not throw.
+///
+void runAsync(std::function<void()> task);
+
+} // namespace rg
@@ -1,5 +1,16 @@
 #include "rg/base.h"
+#include "../src/01-base/block-codec.h"
+#include "../src/01-base/dds.h"
+#include "../src/01-base/ktx.h"
+#include "../src/01-base/pixel-convert.h"
+#include "../src/01-base/resample.h"
+#include "../src/01-base/thread-pool.h"
 #include <filesystem>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <atomic>
+#include <thread>
 
 #define CATCH_CONFIG_MAIN // Let Catch provide main():
 #include "catch.hpp"
@@ -55,6 +66,86 @@ TEST_CASE("formatstr", "[base]") {
     CHECK("abcd 10"s == rg::formatstr("abcd %d", 10));
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+/// Build a legacy DDS file of 32-bit pixels, with the RGBA channel masks. 'pixels' are all planes in FACE_MAJOR order.
+static std::string makeDDS(const uint32_t masks[4], uint32_t width, uint32_t height, uint32_t levels,
+                           const std::vector<uint8_t> & pixels, bool cubemap = false) {
+    DDSFileHeader h = {};
+    h.size          = sizeof(h);
+    h.flags         = 0x1 | 0x2 | 0x4 | 0x1000 | (levels > 1 ? 0x20000 : 0); // caps, height, width, pixel format
+    h.height        = height;
+    h.width         = width;
+    h.mipCount      = levels;
+    h.ddpf.size     = sizeof(h.ddpf);
+    h.ddpf.flags    = 0x40 | 0x1; // RGB | ALPHAPIXELS
+    h.ddpf.bits     = 32;
+    h.ddpf.rMask    = masks[0];
+    h.ddpf.gMask    = masks[1];
+    h.ddpf.bMask    = masks[2];
+    h.ddpf.aMask    = masks[3];
+    h.caps          = 0x1000 | (levels > 1 ? 0x400008 : 0) | (cubemap ? 0x8 : 0); // texture | mipmap | complex
+    h.caps2         = cubemap ? 0xFE00 : 0;                                         // cubemap | all faces
+    std::string dds = "DDS ";
+    dds.append((const char *)&h, sizeof(h));
+    dds.append((const char *)pixels.data(), pixels.size());
+    return dds;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Build a PNG file of raw pixels, with one stored (uncompressed) deflate block. 'rows' are pixels of all rows, in
+/// PNG byte order, without the filter bytes.
+static std::string makePNG(uint32_t width, uint32_t height, uint8_t bits, uint8_t colorType, const std::vector<uint8_t> & rows) {
+    auto be32 = [](std::string & s, uint32_t v) {
+        for (int i = 3; i >= 0; --i) s.push_back((char)(v >> (i * 8)));
+    };
+    auto chunk = [&](std::string & png, const char * type, const std::string & data) {
+        std::string c = type + data;
+        uint32_t    crc = 0xFFFFFFFF;
+        for (char ch : c) {
+            crc ^= (uint8_t)ch;
+            for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        be32(png, (uint32_t)data.size());
+        png += c;
+        be32(png, ~crc);
+    };
+    std::string ihdr;
+    be32(ihdr, width);
+    be32(ihdr, height);
+    ihdr += std::string {(char)bits, (char)colorType, 0, 0, 0};
+
+    // filter type 0 for each row, and the zlib stream of one stored block.
+    std::string raw;
+    size_t      pitch = rows.size() / height;
+    for (uint32_t y = 0; y < height; ++y) {
+        raw.push_back(0);
+        raw.append((const char *)rows.data() + pitch * y, pitch);
+    }
+    uint32_t a = 1, b = 0;
+    for (char ch : raw) {
+        a = (a + (uint8_t)ch) % 65521;
+        b = (b + a) % 65521;
+    }
+    auto        len  = (uint16_t)raw.size();
+    std::string idat = {0x78, 0x01, 0x01, (char)(len & 0xFF), (char)(len >> 8), (char)(~len & 0xFF), (char)((uint16_t)~len >> 8)};
+    idat += raw;
+    be32(idat, (b << 16) | a);
+
+    std::string png = "\x89PNG\r\n\x1A\n";
+    chunk(png, "IHDR", ihdr);
+    chunk(png, "IDAT", idat);
+    chunk(png, "IEND", "");
+    return png;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+/// Write the content to a file in the temp folder, and return the file path.
+static std::string writeTempFile(const std::string & name, const std::string & content) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream(path, std::ios::binary).write(content.data(), (std::streamsize)content.size());
+    return path;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // quick test of image loading from file.
 TEST_CASE("image", "[base]") {
@@ -107,6 +198,1847 @@ TEST_CASE("image", "[base]") {
         CHECK(ri.width() == 600);
         CHECK(ri.height() == 486);
     }
+    SECTION("dds mapped") {
+        // 4x4 image with 3 levels: 21 pixels.
+        std::vector<uint8_t> pixels(21 * 4);
+        for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (uint8_t)(i * 7);
+        const uint32_t rgba[] = {0xff, 0xff00, 0xff0000, 0xff000000};
+        auto           path   = writeTempFile("rg-unit-test-rgba.dds", makeDDS(rgba, 4, 4, 3, pixels));
+
+        // pixels are used in place.
+        auto mapped = RawImage::loadMapped(path);
+        REQUIRE(!mapped.empty());
+        CHECK(mapped.mapped());
+        CHECK(mapped.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(mapped.desc().levels == 3);
+        REQUIRE(mapped.size() == pixels.size());
+        CHECK(0 == memcmp(mapped.data(), pixels.data(), pixels.size()));
+
+        // same as copied.
+        auto copied = RawImage::load(path);
+        REQUIRE(copied.size() == mapped.size());
+        CHECK(!copied.mapped());
+        CHECK(0 == memcmp(mapped.data(), copied.data(), copied.size()));
+
+        // writing to the image doesn't touch the file.
+        mapped.data()[0] = 1;
+        mapped           = RawImage::loadMapped(path);
+        CHECK(mapped.data()[0] == pixels[0]);
+
+        // BGRA pixels are copied and swizzled to RGBA.
+        const uint32_t bgra[] = {0xff0000, 0xff00, 0xff, 0xff000000};
+        path                  = writeTempFile("rg-unit-test-bgra.dds", makeDDS(bgra, 4, 4, 3, pixels));
+        auto swizzled         = RawImage::loadMapped(path);
+        REQUIRE(swizzled.size() == pixels.size());
+        CHECK(!swizzled.mapped());
+        CHECK(swizzled.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        for (size_t i = 0; i < pixels.size(); i += 4) {
+            CHECK(swizzled.data()[i + 0] == pixels[i + 2]);
+            CHECK(swizzled.data()[i + 2] == pixels[i + 0]);
+        }
+
+        // missing file.
+        CHECK(RawImage::loadMapped(path + ".missing").empty());
+    }
+    SECTION("memory") {
+        std::vector<uint8_t> pixels(8 * 8 * 4);
+        for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (uint8_t)(i * 3);
+
+        // DDS
+        const uint32_t rgba[] = {0xff, 0xff00, 0xff0000, 0xff000000};
+        auto           dds    = makeDDS(rgba, 8, 8, 1, pixels);
+        auto           image  = RawImage::load(ConstRange<uint8_t>((const uint8_t *)dds.data(), dds.size()));
+        REQUIRE(image.size() == pixels.size());
+        CHECK(image.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(0 == memcmp(image.data(), pixels.data(), pixels.size()));
+
+        // truncated DDS
+        CHECK(RawImage::load(ConstRange<uint8_t>((const uint8_t *)dds.data(), dds.size() - 1)).empty());
+
+        // PNG, via stb_image
+        auto path = (std::filesystem::temp_directory_path() / "rg-unit-test-memory.png").string();
+        image.desc(0, 0).saveToPNG(path, image.data());
+        std::ifstream        f(path, std::ios::binary);
+        std::vector<uint8_t> png((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        auto                 decoded = RawImage::load(png);
+        REQUIRE(decoded.size() == pixels.size());
+        CHECK(0 == memcmp(decoded.data(), pixels.data(), pixels.size()));
+
+        // garbage
+        CHECK(RawImage::load(ConstRange<uint8_t>(pixels.data(), 16)).empty());
+    }
+    SECTION("dds subset") {
+        // 4x4 cubemap with 3 levels: 6 * 21 pixels.
+        std::vector<uint8_t> pixels(6 * 21 * 4);
+        for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (uint8_t)(i * 5);
+        const uint32_t bgra[] = {0xff0000, 0xff00, 0xff, 0xff000000};
+        auto           path   = writeTempFile("rg-unit-test-cube.dds", makeDDS(bgra, 4, 4, 3, pixels, true));
+        auto           whole  = RawImage::load(path);
+        REQUIRE(whole.desc().layers == 6);
+        REQUIRE(whole.desc().levels == 3);
+
+        // faces 2 and 3, levels 1 and 2.
+        ImageSubset subset;
+        subset.firstLayer = 2;
+        subset.layers     = 2;
+        subset.firstLevel = 1;
+        auto part         = RawImage::load(path, subset);
+        REQUIRE(part.desc().layers == 2);
+        REQUIRE(part.desc().levels == 2);
+        CHECK(part.width() == 2);
+        CHECK(part.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(part.size() == 2 * 5 * 4);
+        for (uint32_t i = 0; i < 2; ++i) {
+            for (uint32_t m = 0; m < 2; ++m) {
+                CHECK(0 == memcmp(part.data() + part.desc().pixel(i, m), whole.data() + whole.desc().pixel(i + 2, m + 1),
+                                  part.desc(i, m).size));
+            }
+        }
+
+        // the lowest level of all faces, from a stream.
+        std::ifstream f(path, std::ios::binary);
+        subset            = {};
+        subset.firstLevel = 2;
+        auto low          = RawImage::load(f, subset);
+        REQUIRE(low.desc().layers == 6);
+        REQUIRE(low.desc().levels == 1);
+        CHECK(0 == memcmp(low.data() + low.desc().pixel(5, 0), whole.data() + whole.desc().pixel(5, 2), 4));
+
+        // out of range
+        subset.firstLevel = 3;
+        CHECK(RawImage::load(path, subset).empty());
+        subset.firstLevel = 1;
+        subset.levels     = 3;
+        CHECK(RawImage::load(path, subset).empty());
+    }
+    SECTION("dds stream") {
+        // 512x512 with 10 levels spans several read chunks.
+        std::vector<uint8_t> pixels(349525 * 4);
+        for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (uint8_t)(i * 7 + i / 4093);
+        const uint32_t bgra[] = {0xff0000, 0xff00, 0xff, 0xff000000};
+        auto           dds    = makeDDS(bgra, 512, 512, 10, pixels);
+        auto           path   = writeTempFile("rg-unit-test-stream.dds", dds);
+        auto           rgba   = pixels;
+        for (size_t i = 0; i < rgba.size(); i += 4) std::swap(rgba[i], rgba[i + 2]);
+
+        // whole image, from a stream and from memory.
+        std::ifstream f(path, std::ios::binary);
+        auto          streamed = RawImage::load(f);
+        REQUIRE(streamed.size() == rgba.size());
+        CHECK(streamed.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(0 == memcmp(streamed.data(), rgba.data(), rgba.size()));
+        auto copied = RawImage::load(ConstRange<uint8_t>((const uint8_t *)dds.data(), dds.size()));
+        REQUIRE(copied.size() == rgba.size());
+        CHECK(0 == memcmp(copied.data(), rgba.data(), rgba.size()));
+
+        // levels 1 and below, from a stream.
+        ImageSubset subset;
+        subset.firstLevel = 1;
+        std::ifstream g(path, std::ios::binary);
+        auto          part = RawImage::load(g, subset);
+        REQUIRE(part.desc().levels == 9);
+        size_t first = streamed.desc().pixel(0, 1);
+        REQUIRE(part.size() == rgba.size() - first);
+        CHECK(0 == memcmp(part.data(), rgba.data() + first, part.size()));
+
+        // truncated stream
+        std::istringstream truncated(dds.substr(0, dds.size() - 1));
+        CHECK(RawImage::load(truncated).empty());
+
+        // from the only worker thread, which can't prefetch chunks for itself.
+        auto saved = getMaxWorkerThreads();
+        setMaxWorkerThreads(2);
+        auto async = RawImage::loadAsync(path).get();
+        setMaxWorkerThreads(saved);
+        REQUIRE(async.size() == rgba.size());
+        CHECK(0 == memcmp(async.data(), rgba.data(), rgba.size()));
+    }
+    SECTION("probe") {
+        std::vector<uint8_t> pixels(21 * 4);
+        const uint32_t       rgba[] = {0xff, 0xff00, 0xff0000, 0xff000000};
+        auto                 dds    = makeDDS(rgba, 4, 4, 3, pixels);
+
+        // DDS from memory and stream
+        auto desc = probeImage(ConstRange<uint8_t>((const uint8_t *)dds.data(), dds.size()));
+        CHECK(desc.plane(0, 0).format == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(desc.plane(0, 0).width == 4);
+        CHECK(desc.levels == 3);
+        CHECK(desc.size == pixels.size());
+        std::istringstream ss(dds);
+        CHECK(probeImage(ss).size == desc.size);
+
+        // a folder of DDS, PNG and non-image files
+        auto dir = std::filesystem::temp_directory_path() / "rg-unit-test-probe";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir / "sub");
+        std::ofstream((dir / "a.dds").string(), std::ios::binary).write(dds.data(), (std::streamsize)dds.size());
+        std::ofstream((dir / "b.txt").string()) << "not an image";
+        auto image = RawImage::load(ConstRange<uint8_t>((const uint8_t *)dds.data(), dds.size()));
+        image.desc(0, 1).saveToPNG((dir / "sub" / "c.png").string(), image.data() + image.desc().pixel(0, 1));
+
+        auto probed = probeImages(dir.string());
+        REQUIRE(probed.size() == 1);
+        CHECK(probed[0].desc.levels == 3);
+
+        probed = probeImages(dir.string(), true);
+        REQUIRE(probed.size() == 2);
+        CHECK(std::filesystem::path(probed[1].path).filename() == "c.png");
+        CHECK(probed[1].desc.plane(0, 0).width == 2);
+        CHECK(probed[1].desc.plane(0, 0).height == 2);
+        CHECK(probed[1].desc.size == RawImage::load(probed[1].path).size());
+
+        CHECK(probeImages((dir / "missing").string()).empty());
+        CHECK(probeImages((dir / "a.dds").string(), true).empty());
+    }
+    SECTION("ktx") {
+        // 7x5 image of 3 layers and all levels.
+        auto image = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_8_8_8_8_UNORM(), 7, 5), 3, 0));
+        for (uint32_t i = 0; i < image.size(); ++i) image.data()[i] = (uint8_t)(i * 11);
+        auto same = [&](const RawImage & loaded, uint32_t firstLayer, uint32_t firstLevel) {
+            for (uint32_t i = 0; i < loaded.desc().layers; ++i) {
+                for (uint32_t m = 0; m < loaded.desc().levels; ++m) {
+                    const auto & p = loaded.desc(i, m);
+                    REQUIRE(p.size == image.desc(i + firstLayer, m + firstLevel).size);
+                    if (0 != memcmp(loaded.data() + p.offset, image.proxy().pixel(i + firstLayer, m + firstLevel), p.size)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        };
+
+        // round trip, with and without zlib.
+        for (bool zlib : {false, true}) {
+            std::ostringstream os;
+            REQUIRE(image.saveKTX2(os, zlib));
+            auto ktx    = os.str();
+            auto loaded = RawImage::load(ConstRange<uint8_t>((const uint8_t *)ktx.data(), ktx.size()));
+            REQUIRE(loaded.desc().layers == 3);
+            REQUIRE(loaded.desc().levels == 3);
+            CHECK(loaded.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+            CHECK(same(loaded, 0, 0));
+            CHECK(probeImage(ConstRange<uint8_t>((const uint8_t *)ktx.data(), ktx.size())).size == image.size());
+
+            // layer 1 and level 1 and 2 only.
+            std::istringstream is(ktx);
+            ImageSubset        subset;
+            subset.firstLayer = 1;
+            subset.layers     = 1;
+            subset.firstLevel = 1;
+            auto part         = RawImage::load(is, subset);
+            REQUIRE(part.desc().layers == 1);
+            REQUIRE(part.desc().levels == 2);
+            CHECK(same(part, 1, 1));
+        }
+
+        // compressed
+        auto bc1 = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::DXT1_UNORM(), 8, 8), 1, 0));
+        for (uint32_t i = 0; i < bc1.size(); ++i) bc1.data()[i] = (uint8_t)(i * 13);
+        auto path = (std::filesystem::temp_directory_path() / "rg-unit-test-bc1.ktx2").string();
+        REQUIRE(bc1.saveKTX2(path));
+        auto loaded = RawImage::load(path);
+        CHECK(loaded.format() == ColorFormat::DXT1_UNORM());
+        REQUIRE(loaded.size() == bc1.size());
+        CHECK(0 == memcmp(loaded.data(), bc1.data(), bc1.size()));
+
+        // no Vulkan format
+        CHECK(!RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::L_8_UNORM(), 4, 4))).saveKTX2(path));
+
+        // cube array of 2 cubemaps: 6 faces and 2 layers in the header, 12 layers when loaded.
+        auto cube = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_8_8_8_8_UNORM(), 4, 4), 12, 0));
+        for (uint32_t i = 0; i < cube.size(); ++i) cube.data()[i] = (uint8_t)(i * 3);
+        for (uint32_t layers : {6u, 12u}) {
+            auto               faces = RawImage(ImageDesc(cube.desc(0, 0), layers, cube.desc().levels));
+            std::ostringstream os;
+            memcpy(faces.data(), cube.data(), faces.size());
+            REQUIRE(faces.saveKTX2(os, false, true));
+            auto           ktx = os.str();
+            KTX2FileHeader h;
+            memcpy(&h, ktx.data() + 12, sizeof(h));
+            CHECK(h.faceCount == 6);
+            CHECK(h.layerCount == (12 == layers ? 2 : 0));
+            auto loaded = RawImage::load(ConstRange<uint8_t>((const uint8_t *)ktx.data(), ktx.size()));
+            REQUIRE(loaded.desc().layers == layers);
+            REQUIRE(loaded.size() == faces.size());
+            for (uint32_t i = 0; i < layers; ++i) {
+                CHECK(0 == memcmp(loaded.data() + loaded.desc().pixel(i, 1), faces.data() + faces.desc().pixel(i, 1),
+                                  faces.desc(i, 1).size));
+            }
+        }
+        CHECK(!image.saveKTX2(path, false, true));
+
+        // DFD of compressed formats: color model, then channel id of each sample.
+        auto dfd = [](ColorFormat format) {
+            std::ostringstream os;
+            REQUIRE(RawImage(ImageDesc(ImagePlaneDesc::make(format, 4, 4))).saveKTX2(os));
+            auto           ktx = os.str();
+            KTX2FileHeader h;
+            memcpy(&h, ktx.data() + 12, sizeof(h));
+            std::vector<uint32_t> words(h.dfdByteLength / 4);
+            memcpy(words.data(), ktx.data() + h.dfdByteOffset, h.dfdByteLength);
+            std::vector<uint32_t> ids = {words[3] & 0xFF};
+            for (size_t i = 7; i < words.size(); i += 4) ids.push_back((words[i] >> 24) & 0xF);
+            return ids;
+        };
+        CHECK(dfd(ColorFormat::DXT1_UNORM()) == std::vector<uint32_t> {128, 1});
+        CHECK(dfd(ColorFormat::ETC2_UNORM()) == std::vector<uint32_t> {161, 2});
+        CHECK(dfd(ColorFormat::ETC2_EAC_UNORM()) == std::vector<uint32_t> {161, 15, 2});
+        CHECK(dfd(ColorFormat::EAC_RG11_UNORM()) == std::vector<uint32_t> {161, 0, 1});
+        CHECK(dfd(ColorFormat::DXT5_UNORM()) == std::vector<uint32_t> {130, 15, 0});
+
+        // KTX1 of 3x2 RGB8 pixels, with rows padded to 4 bytes.
+        const uint8_t  id[] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+        KTX1FileHeader h    = {};
+        h.endianness        = 0x04030201;
+        h.glType            = 0x1401; // GL_UNSIGNED_BYTE
+        h.glTypeSize        = 1;
+        h.glFormat          = 0x1907; // GL_RGB
+        h.glInternalFormat  = 0x8051; // GL_RGB8
+        h.pixelWidth        = 3;
+        h.pixelHeight       = 2;
+        h.numberOfFaces     = 1;
+        uint32_t    imageSize = 2 * 12;
+        std::string ktx1((const char *)id, sizeof(id));
+        ktx1.append((const char *)&h, sizeof(h));
+        ktx1.append((const char *)&imageSize, 4);
+        for (uint32_t i = 0; i < imageSize; ++i) ktx1.push_back((char)(i % 12 < 9 ? i : 0xFF));
+        auto rgb = RawImage::load(ConstRange<uint8_t>((const uint8_t *)ktx1.data(), ktx1.size()));
+        REQUIRE(rgb.format() == ColorFormat::RGB_8_8_8_UNORM());
+        REQUIRE(rgb.size() == 18);
+        for (uint32_t i = 0; i < 18; ++i) CHECK(rgb.data()[i] == (uint8_t)(i / 9 * 12 + i % 9));
+    }
+    SECTION("dds write") {
+        auto make = [](ColorFormat format, uint32_t layers, ImageDesc::ConsructionOrder order) {
+            auto image = RawImage(ImageDesc(ImagePlaneDesc::make(format, 8, 8), layers, 0, order));
+            for (uint32_t i = 0; i < image.size(); ++i) image.data()[i] = (uint8_t)(i * 7);
+            return image;
+        };
+        auto same = [](const RawImage & a, const RawImage & b) {
+            if (a.desc().layers != b.desc().layers || a.desc().levels != b.desc().levels) return false;
+            for (uint32_t i = 0; i < a.desc().layers; ++i) {
+                for (uint32_t m = 0; m < a.desc().levels; ++m) {
+                    if (a.format(i, m) != b.format(i, m) || a.desc(i, m).size != b.desc(i, m).size) return false;
+                    if (0 != memcmp(a.proxy().pixel(i, m), b.proxy().pixel(i, m), a.desc(i, m).size)) return false;
+                }
+            }
+            return true;
+        };
+        auto path = (std::filesystem::temp_directory_path() / "rg-unit-test-write.dds").string();
+
+        // legacy header. The tightly packed FACE_MAJOR image is written as header and one chunk of pixels.
+        auto rgba = make(ColorFormat::RGBA_8_8_8_8_UNORM(), 1, ImageDesc::FACE_MAJOR);
+        {
+            DDSWriter dds;
+            REQUIRE(dds.prepare(rgba.proxy()));
+            REQUIRE(dds.chunks().size() == 2);
+            CHECK(dds.chunks()[1].data() == rgba.data());
+            CHECK(dds.chunks()[1].size() == rgba.size());
+        }
+        REQUIRE(rgba.saveDDS(path));
+        CHECK(same(RawImage::load(path), rgba));
+
+        // MIP_MAJOR cubemap, with the legacy header.
+        auto cube = make(ColorFormat::RGBA_16_16_16_16_FLOAT(), 6, ImageDesc::MIP_MAJOR);
+        REQUIRE(cube.saveDDS(path, true));
+        auto loaded = RawImage::load(path);
+        CHECK(same(loaded, cube));
+
+        // arrays and formats without legacy equivalent go with the DX10 header.
+        for (auto format : {ColorFormat::RGBA_8_8_8_8_UNORM_SRGB(), ColorFormat::BC7_UNORM(), ColorFormat::DXT1_UNORM()}) {
+            auto array = make(format, 3, ImageDesc::FACE_MAJOR);
+            std::stringstream ss;
+            REQUIRE(array.saveDDS(ss));
+            CHECK(same(RawImage::load(ss), array));
+        }
+
+        // BGRA pixels are swizzled to RGBA by the reader.
+        auto bgra = make(ColorFormat::BGRA_8_8_8_8_UNORM(), 1, ImageDesc::FACE_MAJOR);
+        REQUIRE(bgra.saveDDS(path));
+        loaded = RawImage::load(path);
+        REQUIRE(loaded.size() == bgra.size());
+        CHECK(loaded.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(loaded.data()[0] == bgra.data()[2]);
+
+        // not supported
+        CHECK(!make(ColorFormat::ETC2_UNORM(), 1, ImageDesc::FACE_MAJOR).saveDDS(path));
+        CHECK(!make(ColorFormat::RGBA8(), 5, ImageDesc::FACE_MAJOR).saveDDS(path, true));
+    }
+    SECTION("native format") {
+        auto load = [](const std::string & file, ColorFormat format = ColorFormat::UNKNOWN()) {
+            return RawImage::load(ConstRange<uint8_t>((const uint8_t *)file.data(), file.size()), format);
+        };
+
+        // 8-bit gray, and gray + alpha
+        auto gray = makePNG(3, 2, 8, 0, {1, 2, 3, 4, 5, 6});
+        auto l8   = load(gray);
+        REQUIRE(l8.format() == ColorFormat::L_8_UNORM());
+        REQUIRE(l8.size() == 6);
+        CHECK(l8.data()[4] == 5);
+        CHECK(probeImage(ConstRange<uint8_t>((const uint8_t *)gray.data(), gray.size())).size == 6);
+        CHECK(load(makePNG(1, 1, 8, 4, {7, 8})).format() == ColorFormat::LA_8_8_UNORM());
+
+        // 8-bit RGB
+        auto rgb = load(makePNG(1, 1, 8, 2, {9, 10, 11}));
+        REQUIRE(rgb.format() == ColorFormat::RGB_8_8_8_UNORM());
+        CHECK(rgb.data()[2] == 11);
+
+        // 16-bit gray keeps all bits. 16-bit RGB is padded with alpha.
+        auto l16 = load(makePNG(2, 1, 16, 0, {0x12, 0x34, 0xAB, 0xCD}));
+        REQUIRE(l16.format() == ColorFormat::L_16_UNORM());
+        CHECK(((const uint16_t *)l16.data())[0] == 0x1234);
+        CHECK(((const uint16_t *)l16.data())[1] == 0xABCD);
+        auto rgb16 = load(makePNG(1, 1, 16, 2, {0, 1, 0, 2, 0, 3}));
+        REQUIRE(rgb16.format() == ColorFormat::RGBA_16_16_16_16_UNORM());
+        CHECK(((const uint16_t *)rgb16.data())[2] == 3);
+        CHECK(((const uint16_t *)rgb16.data())[3] == 0xFFFF);
+
+        // HDR is not clamped.
+        std::string hdr = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 1 +X 2\n";
+        hdr += std::string {(char)192, (char)192, (char)192, (char)129, (char)128, 0, 0, (char)(128 + 8)}; // 1.5, 128
+        auto f32 = load(hdr);
+        REQUIRE(f32.format() == ColorFormat::RGB_32_32_32_FLOAT());
+        CHECK(((const float *)f32.data())[0] == 1.5f);
+        CHECK(((const float *)f32.data())[3] == 128.0f);
+
+        // fixed output format, decoded directly, or converted.
+        auto rgba8 = load(gray, ColorFormat::RGBA_8_8_8_8_UNORM());
+        REQUIRE(rgba8.format() == ColorFormat::RGBA_8_8_8_8_UNORM());
+        CHECK(rgba8.data()[4] == 2);
+        CHECK(rgba8.data()[7] == 255);
+        auto half = load(hdr, ColorFormat::RGBA_16_16_16_16_FLOAT());
+        REQUIRE(half.format() == ColorFormat::RGBA_16_16_16_16_FLOAT());
+        CHECK(halfToFloat(((const uint16_t *)half.data())[4]) == 128.0f);
+        CHECK(load(gray, ColorFormat::DXT1_UNORM()).format() == ColorFormat::DXT1_UNORM());
+    }
+    SECTION("adopt") {
+        auto desc    = ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 4, 4), 1, 0);
+        auto pixels  = new uint8_t[desc.size];
+        int  deleted = 0;
+        {
+            auto image = RawImage::adopt(desc, pixels, [&](void * p) {
+                CHECK(p == pixels);
+                delete[] static_cast<uint8_t *>(p);
+                ++deleted;
+            });
+            REQUIRE(image.data() == pixels);
+            CHECK(image.external());
+            CHECK(!image.mapped());
+            auto moved = std::move(image);
+            CHECK(moved.data() == pixels);
+            CHECK(0 == deleted);
+        }
+        CHECK(1 == deleted);
+
+        // storage shared with others outlives the image.
+        auto storage = std::make_shared<std::vector<uint8_t>>(desc.size, (uint8_t)3);
+        auto shared  = RawImage::adopt(desc, storage->data(), storage);
+        CHECK(2 == storage.use_count());
+        shared = {};
+        CHECK(1 == storage.use_count());
+
+        // stb_image buffers are adopted as they are.
+        auto png = makePNG(2, 2, 8, 6, std::vector<uint8_t>(16, 9));
+        auto rgba = RawImage::load(ConstRange<uint8_t>((const uint8_t *)png.data(), png.size()));
+        REQUIRE(rgba.size() == 16);
+        CHECK(rgba.external());
+        CHECK(rgba.data()[15] == 9);
+
+        // invalid
+        CHECK(RawImage::adopt(desc, nullptr, storage).empty());
+    }
+    SECTION("async") {
+        // 8 DDS files of different sizes, and a missing one.
+        const uint32_t           rgba[] = {0xff, 0xff00, 0xff0000, 0xff000000};
+        std::vector<std::string> paths;
+        for (uint32_t i = 0; i < 8; ++i) {
+            uint32_t             w = 4 << (i % 3);
+            std::vector<uint8_t> pixels(w * w * 4, (uint8_t)i);
+            paths.push_back(writeTempFile("rg-unit-test-async-" + std::to_string(i) + ".dds", makeDDS(rgba, w, w, 1, pixels)));
+        }
+        paths.push_back(paths[0] + ".missing");
+
+        auto future = RawImage::loadAsync(paths[2]);
+        auto image  = future.get();
+        REQUIRE(image.width() == 16);
+        CHECK(image.data()[0] == 2);
+        CHECK(RawImage::loadAsync(paths.back()).get().empty());
+
+        // a budget smaller than any file loads them one at a time. A large one lets 3 threads load at the same time.
+        for (size_t budget : {(size_t)1, (size_t)1 << 30}) {
+            ImageLoadOptions options;
+            options.maxThreads       = 3;
+            options.maxBytesInFlight = budget;
+            std::vector<int> seen(paths.size());
+            RawImage::loadMany(paths, [&](size_t index, RawImage && loaded, const ImageLoadTiming & timing) {
+                ++seen[index];
+                if (index == paths.size() - 1) {
+                    CHECK(loaded.empty());
+                    return;
+                }
+                REQUIRE(!loaded.empty());
+                CHECK(loaded.data()[0] == (uint8_t)index);
+                CHECK(timing.bytes == loaded.size());
+            }, options);
+            CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return 1 == n; }));
+        }
+
+        // the budget counts both copies of converted images. Single threaded loading still loads everything.
+        auto saved = getMaxWorkerThreads();
+        setMaxWorkerThreads(1);
+        ImageLoadOptions options;
+        options.format = ColorFormat::RGBA_32_32_32_32_FLOAT();
+        size_t loaded  = 0;
+        RawImage::loadMany({paths[0], paths[1]}, [&](size_t, RawImage && image, const ImageLoadTiming & timing) {
+            REQUIRE(image.format() == options.format);
+            CHECK(timing.bytes == image.size() + image.size() / 4);
+            ++loaded;
+        }, options);
+        setMaxWorkerThreads(saved);
+        CHECK(2 == loaded);
+
+        // the first exception of the callback goes to the caller.
+        CHECK_THROWS_AS(RawImage::loadMany(paths, [](size_t, RawImage &&, const ImageLoadTiming &) {
+            throw std::runtime_error("stop");
+        }), std::runtime_error);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// specialized pixel converters must produce exactly the same result as the generic one.
+TEST_CASE("pixel-convert", "[base]") {
+    const ColorFormat formats[] = {
+        ColorFormat::RGBA_8_8_8_8_UNORM(),
+        ColorFormat::RGBA_8_8_8_8_UNORM_SRGB(),
+        ColorFormat::RGBA_8_8_8_8_SNORM(),
+        ColorFormat::BGRA_8_8_8_8_UNORM(),
+        ColorFormat::BGRX_8_8_8_8_UNORM(),
+        ColorFormat::RGB_8_8_8_UNORM(),
+        ColorFormat::L_8_UNORM(),
+        ColorFormat::R_8_SNORM(),
+        ColorFormat::RGB_3_3_2_UNORM(),
+        ColorFormat::BGR_5_6_5_UNORM(),
+        ColorFormat::BGRA_5_5_5_1_UNORM(),
+        ColorFormat::BGRA_4_4_4_4_UNORM(),
+        ColorFormat::RGBA_10_10_10_2_UNORM(),
+        ColorFormat::RGBA_10_10_10_SNORM_2_UNORM(),
+        ColorFormat::RGB_11_11_10_FLOAT(),
+        ColorFormat::RG_16_16_FLOAT(),
+        ColorFormat::RGBA_16_16_16_16_FLOAT(),
+        ColorFormat::RGBA_16_16_16_16_UNORM(),
+        ColorFormat::RGBA_16_16_16_16_SNORM(),
+        ColorFormat::RGBA_16_16_16_16_SINT(),
+        ColorFormat::R_32_UNORM(),
+        ColorFormat::R_32_SINT(),
+        ColorFormat::RGB_32_32_32_FLOAT(),
+        ColorFormat::RGBA_32_32_32_32_UINT(),
+        ColorFormat::RGBA_32_32_32_32_FLOAT(),
+    };
+    const size_t count = 64;
+    std::mt19937 rng(1234);
+    std::vector<uint8_t> src(count * 16 + 16); // extra room since the generic path may read a full 128-bit pixel.
+    for (auto & b : src) b = (uint8_t)rng();
+    for (auto f : formats) {
+        const auto & specialized = getPixelRowConverters(f);
+        const auto & generic = getGenericPixelRowConverters();
+        REQUIRE(specialized.specialized);
+        size_t step = f.bytesPerBlock();
+        std::vector<float4> f1(count), f2(count);
+        specialized.toFloat4(f, f1.data(), src.data(), count, step);
+        generic.toFloat4(f, f2.data(), src.data(), count, step);
+        CHECK(0 == memcmp(f1.data(), f2.data(), count * sizeof(float4)));
+        std::vector<RGBA8> c1(count), c2(count);
+        specialized.toRGBA8(f, c1.data(), src.data(), count, step);
+        generic.toRGBA8(f, c2.data(), src.data(), count, step);
+        CHECK(0 == memcmp(c1.data(), c2.data(), count * sizeof(RGBA8)));
+        // encode random bits (covers NaN and Inf) and the values that were just decoded.
+        std::vector<uint8_t> p1(count * step), p2(count * step);
+        for (auto colors : { (const float4 *)src.data(), (const float4 *)f1.data() }) {
+            specialized.fromFloat4(f, p1.data(), colors, count, step);
+            generic.fromFloat4(f, p2.data(), colors, count, step);
+            CHECK(0 == memcmp(p1.data(), p2.data(), p1.size()));
+        }
+    }
+
+    SECTION("swizzle") {
+        // BGR_5_6_5: blue in the lowest 5 bits.
+        uint16_t pixel = 0x001f;
+        RGBA8 c;
+        getPixelRowConverters(ColorFormat::BGR_5_6_5_UNORM()).toRGBA8(ColorFormat::BGR_5_6_5_UNORM(), &c, (const uint8_t*)&pixel, 1, 2);
+        CHECK(c.x == 0);
+        CHECK(c.y == 0);
+        CHECK(c.z == 255);
+        CHECK(c.w == 255);
+    }
+
+    SECTION("srgb") {
+        // 8-bit sRGB -> float -> 8-bit sRGB must be lossless.
+        auto srgb = ColorFormat::RGBA_8_8_8_8_UNORM_SRGB();
+        std::vector<uint8_t> bytes(256 * 4), back(256 * 4);
+        for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = (uint8_t)(i / 4);
+        std::vector<float4> linear(256);
+        getPixelRowConverters(srgb).toFloat4(srgb, linear.data(), bytes.data(), 256, 4);
+        getPixelRowConverters(srgb).fromFloat4(srgb, back.data(), linear.data(), 256, 4);
+        CHECK(0 == memcmp(bytes.data(), back.data(), bytes.size()));
+        // color channels are decoded to linear space, alpha is not.
+        CHECK(linear[0].x == 0.0f);
+        CHECK(linear[255].x == 1.0f);
+        CHECK(std::abs(linear[128].x - 0.2158605f) < 1e-6f);
+        CHECK(linear[128].w == 128.0f / 255.0f);
+        // the fast encoder must match the analytic one.
+        float4 in[2] = { { 0.2158605f, 0.5f, 0.0031308f, 0.5f }, { 2.0f, -1.0f, NAN, 1.0f } };
+        uint8_t out[8];
+        getPixelRowConverters(srgb).fromFloat4(srgb, out, in, 2, 4);
+        CHECK(out[0] == 128);
+        CHECK(out[1] == 188); // 255 * 1.055 * 0.5^(1/2.4) - 0.055 = 187.5
+        CHECK(out[2] == 10);
+        CHECK(out[3] == 128);
+        CHECK(out[4] == 255);
+        CHECK(out[5] == 0);
+        CHECK(out[6] == 0);
+        CHECK(out[7] == 255);
+    }
+
+    SECTION("signed") {
+        float4 f[3];
+        // SNORM: both -128 and -127 are -1.
+        auto snorm8 = ColorFormat::R_8_SNORM();
+        const uint8_t s8[] = { 0x80, 0x81, 0x7f };
+        getPixelRowConverters(snorm8).toFloat4(snorm8, f, s8, 3, 1);
+        CHECK(f[0].x == -1.0f);
+        CHECK(f[1].x == -1.0f);
+        CHECK(f[2].x == 1.0f);
+        uint8_t e[3];
+        getPixelRowConverters(snorm8).fromFloat4(snorm8, e, f, 3, 1);
+        CHECK(e[0] == 0x81);
+        CHECK(e[1] == 0x81);
+        CHECK(e[2] == 0x7f);
+        // SINT: sign extended
+        auto sint32 = ColorFormat::R_32_SINT();
+        const int32_t s32[] = { -5, 7, INT32_MIN };
+        getPixelRowConverters(sint32).toFloat4(sint32, f, (const uint8_t *)s32, 3, 4);
+        CHECK(f[0].x == -5.0f);
+        CHECK(f[1].x == 7.0f);
+        CHECK(f[2].x == -2147483648.0f);
+        // SNORM to RGBA8 clamps negative values to 0.
+        RGBA8 c[3];
+        getPixelRowConverters(snorm8).toRGBA8(snorm8, c, s8, 3, 1);
+        CHECK(c[0].x == 0);
+        CHECK(c[2].x == 255);
+    }
+
+    SECTION("extract") {
+        // reference: pick the channel bit by bit.
+        auto reference = [](const uint8_t * pixel, uint32_t shift, uint32_t bits) {
+            uint32_t v = 0;
+            for (uint32_t i = 0; i < bits; ++i) v |= (uint32_t)((pixel[(shift + i) / 8] >> ((shift + i) % 8)) & 1) << i;
+            return v;
+        };
+        const uint32_t n = 37;
+        for (uint32_t pixelBytes : { 1u, 3u, 5u, 12u, 16u }) {
+            // the buffer holds exactly n pixels, so reading past the last pixel would be caught by address sanitizer.
+            std::vector<uint8_t> pixels(n * pixelBytes);
+            for (auto & b : pixels) b = (uint8_t)rng();
+            for (uint32_t shift = 0; shift < pixelBytes * 8; shift += 3) {
+                for (uint32_t bits : { 1u, 7u, 13u, 24u, 32u }) {
+                    if (shift + bits > pixelBytes * 8) continue;
+                    INFO("pixelBytes=" << pixelBytes << " shift=" << shift << " bits=" << bits);
+                    std::vector<uint32_t> values(n);
+                    extractChannel(values.data(), pixels.data(), n, pixelBytes, pixelBytes, shift, bits);
+                    for (uint32_t i = 0; i < n; ++i) {
+                        if (values[i] != reference(&pixels[i * pixelBytes], shift, bits)) FAIL("mismatch at " << i);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+TEST_CASE("convert", "[base]") {
+    auto make = [](ColorFormat format) {
+        return RawImage(ImageDesc(ImagePlaneDesc::make(format, 37, 19), 2, 0));
+    };
+    auto conv = [](const RawImage & from, RawImage & to) {
+        ImageProxy dst = to.proxy();
+        return convert(from.proxy(), dst);
+    };
+    std::mt19937 rng(42);
+    auto rgba8 = make(ColorFormat::RGBA8());
+    for (uint32_t i = 0; i < rgba8.size(); ++i) rgba8.data()[i] = (uint8_t)rng();
+
+    SECTION("lossless round trip") {
+        for (auto f : { ColorFormat::BGRA8(), ColorFormat::RGBA_16_16_16_16_UNORM(), ColorFormat::RGBA_32_32_32_32_FLOAT(),
+                        ColorFormat::RGBA_16_16_16_16_FLOAT(), ColorFormat::RGBA_10_10_10_2_UNORM() }) {
+            auto temp = make(f);
+            auto back = make(ColorFormat::RGBA8());
+            REQUIRE(conv(rgba8, temp));
+            REQUIRE(conv(temp, back));
+            if (ColorFormat::RGBA_10_10_10_2_UNORM() == f) {
+                // 2-bit alpha can't hold 8-bit alpha. Only check RGB.
+                for (uint32_t i = 0; i < rgba8.size(); ++i) back.data()[i] = (i % 4 == 3) ? rgba8.data()[i] : back.data()[i];
+            }
+            CHECK(0 == memcmp(rgba8.data(), back.data(), rgba8.size()));
+        }
+    }
+
+    SECTION("uint") {
+        // UNORM [0, 1] rounds to UINT 0 or 1, since UINT channels store the raw value.
+        auto temp = make(ColorFormat::RGBA_32_32_32_32_UINT());
+        REQUIRE(conv(rgba8, temp));
+        auto p = (const uint32_t *)temp.data();
+        for (uint32_t i = 0; i < rgba8.size(); ++i) {
+            if (p[i] != (rgba8.data()[i] >= 128 ? 1u : 0u)) FAIL("mismatch at " << i);
+        }
+    }
+
+    SECTION("routes") {
+        auto direct = [](ColorFormat a, ColorFormat b) { return getPixelConversion(a, b)->direct; };
+        CHECK(direct(ColorFormat::BGR_5_6_5_UNORM(), ColorFormat::RGBA8()));
+        CHECK(direct(ColorFormat::RGBA8(), ColorFormat::BGRA8()));
+        CHECK(direct(ColorFormat::RGBA_32_32_32_32_FLOAT(), ColorFormat::RGB_11_11_10_FLOAT()));
+        CHECK(!direct(ColorFormat::BGR_5_6_5_UNORM(), ColorFormat::R_16_FLOAT()));
+        CHECK(getPixelConversion(ColorFormat::RGBA8(), ColorFormat::BGRA8()) == getPixelConversion(ColorFormat::RGBA8(), ColorFormat::BGRA8()));
+        CHECK(nullptr == getPixelConversion(ColorFormat::DXT1_UNORM(), ColorFormat::RGBA8()));
+    }
+
+    SECTION("two hops") {
+        // 565 -> R16F goes through float4, must match 565 -> float4 -> R16F
+        auto src = make(ColorFormat::BGR_5_6_5_UNORM());
+        for (uint32_t i = 0; i < src.size(); ++i) src.data()[i] = (uint8_t)rng();
+        auto dst  = make(ColorFormat::R_16_FLOAT());
+        auto temp = make(ColorFormat::RGBA_32_32_32_32_FLOAT());
+        auto ref  = make(ColorFormat::R_16_FLOAT());
+        REQUIRE(conv(src, dst));
+        REQUIRE(conv(src, temp));
+        REQUIRE(conv(temp, ref));
+        CHECK(0 == memcmp(dst.data(), ref.data(), dst.size()));
+    }
+
+    SECTION("multithreaded") {
+        // large enough to be split into many row bands, with multiple slices.
+        auto make3d = [](ColorFormat format) { return RawImage(ImageDesc(ImagePlaneDesc::make(format, 301, 257, 5), 1, 0)); };
+        auto src = make3d(ColorFormat::BGR_5_6_5_UNORM());
+        for (uint32_t i = 0; i < src.size(); ++i) src.data()[i] = (uint8_t)rng();
+        auto single = make3d(ColorFormat::RGBA_16_16_16_16_FLOAT());
+        auto multi  = make3d(ColorFormat::RGBA_16_16_16_16_FLOAT());
+        auto saved  = getMaxWorkerThreads();
+        setMaxWorkerThreads(1);
+        REQUIRE(conv(src, single));
+        setMaxWorkerThreads(4);
+        REQUIRE(conv(src, multi));
+        setMaxWorkerThreads(saved);
+        CHECK(0 == memcmp(single.data(), multi.data(), single.size()));
+    }
+
+    SECTION("mismatch") {
+        auto small = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 16, 16), 2, 0));
+        CHECK(!conv(rgba8, small));
+        // ETC2 has no encoder.
+        auto etc = make(ColorFormat::ETC2_UNORM());
+        CHECK(!conv(rgba8, etc));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+TEST_CASE("mipmap", "[base]") {
+    auto make = [](ColorFormat format, uint32_t w, uint32_t h, uint32_t layers,
+                   ImageDesc::ConsructionOrder order = ImageDesc::MIP_MAJOR) {
+        return RawImage(ImageDesc(ImagePlaneDesc::make(format, w, h), layers, 0, order));
+    };
+    std::mt19937 rng(42);
+
+    SECTION("box") {
+        auto image = make(ColorFormat::RGBA8(), 4, 4, 1);
+        REQUIRE(3 == image.desc().levels);
+        for (uint32_t i = 0; i < 64; ++i) image.data()[i] = (uint8_t)(i * 4);
+        REQUIRE(generateMipmaps(image));
+        // each pixel of level 1 is the average of a 2x2 quad of level 0.
+        for (uint32_t y = 0; y < 2; ++y) {
+            for (uint32_t x = 0; x < 2; ++x) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    auto     p0  = [&](uint32_t dx, uint32_t dy) { return (uint32_t)image.proxy().pixel(0, 0, x * 2 + dx, y * 2 + dy)[c]; };
+                    uint32_t avg = (p0(0, 0) + p0(1, 0) + p0(0, 1) + p0(1, 1) + 2) / 4;
+                    CHECK(avg == image.proxy().pixel(0, 1, x, y)[c]);
+                }
+            }
+        }
+        CHECK(image.proxy().pixel(0, 2)[0] == (uint8_t)((image.proxy().pixel(0, 1, 0, 0)[0] + image.proxy().pixel(0, 1, 1, 0)[0] +
+                                                          image.proxy().pixel(0, 1, 0, 1)[0] + image.proxy().pixel(0, 1, 1, 1)[0] + 2) / 4));
+    }
+
+    SECTION("srgb") {
+        // black and white average to 50% linear intensity, which is 188 in sRGB, not 128.
+        auto image = make(ColorFormat::RGBA_8_8_8_8_UNORM_SRGB(), 2, 1, 1);
+        const uint8_t pixels[] = { 0, 0, 0, 0, 255, 255, 255, 255 };
+        memcpy(image.data(), pixels, 8);
+        REQUIRE(generateMipmaps(image));
+        auto p = image.proxy().pixel(0, 1);
+        CHECK(188 == p[0]);
+        CHECK(188 == p[2]);
+        CHECK(128 == p[3]); // alpha is linear.
+    }
+
+    SECTION("constant") {
+        // weights of all filters add up to 1, at any size and near the edges.
+        for (auto filter : { ImageFilter::BOX, ImageFilter::TRIANGLE, ImageFilter::KAISER, ImageFilter::LANCZOS }) {
+            auto image = make(ColorFormat::RGBA8(), 37, 19, 2);
+            memset(image.data(), 100, image.size());
+            REQUIRE(generateMipmaps(image, filter));
+            for (uint32_t i = 0; i < image.size(); ++i) {
+                if (100 != image.data()[i]) FAIL("filter " << (int)filter << " mismatch at " << i);
+            }
+        }
+    }
+
+    SECTION("face-major") {
+        auto mip  = make(ColorFormat::RGBA_16_16_16_16_FLOAT(), 33, 20, 6);
+        auto face = make(ColorFormat::RGBA_16_16_16_16_FLOAT(), 33, 20, 6, ImageDesc::FACE_MAJOR);
+        for (uint32_t l = 0; l < 6; ++l) {
+            auto p = (uint16_t *)(mip.data() + mip.desc().pixel(l, 0));
+            for (uint32_t i = 0; i < 33 * 20 * 4; ++i) p[i] = floatToHalf((float)(rng() % 1000) / 250.0f);
+            memcpy(face.data() + face.desc().pixel(l, 0), p, mip.desc(l, 0).size);
+        }
+        REQUIRE(generateMipmaps(mip, ImageFilter::LANCZOS));
+        REQUIRE(generateMipmaps(face, ImageFilter::LANCZOS));
+        for (uint32_t m = 1; m < mip.desc().levels; ++m) {
+            for (uint32_t l = 0; l < 6; ++l) {
+                CHECK(0 == memcmp(mip.proxy().pixel(l, m), face.proxy().pixel(l, m), mip.desc(l, m).size));
+            }
+        }
+    }
+
+    SECTION("normal map") {
+        // checkerboard of two tilted normals. Their average is shorter than 1, and renormalized in NORMAL_MAP mode.
+        auto run = [&](MipmapMode mode) {
+            auto image = make(ColorFormat::RG_8_8_SNORM(), 8, 8, 1);
+            for (uint32_t i = 0; i < 64; ++i) {
+                bool odd                = ((i % 8) + (i / 8)) % 2;
+                image.data()[i * 2]     = odd ? 0 : 76; // 0.6
+                image.data()[i * 2 + 1] = odd ? 76 : 0;
+            }
+            MipmapOptions options;
+            options.mode = mode;
+            REQUIRE(generateMipmaps(image, options));
+            return (int8_t)image.proxy().pixel(0, 1, 1, 1)[0];
+        };
+        CHECK(std::abs(run(MipmapMode::COLOR) - 38) <= 1);
+        CHECK(std::abs(run(MipmapMode::NORMAL_MAP) - 42) <= 1);
+
+        // random unit normals stored in UNORM channels stay unit length in all levels.
+        auto image = make(ColorFormat::RGBA8(), 37, 19, 2);
+        std::normal_distribution<float> dist;
+        for (uint32_t i = 0; i < 37 * 19 * 2; ++i) {
+            float x = dist(rng), y = dist(rng), z = std::abs(dist(rng)) + 0.5f;
+            float     l = std::sqrt(x * x + y * y + z * z);
+            uint8_t * p = image.data() + i * 4;
+            p[0]        = (uint8_t)std::lround((x / l * 0.5f + 0.5f) * 255.0f);
+            p[1]        = (uint8_t)std::lround((y / l * 0.5f + 0.5f) * 255.0f);
+            p[2]        = (uint8_t)std::lround((z / l * 0.5f + 0.5f) * 255.0f);
+            p[3]        = 255;
+        }
+        MipmapOptions options;
+        options.mode   = MipmapMode::NORMAL_MAP;
+        options.filter = ImageFilter::KAISER;
+        REQUIRE(generateMipmaps(image, options));
+        for (uint32_t m = 1; m < image.desc().levels; ++m) {
+            for (uint32_t l = 0; l < 2; ++l) {
+                const uint8_t * p = image.proxy().pixel(l, m);
+                for (uint32_t i = 0; i < image.width(l, m) * image.height(l, m); ++i, p += 4) {
+                    float x = p[0] / 127.5f - 1.0f, y = p[1] / 127.5f - 1.0f, z = p[2] / 127.5f - 1.0f;
+                    if (std::abs(std::sqrt(x * x + y * y + z * z) - 1.0f) > 0.03f) FAIL("level " << m << " pixel " << i);
+                }
+            }
+        }
+    }
+
+    SECTION("alpha coverage") {
+        // mostly low alpha. Averaging pushes alpha below the reference, so the coverage drops quickly in COLOR mode.
+        auto run = [&](MipmapMode mode) {
+            auto image = make(ColorFormat::RGBA8(), 32, 32, 2);
+            std::uniform_real_distribution<float> dist;
+            for (uint32_t i = 0; i < 32 * 32 * 2; ++i) {
+                float u = dist(rng);
+                image.data()[i * 4 + 3] = (uint8_t)(u * u * u * 255.0f);
+            }
+            MipmapOptions options;
+            options.mode = mode;
+            REQUIRE(generateMipmaps(image, options));
+            auto coverage = [&](uint32_t layer, uint32_t level) {
+                uint32_t n = image.width(layer, level) * image.height(layer, level), passed = 0;
+                for (uint32_t i = 0; i < n; ++i) passed += image.proxy().pixel(layer, level)[i * 4 + 3] >= 128;
+                return (float)passed / (float)n;
+            };
+            std::vector<float> drift;
+            for (uint32_t l = 0; l < 2; ++l) drift.push_back(std::abs(coverage(l, 2) - coverage(l, 0)));
+            return *std::max_element(drift.begin(), drift.end());
+        };
+        CHECK(run(MipmapMode::COLOR) > 0.1f);
+        CHECK(run(MipmapMode::ALPHA_COVERAGE) < 0.05f);
+    }
+
+    SECTION("volume") {
+        auto make3d = [](ColorFormat format, uint32_t w, uint32_t h, uint32_t d) {
+            return RawImage(ImageDesc(ImagePlaneDesc::make(format, w, h, d), 1, 0));
+        };
+        auto image = make3d(ColorFormat::RGBA8(), 8, 6, 4);
+        REQUIRE(4 == image.desc().levels);
+        for (uint32_t i = 0; i < image.size(); ++i) image.data()[i] = (uint8_t)rng();
+        REQUIRE(generateMipmaps(image));
+        // each voxel of level 1 is the average of a 2x2x2 block of level 0.
+        const auto & proxy = image.proxy();
+        for (uint32_t z = 0; z < 2; ++z) {
+            for (uint32_t y = 0; y < 3; ++y) {
+                for (uint32_t x = 0; x < 4; ++x) {
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        uint32_t sum = 0;
+                        for (uint32_t i = 0; i < 8; ++i) sum += proxy.pixel(0, 0, x * 2 + i % 2, y * 2 + i / 2 % 2, z * 2 + i / 4)[c];
+                        CHECK(std::abs((int)proxy.pixel(0, 1, x, y, z)[c] - (int)(sum + 4) / 8) <= 1);
+                    }
+                }
+            }
+        }
+
+        // odd sizes, all filters.
+        for (auto filter : { ImageFilter::BOX, ImageFilter::TRIANGLE, ImageFilter::KAISER, ImageFilter::LANCZOS }) {
+            auto odd = make3d(ColorFormat::RGBA_16_16_16_16_FLOAT(), 7, 5, 9);
+            for (uint32_t i = 0; i < odd.size() / 2; ++i) ((uint16_t *)odd.data())[i] = floatToHalf(0.75f);
+            REQUIRE(generateMipmaps(odd, filter));
+            for (uint32_t i = 0; i < odd.size() / 2; ++i) {
+                if (floatToHalf(0.75f) != ((const uint16_t *)odd.data())[i]) FAIL("filter " << (int)filter << " mismatch at " << i);
+            }
+        }
+
+        // resample() goes through the same code path.
+        auto half = make3d(ColorFormat::RGBA8(), 4, 3, 2);
+        ImageProxy dst = half.proxy();
+        dst.desc.levels = 1;
+        dst.desc.planes.resize(1);
+        ImageProxy src = image.proxy();
+        src.desc.levels = 1;
+        src.desc.planes.resize(1);
+        REQUIRE(resample(src, dst, ImageFilter::BOX));
+        CHECK(0 == memcmp(half.data(), image.proxy().pixel(0, 1), half.desc(0, 0).size));
+
+        auto bc = make3d(ColorFormat::DXT1_UNORM(), 8, 8, 8);
+        CHECK(!generateMipmaps(bc));
+    }
+
+    SECTION("compressed") {
+        auto image = make(ColorFormat::DXT1_UNORM(), 64, 64, 1);
+        auto rgba8 = make(ColorFormat::RGBA8(), 64, 64, 1);
+        for (uint32_t i = 0; i < rgba8.size(); ++i) rgba8.data()[i] = (uint8_t)(i % 256 & 0xF0);
+        ImageProxy dst = image.proxy();
+        REQUIRE(convert(rgba8.proxy(), dst));
+        REQUIRE(generateMipmaps(image, ImageFilter::TRIANGLE));
+        // ETC2 has no encoder.
+        auto etc = make(ColorFormat::ETC2_UNORM(), 16, 16, 1);
+        CHECK(!generateMipmaps(etc));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+TEST_CASE("resample", "[base]") {
+    auto make = [](ColorFormat format, uint32_t w, uint32_t h, uint32_t layers = 1, uint32_t levels = 1) {
+        return RawImage(ImageDesc(ImagePlaneDesc::make(format, w, h), layers, levels));
+    };
+    auto run = [](const RawImage & from, RawImage & to, ImageFilter filter) {
+        ImageProxy dst = to.proxy();
+        return resample(from.proxy(), dst, filter);
+    };
+    std::mt19937 rng(42);
+
+    SECTION("identity") {
+        auto src = make(ColorFormat::RGBA8(), 37, 19, 2, 0);
+        for (uint32_t i = 0; i < src.size(); ++i) src.data()[i] = (uint8_t)rng();
+        for (auto filter : { ImageFilter::BOX, ImageFilter::TRIANGLE, ImageFilter::KAISER, ImageFilter::LANCZOS }) {
+            auto dst = make(ColorFormat::RGBA8(), 37, 19, 2, 0);
+            REQUIRE(run(src, dst, filter));
+            CHECK(0 == memcmp(src.data(), dst.data(), src.size()));
+        }
+    }
+
+    SECTION("formats") {
+        // 16-bit red to BGRA8, stretched in one direction and squeezed in the other.
+        auto src = make(ColorFormat::R_16_UNORM(), 37, 19);
+        for (uint32_t i = 0; i < src.size() / 2; ++i) ((uint16_t *)src.data())[i] = 0x8080;
+        auto dst = make(ColorFormat::BGRA8(), 100, 7);
+        REQUIRE(run(src, dst, ImageFilter::LANCZOS));
+        for (uint32_t i = 0; i < 100 * 7; ++i) {
+            const uint8_t * p = dst.data() + i * 4;
+            if (0 != p[0] || 0 != p[1] || 128 != p[2] || 255 != p[3]) FAIL("mismatch at pixel " << i);
+        }
+    }
+
+    SECTION("ramp") {
+        auto src = make(ColorFormat::R_8_UNORM(), 2, 1);
+        src.data()[0] = 0;
+        src.data()[1] = 255;
+        auto dst = make(ColorFormat::R_8_UNORM(), 4, 1);
+        REQUIRE(run(src, dst, ImageFilter::TRIANGLE));
+        CHECK(0 == dst.data()[0]);
+        CHECK(64 == dst.data()[1]);
+        CHECK(191 == dst.data()[2]);
+        CHECK(255 == dst.data()[3]);
+    }
+
+    SECTION("weights") {
+        auto w = getFilterWeights(1000, 333, ImageFilter::KAISER);
+        CHECK(w == getFilterWeights(1000, 333, ImageFilter::KAISER));
+        CHECK(w != getFilterWeights(1000, 333, ImageFilter::LANCZOS));
+        REQUIRE(333 == w->first.size());
+        for (uint32_t i = 0; i < 333; ++i) {
+            float sum = 0;
+            for (uint32_t k = 0; k < w->taps; ++k) sum += w->weights[i * w->taps + k];
+            CHECK(std::abs(sum - 1.0f) < 1e-5f);
+            CHECK(w->first[i] + w->taps <= 1000);
+        }
+    }
+
+    SECTION("mismatch") {
+        auto src = make(ColorFormat::RGBA8(), 16, 16, 2);
+        auto dst = make(ColorFormat::RGBA8(), 8, 8, 1);
+        CHECK(!run(src, dst, ImageFilter::BOX));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// decode hand made blocks with known values.
+TEST_CASE("block-decode", "[base]") {
+    // decode one 4x4 block to the target format, using convert().
+    auto decode = [](ColorFormat format, const std::vector<uint8_t> & block, ColorFormat target) {
+        auto src = RawImage(ImageDesc(ImagePlaneDesc::make(format, 4, 4), 1, 1), block.data(), block.size());
+        auto dst = RawImage(ImageDesc(ImagePlaneDesc::make(target, 4, 4), 1, 1));
+        ImageProxy d = dst.proxy();
+        REQUIRE(convert(src.proxy(), d));
+        return dst;
+    };
+    auto rgba8 = [](const RawImage & image, uint32_t x, uint32_t y) {
+        RGBA8 c;
+        memcpy(&c, image.data() + image.desc().pixel(0, 0, x, y), 4);
+        return c;
+    };
+    auto rgba16 = [](const RawImage & image, uint32_t x, uint32_t y, uint32_t c) {
+        uint16_t v;
+        memcpy(&v, image.data() + image.desc().pixel(0, 0, x, y) + c * 2, 2);
+        return v;
+    };
+    auto same = [](RGBA8 c, uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return c.x == r && c.y == g && c.z == b && c.w == a; };
+    // pack fields to a 128-bit block, LSB first.
+    auto pack = [](std::initializer_list<std::pair<uint32_t, uint32_t>> fields) {
+        std::vector<uint8_t> block(16, 0);
+        uint32_t             pos = 0;
+        for (auto [value, bits] : fields)
+            for (uint32_t i = 0; i < bits; ++i, ++pos)
+                if (value >> i & 1) block[pos / 8] |= (uint8_t)(1u << (pos % 8));
+        return block;
+    };
+
+    SECTION("bc1") {
+        // c0 = pure red, c1 = pure blue. First row uses all 4 colors, the rest use c0.
+        auto image = decode(ColorFormat::DXT1_UNORM(), { 0x00, 0xF8, 0x1F, 0x00, 0xE4, 0, 0, 0 }, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 255, 0, 0, 255));
+        CHECK(same(rgba8(image, 1, 0), 0, 0, 255, 255));
+        CHECK(same(rgba8(image, 2, 0), 170, 0, 85, 255));
+        CHECK(same(rgba8(image, 3, 0), 85, 0, 170, 255));
+        CHECK(same(rgba8(image, 3, 3), 255, 0, 0, 255));
+
+        // c0 <= c1 selects 3 colors plus transparent black.
+        image = decode(ColorFormat::DXT1_UNORM(), { 0x1F, 0x00, 0x00, 0xF8, 0xE4, 0, 0, 0 }, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 2, 0), 128, 0, 128, 255));
+        CHECK(same(rgba8(image, 3, 0), 0, 0, 0, 0));
+
+        // but not in the color block of BC2 and BC3.
+        image = decode(ColorFormat::DXT3_UNORM(), { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x1F, 0x00, 0x00, 0xF8, 0xE4, 0, 0, 0 },
+                       ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 2, 0), 85, 0, 170, 255));
+        CHECK(same(rgba8(image, 3, 0), 170, 0, 85, 255));
+    }
+
+    SECTION("bc2 bc3 alpha") {
+        auto image = decode(ColorFormat::DXT3_UNORM(), { 0x10, 0xF8, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 },
+                            ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 255, 255, 255, 0));
+        CHECK(same(rgba8(image, 1, 0), 255, 255, 255, 17));
+        CHECK(same(rgba8(image, 2, 0), 255, 255, 255, 136));
+        CHECK(same(rgba8(image, 3, 0), 255, 255, 255, 255));
+
+        // a0 = 255, a1 = 0, 8 alpha mode. Pixels 0, 1, 2 use index 0, 1, 2
+        image = decode(ColorFormat::DXT5_UNORM(), { 0xFF, 0x00, 0x88, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 },
+                       ColorFormat::RGBA8());
+        CHECK(255 == rgba8(image, 0, 0).w);
+        CHECK(0 == rgba8(image, 1, 0).w);
+        CHECK(219 == rgba8(image, 2, 0).w);
+
+        // a0 <= a1 selects 6 alpha mode, with explicit 0 and 255. Pixels 0, 1 use index 6, 7
+        image = decode(ColorFormat::DXT5_UNORM(), { 0x00, 0xFF, 0x3E, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 },
+                       ColorFormat::RGBA8());
+        CHECK(0 == rgba8(image, 0, 0).w);
+        CHECK(255 == rgba8(image, 1, 0).w);
+    }
+
+    SECTION("bc4 bc5") {
+        // BC4 is decoded with 16-bit precision, and only has red channel.
+        auto image = decode(ColorFormat::DXT5A_UNORM(), { 0xFF, 0x00, 0x88, 0, 0, 0, 0, 0 }, ColorFormat::RGBA_16_16_16_16_UNORM());
+        CHECK(65535 == rgba16(image, 0, 0, 0));
+        CHECK(0 == rgba16(image, 1, 0, 0));
+        CHECK(56173 == rgba16(image, 2, 0, 0));
+        CHECK(0 == rgba16(image, 2, 0, 1));
+        CHECK(0 == rgba16(image, 2, 0, 2));
+        CHECK(65535 == rgba16(image, 2, 0, 3));
+
+        // signed BC5: -128 is clamped to -127.
+        image = decode(ColorFormat::DXN_SNORM(), { 0x7F, 0x81, 0x08, 0, 0, 0, 0, 0, 0x80, 0x7F, 0x00, 0, 0, 0, 0, 0 },
+                       ColorFormat::RGBA_32_32_32_32_FLOAT());
+        auto pixel = [&](uint32_t x) {
+            float4 f;
+            memcpy(&f, image.data() + image.desc().pixel(0, 0, x, 0), sizeof(f));
+            return f;
+        };
+        CHECK(1.0f == pixel(0).x);
+        CHECK(-1.0f == pixel(0).y);
+        CHECK(-1.0f == pixel(1).x);
+        CHECK(-1.0f == pixel(1).y);
+        CHECK(0.0f == pixel(1).z);
+        CHECK(1.0f == pixel(1).w);
+    }
+
+    SECTION("bc6h bc7") {
+        // BC7 mode 6: RGBA endpoints are (0, 0, 0, 0) and (255, 255, 255, 255), with p-bits of 0 and 1.
+        // Pixels 0, 1, 2 use index 0, 15, 8. The first one is the anchor, which has 3 bits only.
+        auto block = pack({ { 0x40, 7 }, { 0, 7 }, { 127, 7 }, { 0, 7 }, { 127, 7 }, { 0, 7 }, { 127, 7 }, { 0, 7 },
+                            { 127, 7 }, { 0, 1 }, { 1, 1 }, { 0, 3 }, { 15, 4 }, { 8, 4 } });
+        auto image = decode(ColorFormat::BC7_UNORM(), block, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 0, 0, 0, 0));
+        CHECK(same(rgba8(image, 1, 0), 255, 255, 255, 255));
+        CHECK(same(rgba8(image, 2, 0), 135, 135, 135, 135));
+        CHECK(same(rgba8(image, 3, 0), 0, 0, 0, 0));
+
+        // reserved mode (no mode bit set) decodes to transparent black.
+        image = decode(ColorFormat::BC7_UNORM(), std::vector<uint8_t>(16, 0), ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 1, 1), 0, 0, 0, 0));
+
+        // BC6H mode 11 (1 subset, 10 bits endpoints): endpoints are 0 and max, pixels 0, 1, 2 use index 0, 15, 8.
+        block = pack({ { 0x03, 5 }, { 0, 30 }, { 1023, 10 }, { 1023, 10 }, { 1023, 10 }, { 0, 3 }, { 15, 4 }, { 8, 4 } });
+        image = decode(ColorFormat::BC6H_UF16(), block, ColorFormat::RGBA_16_16_16_16_FLOAT());
+        CHECK(0 == rgba16(image, 0, 0, 0));
+        CHECK(0x7BFF == rgba16(image, 1, 0, 0)); // max unsigned value is 65504, the largest finite half.
+        CHECK(0x7BFF == rgba16(image, 1, 0, 2));
+        CHECK(0x3C00 == rgba16(image, 1, 0, 3)); // alpha is always 1.
+        // interpolation is done on the bits, not the values: ((0xFFFF * 34 + 32) >> 6) * 31 >> 6.
+        CHECK(0x41DF == rgba16(image, 2, 0, 1));
+    }
+
+    SECTION("etc2 eac") {
+        // ETC1 individual mode: left half is red, right half is blue, both use modifier table 0 (2, 8, -2, -8).
+        // Pixel (1, 0) uses index 3. The rest use index 0.
+        auto image = decode(ColorFormat::ETC1_UNORM(), { 0xF0, 0x00, 0x0F, 0x00, 0x00, 0x10, 0x00, 0x10 }, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 255, 2, 2, 255));
+        CHECK(same(rgba8(image, 1, 0), 247, 0, 0, 255));
+        CHECK(same(rgba8(image, 2, 3), 2, 2, 255, 255));
+
+        // ETC2 punch-through alpha: when the opaque bit is off, index 2 is transparent black, and index 0 is the
+        // base color without modifier.
+        image = decode(ColorFormat::ETC2_A1_UNORM(), { 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00 }, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 0, 0, 0, 0));
+        CHECK(same(rgba8(image, 0, 1), 132, 0, 0, 255));
+
+        // EAC R11: base 128, multiplier 1, table 0. Pixel (0, 0) uses index 7 (+14), the rest use index 0 (-3).
+        // The 11-bit values (base * 8 + 4 + modifier * 8) are expanded to 16 bits by bit replication.
+        image = decode(ColorFormat::EAC_R11_UNORM(), { 0x80, 0x10, 0xE0, 0, 0, 0, 0, 0 }, ColorFormat::RGBA_16_16_16_16_UNORM());
+        CHECK(((1140 << 5) | (1140 >> 6)) == rgba16(image, 0, 0, 0));
+        CHECK(((1004 << 5) | (1004 >> 6)) == rgba16(image, 1, 0, 0));
+        CHECK(65535 == rgba16(image, 1, 0, 3));
+    }
+
+    SECTION("astc") {
+        // void extent block of constant color, as 16-bit values.
+        auto block = pack({ { 0x1FC, 9 }, { 0, 1 }, { 3, 2 }, { 0xFFFFF, 20 }, { 0xFFFFFFFF, 32 }, { 0xFFFF, 16 }, { 0x8000, 16 },
+                            { 0, 16 }, { 0xFFFF, 16 } });
+        auto image = decode(ColorFormat::ASTC_4x4_UNORM(), block, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 255, 128, 0, 255));
+        CHECK(same(rgba8(image, 3, 3), 255, 128, 0, 255));
+
+        // 4x4 weight grid of 2-bit weights, 1 partition, RGB direct endpoints (0, 255, 0) and (255, 0, 0). Weights are
+        // stored from the top bit down: pixel 1 uses weight 3 (64), pixel 2 uses weight 1 (21), the rest use 0.
+        block     = pack({ { 66, 11 }, { 0, 2 }, { 8, 4 }, { 0, 8 }, { 255, 8 }, { 255, 8 }, { 0, 8 }, { 0, 8 }, { 0, 8 } });
+        block[15] = 0x38;
+        image     = decode(ColorFormat::ASTC_4x4_UNORM(), block, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 0, 255, 0, 255));
+        CHECK(same(rgba8(image, 1, 0), 255, 0, 0, 255));
+        CHECK(same(rgba8(image, 2, 0), 84, 171, 0, 255));
+        CHECK(same(rgba8(image, 3, 3), 0, 255, 0, 255));
+
+        // reserved block mode decodes to the error color.
+        image = decode(ColorFormat::ASTC_4x4_UNORM(), std::vector<uint8_t>(16, 0), ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 1, 1), 255, 0, 255, 255));
+
+        // pitch of compressed planes is bytes of one row of blocks.
+        auto plane = ImagePlaneDesc::make(ColorFormat::ASTC_UNORM(ColorFormat::LAYOUT_ASTC_5x5), 37, 19);
+        CHECK(8 * 16 == plane.pitch);
+        CHECK(4 * plane.pitch == plane.slice);
+        CHECK(2 * plane.pitch + 16 == plane.pixel(5, 10));
+
+        // random blocks of all kinds of footprints must decode without going out of bounds.
+        std::mt19937 rng(11);
+        for (auto layout : { ColorFormat::LAYOUT_ASTC_5x4, ColorFormat::LAYOUT_ASTC_6x6, ColorFormat::LAYOUT_ASTC_10x8,
+                             ColorFormat::LAYOUT_ASTC_12x12 }) {
+            auto src = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::ASTC_UNORM_SRGB(layout), 37, 19), 1, 1));
+            for (uint32_t i = 0; i < src.size(); ++i) src.data()[i] = (uint8_t)rng();
+            auto       dst = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 37, 19), 1, 1));
+            ImageProxy d   = dst.proxy();
+            CHECK(convert(src.proxy(), d));
+        }
+    }
+
+    SECTION("legacy") {
+        // CTX1: endpoints (0, 255) and (255, 0). Pixels of the first row use index 0, 1, 2, 3.
+        auto image = decode(ColorFormat::CTX1_UNORM(), { 0, 255, 255, 0, 0xE4, 0, 0, 0 }, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 0, 255, 0, 255));
+        CHECK(same(rgba8(image, 1, 0), 255, 0, 0, 255));
+        CHECK(same(rgba8(image, 2, 0), 85, 170, 0, 255));
+        CHECK(same(rgba8(image, 3, 0), 170, 85, 0, 255));
+
+        // DXT3A_AS_1_1_1_1: each 4-bit value holds 4 channels, red in the lowest bit.
+        image = decode(ColorFormat::DXT3A_AS_1_1_1_1_UNORM(), { 0x21, 0xF0, 0, 0, 0, 0, 0, 0 }, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 255, 0, 0, 0));
+        CHECK(same(rgba8(image, 1, 0), 0, 255, 0, 0));
+        CHECK(same(rgba8(image, 2, 0), 0, 0, 0, 0));
+        CHECK(same(rgba8(image, 3, 0), 255, 255, 255, 255));
+
+        // GRGB and RGBG: 2x1 blocks, 2 per row of the 4x4 image.
+        std::vector<uint8_t> packed(32, 0);
+        packed[0] = 10, packed[1] = 20, packed[2] = 30, packed[3] = 40;
+        image = decode(ColorFormat::GRGB_UNORM(), packed, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 20, 10, 40, 255));
+        CHECK(same(rgba8(image, 1, 0), 20, 30, 40, 255));
+        image = decode(ColorFormat::RGBG_UNORM(), packed, ColorFormat::RGBA8());
+        CHECK(same(rgba8(image, 0, 0), 10, 20, 30, 255));
+        CHECK(same(rgba8(image, 1, 0), 10, 40, 30, 255));
+        CHECK(same(rgba8(image, 2, 0), 0, 0, 0, 255));
+    }
+
+    SECTION("image") {
+        // random blocks, with dimensions that are not multiple of 4, and a full mipmap chain.
+        auto src = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::DXT1_UNORM(), 37, 19), 2, 0));
+        std::mt19937 rng(7);
+        for (uint32_t i = 0; i < src.size(); ++i) src.data()[i] = (uint8_t)rng();
+        auto dst = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 37, 19), 2, 0));
+        ImageProxy d = dst.proxy();
+        REQUIRE(convert(src.proxy(), d));
+        size_t mismatches = 0;
+        for (uint32_t f = 0; f < src.desc().layers; ++f)
+        for (uint32_t l = 0; l < src.desc().levels; ++l) {
+            const auto & p = src.desc(f, l);
+            for (uint32_t y = 0; y < p.height; y += 4)
+            for (uint32_t x = 0; x < p.width; x += 4) {
+                RGBA8 block[16];
+                // a block row starts at the first pixel of its first scanline, and blocks are 8 bytes apart.
+                decodeBC1Scalar(block, 16, src.data() + src.desc().pixel(f, l, 0, y) + x / 4 * 8, 1, 8, true);
+                for (uint32_t i = 0; i < 16; ++i) {
+                    if (x + i % 4 >= p.width || y + i / 4 >= p.height) continue;
+                    if (0 != memcmp(&block[i], dst.data() + dst.desc().pixel(f, l, x + i % 4, y + i / 4), 4)) ++mismatches;
+                }
+            }
+        }
+        CHECK(0 == mismatches);
+
+        // compressed planes can be saved directly.
+        auto path = (std::filesystem::temp_directory_path() / "rg-block-decode.png").string();
+        std::filesystem::remove(path);
+        src.desc(0, 0).saveToPNG(path, src.data());
+        CHECK(std::filesystem::exists(path));
+        std::filesystem::remove(path);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Smooth test image, with some high frequency details, and an alpha gradient.
+static RawImage makeBlockTestImage(uint32_t width, uint32_t height) {
+    auto image = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), width, height), 1, 1));
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x) {
+            auto p = image.data() + image.desc().pixel(0, 0, x, y);
+            p[0]   = (uint8_t)(127.5f + 127.5f * std::sin((float)x * 0.11f + (float)y * 0.05f));
+            p[1]   = (uint8_t)(127.5f + 127.5f * std::cos((float)y * 0.13f));
+            p[2]   = (uint8_t)((x / 8 + y / 8) % 2 ? 200 + x % 7 : 40 + y % 5);
+            p[3]   = (uint8_t)std::min(255u, x * 255 / width + y % 3);
+        }
+    return image;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// PSNR of the selected channels of 2 RGBA8 images.
+static double psnrRGBA8(const RawImage & a, const RawImage & b, uint32_t channelMask) {
+    double   sum = 0;
+    uint32_t n   = 0;
+    for (uint32_t y = 0; y < a.height(); ++y)
+        for (uint32_t x = 0; x < a.width(); ++x) {
+            auto pa = a.data() + a.desc().pixel(0, 0, x, y);
+            auto pb = b.data() + b.desc().pixel(0, 0, x, y);
+            for (uint32_t c = 0; c < 4; ++c) {
+                if (!(channelMask & (1u << c))) continue;
+                double d = (double)pa[c] - pb[c];
+                sum += d * d;
+                ++n;
+            }
+        }
+    return sum ? 10.0 * std::log10(255.0 * 255.0 * n / sum) : 100.0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Encode RGBA8 image to the compressed format, then decode it back to RGBA8.
+static RawImage encodeAndDecode(const RawImage & image, ColorFormat format, CompressionQuality quality) {
+    auto       encoded = RawImage(ImageDesc(ImagePlaneDesc::make(format, image.width(), image.height()), 1, 1));
+    auto       decoded = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), image.width(), image.height()), 1, 1));
+    ImageProxy e       = encoded.proxy();
+    ImageProxy d       = decoded.proxy();
+    if (!convert(image.proxy(), e, quality) || !convert(encoded.proxy(), d)) return {};
+    return decoded;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+TEST_CASE("block-encode", "[base]") {
+    SECTION("quality") {
+        // dimensions that are not multiple of 4, to cover the padding of partial blocks.
+        auto image = makeBlockTestImage(67, 45);
+        // DXT1 is tested with opaque pixels. Or else, colors of the transparent ones are lost.
+        auto opaque = makeBlockTestImage(67, 45);
+        for (uint32_t i = 3; i < opaque.size(); i += 4) opaque.data()[i] = 255;
+        const struct {
+            ColorFormat format;
+            uint32_t    channels;
+            double      minPSNR;
+        } cases[] = {
+            { ColorFormat::DXT1_UNORM(), 7, 30.0 },  { ColorFormat::DXT3_UNORM(), 15, 30.0 },
+            { ColorFormat::DXT5_UNORM(), 15, 30.0 }, { ColorFormat::DXT5A_UNORM(), 1, 40.0 },
+            { ColorFormat::DXN_UNORM(), 3, 40.0 },   { ColorFormat::BC7_UNORM(), 15, 34.0 },
+            { ColorFormat::CTX1_UNORM(), 3, 30.0 },  { ColorFormat::GRGB_UNORM(), 7, 30.0 },
+            { ColorFormat::RGBG_UNORM(), 7, 30.0 },
+        };
+        for (const auto & c : cases) {
+            INFO("format 0x" << std::hex << c.format.u32);
+            const auto & src  = ColorFormat::DXT1_UNORM() == c.format ? opaque : image;
+            auto         fast = encodeAndDecode(src, c.format, CompressionQuality::FAST);
+            auto         high = encodeAndDecode(src, c.format, CompressionQuality::HIGH);
+            REQUIRE(!fast.empty());
+            REQUIRE(!high.empty());
+            double fastPSNR = psnrRGBA8(src, fast, c.channels);
+            double highPSNR = psnrRGBA8(src, high, c.channels);
+            CHECK(fastPSNR > c.minPSNR);
+            CHECK(highPSNR >= fastPSNR);
+        }
+    }
+
+    SECTION("exact") {
+        // 2 colors that are on the 565 grid are encoded losslessly by cluster fit.
+        auto image = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 8, 4), 1, 1));
+        for (uint32_t i = 0; i < 32; ++i) {
+            static const uint8_t colors[2][4] = { { 0xFF, 0x82, 0x00, 0xFF }, { 0x21, 0x00, 0xFF, 0xFF } };
+            memcpy(image.data() + i * 4, colors[(i * 7 / 3) % 2], 4);
+        }
+        auto high = encodeAndDecode(image, ColorFormat::DXT1_UNORM(), CompressionQuality::HIGH);
+        REQUIRE(!high.empty());
+        CHECK(0 == memcmp(image.data(), high.data(), image.size()));
+
+        // so are 2 values BC4 blocks, even with the fast tier.
+        auto fast = encodeAndDecode(image, ColorFormat::DXT5A_UNORM(), CompressionQuality::FAST);
+        REQUIRE(!fast.empty());
+        CHECK(100.0 == psnrRGBA8(image, fast, 1));
+
+        // 1-bit channels are lossless for 0 and 255.
+        for (uint32_t i = 0; i < 128; ++i) image.data()[i] = (i * 5) % 3 ? 255 : 0;
+        fast = encodeAndDecode(image, ColorFormat::DXT3A_AS_1_1_1_1_UNORM(), CompressionQuality::FAST);
+        REQUIRE(!fast.empty());
+        CHECK(0 == memcmp(image.data(), fast.data(), image.size()));
+
+        // 4:2:2 layouts are lossless when both pixels of a pair have same red and blue.
+        for (uint32_t i = 0; i < 32; i += 2) {
+            image.data()[i * 4 + 4] = image.data()[i * 4];
+            image.data()[i * 4 + 6] = image.data()[i * 4 + 2];
+            image.data()[i * 4 + 3] = image.data()[i * 4 + 7] = 255;
+        }
+        for (auto format : { ColorFormat::GRGB_UNORM(), ColorFormat::RGBG_UNORM() }) {
+            fast = encodeAndDecode(image, format, CompressionQuality::FAST);
+            REQUIRE(!fast.empty());
+            CHECK(0 == memcmp(image.data(), fast.data(), image.size()));
+        }
+    }
+
+    SECTION("punch-through alpha") {
+        auto image = makeBlockTestImage(16, 16);
+        for (uint32_t i = 0; i < 256; i += 3) image.data()[i * 4 + 3] = 0;
+        for (auto quality : { CompressionQuality::FAST, CompressionQuality::HIGH }) {
+            auto decoded = encodeAndDecode(image, ColorFormat::DXT1_UNORM(), quality);
+            REQUIRE(!decoded.empty());
+            uint32_t mismatches = 0;
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint8_t expected = image.data()[i * 4 + 3] < 128 ? 0 : 255;
+                if (decoded.data()[i * 4 + 3] != expected) ++mismatches;
+            }
+            CHECK(0 == mismatches);
+        }
+    }
+
+    SECTION("signed") {
+        // round trip of SNORM values through signed BC5.
+        auto src = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_32_32_32_32_FLOAT(), 8, 8), 1, 1));
+        auto f   = (float *)src.data();
+        for (uint32_t i = 0; i < 64; ++i) {
+            f[i * 4 + 0] = std::sin((float)i * 0.2f);
+            f[i * 4 + 1] = (float)(i % 8) / 3.5f - 1.0f;
+            f[i * 4 + 2] = 0.0f;
+            f[i * 4 + 3] = 1.0f;
+        }
+        auto       bc5  = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::DXN_SNORM(), 8, 8), 1, 1));
+        auto       back = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_32_32_32_32_FLOAT(), 8, 8), 1, 1));
+        ImageProxy e    = bc5.proxy();
+        ImageProxy d    = back.proxy();
+        REQUIRE(convert(src.proxy(), e, CompressionQuality::HIGH));
+        REQUIRE(convert(bc5.proxy(), d));
+        float maxError = 0;
+        for (uint32_t i = 0; i < 64 * 4; ++i) maxError = std::max(maxError, std::abs(f[i] - ((const float *)back.data())[i]));
+        // values of one block span at most [-1, 1], so the 8 values palette is at most 2/7 apart.
+        CHECK(maxError < 1.0f / 7.0f + 1.0f / 127.0f);
+    }
+
+    SECTION("bc6h") {
+        // HDR values of a smooth gradient, well beyond [0, 1]. The signed format also gets negative values.
+        for (auto format : { ColorFormat::BC6H_UF16(), ColorFormat::BC6H_SF16() }) {
+            bool signed_ = ColorFormat::BC6H_SF16() == format;
+            auto src     = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_32_32_32_32_FLOAT(), 16, 12), 1, 1));
+            auto f       = (float *)src.data();
+            for (uint32_t i = 0; i < 16 * 12; ++i) {
+                float v      = 1.0f + (float)(i % 16) * 0.3f + std::sin((float)(i / 16) * 0.4f);
+                f[i * 4 + 0] = 4.0f * v;
+                f[i * 4 + 1] = (signed_ ? -2.0f : 2.0f) * v;
+                f[i * 4 + 2] = 0.5f * v;
+                f[i * 4 + 3] = 1.0f;
+            }
+            for (auto quality : { CompressionQuality::FAST, CompressionQuality::HIGH }) {
+                INFO("format 0x" << std::hex << format.u32 << ", quality " << (int)quality);
+                auto       bc6  = RawImage(ImageDesc(ImagePlaneDesc::make(format, 16, 12), 1, 1));
+                auto       back = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_32_32_32_32_FLOAT(), 16, 12), 1, 1));
+                ImageProxy e    = bc6.proxy();
+                ImageProxy d    = back.proxy();
+                REQUIRE(convert(src.proxy(), e, quality));
+                REQUIRE(convert(bc6.proxy(), d));
+                auto  b        = (const float *)back.data();
+                float maxError = 0;
+                for (uint32_t i = 0; i < 16 * 12 * 4; ++i) {
+                    // relative error for large values, absolute error for small ones.
+                    maxError = std::max(maxError, std::abs(f[i] - b[i]) / std::max(1.0f, std::abs(f[i])));
+                }
+                // BC6H interpolates the bits of half floats, which is not linear across powers of 2.
+                CHECK(maxError < 0.125f);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+TEST_CASE("thread-pool", "[base]") {
+    auto saved = getMaxWorkerThreads();
+    setMaxWorkerThreads(4);
+
+    SECTION("coverage") {
+        // Catch assertions are not thread safe. So only record results in workers, then check them afterwards.
+        std::vector<std::atomic<int>> hits(1000);
+        std::atomic<size_t>           largest {0};
+        parallelFor(hits.size(), 7, [&](size_t begin, size_t end) {
+            if (end - begin > largest) largest = end - begin;
+            for (size_t i = begin; i < end; ++i) ++hits[i];
+        });
+        CHECK(7 == largest);
+        for (auto & h : hits) CHECK(1 == h);
+    }
+
+    SECTION("nested") {
+        std::atomic<size_t> sum {0};
+        parallelFor(8, 1, [&](size_t, size_t) {
+            parallelFor(100, 10, [&](size_t begin, size_t end) { sum += end - begin; });
+        });
+        CHECK(800 == sum);
+    }
+
+    SECTION("exception") {
+        std::atomic<int> calls {0};
+        CHECK_THROWS(parallelFor(16, 1, [&](size_t begin, size_t) {
+            ++calls;
+            if (3 == begin) RG_THROW("chunk %zu failed", begin);
+        }));
+        CHECK(16 == calls); // other chunks still run.
+    }
+
+    SECTION("single thread") {
+        setMaxWorkerThreads(1);
+        std::vector<std::pair<size_t, size_t>> chunks;
+        std::thread::id                        thread;
+        parallelFor(100, 1, [&](size_t begin, size_t end) {
+            chunks.emplace_back(begin, end);
+            thread = std::this_thread::get_id();
+        });
+        REQUIRE(1 == chunks.size());
+        CHECK(0 == chunks[0].first);
+        CHECK(100 == chunks[0].second);
+        CHECK(std::this_thread::get_id() == thread);
+    }
+
+    setMaxWorkerThreads(saved);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Random source data for the fast row kernels. Float data is a mix of random bit patterns (to cover Inf, NaN and
+// denormals) and random numbers that are in half float and [0, 1] range.
+static std::vector<uint8_t> makeFastKernelTestData(size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(bytes);
+    for (size_t i = 0; i + 4 <= bytes; i += 4) {
+        uint32_t u = (uint32_t)rng();
+        switch (i / 4 % 4) {
+            case 0: break; // random bits
+            case 1: u = (u & 0x807fffffu) | ((100u + (u >> 8) % 46u) << 23); break; // within half float range
+            case 2: { float f = (float)(u % 3000) / 2000.0f - 0.25f; memcpy(&u, &f, 4); break; } // around [0, 1]
+            default: u = (u & 0xffff0000u) | (0x7c00u | (u & 0x3ffu)); break; // half Inf and NaN
+        }
+        memcpy(&data[i], &u, 4);
+    }
+    return data;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+//
+TEST_CASE("pixel-simd", "[base]") {
+    const size_t count = 131; // not multiple of any SIMD width, to cover the tail handling.
+    const auto   src   = makeFastKernelTestData(count * 16, 5678);
+    const auto & ref   = *getFastRowKernels(SimdLevel::SCALAR);
+    for (auto level : { SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::NEON }) {
+        auto k = getFastRowKernels(level);
+        if (!k) continue;
+        INFO(simdLevelName(level));
+        const float4 * srcf4 = (const float4 *)src.data();
+
+        // run one kernel with both scalar and SIMD code, then compare the results bit by bit.
+        auto compare = [&](auto member, auto dstType, auto srcPtr, size_t n) {
+            using T = decltype(dstType);
+            std::vector<T> d1(n), d2(n);
+            (ref.*member)(d1.data(), srcPtr, n);
+            (k->*member)(d2.data(), srcPtr, n);
+            return 0 == memcmp(d1.data(), d2.data(), n * sizeof(T));
+        };
+        CHECK(compare(&FastRowKernels::rgba8ToFloat4, float4(), src.data(), count));
+        CHECK(compare(&FastRowKernels::float4ToRGBA8, RGBA8(), srcf4, count));
+        CHECK(compare(&FastRowKernels::swapRB8888, RGBA8(), src.data(), count));
+        CHECK(compare(&FastRowKernels::rgb8ToRGBA8, RGBA8(), src.data(), count));
+        CHECK(compare(&FastRowKernels::bgr565ToRGBA8, RGBA8(), src.data(), count));
+        CHECK(compare(&FastRowKernels::bgra5551ToRGBA8, RGBA8(), src.data(), count));
+        CHECK(compare(&FastRowKernels::bgra4444ToRGBA8, RGBA8(), src.data(), count));
+        CHECK(compare(&FastRowKernels::rgb10a2ToFloat4, float4(), src.data(), count));
+        CHECK(compare(&FastRowKernels::rgb10a2ToRGBA8, RGBA8(), src.data(), count));
+        CHECK(compare(&FastRowKernels::rg11b10fToFloat4, float4(), src.data(), count));
+        CHECK(compare(&FastRowKernels::halfToFloat, float(), (const uint16_t *)src.data(), count * 8));
+        CHECK(compare(&FastRowKernels::floatToHalf, uint16_t(), (const float *)src.data(), count * 4));
+
+        // channel extraction of every pixel size that has SIMD code, including channels crossing 32-bit boundary.
+        const uint32_t extracts[][3] = { { 1, 2, 5 }, { 2, 5, 6 }, { 4, 0, 32 }, { 4, 22, 10 }, { 8, 40, 24 },
+                                         { 8, 24, 16 }, { 8, 32, 32 }, { 16, 60, 8 } };
+        for (const auto & e : extracts) {
+            std::vector<uint32_t> d1(count), d2(count);
+            ref.extractChannel(d1.data(), src.data(), count, e[0], e[1], e[2]);
+            k->extractChannel(d2.data(), src.data(), count, e[0], e[1], e[2]);
+            CHECK(d1 == d2);
+        }
+
+        // BC1 color blocks, in both BC1 mode and the 4-color mode of BC2/BC3 color blocks.
+        for (bool bc1 : { true, false }) {
+            std::vector<RGBA8> d1(count * 16), d2(count * 16);
+            ref.decodeBC1(d1.data(), count * 16, src.data(), count, 8, bc1);
+            k->decodeBC1(d2.data(), count * 16, src.data(), count, 8, bc1);
+            CHECK(0 == memcmp(d1.data(), d2.data(), count * 64));
+        }
+
+        // BC1 encoding of random pixels, which covers blocks with transparent pixels, and opaque ones.
+        for (bool opaque : { false, true }) {
+            auto pixels = src;
+            if (opaque) for (size_t i = 3; i < pixels.size(); i += 4) pixels[i] = 255;
+            for (bool bc1 : { true, false }) {
+                std::vector<uint8_t> e1(count * 8), e2(count * 8);
+                ref.encodeBC1(e1.data(), 8, (const RGBA8 *)pixels.data(), count * 4, count / 4, bc1);
+                k->encodeBC1(e2.data(), 8, (const RGBA8 *)pixels.data(), count * 4, count / 4, bc1);
+                CHECK(e1 == e2);
+            }
+        }
+
+        // BPTC interpolation, with random endpoints and weights in [0, 64].
+        {
+            std::vector<uint8_t> weights(count * 4);
+            for (size_t i = 0; i < weights.size(); ++i) weights[i] = (uint8_t)(src[i] % 65);
+            std::vector<uint8_t> d1(count * 4), d2(count * 4);
+            ref.interpolateBC7(d1.data(), src.data(), src.data() + count * 4, weights.data(), count * 4);
+            k->interpolateBC7(d2.data(), src.data(), src.data() + count * 4, weights.data(), count * 4);
+            CHECK(d1 == d2);
+            std::vector<int32_t> e0(count * 4), e1(count * 4), i1(count * 4), i2(count * 4);
+            for (size_t i = 0; i < e0.size(); ++i) {
+                e0[i] = (int32_t)(src[i * 2] | src[i * 2 + 1] << 8) - 0x8000;
+                e1[i] = (int32_t)(src[i * 2 + 8] << 9 | src[i * 2 + 9]) - 0xFFFF;
+            }
+            ref.interpolateBC6H(i1.data(), e0.data(), e1.data(), weights.data(), count * 4);
+            k->interpolateBC6H(i2.data(), e0.data(), e1.data(), weights.data(), count * 4);
+            CHECK(i1 == i2);
+        }
+
+        // legacy layouts: 4:2:2 in both byte orders, CTX1 and DXT3A_AS_1_1_1_1.
+        for (bool rgbg : { false, true }) {
+            std::vector<RGBA8> d1(count * 2), d2(count * 2);
+            ref.unpack422(d1.data(), src.data(), count, rgbg);
+            k->unpack422(d2.data(), src.data(), count, rgbg);
+            CHECK(0 == memcmp(d1.data(), d2.data(), count * 8));
+            std::vector<uint8_t> p1(count * 4), p2(count * 4);
+            ref.pack422(p1.data(), (const RGBA8 *)src.data(), count, rgbg);
+            k->pack422(p2.data(), (const RGBA8 *)src.data(), count, rgbg);
+            CHECK(p1 == p2);
+        }
+        {
+            std::vector<uint8_t> d1(count * 32), d2(count * 32);
+            ref.decodeCTX1(d1.data(), count * 8, src.data(), count);
+            k->decodeCTX1(d2.data(), count * 8, src.data(), count);
+            CHECK(d1 == d2);
+            std::vector<RGBA8> r1(count * 16), r2(count * 16);
+            ref.decodeDXT3AAs1111(r1.data(), count * 16, src.data(), count);
+            k->decodeDXT3AAs1111(r2.data(), count * 16, src.data(), count);
+            CHECK(0 == memcmp(r1.data(), r2.data(), count * 64));
+        }
+
+        // separable filter passes, with random weights and source pixels.
+        {
+            const size_t taps = 5;
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> dist(-1.0f, 2.0f);
+            std::vector<float4> pixels(count + taps);
+            for (auto & p : pixels) p = { dist(rng), dist(rng), dist(rng), dist(rng) };
+            std::vector<float>    weights(count * taps);
+            std::vector<uint32_t> first(count);
+            for (auto & w : weights) w = dist(rng);
+            for (auto & f : first) f = (uint32_t)(rng() % count);
+            std::vector<float4> d1(count), d2(count);
+            ref.filterFloat4H(d1.data(), pixels.data(), first.data(), weights.data(), taps, count);
+            k->filterFloat4H(d2.data(), pixels.data(), first.data(), weights.data(), taps, count);
+            CHECK(0 == memcmp(d1.data(), d2.data(), count * 16));
+            const float4 * rows[taps];
+            for (size_t t = 0; t < taps; ++t) rows[t] = pixels.data() + t;
+            ref.filterFloat4V(d1.data(), rows, weights.data(), taps, count);
+            k->filterFloat4V(d2.data(), rows, weights.data(), taps, count);
+            CHECK(0 == memcmp(d1.data(), d2.data(), count * 16));
+        }
+
+        // in-place swizzle, as used by the DDS loader.
+        std::vector<RGBA8> inplace(count), expected(count);
+        memcpy(inplace.data(), src.data(), count * 4);
+        ref.swapRB8888(expected.data(), src.data(), count);
+        k->swapRB8888(inplace.data(), (const uint8_t *)inplace.data(), count);
+        CHECK(0 == memcmp(inplace.data(), expected.data(), count * 4));
+    }
+
+    SECTION("half") {
+        CHECK(0x3c00 == floatToHalf(1.0f));
+        CHECK(0xc000 == floatToHalf(-2.0f));
+        CHECK(0x7c00 == floatToHalf(65520.0f)); // rounds up to infinity
+        CHECK(0x7bff == floatToHalf(65519.0f));
+        CHECK(0x0001 == floatToHalf(5.9604645e-8f)); // smallest denormal
+        CHECK(1.0f == halfToFloat(0x3c00));
+        CHECK(5.9604645e-8f == halfToFloat(0x0001));
+        CHECK(std::isnan(halfToFloat(0x7d00)));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Throughput of the fast row kernels. Hidden by default. Run with "[perf]" to see the numbers.
+TEST_CASE("pixel-simd-perf", "[.][perf]") {
+    const size_t count = 1 << 20;
+    const int    loops = 20;
+    const auto   src   = makeFastKernelTestData(count * 16, 1);
+    std::vector<uint8_t> dst(count * 16);
+    for (auto level : { SimdLevel::SCALAR, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::NEON }) {
+        auto k = getFastRowKernels(level);
+        if (!k) continue;
+        auto run = [&](const char * name, auto member, auto dstPtr, auto srcPtr, size_t n) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < loops; ++i) (k->*member)(dstPtr, srcPtr, n);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            RG_LOGI("%-7s %-18s %8.1f Mpixels/s", simdLevelName(level), name, (double)n * loops / elapsed.count() / 1e6);
+        };
+        auto d4 = (float4 *)dst.data();
+        auto d8 = (RGBA8 *)dst.data();
+        run("rgba8ToFloat4", &FastRowKernels::rgba8ToFloat4, d4, src.data(), count);
+        run("float4ToRGBA8", &FastRowKernels::float4ToRGBA8, d8, (const float4 *)src.data(), count);
+        run("swapRB8888", &FastRowKernels::swapRB8888, d8, src.data(), count);
+        run("rgb8ToRGBA8", &FastRowKernels::rgb8ToRGBA8, d8, src.data(), count);
+        run("bgr565ToRGBA8", &FastRowKernels::bgr565ToRGBA8, d8, src.data(), count);
+        run("bgra5551ToRGBA8", &FastRowKernels::bgra5551ToRGBA8, d8, src.data(), count);
+        run("bgra4444ToRGBA8", &FastRowKernels::bgra4444ToRGBA8, d8, src.data(), count);
+        run("rgb10a2ToFloat4", &FastRowKernels::rgb10a2ToFloat4, d4, src.data(), count);
+        run("rgb10a2ToRGBA8", &FastRowKernels::rgb10a2ToRGBA8, d8, src.data(), count);
+        run("rg11b10fToFloat4", &FastRowKernels::rg11b10fToFloat4, d4, src.data(), count);
+        run("halfToFloat(x4)", &FastRowKernels::halfToFloat, (float *)dst.data(), (const uint16_t *)src.data(), count * 4);
+        run("floatToHalf(x4)", &FastRowKernels::floatToHalf, (uint16_t *)dst.data(), (const float *)src.data(), count * 4);
+        auto extract = [&](const char * name, uint32_t pixelBytes, uint32_t shift, uint32_t bits) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < loops; ++i) k->extractChannel((uint32_t *)dst.data(), src.data(), count, pixelBytes, shift, bits);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            RG_LOGI("%-7s %-18s %8.1f Mpixels/s", simdLevelName(level), name, (double)count * loops / elapsed.count() / 1e6);
+        };
+        extract("extract(4:10@10)", 4, 10, 10);
+        extract("extract(8:24@40)", 8, 40, 24);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Throughput of loading BGRA DDS files, which are swizzled while they are read. Hidden by default. Run with "[perf]" to
+// see the numbers.
+TEST_CASE("dds-load-perf", "[.][perf]") {
+    const uint32_t       w = 4096;
+    std::vector<uint8_t> pixels((size_t)w * w * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (uint8_t)(i * 7);
+    const uint32_t bgra[] = {0xff0000, 0xff00, 0xff, 0xff000000};
+    const uint32_t rgba[] = {0xff, 0xff00, 0xff0000, 0xff000000};
+    for (auto masks : {rgba, bgra}) {
+        auto path  = writeTempFile("rg-unit-test-perf.dds", makeDDS(masks, w, w, 1, pixels));
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 5; ++i) {
+            std::ifstream f(path, std::ios::binary);
+            REQUIRE(!RawImage::load(f).empty());
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        RG_LOGI("load %s DDS from stream: %8.1f MB/s", masks == bgra ? "BGRA" : "RGBA",
+                (double)pixels.size() * 5 / elapsed.count() / 1e6);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scaling of convert() with number of threads. Hidden by default. Run with "[perf]" to see the numbers.
+TEST_CASE("convert-perf", "[.][perf]") {
+    auto src = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::BGR_5_6_5_UNORM(), 4096, 4096), 1, 1));
+    auto dst = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA_16_16_16_16_FLOAT(), 4096, 4096), 1, 1));
+    memset(src.data(), 0x5a, src.size());
+    auto saved = getMaxWorkerThreads();
+    for (uint32_t threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2) {
+        setMaxWorkerThreads(threads);
+        ImageProxy d     = dst.proxy();
+        auto       start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 5; ++i) convert(src.proxy(), d);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        RG_LOGI("convert 565 -> RGBA16F, %2u threads: %8.1f Mpixels/s", threads, 4096.0 * 4096.0 * 5 / elapsed.count() / 1e6);
+    }
+    for (auto format : { ColorFormat::DXT1_UNORM(), ColorFormat::DXT5_UNORM(), ColorFormat::DXN_UNORM() }) {
+        auto bc   = RawImage(ImageDesc(ImagePlaneDesc::make(format, 4096, 4096), 1, 1));
+        auto rgba = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 4096, 4096), 1, 1));
+        std::mt19937 rng(1);
+        for (uint32_t i = 0; i < bc.size(); ++i) bc.data()[i] = (uint8_t)rng();
+        setMaxWorkerThreads(0);
+        ImageProxy d     = rgba.proxy();
+        auto       start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 5; ++i) convert(bc.proxy(), d);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        RG_LOGI("decode format 0x%08X -> RGBA8: %8.1f Mpixels/s", format.u32, 4096.0 * 4096.0 * 5 / elapsed.count() / 1e6);
+    }
+    setMaxWorkerThreads(saved);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Throughput of resample() against a naive (single threaded, per pixel) bilinear filter. Hidden by default. Run with
+// "[perf]" to see the numbers.
+TEST_CASE("resample-perf", "[.][perf]") {
+    auto src = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 2048, 2048), 1, 1));
+    std::mt19937 rng(1);
+    for (uint32_t i = 0; i < src.size(); ++i) src.data()[i] = (uint8_t)rng();
+    const int loops = 5;
+    for (auto size : { std::make_pair(1280u, 720u), std::make_pair(3000u, 2500u) }) {
+        auto dst = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), size.first, size.second), 1, 1));
+        auto report = [&](const char * name, auto && proc) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < loops; ++i) proc();
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            RG_LOGI("2048x2048 -> %ux%u %-9s %8.1f Mpixels/s", size.first, size.second, name,
+                    (double)size.first * size.second * loops / elapsed.count() / 1e6);
+        };
+        report("bilinear", [&] {
+            const float sx = 2048.0f / (float)size.first, sy = 2048.0f / (float)size.second;
+            for (uint32_t y = 0; y < size.second; ++y) {
+                float    fy = std::clamp(((float)y + 0.5f) * sy - 0.5f, 0.0f, 2047.0f);
+                uint32_t y0 = (uint32_t)fy, y1 = std::min(y0 + 1, 2047u);
+                float    wy = fy - (float)y0;
+                for (uint32_t x = 0; x < size.first; ++x) {
+                    float           fx = std::clamp(((float)x + 0.5f) * sx - 0.5f, 0.0f, 2047.0f);
+                    uint32_t        x0 = (uint32_t)fx, x1 = std::min(x0 + 1, 2047u);
+                    float           wx = fx - (float)x0;
+                    const uint8_t * r0 = src.data() + y0 * 2048 * 4;
+                    const uint8_t * r1 = src.data() + y1 * 2048 * 4;
+                    uint8_t *       d  = dst.data() + (y * size.first + x) * 4;
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        float a = r0[x0 * 4 + c] * (1.0f - wx) + r0[x1 * 4 + c] * wx;
+                        float b = r1[x0 * 4 + c] * (1.0f - wx) + r1[x1 * 4 + c] * wx;
+                        d[c]    = (uint8_t)(a * (1.0f - wy) + b * wy + 0.5f);
+                    }
+                }
+            }
+        });
+        for (auto filter : { ImageFilter::BOX, ImageFilter::TRIANGLE, ImageFilter::LANCZOS }) {
+            const char * names[] = { "box", "triangle", "kaiser", "lanczos" };
+            ImageProxy   d       = dst.proxy();
+            report(names[(int)filter], [&] { resample(src.proxy(), d, filter); });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Throughput of mipmap generation of a volume texture. Hidden by default. Run with "[perf]" to see the numbers.
+TEST_CASE("volume-mipmap-perf", "[.][perf]") {
+    auto image = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), 256, 256, 256), 1, 0));
+    memset(image.data(), 0x5a, image.size());
+    for (auto filter : { ImageFilter::BOX, ImageFilter::TRIANGLE }) {
+        auto start = std::chrono::high_resolution_clock::now();
+        generateMipmaps(image, filter);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        RG_LOGI("256^3 RGBA8 volume mipmaps, filter %d: %8.1f Mvoxels/s", (int)filter, 256.0 * 256.0 * 256.0 / elapsed.count() / 1e6);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Throughput and PSNR of the block encoders. Hidden by default. Run with "[perf]" to see the numbers.
+TEST_CASE("block-encode-perf", "[.][perf]") {
+    const uint32_t size  = 1024;
+    auto           image = makeBlockTestImage(size, size);
+    const struct {
+        const char * name;
+        ColorFormat  format;
+        uint32_t     channels;
+    } cases[] = {
+        { "DXT1", ColorFormat::DXT1_UNORM(), 7 },
+        { "DXT5", ColorFormat::DXT5_UNORM(), 15 },
+        { "DXT5A", ColorFormat::DXT5A_UNORM(), 1 },
+        { "DXN", ColorFormat::DXN_UNORM(), 3 },
+        { "BC7", ColorFormat::BC7_UNORM(), 15 },
+    };
+    for (uint32_t i = 3; i < image.size(); i += 4) image.data()[i] = 255;
+    for (const auto & c : cases) {
+        for (auto quality : { CompressionQuality::FAST, CompressionQuality::HIGH }) {
+            auto       encoded = RawImage(ImageDesc(ImagePlaneDesc::make(c.format, size, size), 1, 1));
+            auto       decoded = RawImage(ImageDesc(ImagePlaneDesc::make(ColorFormat::RGBA8(), size, size), 1, 1));
+            ImageProxy e       = encoded.proxy();
+            ImageProxy d       = decoded.proxy();
+            auto       start   = std::chrono::high_resolution_clock::now();
+            convert(image.proxy(), e, quality);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            convert(encoded.proxy(), d);
+            RG_LOGI("encode %-5s %-4s: %8.2f Mpixels/s, PSNR %6.2f dB", c.name,
+                    CompressionQuality::FAST == quality ? "fast" : "high", (double)size * size / elapsed.count() / 1e6,
+                    psnrRGBA8(image, decoded, c.channels));
+        }
+    }
 }
 
 // ---------------------------------------------------------------------------------------------------------------------